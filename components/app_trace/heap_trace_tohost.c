@@ -74,6 +74,16 @@ void heap_trace_dump(void)
     return;
 }
 
+esp_err_t heap_trace_summary_get(size_t index, heap_trace_site_t *site)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void heap_trace_summary_dump(void)
+{
+    return;
+}
+
 /* Add a new allocation to the heap trace records */
 static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 {
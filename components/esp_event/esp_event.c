@@ -13,7 +13,9 @@
 // limitations under the License.
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <sys/param.h>
 #include <stdio.h>
 #include <stdbool.h>
 
@@ -27,8 +29,33 @@
 #include "esp_timer.h"
 #endif
 
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+#include "esp_heap_caps_pool.h"
+#endif
+
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+#include "esp_heap_caps.h"
+#endif
+
 /* ---------------------------- Definitions --------------------------------- */
 
+// Initial number of slots of a loop's dispatch index, must be a power of 2
+#define DISPATCH_INDEX_INITIAL_SIZE   16
+// The dispatch index is cleared when it holds this many entries, or as many entries as there are handlers
+// registered to the loop if that is more, so that posting many different events doesn't take up memory indefinitely
+#define DISPATCH_INDEX_MAX_ENTRIES    128
+
+#define ALIGN_UP(num, align)          (((num) + ((align) - 1)) & ~((align) - 1))
+
+// Alignment of the events of a batch and of their data
+#define BATCH_ALIGN                   8
+// Space taken by an event of a batch with data_size bytes of data
+#define BATCH_RECORD_SIZE(data_size)  ALIGN_UP(sizeof(esp_event_batch_record_t) + (data_size), BATCH_ALIGN)
+
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+#define BATCH_RING_SIZE               (CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE & ~(BATCH_ALIGN - 1))
+#endif
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
 // LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.>
 #define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u\n"
@@ -54,6 +81,14 @@ static SLIST_HEAD(esp_event_loop_instance_list_t, esp_event_loop_instance) s_eve
 static portMUX_TYPE s_event_loops_spinlock = portMUX_INITIALIZER_UNLOCKED;
 #endif
 
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+// Copies of small event data are taken from this pool, shared by all event loops. It is created
+// along with the first event loop and never deleted.
+static heap_caps_pool_handle_t s_post_data_pool = NULL;
+
+static portMUX_TYPE s_post_data_pool_spinlock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
 
 /* ------------------------- Static Functions ------------------------------- */
 
@@ -122,30 +157,17 @@ static void esp_event_loop_run_task(void* args)
     vTaskSuspend(NULL);
 }
 
-static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_node_t *handler, esp_event_post_instance_t post)
+static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_node_t *handler,
+                            esp_event_base_t base, int32_t id, void* data)
 {
-    ESP_LOGD(TAG, "running post %s:%d with handler %p and context %p on loop %p", post.base, post.id, handler->handler_ctx->handler, &handler->handler_ctx, loop);
+    ESP_LOGD(TAG, "running post %s:%d with handler %p and context %p on loop %p", base, id, handler->handler_ctx->handler, &handler->handler_ctx, loop);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     int64_t start, diff;
     start = esp_timer_get_time();
 #endif
     // Execute the handler
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
-    void* data_ptr = NULL;
-
-    if (post.data_set) {
-        if (post.data_allocated) {
-            data_ptr = post.data.ptr;
-        } else {
-            data_ptr = &post.data.val;
-        }
-    }
-
-    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, post.base, post.id, data_ptr);
-#else
-    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, post.base, post.id, post.data);
-#endif
+    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, base, id, data);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     diff = esp_timer_get_time() - start;
@@ -159,7 +181,8 @@ static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_n
 #endif
 }
 
-static esp_err_t handler_instances_add(esp_event_handler_nodes_t* handlers, esp_event_handler_t event_handler, void* event_handler_arg, esp_event_handler_instance_context_t **handler_ctx, bool legacy)
+/* Sets *added if a handler node was added, not if a legacy handler was registered again */
+static esp_err_t handler_instances_add(esp_event_handler_nodes_t* handlers, esp_event_handler_t event_handler, void* event_handler_arg, esp_event_handler_instance_context_t **handler_ctx, bool legacy, bool *added)
 {
     esp_event_handler_node_t *handler_instance = calloc(1, sizeof(*handler_instance));
 
@@ -203,6 +226,7 @@ static esp_err_t handler_instances_add(esp_event_handler_nodes_t* handlers, esp_
     if (handler_ctx) {
         *handler_ctx = context;
     }
+    *added = true;
 
     return ESP_OK;
 }
@@ -212,10 +236,11 @@ static esp_err_t base_node_add_handler(esp_event_base_node_t* base_node,
         esp_event_handler_t event_handler,
         void *event_handler_arg,
         esp_event_handler_instance_context_t **handler_ctx,
-        bool legacy)
+        bool legacy,
+        bool *added)
 {
     if (id == ESP_EVENT_ANY_ID) {
-        return handler_instances_add(&(base_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy);
+        return handler_instances_add(&(base_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy, added);
     }
     else {
         esp_err_t err = ESP_OK;
@@ -240,7 +265,7 @@ static esp_err_t base_node_add_handler(esp_event_base_node_t* base_node,
 
             SLIST_INIT(&(id_node->handlers));
 
-            err = handler_instances_add(&(id_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy);
+            err = handler_instances_add(&(id_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy, added);
 
             if (err == ESP_OK) {
                 if (!last_id_node) {
@@ -256,7 +281,7 @@ static esp_err_t base_node_add_handler(esp_event_base_node_t* base_node,
             return err;
         }
         else {
-            return handler_instances_add(&(id_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy);
+            return handler_instances_add(&(id_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy, added);
         }
     }
 }
@@ -267,10 +292,11 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node,
         esp_event_handler_t event_handler,
         void *event_handler_arg,
         esp_event_handler_instance_context_t **handler_ctx,
-        bool legacy)
+        bool legacy,
+        bool *added)
 {
     if (base == esp_event_any_base && id == ESP_EVENT_ANY_ID) {
-        return handler_instances_add(&(loop_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy);
+        return handler_instances_add(&(loop_node->handlers), event_handler, event_handler_arg, handler_ctx, legacy, added);
     }
     else {
         esp_err_t err = ESP_OK;
@@ -299,7 +325,7 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node,
             SLIST_INIT(&(base_node->handlers));
             SLIST_INIT(&(base_node->id_nodes));
 
-            err = base_node_add_handler(base_node, id, event_handler, event_handler_arg, handler_ctx, legacy);
+            err = base_node_add_handler(base_node, id, event_handler, event_handler_arg, handler_ctx, legacy, added);
 
             if (err == ESP_OK) {
                 if (!last_base_node) {
@@ -314,12 +340,25 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node,
 
             return err;
         } else {
-            return base_node_add_handler(base_node, id, event_handler, event_handler_arg, handler_ctx, legacy);
+            return base_node_add_handler(base_node, id, event_handler, event_handler_arg, handler_ctx, legacy, added);
         }
     }
 }
 
-static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static void handler_node_delete(esp_event_loop_instance_t* loop, esp_event_handler_node_t* handler)
+{
+    loop->registered_handlers--;
+    if (loop->dispatch_depth > 0) {
+        // The handler may be in the dispatch entry of an event being dispatched, free it afterwards
+        handler->removed = true;
+        SLIST_INSERT_HEAD(&(loop->removed_handlers), handler, next);
+    } else {
+        free(handler->handler_ctx);
+        free(handler);
+    }
+}
+
+static esp_err_t handler_instances_remove(esp_event_loop_instance_t* loop, esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     esp_event_handler_node_t *it, *temp;
 
@@ -327,15 +366,13 @@ static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, e
         if (legacy) {
             if (it->handler_ctx->handler == handler_ctx->handler) {
                 SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_node_delete(loop, it);
                 return ESP_OK;
             }
         } else {
             if (it->handler_ctx == handler_ctx) {
                 SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_node_delete(loop, it);
                 return ESP_OK;
             }
         }
@@ -345,16 +382,16 @@ static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, e
 }
 
 
-static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t base_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     if (id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(base_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(loop, &(base_node->handlers), handler_ctx, legacy);
     }
     else {
         esp_event_id_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(base_node->id_nodes), next, temp) {
             if (it->id == id) {
-                esp_err_t res = handler_instances_remove(&(it->handlers), handler_ctx, legacy);
+                esp_err_t res = handler_instances_remove(loop, &(it->handlers), handler_ctx, legacy);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers))) {
@@ -370,16 +407,16 @@ static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int3
     return ESP_ERR_NOT_FOUND;
 }
 
-static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t loop_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     if (base == esp_event_any_base && id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(loop_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(loop, &(loop_node->handlers), handler_ctx, legacy);
     }
     else {
         esp_event_base_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(loop_node->base_nodes), next, temp) {
             if (it->base == base) {
-                esp_err_t res = base_node_remove_handler(it, id, handler_ctx, legacy);
+                esp_err_t res = base_node_remove_handler(loop, it, id, handler_ctx, legacy);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers)) && SLIST_EMPTY(&(it->id_nodes))) {
@@ -429,20 +466,516 @@ static void loop_node_remove_all_handler(esp_event_loop_node_t* loop_node)
     }
 }
 
-static void inline __attribute__((always_inline)) post_instance_delete(esp_event_post_instance_t* post)
+static void dispatch_entry_release(esp_event_dispatch_entry_t* entry)
+{
+    if (--entry->refs == 0) {
+        free(entry);
+    }
+}
+
+static void dispatch_index_clear(esp_event_loop_instance_t* loop)
+{
+    for (size_t i = 0; i < loop->dispatch_index_size; i++) {
+        if (loop->dispatch_index[i] != NULL) {
+            dispatch_entry_release(loop->dispatch_index[i]);
+            loop->dispatch_index[i] = NULL;
+        }
+    }
+    loop->dispatch_index_count = 0;
+}
+
+static inline size_t dispatch_index_slot(esp_event_base_t base, int32_t id, size_t size)
+{
+    uint32_t hash = ((uint32_t) (uintptr_t) base * 2654435761u) ^ ((uint32_t) id * 2246822519u);
+    return (hash ^ (hash >> 16)) & (size - 1);
+}
+
+static void dispatch_index_put(esp_event_dispatch_entry_t** index, size_t size, esp_event_dispatch_entry_t* entry)
+{
+    size_t i = dispatch_index_slot(entry->base, entry->id, size);
+    while (index[i] != NULL) {
+        i = (i + 1) & (size - 1);
+    }
+    index[i] = entry;
+}
+
+static void dispatch_index_insert(esp_event_loop_instance_t* loop, esp_event_dispatch_entry_t* entry)
+{
+    if (loop->dispatch_index_count >= MAX(DISPATCH_INDEX_MAX_ENTRIES, loop->registered_handlers)) {
+        dispatch_index_clear(loop);
+    }
+
+    // Keep the index at most half full
+    if ((loop->dispatch_index_count + 1) * 2 > loop->dispatch_index_size) {
+        size_t size = loop->dispatch_index_size ? loop->dispatch_index_size * 2 : DISPATCH_INDEX_INITIAL_SIZE;
+        esp_event_dispatch_entry_t** index = calloc(size, sizeof(*index));
+        if (index == NULL) {
+            // Not fatal, the entry is used for this event only
+            return;
+        }
+        for (size_t i = 0; i < loop->dispatch_index_size; i++) {
+            if (loop->dispatch_index[i] != NULL) {
+                dispatch_index_put(index, size, loop->dispatch_index[i]);
+            }
+        }
+        free(loop->dispatch_index);
+        loop->dispatch_index = index;
+        loop->dispatch_index_size = size;
+    }
+
+    dispatch_index_put(loop->dispatch_index, loop->dispatch_index_size, entry);
+    loop->dispatch_index_count++;
+    entry->refs++;
+}
+
+/* Collect the handlers to execute for an event in the order of execution, which is the order they are found
+   in when walking the loop nodes. If handlers is NULL, only count them. */
+static size_t dispatch_collect(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id, esp_event_handler_node_t** handlers)
+{
+    size_t count = 0;
+    esp_event_handler_node_t *handler;
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        // Loop level handlers
+        SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+            if (handlers) {
+                handlers[count] = handler;
+            }
+            count++;
+        }
+
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            if (base_node->base == base) {
+                // Base level handlers
+                SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                    if (handlers) {
+                        handlers[count] = handler;
+                    }
+                    count++;
+                }
+
+                SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                    if (id_node->id == id) {
+                        // Id level handlers
+                        SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                            if (handlers) {
+                                handlers[count] = handler;
+                            }
+                            count++;
+                        }
+                        // Skip to next base node
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/* Find the handlers to execute for an event in the dispatch index, or build the list if the event is not in
+   the index yet. Returns NULL if out of memory. */
+static esp_event_dispatch_entry_t* dispatch_entry_get(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_entry_t* entry;
+
+    if (loop->dispatch_index_count > 0) {
+        size_t mask = loop->dispatch_index_size - 1;
+        for (size_t i = dispatch_index_slot(base, id, loop->dispatch_index_size);
+                (entry = loop->dispatch_index[i]) != NULL; i = (i + 1) & mask) {
+            if (entry->base == base && entry->id == id) {
+                return entry;
+            }
+        }
+    }
+
+    size_t count = dispatch_collect(loop, base, id, NULL);
+    entry = malloc(sizeof(*entry) + count * sizeof(entry->handlers[0]));
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->base = base;
+    entry->id = id;
+    entry->refs = 0;
+    entry->handlers_count = dispatch_collect(loop, base, id, entry->handlers);
+
+    dispatch_index_insert(loop, entry);
+    return entry;
+}
+
+static void removed_handlers_free(esp_event_loop_instance_t* loop)
+{
+    esp_event_handler_node_t *it;
+    while ((it = SLIST_FIRST(&(loop->removed_handlers))) != NULL) {
+        SLIST_REMOVE_HEAD(&(loop->removed_handlers), next);
+        free(it->handler_ctx);
+        free(it);
+    }
+}
+
+/* Execute the handlers of an event by walking the loop nodes, without the dispatch index */
+static bool event_dispatch_walk(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id, void* data)
+{
+    bool exec = false;
+    esp_event_handler_node_t *handler, *temp_handler;
+    esp_event_loop_node_t *loop_node, *temp_node;
+    esp_event_base_node_t *base_node, *temp_base;
+    esp_event_id_node_t *id_node, *temp_id_node;
+
+    SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
+        // Execute loop level handlers
+        SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
+            if (!handler->removed) {
+                handler_execute(loop, handler, base, id, data);
+                exec |= true;
+            }
+        }
+
+        SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
+            if (base_node->base == base) {
+                // Execute base level handlers
+                SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
+                    if (!handler->removed) {
+                        handler_execute(loop, handler, base, id, data);
+                        exec |= true;
+                    }
+                }
+
+                SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
+                    if (id_node->id == id) {
+                        // Execute id level handlers
+                        SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
+                            if (!handler->removed) {
+                                handler_execute(loop, handler, base, id, data);
+                                exec |= true;
+                            }
+                        }
+                        // Skip to next base node
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return exec;
+}
+
+/* Execute the handlers of an event */
+static void event_dispatch(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id, void* data)
+{
+    bool exec = false;
+
+    esp_event_dispatch_entry_t* entry = dispatch_entry_get(loop, base, id);
+
+    // Handlers may register or unregister handlers, keep the entry and the handlers in it alive
+    // until the event has been dispatched
+    loop->dispatch_depth++;
+
+    if (entry != NULL) {
+        entry->refs++;
+        for (size_t i = 0; i < entry->handlers_count; i++) {
+            esp_event_handler_node_t *handler = entry->handlers[i];
+            if (!handler->removed) {
+                handler_execute(loop, handler, base, id, data);
+                exec |= true;
+            }
+        }
+        dispatch_entry_release(entry);
+    } else {
+        // Out of memory for the index, which is only there to speed dispatching up
+        ESP_LOGD(TAG, "alloc for dispatch index entry of event %s:%d failed", base, id);
+        exec = event_dispatch_walk(loop, base, id, data);
+    }
+
+    loop->dispatch_depth--;
+
+    if (loop->dispatch_depth == 0) {
+        removed_handlers_free(loop);
+    }
+
+    if (!exec) {
+        // No handlers were registered, not even loop/base level handlers
+        ESP_LOGD(TAG, "no handlers have been registered for event %s:%d posted to loop %p", base, id, loop);
+    }
+}
+
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+static void post_data_pool_init(void)
+{
+    if (s_post_data_pool != NULL) {
+        return;
+    }
+
+    heap_caps_pool_handle_t pool = heap_caps_pool_create_growable(CONFIG_ESP_EVENT_POST_DATA_POOL_OBJ_SIZE,
+                                        CONFIG_ESP_EVENT_POST_DATA_POOL_SLAB_COUNT,
+                                        CONFIG_ESP_EVENT_POST_DATA_POOL_SLAB_COUNT * CONFIG_ESP_EVENT_POST_DATA_POOL_MAX_SLABS,
+                                        MALLOC_CAP_DEFAULT);
+    if (pool == NULL) {
+        // Not fatal, event data is then copied to the heap as usual
+        ESP_LOGW(TAG, "create event data pool failed");
+        return;
+    }
+
+    portENTER_CRITICAL(&s_post_data_pool_spinlock);
+    if (s_post_data_pool == NULL) {
+        s_post_data_pool = pool;
+        pool = NULL;
+    }
+    portEXIT_CRITICAL(&s_post_data_pool_spinlock);
+
+    // Another loop got there first
+    heap_caps_pool_delete(pool);
+}
+#endif
+
+static void* post_data_alloc(esp_event_post_instance_t* post, size_t size)
+{
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+    if (size <= CONFIG_ESP_EVENT_POST_DATA_POOL_OBJ_SIZE && s_post_data_pool != NULL) {
+        void* data = heap_caps_pool_alloc(s_post_data_pool);
+        if (data != NULL) {
+            post->data_pooled = true;
+            return data;
+        }
+    }
+#endif
+    return malloc(size);
+}
+
+static void inline __attribute__((always_inline)) post_data_free(esp_event_post_instance_t* post, void* data)
+{
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+    if (post->data_pooled) {
+        // Only data taken from the pool is marked as pooled, anything else means corrupt post instances
+        ESP_ERROR_CHECK(heap_caps_pool_free(s_post_data_pool, data));
+        return;
+    }
+#endif
+    free(data);
+}
+
+static inline void* post_data_get(esp_event_post_instance_t* post)
 {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
-    if (post->data_allocated && post->data.ptr) {
-        free(post->data.ptr);
+    if (!post->data_set) {
+        return NULL;
     }
+    return post->data_allocated ? post->data.ptr : &post->data.val;
+#else
+    return post->data;
+#endif
+}
+
+static inline void post_data_set(esp_event_post_instance_t* post, void* data)
+{
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+    post->data.ptr = data;
+    post->data_allocated = true;
+    post->data_set = true;
 #else
-    if (post->data) {
-        free(post->data);
+    post->data = data;
+#endif
+}
+
+static inline bool post_is_batch(const esp_event_post_instance_t* post)
+{
+    // Single events can't be posted with ESP_EVENT_ANY_BASE
+    return post->base == ESP_EVENT_ANY_BASE;
+}
+
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+/* Batches are placed in the ring one after the other, each preceded by a header. When a batch doesn't fit
+   in the space left at the end of the ring, that space is taken up by a free padding block and the batch
+   is placed at the start. Batches are usually freed in the order they were posted, but not always: a batch
+   posted later may end up on the event queue first. Freed batches are therefore only marked as free, and the
+   tail of the ring is moved past all the free blocks it is followed by. */
+typedef struct {
+    uint32_t size;                  // size of the block, including this header
+    uint32_t free;                  // the block is padding or a batch which has been dispatched
+    uint8_t batch[0] __attribute__((aligned(8)));
+} batch_ring_block_t;
+
+static void batch_ring_init(esp_event_loop_instance_t* loop)
+{
+    uint8_t* ring = heap_caps_aligned_alloc(BATCH_ALIGN, BATCH_RING_SIZE, MALLOC_CAP_DEFAULT);
+    if (ring == NULL) {
+        // Not fatal, batches are then copied to the heap
+        return;
+    }
+
+    portENTER_CRITICAL(&loop->batch_ring_spinlock);
+    if (loop->batch_ring == NULL) {
+        loop->batch_ring = ring;
+        ring = NULL;
+    }
+    portEXIT_CRITICAL(&loop->batch_ring_spinlock);
+
+    // Another task posting a batch got there first
+    heap_caps_free(ring);
+}
+
+static esp_event_post_batch_t* batch_ring_alloc(esp_event_loop_instance_t* loop, size_t size)
+{
+    size = ALIGN_UP(sizeof(batch_ring_block_t) + size, BATCH_ALIGN);
+    if (size > BATCH_RING_SIZE) {
+        return NULL;
+    }
+
+    batch_ring_block_t* block = NULL;
+
+    portENTER_CRITICAL(&loop->batch_ring_spinlock);
+    if (loop->batch_ring_used == 0) {
+        loop->batch_ring_head = loop->batch_ring_tail = 0;
+    }
+
+    size_t head = loop->batch_ring_head;
+    size_t pad = (BATCH_RING_SIZE - head < size) ? BATCH_RING_SIZE - head : 0;
+
+    if (loop->batch_ring_used + pad + size <= BATCH_RING_SIZE) {
+        if (pad) {
+            batch_ring_block_t* padding = (batch_ring_block_t*) (loop->batch_ring + head);
+            padding->size = pad;
+            padding->free = true;
+            head = 0;
+        }
+        block = (batch_ring_block_t*) (loop->batch_ring + head);
+        block->size = size;
+        block->free = false;
+        loop->batch_ring_head = (head + size) % BATCH_RING_SIZE;
+        loop->batch_ring_used += pad + size;
+    }
+    portEXIT_CRITICAL(&loop->batch_ring_spinlock);
+
+    return block ? (esp_event_post_batch_t*) block->batch : NULL;
+}
+
+static void batch_ring_free(esp_event_loop_instance_t* loop, esp_event_post_batch_t* batch)
+{
+    batch_ring_block_t* block = (batch_ring_block_t*) ((uint8_t*) batch - offsetof(batch_ring_block_t, batch));
+
+    portENTER_CRITICAL(&loop->batch_ring_spinlock);
+    block->free = true;
+    while (loop->batch_ring_used > 0) {
+        batch_ring_block_t* tail = (batch_ring_block_t*) (loop->batch_ring + loop->batch_ring_tail);
+        if (!tail->free) {
+            break;
+        }
+        loop->batch_ring_used -= tail->size;
+        loop->batch_ring_tail = (loop->batch_ring_tail + tail->size) % BATCH_RING_SIZE;
+    }
+    portEXIT_CRITICAL(&loop->batch_ring_spinlock);
+}
+#endif
+
+static esp_event_post_batch_t* batch_alloc(esp_event_loop_instance_t* loop, size_t size)
+{
+    esp_event_post_batch_t* batch = NULL;
+
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+    if (loop->batch_ring == NULL) {
+        batch_ring_init(loop);
+    }
+    if (loop->batch_ring != NULL) {
+        batch = batch_ring_alloc(loop, size);
+    }
+    if (batch != NULL) {
+        batch->in_ring = true;
+        return batch;
+    }
+#endif
+
+    batch = malloc(size);
+    if (batch != NULL) {
+        batch->in_ring = false;
+    }
+    return batch;
+}
+
+static void batch_free(esp_event_loop_instance_t* loop, esp_event_post_batch_t* batch)
+{
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+    if (batch->in_ring) {
+        batch_ring_free(loop, batch);
+        return;
+    }
+#endif
+    free(batch);
+}
+
+/* Dispatch a post taken from the event queue, which may be a batch of events */
+static void post_dispatch(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
+{
+    if (!post_is_batch(post)) {
+        event_dispatch(loop, post->base, post->id, post_data_get(post));
+        return;
+    }
+
+    esp_event_post_batch_t* batch = post_data_get(post);
+    uint8_t* it = batch->records;
+
+    for (uint32_t i = 0; i < batch->count; i++) {
+        esp_event_batch_record_t* record = (esp_event_batch_record_t*) it;
+        event_dispatch(loop, record->base, record->id, record->data_size ? record->data : NULL);
+        it += BATCH_RECORD_SIZE(record->data_size);
     }
+}
+
+static void inline __attribute__((always_inline)) post_instance_delete(esp_event_loop_instance_t* loop,
+                                                                       esp_event_post_instance_t* post)
+{
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+    void* data = post->data_allocated ? post->data.ptr : NULL;
+#else
+    void* data = post->data;
 #endif
+    if (data) {
+        if (post_is_batch(post)) {
+            batch_free(loop, data);
+        } else {
+            post_data_free(post, data);
+        }
+    }
     memset(post, 0, sizeof(*post));
 }
 
+/* Put a post on the event queue of the loop */
+static BaseType_t post_instance_send(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post,
+                                     TickType_t ticks_to_wait)
+{
+    BaseType_t result = pdFALSE;
+
+    // Find the task that currently executes the loop. It is safe to query loop->task since it is
+    // not mutated since loop creation. ENSURE THIS REMAINS TRUE.
+    if (loop->task == NULL) {
+        // The loop has no dedicated task. Find out what task is currently running it.
+        result = xSemaphoreTakeRecursive(loop->mutex, ticks_to_wait);
+
+        if (result == pdTRUE) {
+            if (loop->running_task != xTaskGetCurrentTaskHandle()) {
+                xSemaphoreGiveRecursive(loop->mutex);
+                result = xQueueSendToBack(loop->queue, post, ticks_to_wait);
+            } else {
+                xSemaphoreGiveRecursive(loop->mutex);
+                result = xQueueSendToBack(loop->queue, post, 0);
+            }
+        }
+    } else {
+        // The loop has a dedicated task.
+        if (loop->task != xTaskGetCurrentTaskHandle()) {
+            result = xQueueSendToBack(loop->queue, post, ticks_to_wait);
+        } else {
+            result = xQueueSendToBack(loop->queue, post, 0);
+        }
+    }
+
+    return result;
+}
+
 /* ---------------------------- Public API --------------------------------- */
 
 esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
@@ -487,6 +1020,14 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
 #endif
 
     SLIST_INIT(&(loop->loop_nodes));
+    SLIST_INIT(&(loop->removed_handlers));
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+    portMUX_INITIALIZE(&loop->batch_ring_spinlock);
+#endif
+
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+    post_data_pool_init();
+#endif
 
     // Create the loop task if requested
     if (event_loop_args->task_name != NULL) {
@@ -542,12 +1083,10 @@ on_err:
     return err;
 }
 
-// On event lookup performance: The library implements the event list as a linked list, which results to O(n)
-// lookup time. The test comparing this implementation to the O(lg n) performance of rbtrees
-// (https://github.com/freebsd/freebsd/blob/master/sys/sys/tree.h)
-// indicate that the difference is not that substantial, especially considering the additional
-// pointers per node of rbtrees. Code for the rbtree implementation of the event loop library is archived
-// in feature/esp_event_loop_library_rbtrees if needed.
+// On event lookup performance: The library stores the registered handlers in linked lists, which are walked
+// to find the handlers for an event. To avoid doing this for every posted event, the resulting list of
+// handlers is kept in a per-loop hash table keyed by (base, id), the dispatch index. The dispatch index is
+// cleared whenever handlers are registered or unregistered, and entries are rebuilt as events are posted.
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
 {
     assert(event_loop);
@@ -569,68 +1108,35 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
 
         loop->running_task = xTaskGetCurrentTaskHandle();
 
-        bool exec = false;
-
-        esp_event_handler_node_t *handler, *temp_handler;
-        esp_event_loop_node_t *loop_node, *temp_node;
-        esp_event_base_node_t *base_node, *temp_base;
-        esp_event_id_node_t *id_node, *temp_id_node;
+        bool expired = false;
+        int drained = 0;
 
-        SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
-            // Execute loop level handlers
-            SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
-                handler_execute(loop, handler, post);
-                exec |= true;
-            }
+        // Handle the events queued in the meantime as well, up to CONFIG_ESP_EVENT_LOOP_DRAIN_COUNT, before
+        // releasing the mutex
+        do {
+            post_dispatch(loop, &post);
+            post_instance_delete(loop, &post);
 
-            SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
-                if (base_node->base == post.base) {
-                    // Execute base level handlers
-                    SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
-                        handler_execute(loop, handler, post);
-                        exec |= true;
-                    }
-
-                    SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
-                        if (id_node->id == post.id) {
-                            // Execute id level handlers
-                            SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
-                                handler_execute(loop, handler, post);
-                                exec |= true;
-                            }
-                            // Skip to next base node
-                            break;
-                        }
-                    }
+            if (ticks_to_run != portMAX_DELAY) {
+                end = xTaskGetTickCount();
+                remaining_ticks -= end - marker;
+                marker = end;
+                // If the ticks to run expired, return to the caller
+                if (remaining_ticks <= 0) {
+                    expired = true;
+                    break;
                 }
             }
-        }
-
-        esp_event_base_t base = post.base;
-        int32_t id = post.id;
+        } while (++drained < CONFIG_ESP_EVENT_LOOP_DRAIN_COUNT && xQueueReceive(loop->queue, &post, 0) == pdTRUE);
 
-        post_instance_delete(&post);
-
-        if (ticks_to_run != portMAX_DELAY) {
-            end = xTaskGetTickCount();
-            remaining_ticks -= end - marker;
-            // If the ticks to run expired, return to the caller
-            if (remaining_ticks <= 0) {
-                xSemaphoreGiveRecursive(loop->mutex);
-                break;
-            } else {
-                marker = end;
-            }
+        if (expired) {
+            xSemaphoreGiveRecursive(loop->mutex);
+            break;
         }
 
         loop->running_task = NULL;
 
         xSemaphoreGiveRecursive(loop->mutex);
-
-        if (!exec) {
-            // No handlers were registered, not even loop/base level handlers
-            ESP_LOGD(TAG, "no handlers have been registered for event %s:%d posted to loop %p", base, id, event_loop);
-        }
     }
 
     return ESP_OK;
@@ -661,6 +1167,10 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
     }
 
     // Remove all registered events and handlers in the loop
+    dispatch_index_clear(loop);
+    free(loop->dispatch_index);
+    removed_handlers_free(loop);
+
     esp_event_loop_node_t *it, *temp;
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
         loop_node_remove_all_handler(it);
@@ -671,11 +1181,14 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
     // Drop existing posts on the queue
     esp_event_post_instance_t post;
     while(xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
     }
 
     // Cleanup loop
     vQueueDelete(loop->queue);
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+    heap_caps_free(loop->batch_ring);
+#endif
     free(loop);
     // Free loop mutex before deleting
     xSemaphoreGiveRecursive(loop_mutex);
@@ -709,6 +1222,7 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
     }
 
     esp_err_t err = ESP_OK;
+    bool added = false;
 
     xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
@@ -733,7 +1247,7 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
         SLIST_INIT(&(loop_node->handlers));
         SLIST_INIT(&(loop_node->base_nodes));
 
-        err = loop_node_add_handler(loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy);
+        err = loop_node_add_handler(loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy, &added);
 
         if (err == ESP_OK) {
             if (!last_loop_node) {
@@ -747,7 +1261,14 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
         }
     }
     else {
-        err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy);
+        err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy, &added);
+    }
+
+    if (err == ESP_OK) {
+        if (added) {
+            loop->registered_handlers++;
+        }
+        dispatch_index_clear(loop);
     }
 
 on_err:
@@ -790,7 +1311,7 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
     esp_event_loop_node_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
-        esp_err_t res = loop_node_remove_handler(it, event_base, event_id, handler_ctx, legacy);
+        esp_err_t res = loop_node_remove_handler(loop, it, event_base, event_id, handler_ctx, legacy);
 
         if (res == ESP_OK && SLIST_EMPTY(&(it->base_nodes)) && SLIST_EMPTY(&(it->handlers))) {
             SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
@@ -799,6 +1320,8 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
         }
     }
 
+    dispatch_index_clear(loop);
+
     xSemaphoreGiveRecursive(loop->mutex);
 
     return ESP_OK;
@@ -837,62 +1360,100 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     memset((void*)(&post), 0, sizeof(post));
 
     if (event_data != NULL && event_data_size != 0) {
-        // Make persistent copy of event data on heap.
-        void* event_data_copy = calloc(1, event_data_size);
+        // Make persistent copy of event data, from the post data pool if it fits or on heap.
+        void* event_data_copy = post_data_alloc(&post, event_data_size);
 
         if (event_data_copy == NULL) {
             return ESP_ERR_NO_MEM;
         }
 
         memcpy(event_data_copy, event_data, event_data_size);
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
-        post.data.ptr = event_data_copy;
-        post.data_allocated = true;
-        post.data_set = true;
-#else
-        post.data = event_data_copy;
-#endif
+        post_data_set(&post, event_data_copy);
     }
     post.base = event_base;
     post.id = event_id;
 
-    BaseType_t result = pdFALSE;
+    BaseType_t result = post_instance_send(loop, &post, ticks_to_wait);
 
-    // Find the task that currently executes the loop. It is safe to query loop->task since it is
-    // not mutated since loop creation. ENSURE THIS REMAINS TRUE.
-    if (loop->task == NULL) {
-        // The loop has no dedicated task. Find out what task is currently running it.
-        result = xSemaphoreTakeRecursive(loop->mutex, ticks_to_wait);
+    if (result != pdTRUE) {
+        post_instance_delete(loop, &post);
 
-        if (result == pdTRUE) {
-            if (loop->running_task != xTaskGetCurrentTaskHandle()) {
-                xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
-            } else {
-                xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, 0);
-            }
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+        atomic_fetch_add(&loop->events_dropped, 1);
+#endif
+        return ESP_ERR_TIMEOUT;
+    }
+
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    atomic_fetch_add(&loop->events_recieved, 1);
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post_batch_to(esp_event_loop_handle_t event_loop, const esp_event_post_item_t* events,
+                                  size_t events_count, TickType_t ticks_to_wait)
+{
+    assert(event_loop);
+
+    if (events == NULL || events_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t size = sizeof(esp_event_post_batch_t);
+    for (size_t i = 0; i < events_count; i++) {
+        if (events[i].event_base == ESP_EVENT_ANY_BASE || events[i].event_id == ESP_EVENT_ANY_ID
+                || events[i].event_data_size > UINT32_MAX - BATCH_ALIGN) {
+            return ESP_ERR_INVALID_ARG;
         }
-    } else {
-        // The loop has a dedicated task.
-        if (loop->task != xTaskGetCurrentTaskHandle()) {
-            result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
-        } else {
-            result = xQueueSendToBack(loop->queue, &post, 0);
+        size_t data_size = events[i].event_data ? events[i].event_data_size : 0;
+        if (BATCH_RECORD_SIZE(data_size) > SIZE_MAX - size) {
+            return ESP_ERR_NO_MEM;
         }
+        size += BATCH_RECORD_SIZE(data_size);
+    }
+
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+
+    // Copy all the events of the batch, with their data, to a single block
+    esp_event_post_batch_t* batch = batch_alloc(loop, size);
+    if (batch == NULL) {
+        return ESP_ERR_NO_MEM;
     }
 
+    batch->count = events_count;
+    uint8_t* it = batch->records;
+    for (size_t i = 0; i < events_count; i++) {
+        esp_event_batch_record_t* record = (esp_event_batch_record_t*) it;
+        size_t data_size = events[i].event_data ? events[i].event_data_size : 0;
+        record->base = events[i].event_base;
+        record->id = events[i].event_id;
+        record->data_size = data_size;
+        if (data_size) {
+            memcpy(record->data, events[i].event_data, data_size);
+        }
+        it += BATCH_RECORD_SIZE(data_size);
+    }
+
+    esp_event_post_instance_t post;
+    memset((void*)(&post), 0, sizeof(post));
+    post.base = ESP_EVENT_ANY_BASE;
+    post.id = ESP_EVENT_ANY_ID;
+    post_data_set(&post, batch);
+
+    BaseType_t result = post_instance_send(loop, &post, ticks_to_wait);
+
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
-        atomic_fetch_add(&loop->events_dropped, 1);
+        atomic_fetch_add(&loop->events_dropped, events_count);
 #endif
         return ESP_ERR_TIMEOUT;
     }
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
-    atomic_fetch_add(&loop->events_recieved, 1);
+    atomic_fetch_add(&loop->events_recieved, events_count);
 #endif
 
     return ESP_OK;
@@ -931,7 +1492,7 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_ba
     result = xQueueSendToBackFromISR(loop->queue, &post, task_unblocked);
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
         atomic_fetch_add(&loop->events_dropped, 1);
@@ -10,6 +10,7 @@
 #define CATCH_CONFIG_MAIN
 
 #include <stdio.h>
+#include <chrono>
 #include "esp_event.h"
 
 #include "catch.hpp"
@@ -43,6 +44,29 @@ static esp_event_loop_args_t test_event_get_default_loop_args(void)
 
 void dummy_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data) { }
 
+void counting_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    (*static_cast<int*>(event_handler_arg))++;
+}
+
+esp_event_loop_handle_t create_loop_without_task(void)
+{
+    esp_event_loop_handle_t loop = nullptr;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+    return loop;
+}
+
+void post_and_run(esp_event_loop_handle_t loop, esp_event_base_t base, int32_t id)
+{
+    REQUIRE(ESP_OK == esp_event_post_to(loop, base, id, nullptr, 0, 0));
+    REQUIRE(ESP_OK == esp_event_loop_run(loop, 1));
+}
+
+ESP_EVENT_DEFINE_BASE(s_test_base1);
+ESP_EVENT_DEFINE_BASE(s_test_base2);
+
 }
 
 // TODO: IDF-2693, function definition just to satisfy linker, implement esp_common instead
@@ -150,3 +174,264 @@ TEST_CASE("registering with ANY_BASE but specific ID fails") {
             dummy_handler,
             nullptr) == ESP_ERR_INVALID_ARG);
 }
+
+TEST_CASE("dispatch follows handler registration and unregistration")
+{
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    esp_event_handler_instance_t specific_ctx;
+    int specific = 0;
+    int any_id = 0;
+    int any_base = 0;
+
+    CHECK(ESP_OK == esp_event_handler_instance_register_with(loop, s_test_base1, 1,
+            counting_handler, &specific, &specific_ctx));
+    post_and_run(loop, s_test_base1, 1);
+    CHECK(specific == 1);
+
+    // handlers registered after an event has been dispatched once must be called for it too
+    CHECK(ESP_OK == esp_event_handler_register_with(loop, s_test_base1, ESP_EVENT_ANY_ID, counting_handler, &any_id));
+    CHECK(ESP_OK == esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID,
+            counting_handler, &any_base));
+    post_and_run(loop, s_test_base1, 1);
+    post_and_run(loop, s_test_base1, 2);
+    post_and_run(loop, s_test_base2, 1);
+    CHECK(specific == 2);
+    CHECK(any_id == 2);
+    CHECK(any_base == 3);
+
+    CHECK(ESP_OK == esp_event_handler_instance_unregister_with(loop, s_test_base1, 1, specific_ctx));
+    post_and_run(loop, s_test_base1, 1);
+    CHECK(specific == 2);
+    CHECK(any_id == 3);
+    CHECK(any_base == 4);
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+namespace {
+
+struct unregistering_handler_arg {
+    esp_event_loop_handle_t loop;
+    esp_event_handler_instance_t victim;
+    int calls;
+};
+
+void unregistering_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    unregistering_handler_arg *arg = static_cast<unregistering_handler_arg*>(event_handler_arg);
+    arg->calls++;
+    if (arg->victim != nullptr) {
+        CHECK(ESP_OK == esp_event_handler_instance_unregister_with(arg->loop, event_base, event_id, arg->victim));
+        arg->victim = nullptr;
+    }
+}
+
+}
+
+TEST_CASE("handler unregistered by an earlier handler of the same event is not called")
+{
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    unregistering_handler_arg arg = { loop, nullptr, 0 };
+    int victim_calls = 0;
+
+    CHECK(ESP_OK == esp_event_handler_register_with(loop, s_test_base1, 1, unregistering_handler, &arg));
+    CHECK(ESP_OK == esp_event_handler_instance_register_with(loop, s_test_base1, 1,
+            counting_handler, &victim_calls, &arg.victim));
+
+    post_and_run(loop, s_test_base1, 1);
+    CHECK(arg.calls == 1);
+    CHECK(victim_calls == 0);
+
+    post_and_run(loop, s_test_base1, 1);
+    CHECK(arg.calls == 2);
+    CHECK(victim_calls == 0);
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+namespace {
+
+double dispatch_events_per_second(int handler_count)
+{
+    static const char *bases[] = { "bench0", "bench1", "bench2", "bench3", "bench4",
+                                   "bench5", "bench6", "bench7", "bench8", "bench9" };
+    const int base_count = sizeof(bases) / sizeof(bases[0]);
+    const int id_count = handler_count / base_count;
+    const int event_count = 50000;
+    const int batch_size = QUEUE_SIZE;
+
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    int calls = 0;
+
+    for (int i = 0; i < handler_count; i++) {
+        REQUIRE(ESP_OK == esp_event_handler_register_with(loop, bases[i % base_count], i / base_count,
+                counting_handler, &calls));
+    }
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID,
+            counting_handler, &calls));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int posted = 0; posted < event_count; posted += batch_size) {
+        for (int i = posted; i < posted + batch_size; i++) {
+            esp_event_post_to(loop, bases[i % base_count], (i / base_count) % id_count, nullptr, 0, 0);
+        }
+        esp_event_loop_run(loop, 1);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // every event reaches its own handler and the ANY_BASE one
+    CHECK(calls == 2 * ((event_count + batch_size - 1) / batch_size) * batch_size);
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+    return calls / 2 / elapsed.count();
+}
+
+}
+
+TEST_CASE("dispatch throughput with 10, 100 and 1000 handlers", "[bench]")
+{
+    for (int handler_count : { 10, 100, 1000 }) {
+        printf("%4d handlers: %.0f events/s\n", handler_count, dispatch_events_per_second(handler_count));
+    }
+}
+
+namespace {
+
+struct recorded_event {
+    esp_event_base_t base;
+    int32_t id;
+    int data;
+};
+
+void recording_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    std::vector<recorded_event> *events = static_cast<std::vector<recorded_event>*>(event_handler_arg);
+    events->push_back({ event_base, event_id, event_data ? *static_cast<int*>(event_data) : -1 });
+}
+
+}
+
+TEST_CASE("batch of events is dispatched in order, with the events' data")
+{
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    std::vector<recorded_event> events;
+    int data[] = { 10, 20, 30 };
+    esp_event_post_item_t batch[] = {
+        { s_test_base1, 1, &data[0], sizeof(data[0]) },
+        { s_test_base2, 2, nullptr, 0 },
+        { s_test_base1, 3, &data[1], sizeof(data[1]) },
+    };
+
+    CHECK(ESP_OK == esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID,
+            recording_handler, &events));
+
+    CHECK(ESP_OK == esp_event_post_to(loop, s_test_base2, 4, &data[2], sizeof(data[2]), 0));
+    CHECK(ESP_OK == esp_event_post_batch_to(loop, batch, 3, 0));
+    data[0] = data[1] = 0; // the batch holds a copy of the data
+    CHECK(ESP_OK == esp_event_post_to(loop, s_test_base2, 5, nullptr, 0, 0));
+    CHECK(ESP_OK == esp_event_loop_run(loop, 1));
+
+    REQUIRE(events.size() == 5);
+    CHECK((events[0].base == s_test_base2 && events[0].id == 4 && events[0].data == 30));
+    CHECK((events[1].base == s_test_base1 && events[1].id == 1 && events[1].data == 10));
+    CHECK((events[2].base == s_test_base2 && events[2].id == 2 && events[2].data == -1));
+    CHECK((events[3].base == s_test_base1 && events[3].id == 3 && events[3].data == 20));
+    CHECK((events[4].base == s_test_base2 && events[4].id == 5 && events[4].data == -1));
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+TEST_CASE("batch with an invalid event is not posted")
+{
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    std::vector<recorded_event> events;
+    esp_event_post_item_t batch[] = {
+        { s_test_base1, 1, nullptr, 0 },
+        { s_test_base1, ESP_EVENT_ANY_ID, nullptr, 0 },
+    };
+
+    CHECK(ESP_OK == esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID,
+            recording_handler, &events));
+
+    CHECK(ESP_ERR_INVALID_ARG == esp_event_post_batch_to(loop, batch, 2, 0));
+    CHECK(ESP_ERR_INVALID_ARG == esp_event_post_batch_to(loop, batch, 0, 0));
+    CHECK(ESP_OK == esp_event_loop_run(loop, 1));
+    CHECK(events.empty());
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+TEST_CASE("posts left on the queue are freed when the loop is deleted")
+{
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    int data = 47;
+    esp_event_post_item_t batch[] = {
+        { s_test_base1, 1, &data, sizeof(data) },
+        { s_test_base1, 2, &data, sizeof(data) },
+    };
+
+    CHECK(ESP_OK == esp_event_post_to(loop, s_test_base1, 1, &data, sizeof(data), 0));
+    CHECK(ESP_OK == esp_event_post_batch_to(loop, batch, 2, 0));
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+namespace {
+
+void latency_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    static_cast<LatencyStats*>(event_handler_arg)->handled(*static_cast<int64_t*>(event_data));
+}
+
+void bench_bursts(bool batched)
+{
+    const int burst_size = 16;
+    const int burst_count = 5000;
+
+    MockLoopQueue queue;
+    esp_event_loop_handle_t loop = create_loop_without_task();
+    LatencyStats latency;
+
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, s_test_base1, ESP_EVENT_ANY_ID, latency_handler, &latency));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int burst = 0; burst < burst_count; burst++) {
+        int64_t posted[burst_size];
+        esp_event_post_item_t batch[burst_size];
+
+        for (int i = 0; i < burst_size; i++) {
+            posted[i] = LatencyStats::post();
+            if (batched) {
+                batch[i] = { s_test_base1, i, &posted[i], sizeof(posted[i]) };
+            } else {
+                esp_event_post_to(loop, s_test_base1, i, &posted[i], sizeof(posted[i]), 0);
+            }
+        }
+        if (batched) {
+            esp_event_post_batch_to(loop, batch, burst_size, 0);
+        }
+        esp_event_loop_run(loop, 1);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(latency.count() == burst_size * burst_count);
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+
+    printf("%s: %.0f events/s, latency p50 %lld ns, p90 %lld ns, p99 %lld ns\n",
+           batched ? "esp_event_post_batch_to" : "esp_event_post_to      ",
+           latency.count() / elapsed.count(), (long long) latency.percentile(50),
+           (long long) latency.percentile(90), (long long) latency.percentile(99));
+}
+
+}
+
+TEST_CASE("posting bursts of 16 events one by one and as batches", "[bench]")
+{
+    bench_bursts(false);
+    bench_bursts(true);
+}
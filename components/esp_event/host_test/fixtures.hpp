@@ -7,6 +7,11 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include "esp_event.h"
 
 #include "catch.hpp"
@@ -146,3 +151,114 @@ struct MockTask : public CMockFix {
 
     TaskHandle_t task;
 };
+
+/**
+ * Lets event loops without dedicated task run on the host.
+ *
+ * Queues are replaced by stubs which keep the posted events in a std::deque, and the other FreeRTOS
+ * functions called when posting events and running the loop are ignored.
+ */
+struct MockLoopQueue : public CMockFix {
+    MockLoopQueue() : sem(CreateAnd::IGNORE)
+    {
+        items().clear();
+        xQueueGenericCreate_StubWithCallback(create_callback);
+        xQueueGenericSend_StubWithCallback(send_callback);
+        xQueueReceive_StubWithCallback(receive_callback);
+        vQueueDelete_Ignore();
+        xQueueTakeMutexRecursive_IgnoreAndReturn(pdTRUE);
+        xQueueGiveMutexRecursive_IgnoreAndReturn(pdTRUE);
+        xTaskGetTickCount_IgnoreAndReturn(0);
+        xTaskGetCurrentTaskHandle_IgnoreAndReturn(nullptr);
+    }
+
+    ~MockLoopQueue()
+    {
+        xQueueGenericCreate_StubWithCallback(nullptr);
+        xQueueGenericSend_StubWithCallback(nullptr);
+        xQueueReceive_StubWithCallback(nullptr);
+        vQueueDelete_StopIgnore();
+        xQueueTakeMutexRecursive_StopIgnore();
+        xQueueGiveMutexRecursive_StopIgnore();
+        xTaskGetTickCount_StopIgnore();
+        xTaskGetCurrentTaskHandle_StopIgnore();
+    }
+
+    MockMutex sem;
+
+private:
+    static std::deque<std::vector<uint8_t> > &items()
+    {
+        static std::deque<std::vector<uint8_t> > queue_items;
+        return queue_items;
+    }
+
+    static size_t &item_size()
+    {
+        static size_t size;
+        return size;
+    }
+
+    static QueueHandle_t create_callback(const UBaseType_t length, const UBaseType_t size, const uint8_t type, int num_calls)
+    {
+        item_size() = size;
+        return reinterpret_cast<QueueHandle_t>(0xdeadbeef);
+    }
+
+    static BaseType_t send_callback(QueueHandle_t queue, const void *item, TickType_t ticks, const BaseType_t position, int num_calls)
+    {
+        const uint8_t *data = static_cast<const uint8_t *>(item);
+        items().emplace_back(data, data + item_size());
+        return pdTRUE;
+    }
+
+    static BaseType_t receive_callback(QueueHandle_t queue, void *buffer, TickType_t ticks, int num_calls)
+    {
+        if (items().empty()) {
+            return pdFALSE;
+        }
+        memcpy(buffer, items().front().data(), item_size());
+        items().pop_front();
+        return pdTRUE;
+    }
+};
+
+/**
+ * Collects the time taken by events from being posted to being handled, for benchmarks.
+ *
+ * post() gives the timestamp to post with an event, handled() is called with it when the event is handled.
+ */
+struct LatencyStats {
+    typedef std::chrono::steady_clock clock;
+
+    static int64_t post()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    void handled(int64_t posted)
+    {
+        samples.push_back(post() - posted);
+    }
+
+    size_t count() const
+    {
+        return samples.size();
+    }
+
+    /**
+     * Latency in ns which the given percentage of the events didn't exceed.
+     */
+    int64_t percentile(double percent)
+    {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(samples.size() * percent / 100));
+        return samples[index];
+    }
+
+private:
+    std::vector<int64_t> samples;
+};
@@ -35,6 +35,15 @@ typedef struct {
                                                         ignored if task name is NULL */
 } esp_event_loop_args_t;
 
+/// Event posted as part of a batch, see esp_event_post_batch_to
+typedef struct {
+    esp_event_base_t event_base;                /**< the event base that identifies the event */
+    int32_t event_id;                           /**< the event ID that identifies the event */
+    const void *event_data;                     /**< the data, specific to the event occurrence, that gets passed
+                                                        to the handler; can be NULL */
+    size_t event_data_size;                     /**< the size of the event data */
+} esp_event_post_item_t;
+
 /**
  * @brief Create a new event loop.
  *
@@ -406,6 +415,54 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
                             size_t event_data_size,
                             TickType_t ticks_to_wait);
 
+/**
+ * @brief Posts a batch of events to the system default event loop.
+ *
+ * This function does the same as esp_event_post_batch_to, except that it posts the events to the default
+ * event loop.
+ *
+ * @param[in] events the events to post
+ * @param[in] events_count the number of events to post
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID in one of the events, no events
+ *  - ESP_ERR_NO_MEM: Cannot allocate memory for the copy of the events
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_batch(const esp_event_post_item_t *events,
+                               size_t events_count,
+                               TickType_t ticks_to_wait);
+
+/**
+ * @brief Posts a batch of events to the specified event loop.
+ *
+ * The events, together with their data, are copied to a single block, which takes up one entry of the event loop
+ * queue. The event loop dispatches the events of a batch one after the other and in order, without other events
+ * in between. Either all the events of the batch are posted or none of them.
+ *
+ * Posting a burst of events this way is cheaper than posting them one by one with esp_event_post_to, as it
+ * only takes one copy, one queue operation and one wakeup of the event loop task.
+ *
+ * @param[in] event_loop the event loop to post to, must not be NULL
+ * @param[in] events the events to post
+ * @param[in] events_count the number of events to post
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID in one of the events, no events
+ *  - ESP_ERR_NO_MEM: Cannot allocate memory for the copy of the events
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_batch_to(esp_event_loop_handle_t event_loop,
+                                  const esp_event_post_item_t *events,
+                                  size_t events_count,
+                                  TickType_t ticks_to_wait);
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 /**
  * @brief Special variant of esp_event_post for posting events from interrupt handlers.
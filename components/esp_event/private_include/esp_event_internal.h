@@ -38,11 +38,24 @@ typedef struct esp_event_handler_node {
     uint32_t invoked;                                               /**< number of times this handler has been invoked */
     int64_t time;                                                   /**< total runtime of this handler across all calls */
 #endif
+    bool removed;                                                   /**< handler was unregistered while an event was
+                                                                            being dispatched, and is waiting to be freed */
     SLIST_ENTRY(esp_event_handler_node) next;                   /**< next event handler in the list */
 } esp_event_handler_node_t;
 
 typedef SLIST_HEAD(esp_event_handler_instances, esp_event_handler_node) esp_event_handler_nodes_t;
 
+/// Handlers to execute for an event, in order of execution
+typedef struct esp_event_dispatch_entry {
+    esp_event_base_t base;                                          /**< base of the event */
+    int32_t id;                                                     /**< id of the event */
+    uint32_t refs;                                                  /**< references from the dispatch index and
+                                                                            from esp_event_loop_run */
+    size_t handlers_count;                                          /**< number of handlers */
+    esp_event_handler_node_t* handlers[0];                          /**< loop, base and id level handlers
+                                                                            for the event */
+} esp_event_dispatch_entry_t;
+
 /// Event
 typedef struct esp_event_id_node {
     int32_t id;                                                     /**< id number of the event */
@@ -83,6 +96,23 @@ typedef struct esp_event_loop_instance {
     SemaphoreHandle_t mutex;                                        /**< mutex for updating the events linked list */
     esp_event_loop_nodes_t loop_nodes;                              /**< set of linked lists containing the
                                                                             registered handlers for the loop */
+    esp_event_dispatch_entry_t** dispatch_index;                    /**< hash table of the handlers to execute for
+                                                                            each posted (base, id), built on dispatch
+                                                                            and cleared when handlers change */
+    size_t dispatch_index_size;                                     /**< number of slots of the dispatch index */
+    size_t dispatch_index_count;                                    /**< number of entries in the dispatch index */
+    size_t registered_handlers;                                     /**< number of handlers registered to the loop */
+    uint32_t dispatch_depth;                                        /**< number of events being dispatched */
+    esp_event_handler_nodes_t removed_handlers;                     /**< handlers unregistered while dispatching
+                                                                            events, freed when dispatching is done */
+#if CONFIG_ESP_EVENT_POST_BATCH_RING_SIZE
+    uint8_t* batch_ring;                                            /**< ring buffer for batches of events, allocated
+                                                                            when the first batch is posted */
+    size_t batch_ring_head;                                         /**< offset of the next batch in the ring */
+    size_t batch_ring_tail;                                         /**< offset of the oldest batch in the ring */
+    size_t batch_ring_used;                                         /**< bytes of the ring in use */
+    portMUX_TYPE batch_ring_spinlock;                               /**< spinlock for the ring */
+#endif
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_uint_least32_t events_recieved;                          /**< number of events successfully posted to the loop */
     atomic_uint_least32_t events_dropped;                           /**< number of events dropped due to queue being full */
@@ -100,11 +130,32 @@ typedef union esp_event_post_data {
 typedef void* esp_event_post_data_t;
 #endif
 
+/// Event of a batch, followed by its data
+typedef struct esp_event_batch_record {
+    esp_event_base_t base;                                           /**< the event base */
+    int32_t id;                                                      /**< the event id */
+    uint32_t data_size;                                              /**< size of the data, 0 if the event has none */
+    uint8_t data[0] __attribute__((aligned(8)));                     /**< copy of the data */
+} esp_event_batch_record_t;
+
+/// Batch of events posted with esp_event_post_batch_to, queued as a single post with ESP_EVENT_ANY_BASE as base
+typedef struct esp_event_post_batch {
+    uint32_t count;                                                  /**< number of events in the batch */
+    bool in_ring;                                                    /**< indicates whether the batch is in the
+                                                                            loop's batch ring or on the heap */
+    uint8_t records[0] __attribute__((aligned(8)));                  /**< the events, esp_event_batch_record_t each
+                                                                            padded to a multiple of 8 bytes */
+} esp_event_post_batch_t;
+
 /// Event posted to the event queue
 typedef struct esp_event_post_instance {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
     bool data_allocated;                                             /**< indicates whether data is allocated from heap */
     bool data_set;                                                   /**< indicates if data is null */
+#endif
+#if CONFIG_ESP_EVENT_POST_DATA_POOL
+    bool data_pooled;                                                /**< indicates whether data is allocated from
+                                                                            the post data pool */
 #endif
     esp_event_base_t base;                                           /**< the event base */
     int32_t id;                                                      /**< the event id */
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/types.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <http_parser.h>
@@ -36,6 +37,7 @@ initializer that should be kept in sync
         .lru_purge_enable   = false,                    \
         .recv_wait_timeout  = 5,                        \
         .send_wait_timeout  = 5,                        \
+        .worker_count       = 0,                        \
         .global_user_ctx = NULL,                        \
         .global_user_ctx_free_fn = NULL,                \
         .global_transport_ctx = NULL,                   \
@@ -155,6 +157,25 @@ typedef struct httpd_config {
     uint16_t    recv_wait_timeout;  /*!< Timeout for recv function (in seconds)*/
     uint16_t    send_wait_timeout;  /*!< Timeout for send function (in seconds)*/
 
+    /**
+     * Number of worker tasks which run the URI handlers.
+     *
+     * With 0, the handlers run on the server task, one at a time, so a slow
+     * handler delays the requests of all the other sessions.
+     *
+     * Otherwise the server task still accepts the connections and receives and
+     * parses the requests, and then passes each request to one of the worker tasks.
+     * The session is handed back to the server task when the handler returns. Up to
+     * worker_count handlers may then run at the same time, on different sessions.
+     * The worker tasks are created with the stack_size, task_priority and core_id
+     * of the server task, and each one needs a request buffer (about the scratch
+     * buffer size, see HTTPD_MAX_REQ_HDR_LEN and HTTPD_MAX_URI_LEN).
+     *
+     * Error responses of the server (e.g. 404 Not Found) and the WebSocket handshake
+     * are still sent from the server task, so the error handlers run there.
+     */
+    uint16_t    worker_count;
+
     /**
      * Global user context.
      *
@@ -232,6 +253,11 @@ typedef struct httpd_config {
      *
      * Users can implement their own matching functions (See description
      * of the `httpd_uri_match_func_t` function prototype)
+     *
+     * With the two built-in options, the registered URIs are indexed in a
+     * radix trie and the time to find the handler of a request doesn't grow
+     * with the number of handlers. Custom matcher functions are called for
+     * each registered handler in turn.
      */
     httpd_uri_match_func_t uri_match_fn;
 } httpd_config_t;
@@ -958,7 +984,6 @@ esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, siz
  *  - ESP_ERR_NOT_FOUND          : Key not found
  *  - ESP_ERR_INVALID_ARG        : Null arguments
  *  - ESP_ERR_HTTPD_RESULT_TRUNC : Value string truncated
- *  - ESP_ERR_NO_MEM             : Memory allocation failure
  */
 esp_err_t httpd_req_get_cookie_val(httpd_req_t *req, const char *cookie_name, char *val, size_t *val_size);
 
@@ -1106,6 +1131,89 @@ static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *r, const char *str
     return httpd_resp_send_chunk(r, str, (str == NULL) ? 0 : HTTPD_RESP_USE_STRLEN);
 }
 
+/**
+ * @brief   API to send a file from a filesystem as HTTP response
+ *
+ * The file is read directly into a buffer of CONFIG_HTTPD_FILE_BUF_SIZE
+ * bytes, from which it is sent with Content-Length, without chunked
+ * encoding. Along with the file, the following are handled:
+ *      - If a pre-compressed variant of the file exists (the same path
+ *        with ".gz" appended) and the request's Accept-Encoding allows
+ *        gzip, the variant is sent with "Content-Encoding: gzip".
+ *      - An ETag derived from the modification time and the size of the
+ *        file is sent. If the request's If-None-Match matches it, the
+ *        response is "304 Not Modified" without body.
+ *      - A Range request for a single byte range gets a "206 Partial
+ *        Content" response with this part of the file, or "416 Range
+ *        Not Satisfiable" if the range is beyond the end of the file.
+ *        If-Range is supported with the ETag.
+ *      - HEAD requests get the headers only.
+ *
+ * Status 304, 206 and 416 responses are sent only if the status of the
+ * response is 200 OK (the default), e.g. a custom error page is sent as
+ * it is with the status set by httpd_resp_set_status().
+ *
+ * @note
+ * - This API is supposed to be called only from the context of
+ *   a URI handler where httpd_req_t* request pointer is valid.
+ * - The Content-Type is not derived from the file name, set it
+ *   with httpd_resp_set_type() if the default text/html doesn't fit.
+ * - Once this API is called, the request has been responded to.
+ *   No additional data can then be sent for the request.
+ * - If an error occurs after the headers have been sent, the client
+ *   is waiting for the rest of the file. Return ESP_FAIL from the URI
+ *   handler then, so that the connection is closed.
+ *
+ * @param[in] r      The request being responded to
+ * @param[in] path   Path of the file in the VFS, e.g. "/spiffs/index.html"
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response
+ *  - ESP_ERR_NOT_FOUND   : File doesn't exist, isn't a regular file or can't be read from the
+ *                          start of the requested range, nothing has been sent
+ *  - ESP_ERR_NO_MEM      : Failed to allocate the buffer, nothing has been sent
+ *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Headers are too large for the buffer, nothing has been sent
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - ESP_FAIL : Error in reading the file
+ */
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path);
+
+/**
+ * @brief   API to send a part of an open file as HTTP response
+ *
+ * Sends len bytes of the file starting from offset as the body of the
+ * response, with Content-Length and the status, content type and
+ * headers set for the response. Unlike httpd_resp_send_file(), request
+ * headers like Range aren't looked at. The file descriptor is left open
+ * and its position is changed.
+ *
+ * @note
+ * - This API is supposed to be called only from the context of
+ *   a URI handler where httpd_req_t* request pointer is valid.
+ * - Once this API is called, the request has been responded to.
+ *   No additional data can then be sent for the request.
+ * - If an error occurs after the headers have been sent, return
+ *   ESP_FAIL from the URI handler, so that the connection is closed.
+ *
+ * @param[in] r      The request being responded to
+ * @param[in] fd     File descriptor of the file, opened for reading
+ * @param[in] offset Offset in the file of the data to send
+ * @param[in] len    Length of the data to send, -1 to send up to the end of the file
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response
+ *  - ESP_ERR_NO_MEM      : Failed to allocate the buffer, nothing has been sent
+ *  - ESP_ERR_INVALID_ARG : Null request pointer, invalid file descriptor or offset, or the file
+ *                          can't be seeked to the offset, nothing has been sent
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Headers are too large for the buffer, nothing has been sent
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - ESP_FAIL : Error in reading the file
+ */
+esp_err_t httpd_resp_send_fd(httpd_req_t *r, int fd, off_t offset, ssize_t len);
+
 /* Some commonly used status codes */
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
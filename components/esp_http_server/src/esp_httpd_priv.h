@@ -30,6 +30,14 @@ extern "C" {
 /* Calculate the maximum size needed for the scratch buffer */
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
 
+/* Number of request headers indexed for lookups by field name, the
+ * other ones are found by searching the headers in the scratch buffer */
+#define HTTPD_REQ_HDR_INDEX_LEN     24
+
+/* Number of slots of the hash table of the header index, a power of 2
+ * larger than HTTPD_REQ_HDR_INDEX_LEN */
+#define HTTPD_REQ_HDR_INDEX_SLOTS   32
+
 /* Formats a log string to prepend context function name */
 #define LOG_FMT(x)      "%s: " x, __func__
 
@@ -64,6 +72,8 @@ struct sock_db {
     bool lru_socket;                        /*!< Flag indicating LRU socket */
     char pending_data[PARSER_BLOCK_SIZE];   /*!< Buffer for pending data to be received */
     size_t pending_len;                     /*!< Length of pending data to be received */
+    bool busy;                              /*!< Flag indicating that a worker task is processing a request of the session */
+    bool close_pending;                     /*!< Flag indicating that the session is to be deleted when the worker task is done */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_done;                 /*!< True if it has done WebSocket handshake (if this socket is a valid WS) */
     bool ws_close;                          /*!< Set to true to close the socket later (when WS Close frame received) */
@@ -85,12 +95,23 @@ struct httpd_req_aux {
     char           *content_type;                   /*!< HTTP response's content type */
     bool            first_chunk_sent;               /*!< Used to indicate if first chunk sent */
     unsigned        req_hdrs_count;                 /*!< Count of total headers in request packet */
+    struct req_hdr {
+        uint16_t hash;                              /*!< Hash of the lower case field name */
+        uint16_t field_off;                         /*!< Offset of the field name in scratch buffer */
+        uint16_t field_len;
+        uint16_t value_off;                         /*!< Offset of the NULL terminated value in scratch buffer */
+        uint16_t value_len;
+    } req_hdrs[HTTPD_REQ_HDR_INDEX_LEN];            /*!< Index of the request headers, the first one of each field name */
+    uint8_t         req_hdrs_slots[HTTPD_REQ_HDR_INDEX_SLOTS]; /*!< Hash table of the index, entry number + 1 or 0 if free */
+    uint8_t         req_hdrs_indexed;               /*!< Count of entries in req_hdrs */
+    bool            req_hdrs_overflow;              /*!< Some headers didn't fit in the index */
     unsigned        resp_hdrs_count;                /*!< Count of additional headers in response packet */
     struct resp_hdr {
         const char *field;
         const char *value;
     } *resp_hdrs;                                   /*!< Additional headers in response packet */
     struct http_parser_url url_parse_res;           /*!< URL parsing result, used for retrieving URL elements */
+    esp_err_t (*handler)(httpd_req_t *r);           /*!< Handler left to a worker task, NULL if the request has been processed */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_detect;                       /*!< WebSocket handshake detection flag */
     httpd_ws_type_t ws_type;                        /*!< WebSocket frame type */
@@ -99,6 +120,32 @@ struct httpd_req_aux {
 #endif
 };
 
+/**
+ * @brief   Radix trie of the registered URI templates, used for finding
+ *          the handler of a request in a time depending on the URI length only
+ */
+typedef struct httpd_uri_trie httpd_uri_trie_t;
+
+/**
+ * @brief   A request slot of the worker tasks. There is one slot per worker task.
+ */
+struct httpd_worker_job {
+    struct httpd_data *hd;                  /*!< Server instance data */
+    struct sock_db *sd;                     /*!< Session of the request while the job is busy */
+    struct httpd_req req;                   /*!< The request */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the request */
+    esp_err_t ret;                          /*!< Result of the request, the session is deleted on failure */
+    bool busy;                              /*!< Flag indicating that the job has been passed to a worker task */
+};
+
+/**
+ * @brief   Worker task data
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance data */
+    struct thread_data td;                  /*!< Information for the worker thread */
+};
+
 /**
  * @brief   Server data for each instance. This is exposed publicly as
  *          httpd_handle_t but internal structure/members are kept private.
@@ -112,9 +159,14 @@ struct httpd_data {
     struct sock_db *hd_sd;                  /*!< The socket database */
     int hd_sd_active_count;                 /*!< The number of the active sockets */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
+    httpd_uri_trie_t *hd_uri_trie;          /*!< Trie of hd_calls, NULL if not supported by the URI matching function or out of memory */
     struct httpd_req hd_req;                /*!< The current HTTPD request */
     struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
     uint64_t lru_counter;                   /*!< LRU counter */
+    struct httpd_worker *hd_workers;        /*!< Worker tasks, NULL if the handlers run on the server task */
+    struct httpd_worker_job *hd_jobs;       /*!< Request slots of the worker tasks */
+    oqueue_t hd_job_queue;                  /*!< Jobs passed to the worker tasks, NULL stops a worker task */
+    int hd_jobs_busy;                       /*!< The number of busy jobs */
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
@@ -272,6 +324,16 @@ bool httpd_sess_pending(struct httpd_data *hd, struct sock_db *session);
  */
 esp_err_t httpd_sess_close_lru(struct httpd_data *hd);
 
+/**
+ * @brief   Returns the request which is being processed on a session
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ *
+ * @return the request, or NULL if no request of the session is being processed
+ */
+httpd_req_t *httpd_sess_get_req(struct httpd_data *hd, struct sock_db *session);
+
 /**
  * @brief   Closes all sessions
  *
@@ -284,6 +346,63 @@ void httpd_sess_close_all(struct httpd_data *hd);
  * @}
  */
 
+/****************** Group : Worker Tasks ********************/
+/** @name Worker Tasks
+ * Functions running the URI handlers on worker tasks, see httpd_config_t::worker_count
+ * @{
+ */
+
+/**
+ * @brief   Creates the worker tasks, if configured
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - ESP_OK                  : on success, or if no worker tasks are configured
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if out of memory
+ *  - ESP_ERR_HTTPD_TASK      : if a worker task couldn't be created
+ */
+esp_err_t httpd_workers_start(struct httpd_data *hd);
+
+/**
+ * @brief   Stops the worker tasks after they have finished their requests,
+ *          and frees their resources. The busy sessions are handed back.
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_workers_stop(struct httpd_data *hd);
+
+/**
+ * @brief   Receives and parses a request of the session into a free job, and
+ *          passes it to a worker task if it has to run a URI handler
+ *
+ * Does nothing if all the jobs are busy, the data is left in the socket.
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ *
+ * @return
+ *  - ESP_OK    : on successfully passing the request, or responding to it
+ *  - ESP_FAIL  : in case of failure, the session needs to be deleted
+ */
+esp_err_t httpd_workers_process(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Checks if there is a free job for a new request
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return True if there is a free job, always true without worker tasks
+ */
+static inline bool httpd_workers_available(struct httpd_data *hd)
+{
+    return (!hd->hd_workers) || (hd->hd_jobs_busy < hd->config.worker_count);
+}
+
+/** End of Group : Worker Tasks
+ * @}
+ */
+
 /****************** Group : URI Handling ********************/
 /** @name URI Handling
  * Methods for accessing URI handlers
@@ -294,13 +413,68 @@ void httpd_sess_close_all(struct httpd_data *hd);
  * @brief   For an HTTP request, searches through all the registered URI handlers
  *          and invokes the appropriate one if found
  *
+ * @note    With worker tasks, the handler isn't invoked but stored in the
+ *          handler field of the httpd_req_aux of the request
+ *
  * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] req The parsed request
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req);
+
+/**
+ * @brief   Creates an empty URI trie
+ *
+ * @return the trie, or NULL if out of memory
+ */
+httpd_uri_trie_t *httpd_uri_trie_create(void);
+
+/**
+ * @brief   Deletes a URI trie
+ *
+ * @param[in] trie  The trie, may be NULL
+ */
+void httpd_uri_trie_delete(httpd_uri_trie_t *trie);
+
+/**
+ * @brief   Adds a URI handler to a trie
+ *
+ * @note    Removing handlers is not supported, the trie needs to be built again.
+ *          On failure, the trie is left in an undefined state.
+ *
+ * @param[in] trie      The trie
+ * @param[in] uri       The handler, which has to remain valid while it is in the trie
+ * @param[in] order     Position of the handler in hd_calls. If several handlers match
+ *                      a request, the one with the lowest position is selected.
+ * @param[in] wildcard  Whether the URI template is matched by httpd_uri_match_wildcard(),
+ *                      otherwise it is matched as it is
+ *
+ * @return
+ *  - ESP_OK                  : if the handler has been added
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if out of memory
+ */
+esp_err_t httpd_uri_trie_add(httpd_uri_trie_t *trie, httpd_uri_t *uri, uint16_t order, bool wildcard);
+
+/**
+ * @brief   Finds the handler for a URI and method in a trie
+ *
+ * @param[in]  trie     The trie
+ * @param[in]  uri      The URI path
+ * @param[in]  uri_len  Length of the URI path
+ * @param[in]  method   Method of the request
+ * @param[out] err      Set to 0 if a handler is found, to HTTPD_405_METHOD_NOT_ALLOWED
+ *                      if the URI matches only handlers of other methods, or to
+ *                      HTTPD_404_NOT_FOUND. May be NULL.
+ *
+ * @return the handler, or NULL if not found
+ */
+httpd_uri_t *httpd_uri_trie_find(const httpd_uri_trie_t *trie,
+                                 const char *uri, size_t uri_len,
+                                 httpd_method_t method,
+                                 httpd_err_code_t *err);
 
 /**
  * @brief   Unregister all URI handlers
@@ -348,26 +522,43 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  * URI, headers are ready to be fetched from scratch buffer and calling
  * http_recv() after this reads the body of the request.
  *
+ * With worker tasks, the handler of the request is not invoked, see httpd_uri().
+ * The request is complete (and needs httpd_req_delete()) if the handler field of
+ * its httpd_req_aux is NULL, otherwise httpd_req_run_handler() is to be called first.
+ *
  * @param[in] hd  Server instance data
+ * @param[in] r   Request to be filled
+ * @param[in] ra  Auxiliary data of the request
  * @param[in] sd  Pointer to socket which is needed for receiving TCP packets.
  *
  * @return
  *  - ESP_OK    : if request packet is valid
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
+esp_err_t httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd);
+
+/**
+ * @brief   Invokes the handler which httpd_req_new() left to a worker task
+ *
+ * @param[in] r   Request
+ *
+ * @return
+ *  - ESP_OK    : if the handler succeeded, httpd_req_delete() is to be called next
+ *  - ESP_FAIL  : otherwise, the request is cleaned up and the session needs to be deleted
+ */
+esp_err_t httpd_req_run_handler(httpd_req_t *r);
 
 /**
  * @brief   For an HTTP request, resets the resources allocated for it and
  *          purges any data left to be received
  *
- * @param[in] hd  Server instance data
+ * @param[in] r   Request
  *
  * @return
  *  - ESP_OK    : if request packet deleted and resources cleaned.
  *  - ESP_FAIL  : otherwise.
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd);
+esp_err_t httpd_req_delete(httpd_req_t *r);
 
 /**
  * @brief   For handling HTTP errors by invoking registered
@@ -405,6 +596,20 @@ esp_err_t httpd_req_handle_err(httpd_req_t *req, httpd_err_code_t error);
  */
 int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
 
+/**
+ * @brief   For sending out all the data of a buffer, calling the send function
+ *          of the session until everything is sent or an error occurs
+ *
+ * @param[in] req     Pointer to the HTTP request for which the response needs to be sent
+ * @param[in] buf     Pointer to the buffer with the data
+ * @param[in] buf_len Length of the buffer
+ *
+ * @return
+ *  - ESP_OK   : if successful
+ *  - ESP_FAIL : if failed
+ */
+esp_err_t httpd_send_all(httpd_req_t *req, const char *buf, size_t buf_len);
+
 /**
  * @brief   For receiving HTTP request data
  *
@@ -541,6 +746,71 @@ esp_err_t httpd_sess_trigger_close_(httpd_handle_t handle, struct sock_db *sessi
  * @}
  */
 
+/****************** Group : Files ********************/
+/** @name Files
+ * Request header checks and read sizes of httpd_resp_send_file()
+ * @{
+ */
+
+/**
+ * @brief   Checks if an Accept-Encoding header value allows gzip,
+ *          i.e. it lists gzip without q=0
+ *
+ * @param[in] accept  Accept-Encoding header value
+ *
+ * @return True if a gzip encoded response is acceptable
+ */
+bool httpd_file_accepts_gzip(const char *accept);
+
+/**
+ * @brief   Checks if an If-None-Match header value matches the entity tag of a file
+ *
+ * @param[in] if_none_match  If-None-Match header value, a list of entity tags or "*"
+ * @param[in] etag           Entity tag of the file, with the quotes
+ *
+ * @return True if the file hasn't changed, i.e. 304 Not Modified is to be sent
+ */
+bool httpd_file_etag_match(const char *if_none_match, const char *etag);
+
+/**
+ * @brief   Parses a Range header value, for a file of the given size
+ *
+ * Only single byte ranges are supported. Multiple ranges and invalid values
+ * are ignored, and so is the range if an If-Range value is given and it
+ * isn't the entity tag of the file.
+ *
+ * @param[in]  range     Range header value
+ * @param[in]  if_range  If-Range header value, NULL if not present
+ * @param[in]  etag      Entity tag of the file, with the quotes
+ * @param[in]  size      Size of the file
+ * @param[out] start     First byte of the range, if valid
+ * @param[out] end       Last byte of the range, if valid, clipped to the file size
+ *
+ * @return
+ *  - 1  : The range is valid, 206 Partial Content is to be sent
+ *  - 0  : The range is to be ignored, the whole file is to be sent
+ *  - -1 : The range isn't satisfiable, 416 Range Not Satisfiable is to be sent
+ */
+int httpd_file_parse_range(const char *range, const char *if_range, const char *etag,
+                           size_t size, size_t *start, size_t *end);
+
+/**
+ * @brief   Gets the number of bytes to read from a file into the buffer,
+ *          so that the reads after this one start at aligned offsets
+ *
+ * @param[in] pos    Current position in the file
+ * @param[in] room   Free space in the buffer
+ * @param[in] align  Alignment of the reads, e.g. the filesystem sector size
+ *
+ * @return The largest size up to room which ends at a multiple of align,
+ *         or room if there is none
+ */
+size_t httpd_file_read_size(size_t pos, size_t room, size_t align);
+
+/** End of Group : Files
+ * @}
+ */
+
 #ifdef __cplusplus
 }
 #endif
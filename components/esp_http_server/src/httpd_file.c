@@ -0,0 +1,320 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_file";
+
+/* Reads from the file start at multiples of this, so that
+ * the filesystem can read whole sectors into the buffer */
+#define FILE_READ_ALIGN     4096
+
+/* Buffer for the response headers and the file data */
+#define FILE_BUF_SIZE       CONFIG_HTTPD_FILE_BUF_SIZE
+
+/* Number of bytes to read from file position pos into room bytes of the buffer:
+ * as many as fit and end at an aligned offset, or all of room if none does */
+size_t httpd_file_read_size(size_t pos, size_t room, size_t align)
+{
+    size_t end = (pos + room) / align * align;
+    return end > pos ? end - pos : room;
+}
+
+/* Sends the response headers and len bytes of the file from offset. The headers
+ * and the first block of the file are sent together from buf. If len is negative
+ * there is no body and no Content-Length header (e.g. 304 Not Modified). */
+static esp_err_t httpd_send_fd_part(httpd_req_t *r, int fd, char *buf, size_t buf_size,
+                                    off_t offset, ssize_t len, const char *extra_hdrs)
+{
+    struct httpd_req_aux *ra = r->aux;
+    size_t hdr_len;
+    bool body = len > 0 && r->method != HTTP_HEAD;
+
+    /* Nothing has been sent yet, so this can still be answered with an error response */
+    if (body && lseek(fd, offset, SEEK_SET) != offset) {
+        ESP_LOGE(TAG, LOG_FMT("failed to seek to %ld"), (long) offset);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (len >= 0) {
+        hdr_len = snprintf(buf, buf_size, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s",
+                           ra->status, ra->content_type, (size_t) len, extra_hdrs);
+    } else {
+        hdr_len = snprintf(buf, buf_size, "HTTP/1.1 %s\r\n%s", ra->status, extra_hdrs);
+    }
+    for (unsigned i = 0; i < ra->resp_hdrs_count && hdr_len < buf_size; i++) {
+        hdr_len += snprintf(buf + hdr_len, buf_size - hdr_len, "%s: %s\r\n",
+                            ra->resp_hdrs[i].field, ra->resp_hdrs[i].value);
+    }
+    if (hdr_len < buf_size) {
+        hdr_len += snprintf(buf + hdr_len, buf_size - hdr_len, "\r\n");
+    }
+    /* Leave at least half of the buffer for the file data */
+    if (hdr_len >= buf_size / 2) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+
+    /* Request headers are no longer needed */
+    ra->req_hdrs_count = 0;
+
+    if (!body) {
+        return httpd_send_all(r, buf, hdr_len) == ESP_OK ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+    }
+
+    /* The first read fills the buffer after the headers. If it doesn't end
+     * at an aligned offset, the next one is shortened to get back to one. */
+    size_t align = MIN(FILE_READ_ALIGN, buf_size);
+    size_t pos = offset;
+    char *dst = buf + hdr_len;
+    size_t remaining = len;
+    while (remaining) {
+        size_t room = buf_size - (dst - buf);
+        size_t to_read = MIN(httpd_file_read_size(pos, room, align), remaining);
+        ssize_t n = read(fd, dst, to_read);
+        if (n <= 0) {
+            /* The headers announced more data, the connection must be closed */
+            ESP_LOGE(TAG, LOG_FMT("failed to read file, %zu bytes missing"), remaining);
+            return ESP_FAIL;
+        }
+        pos += n;
+        remaining -= n;
+        if (httpd_send_all(r, buf, dst - buf + n) != ESP_OK) {
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        dst = buf;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_fd(httpd_req_t *r, int fd, off_t offset, ssize_t len)
+{
+    if (r == NULL || fd < 0 || offset < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    if (len < 0) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < offset) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        len = st.st_size - offset;
+    }
+
+    char *buf = malloc(FILE_BUF_SIZE);
+    if (!buf) {
+        ESP_LOGE(TAG, LOG_FMT("failed to allocate buffer"));
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = httpd_send_fd_part(r, fd, buf, FILE_BUF_SIZE, offset, len, "");
+    free(buf);
+    return ret;
+}
+
+/* Gets a request header value into buf, NULL if not present or too long */
+static const char *httpd_file_req_hdr(httpd_req_t *r, const char *field, char *buf, size_t buf_size)
+{
+    return httpd_req_get_hdr_value_str(r, field, buf, buf_size) == ESP_OK ? buf : NULL;
+}
+
+/* Checks if an Accept-Encoding value allows gzip */
+bool httpd_file_accepts_gzip(const char *accept)
+{
+    while (*accept) {
+        accept += strspn(accept, " \t,");
+        size_t len = strcspn(accept, " \t;,");
+        bool gzip = (len == 4 && strncasecmp(accept, "gzip", 4) == 0);
+        accept += len;
+
+        /* Parameters of the coding, look for q=0 */
+        float q = 1;
+        size_t params_len = strcspn(accept, ",");
+        const char *q_param = strstr(accept, "q=");
+        if (q_param && q_param < accept + params_len) {
+            q = strtof(q_param + 2, NULL);
+        }
+        if (gzip) {
+            return q > 0;
+        }
+        accept += params_len;
+    }
+    return false;
+}
+
+/* Checks if an If-None-Match value contains the entity tag of the file */
+bool httpd_file_etag_match(const char *if_none_match, const char *etag)
+{
+    if (strcmp(if_none_match, "*") == 0) {
+        return true;
+    }
+    size_t etag_len = strlen(etag);
+    for (const char *p = strstr(if_none_match, etag); p; p = strstr(p + 1, etag)) {
+        /* Weak comparison, the entity tag may have W/ in front */
+        char after = p[etag_len];
+        if (after == '\0' || after == ',' || after == ' ') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Parses a Range header value with a single byte range. Returns 1 and the
+ * range if it is valid, -1 if it isn't satisfiable and 0 if it is to be ignored
+ * (invalid or multiple ranges, or an If-Range for another version of the file,
+ * then the whole file is sent). */
+int httpd_file_parse_range(const char *range, const char *if_range, const char *etag,
+                           size_t size, size_t *start, size_t *end)
+{
+    /* A range of a different version of the file is not what the client asks for */
+    if (if_range && strcmp(if_range, etag) != 0) {
+        return 0;
+    }
+    if (strncmp(range, "bytes=", 6) != 0 || strchr(range, ',')) {
+        return 0;
+    }
+    range += 6;
+
+    char *p;
+    if (*range == '-') {
+        /* Last bytes of the file */
+        unsigned long suffix = strtoul(range + 1, &p, 10);
+        if (p == range + 1 || *p) {
+            return 0;
+        }
+        if (suffix == 0 || size == 0) {
+            return -1;
+        }
+        *start = size - MIN(suffix, size);
+        *end = size - 1;
+        return 1;
+    }
+
+    unsigned long first = strtoul(range, &p, 10);
+    if (p == range || *p != '-') {
+        return 0;
+    }
+    range = p + 1;
+    unsigned long last = size ? size - 1 : 0;
+    if (*range) {
+        last = strtoul(range, &p, 10);
+        if (p == range || *p || last < first) {
+            return 0;
+        }
+    }
+    if (first >= size) {
+        return -1;
+    }
+    *start = first;
+    *end = MIN(last, size - 1);
+    return 1;
+}
+
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path)
+{
+    if (r == NULL || path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_req_aux *ra = r->aux;
+    char *buf = malloc(FILE_BUF_SIZE);
+    if (!buf) {
+        ESP_LOGE(TAG, LOG_FMT("failed to allocate buffer"));
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Use the pre-compressed variant of the file if there is one and the client accepts it */
+    struct stat st;
+    bool gz_exists = false;
+    bool gzip = false;
+    if (snprintf(buf, FILE_BUF_SIZE, "%s.gz", path) < FILE_BUF_SIZE &&
+            stat(buf, &st) == 0 && S_ISREG(st.st_mode)) {
+        gz_exists = true;
+        const char *accept = httpd_file_req_hdr(r, "Accept-Encoding", buf + strlen(buf) + 1,
+                                                FILE_BUF_SIZE - strlen(buf) - 1);
+        gzip = accept && httpd_file_accepts_gzip(accept);
+    }
+
+    int fd = open(gzip ? buf : path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ESP_LOGD(TAG, LOG_FMT("can't open %s"), gzip ? buf : path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(buf);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Changes if the file is replaced, rewritten or compressed anew */
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long) st.st_mtime, (unsigned long long) st.st_size);
+
+    size_t size = st.st_size;
+    size_t start = 0;
+    size_t end = size ? size - 1 : 0;
+    int range = 0;
+    bool not_modified = false;
+
+    /* Conditional and range requests are for a file sent with a 200 OK status only */
+    if (strcmp(ra->status, HTTPD_200) == 0) {
+        const char *value = httpd_file_req_hdr(r, "If-None-Match", buf, FILE_BUF_SIZE);
+        not_modified = value && httpd_file_etag_match(value, etag);
+
+        value = not_modified ? NULL : httpd_file_req_hdr(r, "Range", buf, FILE_BUF_SIZE);
+        if (value) {
+            size_t value_size = strlen(value) + 1;
+            const char *if_range = httpd_file_req_hdr(r, "If-Range", buf + value_size, FILE_BUF_SIZE - value_size);
+            range = httpd_file_parse_range(value, if_range, etag, size, &start, &end);
+        }
+    }
+
+    char extra_hdrs[160];
+    int extra_len = snprintf(extra_hdrs, sizeof(extra_hdrs), "Accept-Ranges: bytes\r\nETag: %s\r\n%s%s",
+                             etag, gzip ? "Content-Encoding: gzip\r\n" : "",
+                             gz_exists ? "Vary: Accept-Encoding\r\n" : "");
+    ssize_t len = size;
+    if (not_modified) {
+        ra->status = "304 Not Modified";
+        len = -1;
+    } else if (range > 0) {
+        ra->status = "206 Partial Content";
+        snprintf(extra_hdrs + extra_len, sizeof(extra_hdrs) - extra_len,
+                 "Content-Range: bytes %zu-%zu/%zu\r\n", start, end, size);
+        len = end - start + 1;
+    } else if (range < 0) {
+        ra->status = "416 Range Not Satisfiable";
+        snprintf(extra_hdrs + extra_len, sizeof(extra_hdrs) - extra_len,
+                 "Content-Range: bytes */%zu\r\n", size);
+        len = 0;
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("%s: %s, %zd bytes from %zu"), gzip ? "gzip" : "file", ra->status, len, start);
+    esp_err_t ret = httpd_send_fd_part(r, fd, buf, FILE_BUF_SIZE, start, len, extra_hdrs);
+    if (ret == ESP_ERR_INVALID_ARG) {
+        /* The file can't be read from the start offset */
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    close(fd);
+    free(buf);
+    return ret;
+}
@@ -166,7 +166,8 @@ static int httpd_process_session(struct sock_db *session, void *context)
         return 0;
     }
 
-    if (session->fd < 0) {
+    /* Sessions of the worker tasks are handed back by httpd_worker_done() */
+    if (session->fd < 0 || session->busy) {
         return 1;
     }
 
@@ -187,10 +188,12 @@ static esp_err_t httpd_server(struct httpd_data *hd)
 {
     fd_set read_set;
     FD_ZERO(&read_set);
-    if (hd->config.lru_purge_enable || httpd_is_sess_available(hd)) {
+    if ((hd->config.lru_purge_enable && hd->hd_sd_active_count > hd->hd_jobs_busy) ||
+            httpd_is_sess_available(hd)) {
         /* Only listen for new connections if server has capacity to
          * handle more (or when LRU purge is enabled, in which case
-         * older connections will be closed) */
+         * older connections will be closed, unless all of them are
+         * being processed by worker tasks) */
         FD_SET(hd->listen_fd, &read_set);
     }
     FD_SET(hd->ctrl_fd, &read_set);
@@ -254,6 +257,7 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    httpd_workers_stop(hd);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_sess_close_all(hd);
@@ -374,6 +378,11 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
     }
     /* Save the configuration for this instance */
     hd->config = *config;
+    /* The URI trie supports only the built-in URI matching functions. If it
+     * can't be allocated, all the handlers are checked for every request. */
+    if (!config->uri_match_fn || config->uri_match_fn == httpd_uri_match_wildcard) {
+        hd->hd_uri_trie = httpd_uri_trie_create();
+    }
     return hd;
 }
 
@@ -387,6 +396,7 @@ static void httpd_delete(struct httpd_data *hd)
 
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
+    httpd_uri_trie_delete(hd->hd_uri_trie);
     free(hd->hd_calls);
     free(hd);
 }
@@ -426,12 +436,19 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    esp_err_t err = httpd_workers_start(hd);
+    if (err != ESP_OK) {
+        httpd_workers_stop(hd);
+        httpd_delete(hd);
+        return err;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd,
                                hd->config.core_id) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
@@ -6,6 +6,7 @@
 
 
 #include <stdlib.h>
+#include <ctype.h>
 #include <sys/param.h>
 #include <esp_log.h>
 #include <esp_err.h>
@@ -46,6 +47,12 @@ typedef struct {
         size_t      length;
     } last;
 
+    /* Field name of the header whose value is being parsed */
+    struct {
+        const char *at;
+        size_t      length;
+    } field;
+
     /* State variables */
     bool   paused;          /*!< Parser is paused */
     size_t pre_parsed;      /*!< Length of data to be skipped while parsing */
@@ -187,6 +194,65 @@ static size_t continue_parsing(http_parser *parser, size_t length)
     return length;
 }
 
+/* Hash of a header field name, which is case insensitive */
+static uint16_t hdr_field_hash(const char *field, size_t len)
+{
+    /* FNV-1a folded to 16 bits */
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) tolower((unsigned char) field[i]);
+        hash *= 16777619U;
+    }
+    return (uint16_t) (hash ^ (hash >> 16));
+}
+
+/* Finds the slot of the header index where the given field
+ * is, or the free slot where it would be inserted */
+static unsigned hdr_index_slot(const struct httpd_req_aux *ra, const char *field, size_t len, uint16_t hash)
+{
+    unsigned slot = hash & (HTTPD_REQ_HDR_INDEX_SLOTS - 1);
+    /* There are more slots than entries, so there is always a free one */
+    while (ra->req_hdrs_slots[slot]) {
+        const struct req_hdr *hdr = &ra->req_hdrs[ra->req_hdrs_slots[slot] - 1];
+        if (hdr->hash == hash && hdr->field_len == len &&
+                strncasecmp(ra->scratch + hdr->field_off, field, len) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (HTTPD_REQ_HDR_INDEX_SLOTS - 1);
+    }
+    return slot;
+}
+
+/* Adds the header just parsed to the header index */
+static void hdr_index_add(parser_data_t *parser_data)
+{
+    struct httpd_req_aux *ra = parser_data->req->aux;
+    const size_t field_off = parser_data->field.at - ra->scratch;
+    const size_t field_len = parser_data->field.length;
+    const size_t value_off = parser_data->last.at - ra->scratch;
+    const size_t value_len = parser_data->last.length;
+
+    if (ra->req_hdrs_indexed == HTTPD_REQ_HDR_INDEX_LEN || value_off + value_len > UINT16_MAX) {
+        ra->req_hdrs_overflow = true;
+        return;
+    }
+
+    const uint16_t hash = hdr_field_hash(parser_data->field.at, field_len);
+    const unsigned slot = hdr_index_slot(ra, parser_data->field.at, field_len, hash);
+    if (ra->req_hdrs_slots[slot]) {
+        /* Lookups return the value of the first header with the field name */
+        return;
+    }
+    ra->req_hdrs[ra->req_hdrs_indexed] = (struct req_hdr) {
+        .hash = hash,
+        .field_off = field_off,
+        .field_len = field_len,
+        .value_off = value_off,
+        .value_len = value_len,
+    };
+    ra->req_hdrs_slots[slot] = ++ra->req_hdrs_indexed;
+}
+
 /* http_parser callback on header field in HTTP request
  * May be invoked ATLEAST once every header field
  */
@@ -225,13 +291,14 @@ static esp_err_t cb_header_field(http_parser *parser, const char *at, size_t len
         char *term_start = (char *)parser_data->last.at + parser_data->last.length;
         memset(term_start, '\0', at - term_start);
 
+        /* Index the header and increment header count */
+        hdr_index_add(parser_data);
+        ra->req_hdrs_count++;
+
         /* Store current values of the parser callback arguments */
         parser_data->last.at     = at;
         parser_data->last.length = 0;
         parser_data->status      = PARSING_HDR_FIELD;
-
-        /* Increment header count */
-        ra->req_hdrs_count++;
     } else if (parser_data->status != PARSING_HDR_FIELD) {
         ESP_LOGE(TAG, LOG_FMT("unexpected state transition"));
         parser_data->error = HTTPD_500_INTERNAL_SERVER_ERROR;
@@ -255,6 +322,10 @@ static esp_err_t cb_header_value(http_parser *parser, const char *at, size_t len
 
     /* Check previous status */
     if (parser_data->status == PARSING_HDR_FIELD) {
+        /* The field name is complete */
+        parser_data->field.at     = parser_data->last.at;
+        parser_data->field.length = parser_data->last.length;
+
         /* Store current values of the parser callback arguments */
         parser_data->last.at     = at;
         parser_data->last.length = 0;
@@ -347,11 +418,12 @@ static esp_err_t cb_headers_complete(http_parser *parser)
             return ESP_FAIL;
         }
 
+        /* Index the header and increment header count */
+        hdr_index_add(parser_data);
+        ra->req_hdrs_count++;
+
         /* Place the parser ptr right after the end of headers section */
         parser_data->last.at = at;
-
-        /* Increment header count */
-        ra->req_hdrs_count++;
     } else {
         ESP_LOGE(TAG, LOG_FMT("unexpected state transition"));
         parser_data->error = HTTPD_500_INTERNAL_SERVER_ERROR;
@@ -614,9 +686,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static esp_err_t httpd_parse_req(struct httpd_data *hd)
+static esp_err_t httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser;
     parser_data_t parser_data;
@@ -656,7 +727,7 @@ static esp_err_t httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     ESP_LOGD(TAG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -681,7 +752,11 @@ static void init_req_aux(struct httpd_req_aux *ra, httpd_config_t *config)
     ra->content_type = 0;
     ra->first_chunk_sent = 0;
     ra->req_hdrs_count = 0;
+    memset(ra->req_hdrs_slots, 0, sizeof(ra->req_hdrs_slots));
+    ra->req_hdrs_indexed = 0;
+    ra->req_hdrs_overflow = false;
     ra->resp_hdrs_count = 0;
+    ra->handler = NULL;
 #if CONFIG_HTTPD_WS_SUPPORT
     ra->ws_handshake_detect = false;
 #endif
@@ -720,16 +795,14 @@ static void httpd_req_cleanup(httpd_req_t *r)
 /* Function that processes incoming TCP data and
  * updates the http request data httpd_req_t
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
+esp_err_t httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd)
 {
-    httpd_req_t *r = &hd->hd_req;
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(ra, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = ra;
 
     /* Associate the request to the socket */
-    struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
 
     /* Set defaults */
@@ -770,6 +843,11 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
         /* Call handler if it's a non-control frame (or if handler requests control frames, as well) */
         if (ret == ESP_OK &&
             (ra->ws_type < HTTPD_WS_TYPE_CLOSE || sd->ws_control_frames)) {
+            if (hd->hd_workers) {
+                /* Leave the handler to a worker task */
+                ra->handler = sd->ws_handler;
+                return ESP_OK;
+            }
             ret = sd->ws_handler(r);
         }
 
@@ -781,18 +859,35 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 #endif
 
     /* Parse request */
-    ret = httpd_parse_req(hd);
+    ret = httpd_parse_req(hd, r);
     if (ret != ESP_OK) {
         httpd_req_cleanup(r);
     }
     return ret;
 }
 
+/* Function that invokes the handler left to a worker task
+ * by httpd_req_new()
+ */
+esp_err_t httpd_req_run_handler(httpd_req_t *r)
+{
+    struct httpd_req_aux *ra = r->aux;
+    esp_err_t (*handler)(httpd_req_t *r) = ra->handler;
+    ra->handler = NULL;
+
+    if (handler(r) != ESP_OK) {
+        /* Handler returns error, this socket should be closed */
+        ESP_LOGW(TAG, LOG_FMT("uri handler execution failed"));
+        httpd_req_cleanup(r);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 /* Function that resets the http request data
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd)
+esp_err_t httpd_req_delete(httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -833,9 +928,16 @@ bool httpd_validate_req_ptr(httpd_req_t *r)
         if (hd) {
             /* Check if this function is running in the context of
              * the correct httpd server thread */
-            if (httpd_os_thread_handle() == hd->hd_td.handle) {
+            othread_t current = httpd_os_thread_handle();
+            if (current == hd->hd_td.handle) {
                 return true;
             }
+            /* or one of its worker threads */
+            for (int i = 0; hd->hd_workers && i < hd->config.worker_count; i++) {
+                if (current == hd->hd_workers[i].td.handle) {
+                    return true;
+                }
+            }
         }
     }
     return false;
@@ -949,18 +1051,10 @@ esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
     return ESP_ERR_NOT_FOUND;
 }
 
-/* Get the length of the value string of a header request field */
-size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+/* Search the request headers in scratch buffer for a field, used for the
+ * headers which didn't fit in the header index */
+static const char *httpd_req_search_hdr(struct httpd_req_aux *ra, const char *field)
 {
-    if (r == NULL || field == NULL) {
-        return 0;
-    }
-
-    if (!httpd_valid_req(r)) {
-        return 0;
-    }
-
-    struct httpd_req_aux *ra = r->aux;
     const char   *hdr_ptr = ra->scratch;         /*!< Request headers are kept in scratch buffer */
     unsigned      count   = ra->req_hdrs_count;  /*!< Count set during parsing  */
 
@@ -999,76 +1093,82 @@ size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
         while ((*val_ptr != '\0') && (*val_ptr == ' ')) {
             val_ptr++;
         }
-        return strlen(val_ptr);
+        return val_ptr;
     }
-    return 0;
+    return NULL;
 }
 
-/* Get the value of a field from the request headers */
-esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+/* Get the NULL terminated value of a header request field and its length,
+ * returns NULL if the field isn't present */
+static const char *httpd_req_find_hdr(struct httpd_req_aux *ra, const char *field, size_t *val_len)
 {
-    if (r == NULL || field == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    if (ra->req_hdrs_count == 0) {
+        /* No headers, or the scratch buffer has been reused for the response */
+        return NULL;
     }
 
-    if (!httpd_valid_req(r)) {
-        return ESP_ERR_HTTPD_INVALID_REQ;
+    const size_t field_len = strlen(field);
+    const unsigned slot = hdr_index_slot(ra, field, field_len, hdr_field_hash(field, field_len));
+    if (ra->req_hdrs_slots[slot]) {
+        const struct req_hdr *hdr = &ra->req_hdrs[ra->req_hdrs_slots[slot] - 1];
+        *val_len = hdr->value_len;
+        return ra->scratch + hdr->value_off;
+    }
+    if (!ra->req_hdrs_overflow) {
+        return NULL;
     }
 
-    struct httpd_req_aux *ra = r->aux;
-    const char   *hdr_ptr = ra->scratch;         /*!< Request headers are kept in scratch buffer */
-    unsigned     count    = ra->req_hdrs_count;  /*!< Count set during parsing  */
-    const size_t buf_len  = val_size;
+    const char *val_ptr = httpd_req_search_hdr(ra, field);
+    if (val_ptr) {
+        *val_len = strlen(val_ptr);
+    }
+    return val_ptr;
+}
 
-    while (count--) {
-        /* Search for the ':' character. Else, it would mean
-         * that the field is invalid
-         */
-        const char *val_ptr = strchr(hdr_ptr, ':');
-        if (!val_ptr) {
-            break;
-        }
+/* Get the length of the value string of a header request field */
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    if (r == NULL || field == NULL) {
+        return 0;
+    }
 
-        /* If the field, does not match, continue searching.
-         * Compare lengths first as field from header is not
-         * null terminated (has ':' in the end).
-         */
-        if ((val_ptr - hdr_ptr != strlen(field)) ||
-            (strncasecmp(hdr_ptr, field, strlen(field)))) {
-            if (count) {
-                /* Jump to end of header field-value string */
-                hdr_ptr = 1 + strchr(hdr_ptr, '\0');
+    if (!httpd_valid_req(r)) {
+        return 0;
+    }
 
-                /* Skip all null characters (with which the line
-                 * terminators had been overwritten) */
-                while (*hdr_ptr == '\0') {
-                    hdr_ptr++;
-                }
-            }
-            continue;
-        }
+    size_t val_len;
+    if (!httpd_req_find_hdr(r->aux, field, &val_len)) {
+        return 0;
+    }
+    return val_len;
+}
 
-        /* Skip ':' */
-        val_ptr++;
+/* Get the value of a field from the request headers */
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    if (r == NULL || field == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-        /* Skip preceding space */
-        while ((*val_ptr != '\0') && (*val_ptr == ' ')) {
-            val_ptr++;
-        }
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
 
-        /* Get the NULL terminated value and copy it to the caller's buffer. */
-        strlcpy(val, val_ptr, buf_len);
+    size_t val_len;
+    const char *val_ptr = httpd_req_find_hdr(r->aux, field, &val_len);
+    if (!val_ptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
 
-        /* Update value length, including one byte for null */
-        val_size = strlen(val_ptr) + 1;
+    /* Get the NULL terminated value and copy it to the caller's buffer. */
+    strlcpy(val, val_ptr, val_size);
 
-        /* If buffer length is smaller than needed, return truncation error */
-        if (buf_len < val_size) {
-            return ESP_ERR_HTTPD_RESULT_TRUNC;
-        }
-        return ESP_OK;
+    /* If buffer length is smaller than needed (including one
+     * byte for null), return truncation error */
+    if (val_size < val_len + 1) {
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
     }
-    return ESP_ERR_NOT_FOUND;
+    return ESP_OK;
 }
 
 /* Helper function to get a cookie value from a cookie string of the type "cookie1=val1; cookie2=val2" */
@@ -1135,27 +1235,15 @@ esp_err_t static httpd_cookie_key_value(const char *cookie_str, const char *key,
 /* Get the value of a cookie from the request headers */
 esp_err_t httpd_req_get_cookie_val(httpd_req_t *req, const char *cookie_name, char *val, size_t *val_size)
 {
-    esp_err_t ret;
-    size_t hdr_len_cookie = httpd_req_get_hdr_value_len(req, "Cookie");
-    char *cookie_str = NULL;
-
-    if (hdr_len_cookie <= 0) {
+    if (req == NULL || !httpd_valid_req(req)) {
         return ESP_ERR_NOT_FOUND;
     }
-    cookie_str = malloc(hdr_len_cookie + 1);
-    if (cookie_str == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for cookie string");
-        return ESP_ERR_NO_MEM;
-    }
 
-    if (httpd_req_get_hdr_value_str(req, "Cookie", cookie_str, hdr_len_cookie + 1) != ESP_OK) {
-        ESP_LOGW(TAG, "Cookie not found in header uri:[%s]", req->uri);
-        free(cookie_str);
+    /* The header value is NULL terminated in scratch buffer, parse it in place */
+    size_t hdr_len_cookie = 0;
+    const char *cookie_str = httpd_req_find_hdr(req->aux, "Cookie", &hdr_len_cookie);
+    if (cookie_str == NULL || hdr_len_cookie == 0) {
         return ESP_ERR_NOT_FOUND;
     }
-
-    ret = httpd_cookie_key_value(cookie_str, cookie_name, val, val_size);
-    free(cookie_str);
-    return ret;
-
+    return httpd_cookie_key_value(cookie_str, cookie_name, val, val_size);
 }
@@ -87,7 +87,8 @@ static int enum_function(struct sock_db *session, void *context)
         break;
     // Set descriptor
     case HTTPD_TASK_SET_DESCRIPTOR:
-        if (session->fd != -1) {
+        // Sessions of the worker tasks are not read by the server task
+        if (session->fd != -1 && !session->busy) {
             FD_SET(session->fd, ctx->fdset);
             if (session->fd > ctx->max_fd) {
                 ctx->max_fd = session->fd;
@@ -107,8 +108,8 @@ static int enum_function(struct sock_db *session, void *context)
         if (session->fd == -1) {
             return 0;
         }
-        // Check/update lowest lru
-        if (session->lru_counter < ctx->lru_counter) {
+        // Check/update lowest lru, the sessions of the worker tasks can't be closed now
+        if (!session->busy && session->lru_counter < ctx->lru_counter) {
             ctx->lru_counter = session->lru_counter;
             ctx->session = session;
         }
@@ -253,6 +254,19 @@ void httpd_sess_clear_ctx(struct sock_db *session)
     }
 }
 
+httpd_req_t *httpd_sess_get_req(struct httpd_data *hd, struct sock_db *session)
+{
+    if (hd->hd_req_aux.sd == session) {
+        return &hd->hd_req;
+    }
+    for (int i = 0; hd->hd_jobs && i < hd->config.worker_count; i++) {
+        if (hd->hd_jobs[i].req_aux.sd == session) {
+            return &hd->hd_jobs[i].req;
+        }
+    }
+    return NULL;
+}
+
 void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
 {
     struct sock_db *session = httpd_sess_get(handle, sockfd);
@@ -263,9 +277,9 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     // Check if the function has been called from inside a
     // request handler, in which case fetch the context from
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        return hd->hd_req.sess_ctx;
+    httpd_req_t *req = httpd_sess_get_req(handle, session);
+    if (req) {
+        return req->sess_ctx;
     }
     return session->ctx;
 }
@@ -280,17 +294,17 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     // Check if the function has been called from inside a
     // request handler, in which case set the context inside
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    httpd_req_t *req = httpd_sess_get_req(handle, session);
+    if (req) {
+        if (req->sess_ctx != ctx) {
             // Don't free previous context if it is in sockdb
             // as it will be freed inside httpd_req_cleanup()
-            if (session->ctx != hd->hd_req.sess_ctx) {
-                httpd_sess_free_ctx(&hd->hd_req.sess_ctx, hd->hd_req.free_ctx); // Free previous context
+            if (session->ctx != req->sess_ctx) {
+                httpd_sess_free_ctx(&req->sess_ctx, req->free_ctx); // Free previous context
             }
-            hd->hd_req.sess_ctx = ctx;
+            req->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        req->free_ctx = free_fn;
         return;
     }
 
@@ -331,7 +345,10 @@ void httpd_sess_set_descriptors(struct httpd_data *hd, fd_set *fdset, int *maxfd
         .max_fd = -1,
         .fdset = fdset
     };
-    httpd_sess_enum(hd, enum_function, &context);
+    // New requests wait in the sockets until a worker task is free
+    if (httpd_workers_available(hd)) {
+        httpd_sess_enum(hd, enum_function, &context);
+    }
     if (maxfd) {
         *maxfd = context.max_fd;
     }
@@ -352,6 +369,13 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
         return;
     }
 
+    if (session->busy) {
+        // A worker task is using the session, delete it when the worker is done
+        ESP_LOGD(TAG, LOG_FMT("fd = %d busy, closing later"), session->fd);
+        session->close_pending = true;
+        return;
+    }
+
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), session->fd);
 
     // Call close function if defined
@@ -408,12 +432,16 @@ esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session)
         return ESP_FAIL;
     }
 
+    if (hd->hd_workers) {
+        return httpd_workers_process(hd, session);
+    }
+
     ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
-    if (httpd_req_new(hd, session) != ESP_OK) {
+    if (httpd_req_new(hd, &hd->hd_req, &hd->hd_req_aux, session) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != ESP_OK) {
+    if (httpd_req_delete(&hd->hd_req) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("success"));
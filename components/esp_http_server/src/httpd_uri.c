@@ -80,6 +80,59 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
     }
 }
 
+static void httpd_uri_trie_delete_work(void *arg)
+{
+    httpd_uri_trie_delete((httpd_uri_trie_t *) arg);
+}
+
+/* Deletes a trie which has been replaced. The server task may still be
+ * looking up a request in it, so unless this runs on the server task
+ * itself, the trie is deleted by the server task between two requests. */
+static void httpd_uri_trie_retire(struct httpd_data *hd, httpd_uri_trie_t *trie)
+{
+    if (!trie) {
+        return;
+    }
+    if (httpd_os_thread_handle() != hd->hd_td.handle) {
+        /* The server task may be unable to receive the message for a moment */
+        while (hd->hd_td.status == THREAD_RUNNING) {
+            if (httpd_queue_work(hd, httpd_uri_trie_delete_work, trie) == ESP_OK) {
+                return;
+            }
+            httpd_os_thread_sleep(10);
+        }
+    }
+    httpd_uri_trie_delete(trie);
+}
+
+/* Builds the URI trie again from the registered handlers. Without
+ * the trie, httpd_find_uri_handler() checks all the handlers.
+ *
+ * The new trie is built off to the side and published with a single
+ * pointer store, so a concurrent lookup sees either the old or the new
+ * trie, never one being modified. If the trie can't be allocated, the
+ * next rebuild tries again. */
+static void httpd_uri_trie_rebuild(struct httpd_data *hd)
+{
+    if (hd->config.uri_match_fn && hd->config.uri_match_fn != httpd_uri_match_wildcard) {
+        return;
+    }
+    httpd_uri_trie_t *trie = httpd_uri_trie_create();
+    for (int i = 0; trie && i < hd->config.max_uri_handlers && hd->hd_calls[i]; i++) {
+        if (httpd_uri_trie_add(trie, hd->hd_calls[i], i,
+                               hd->config.uri_match_fn == httpd_uri_match_wildcard) != ESP_OK) {
+            httpd_uri_trie_delete(trie);
+            trie = NULL;
+        }
+    }
+    if (!trie) {
+        ESP_LOGW(TAG, LOG_FMT("no memory for the URI trie, checking all handlers"));
+    }
+    httpd_uri_trie_t *old = hd->hd_uri_trie;
+    hd->hd_uri_trie = trie;
+    httpd_uri_trie_retire(hd, old);
+}
+
 /* Find handler with matching URI and method, and set
  * appropriate error code if URI or method not found */
 static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
@@ -87,6 +140,12 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
                                            httpd_method_t method,
                                            httpd_err_code_t *err)
 {
+    /* Load the trie once, it may be replaced meanwhile */
+    const httpd_uri_trie_t *trie = hd->hd_uri_trie;
+    if (trie) {
+        return httpd_uri_trie_find(trie, uri, uri_len, method, err);
+    }
+
     if (err) {
         *err = HTTPD_404_NOT_FOUND;
     }
@@ -173,6 +232,7 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
                 hd->hd_calls[i]->supported_subprotocol = NULL;
             }
 #endif
+            httpd_uri_trie_rebuild(hd);
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
             return ESP_OK;
         }
@@ -212,6 +272,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             }
             /* Nullify the following non null entry */
             hd->hd_calls[i-1] = NULL;
+            httpd_uri_trie_rebuild(hd);
             return ESP_OK;
         }
     }
@@ -255,6 +316,8 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
 
     if (!found) {
         ESP_LOGW(TAG, LOG_FMT("no handler found for URI %s"), uri);
+    } else {
+        httpd_uri_trie_rebuild(hd);
     }
     return (found ? ESP_OK : ESP_ERR_NOT_FOUND);
 }
@@ -271,13 +334,13 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
     }
+    httpd_uri_trie_rebuild(hd);
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct http_parser_url *res = &((struct httpd_req_aux *) req->aux)->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
@@ -313,7 +376,7 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     struct httpd_req_aux   *aux = req->aux;
     if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
         ESP_LOGD(TAG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        esp_err_t ret = httpd_ws_respond_server_handshake(&hd->hd_req, uri->supported_subprotocol);
+        esp_err_t ret = httpd_ws_respond_server_handshake(req, uri->supported_subprotocol);
         if (ret != ESP_OK) {
             return ret;
         }
@@ -325,6 +388,12 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     }
 #endif
 
+    if (hd->hd_workers) {
+        /* Leave the handler to a worker task */
+        ((struct httpd_req_aux *) req->aux)->handler = uri->handler;
+        return ESP_OK;
+    }
+
     /* Invoke handler */
     if (uri->handler(req) != ESP_OK) {
         /* Handler returns error, this socket should be closed */
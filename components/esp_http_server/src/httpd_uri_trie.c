@@ -0,0 +1,224 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+/* A handler reachable at a node, for requests whose URI ends at
+ * the node, or for all the URIs going through it if prefix is set */
+struct trie_entry {
+    struct trie_entry *next;
+    httpd_uri_t *uri;
+    uint16_t order;                 /* Position of the handler in hd_calls, the lowest one wins */
+    bool prefix;
+};
+
+/* Radix trie node. The label is the part of the URI from the parent node
+ * to this one, the labels of the children start with different characters. */
+struct trie_node {
+    struct trie_node *children;
+    struct trie_node *next;         /* Next sibling */
+    struct trie_entry *entries;
+    size_t len;
+    char label[];
+};
+
+struct httpd_uri_trie {
+    struct trie_node root;          /* Empty label */
+};
+
+static struct trie_node *trie_node_new(const char *label, size_t len)
+{
+    struct trie_node *node = calloc(1, sizeof(struct trie_node) + len);
+    if (node) {
+        memcpy(node->label, label, len);
+        node->len = len;
+    }
+    return node;
+}
+
+static void trie_node_free_entries(struct trie_node *node)
+{
+    while (node->entries) {
+        struct trie_entry *entry = node->entries;
+        node->entries = entry->next;
+        free(entry);
+    }
+}
+
+/* Frees the descendants of the node, without recursion as the trie may be deep */
+static void trie_node_free_children(struct trie_node *node)
+{
+    struct trie_node *pending = node->children;
+    node->children = NULL;
+    while (pending) {
+        struct trie_node *child = pending;
+        pending = child->next;
+        if (child->children) {
+            struct trie_node *last = child->children;
+            while (last->next) {
+                last = last->next;
+            }
+            last->next = pending;
+            pending = child->children;
+        }
+        trie_node_free_entries(child);
+        free(child);
+    }
+}
+
+static struct trie_node *trie_child(const struct trie_node *node, char c)
+{
+    for (struct trie_node *child = node->children; child; child = child->next) {
+        if (child->label[0] == c) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t trie_insert(struct httpd_uri_trie *trie, const char *str, size_t len,
+                             bool prefix, httpd_uri_t *uri, uint16_t order)
+{
+    /* Allocate first, so that the trie isn't changed on failure */
+    struct trie_entry *entry = calloc(1, sizeof(struct trie_entry));
+    if (!entry) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    entry->uri = uri;
+    entry->order = order;
+    entry->prefix = prefix;
+
+    struct trie_node *node = &trie->root;
+    size_t pos = 0;
+    while (pos < len) {
+        struct trie_node *child = trie_child(node, str[pos]);
+        if (!child) {
+            child = trie_node_new(str + pos, len - pos);
+            if (!child) {
+                free(entry);
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
+            child->next = node->children;
+            node->children = child;
+            node = child;
+            break;
+        }
+
+        size_t common = 1;
+        while (common < child->len && pos + common < len && child->label[common] == str[pos + common]) {
+            common++;
+        }
+        if (common < child->len) {
+            /* Split the child, its tail keeps the children and entries */
+            struct trie_node *tail = trie_node_new(child->label + common, child->len - common);
+            if (!tail) {
+                free(entry);
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
+            tail->children = child->children;
+            tail->entries = child->entries;
+            child->children = tail;
+            child->entries = NULL;
+            child->len = common;
+        }
+        node = child;
+        pos += common;
+    }
+
+    entry->next = node->entries;
+    node->entries = entry;
+    return ESP_OK;
+}
+
+httpd_uri_trie_t *httpd_uri_trie_create(void)
+{
+    return calloc(1, sizeof(struct httpd_uri_trie));
+}
+
+void httpd_uri_trie_delete(httpd_uri_trie_t *trie)
+{
+    if (trie) {
+        trie_node_free_children(&trie->root);
+        trie_node_free_entries(&trie->root);
+        free(trie);
+    }
+}
+
+esp_err_t httpd_uri_trie_add(httpd_uri_trie_t *trie, httpd_uri_t *uri, uint16_t order, bool wildcard)
+{
+    const char *tpl = uri->uri;
+    const size_t tpl_len = strlen(tpl);
+    if (!wildcard) {
+        return trie_insert(trie, tpl, tpl_len, false, uri, order);
+    }
+
+    /* Same template rules as httpd_uri_match_wildcard() */
+    const char last = (const char) (tpl_len > 0 ? tpl[tpl_len - 1] : 0);
+    const char prevlast = (const char) (tpl_len > 1 ? tpl[tpl_len - 2] : 0);
+    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    if (tpl_len < asterisk + quest*2) {
+        /* Invalid template, doesn't match anything */
+        return ESP_OK;
+    }
+    const size_t exact_match_chars = tpl_len - (asterisk + quest*2);
+
+    if (!quest) {
+        return trie_insert(trie, tpl, exact_match_chars, asterisk, uri, order);
+    }
+    /* The mandatory part alone, or followed by the optional character
+     * (and by anything with an asterisk) */
+    esp_err_t ret = trie_insert(trie, tpl, exact_match_chars, false, uri, order);
+    if (ret == ESP_OK) {
+        ret = trie_insert(trie, tpl, exact_match_chars + 1, asterisk, uri, order);
+    }
+    return ret;
+}
+
+httpd_uri_t *httpd_uri_trie_find(const httpd_uri_trie_t *trie,
+                                 const char *uri, size_t uri_len,
+                                 httpd_method_t method,
+                                 httpd_err_code_t *err)
+{
+    const struct trie_entry *found = NULL;
+    bool uri_found = false;
+
+    const struct trie_node *node = &trie->root;
+    size_t pos = 0;
+    while (node) {
+        for (const struct trie_entry *entry = node->entries; entry; entry = entry->next) {
+            if (!entry->prefix && pos != uri_len) {
+                continue;
+            }
+            uri_found = true;
+            if (entry->uri->method == method && (!found || entry->order < found->order)) {
+                found = entry;
+            }
+        }
+        if (pos == uri_len) {
+            break;
+        }
+        node = trie_child(node, uri[pos]);
+        if (node && (node->len > uri_len - pos || memcmp(node->label, uri + pos, node->len) != 0)) {
+            node = NULL;
+        }
+        if (node) {
+            pos += node->len;
+        }
+    }
+
+    if (err) {
+        *err = found ? 0 : (uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND);
+    }
+    return found ? found->uri : NULL;
+}
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_worker";
+
+/* Runs on the server task when a worker task is done with a job,
+ * hands the session of the job back to the server task */
+static void httpd_worker_done(void *arg)
+{
+    struct httpd_worker_job *job = (struct httpd_worker_job *) arg;
+    struct httpd_data *hd = job->hd;
+    struct sock_db *session = job->sd;
+
+    job->sd = NULL;
+    job->busy = false;
+    hd->hd_jobs_busy--;
+    session->busy = false;
+
+    if (job->ret != ESP_OK || session->close_pending) {
+        ESP_LOGD(TAG, LOG_FMT("closing socket %d"), session->fd);
+        session->close_pending = false;
+        session->lru_socket = false;
+        httpd_sess_delete(hd, session);
+        return;
+    }
+    session->lru_counter = ++hd->lru_counter;
+}
+
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *worker = (struct httpd_worker *) arg;
+    struct httpd_data *hd = worker->hd;
+    worker->td.status = THREAD_RUNNING;
+
+    while (1) {
+        struct httpd_worker_job *job;
+        httpd_os_queue_receive(hd->hd_job_queue, &job);
+        if (!job) {
+            break;
+        }
+
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), job->sd->fd);
+        job->ret = httpd_req_run_handler(&job->req);
+        if (job->ret == ESP_OK) {
+            job->ret = httpd_req_delete(&job->req);
+        }
+
+        /* The server task may be unable to receive the message for a moment.
+         * If it is stopping, httpd_workers_stop() hands the session back. */
+        while (httpd_queue_work(hd, httpd_worker_done, job) != ESP_OK &&
+               hd->hd_td.status == THREAD_RUNNING) {
+            httpd_os_thread_sleep(10);
+        }
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("worker exiting"));
+    worker->td.status = THREAD_STOPPED;
+    httpd_os_thread_delete();
+}
+
+esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    unsigned count = hd->config.worker_count;
+    if (!count) {
+        return ESP_OK;
+    }
+
+    hd->hd_workers = calloc(count, sizeof(struct httpd_worker));
+    hd->hd_jobs = calloc(count, sizeof(struct httpd_worker_job));
+    /* Room for all the jobs and the stop requests */
+    hd->hd_job_queue = httpd_os_queue_create(2 * count, sizeof(struct httpd_worker_job *));
+    if (!hd->hd_workers || !hd->hd_jobs || !hd->hd_job_queue) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP worker tasks"));
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        struct httpd_worker_job *job = &hd->hd_jobs[i];
+        job->hd = hd;
+        job->req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!job->req_aux.resp_hdrs) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP response headers"));
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        struct httpd_worker *worker = &hd->hd_workers[i];
+        worker->hd = hd;
+        if (httpd_os_thread_create(&worker->td.handle, "httpd_worker",
+                                   hd->config.stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, worker,
+                                   hd->config.core_id) != ESP_OK) {
+            worker->td.handle = NULL;
+            ESP_LOGE(TAG, LOG_FMT("Failed to launch HTTP worker task"));
+            return ESP_ERR_HTTPD_TASK;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Also frees what a failed httpd_workers_start() has allocated, each of
+ * the allocations may have failed */
+void httpd_workers_stop(struct httpd_data *hd)
+{
+    unsigned count = hd->config.worker_count;
+
+    /* The workers finish the jobs queued before the stop requests.
+     * Workers are only started once all the allocations succeeded. */
+    for (unsigned i = 0; hd->hd_workers && i < count; i++) {
+        if (hd->hd_workers[i].td.handle) {
+            struct httpd_worker_job *stop = NULL;
+            httpd_os_queue_send(hd->hd_job_queue, &stop);
+        }
+    }
+    for (unsigned i = 0; hd->hd_workers && i < count; i++) {
+        if (hd->hd_workers[i].td.handle) {
+            while (hd->hd_workers[i].td.status != THREAD_STOPPED) {
+                httpd_os_thread_sleep(10);
+            }
+        }
+    }
+
+    for (unsigned i = 0; hd->hd_jobs && i < count; i++) {
+        struct httpd_worker_job *job = &hd->hd_jobs[i];
+        if (job->busy) {
+            /* The server task didn't receive the message of the worker */
+            httpd_worker_done(job);
+        }
+        free(job->req_aux.resp_hdrs);
+    }
+    if (hd->hd_job_queue) {
+        httpd_os_queue_delete(hd->hd_job_queue);
+    }
+    free(hd->hd_jobs);
+    free(hd->hd_workers);
+    hd->hd_job_queue = NULL;
+    hd->hd_jobs = NULL;
+    hd->hd_workers = NULL;
+    hd->hd_jobs_busy = 0;
+}
+
+esp_err_t httpd_workers_process(struct httpd_data *hd, struct sock_db *session)
+{
+    struct httpd_worker_job *job = NULL;
+    for (unsigned i = 0; i < hd->config.worker_count; i++) {
+        if (!hd->hd_jobs[i].busy) {
+            job = &hd->hd_jobs[i];
+            break;
+        }
+    }
+    if (!job) {
+        ESP_LOGD(TAG, LOG_FMT("no free worker for socket %d"), session->fd);
+        return ESP_OK;
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
+    if (httpd_req_new(hd, &job->req, &job->req_aux, session) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    if (!job->req_aux.handler) {
+        /* Nothing left for a worker task, e.g. an error response has been sent */
+        ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
+        if (httpd_req_delete(&job->req) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        session->lru_counter = ++hd->lru_counter;
+        return ESP_OK;
+    }
+
+    job->sd = session;
+    job->busy = true;
+    session->busy = true;
+    hd->hd_jobs_busy++;
+    /* The queue has room for all the jobs */
+    httpd_os_queue_send(hd->hd_job_queue, &job);
+    ESP_LOGD(TAG, LOG_FMT("passed socket %d to a worker"), session->fd);
+    return ESP_OK;
+}
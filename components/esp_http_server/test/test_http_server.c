@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <esp_system.h>
 #include <esp_http_server.h>
+#include "lwip/sockets.h"
 
 #include "unity.h"
 #include "test_utils.h"
@@ -148,6 +149,29 @@ TEST_CASE("Leak Test", "[HTTP SERVER]")
     TEST_ASSERT(res == true);
 }
 
+#define TEST_WORKER_COUNT 3
+
+TEST_CASE("Worker Tasks Leak Test", "[HTTP SERVER]")
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.worker_count = TEST_WORKER_COUNT;
+
+    test_case_uses_tcpip();
+
+    unsigned task_count = uxTaskGetNumberOfTasks();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    vTaskDelay(10);
+    /* The server task and the worker tasks */
+    TEST_ASSERT_EQUAL(task_count + 1 + TEST_WORKER_COUNT, uxTaskGetNumberOfTasks());
+
+    test_handler_limit(hd);
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+    vTaskDelay(10);
+    TEST_ASSERT_EQUAL(task_count, uxTaskGetNumberOfTasks());
+}
+
 TEST_CASE("Basic Functionality Tests", "[HTTP SERVER]")
 {
     httpd_handle_t hd;
@@ -243,3 +267,150 @@ TEST_CASE("Max Allowed Sockets Test", "[HTTP SERVER]")
     config.max_open_sockets += 1;
     TEST_ASSERT(httpd_start(&hd, &config) != ESP_OK);
 }
+
+/********************* Request Header Tests *******************/
+
+/* Lookups made by the handler of the request header tests */
+static const char *s_hdr_lookups[] = {
+    "X-Dup", "x-mixed-case", "X-MIXED-CASE", "X-Trunc", "X-Last", "X-Missing",
+};
+#define HDR_LOOKUPS (sizeof(s_hdr_lookups) / sizeof(s_hdr_lookups[0]))
+
+typedef struct {
+    size_t len;                 /* Result of httpd_req_get_hdr_value_len() */
+    esp_err_t err;              /* Result of httpd_req_get_hdr_value_str() */
+    char val[16];
+} hdr_lookup_t;
+
+static hdr_lookup_t s_hdr_results[HDR_LOOKUPS];
+
+/* Results of reading X-Trunc: 0123456789 into buffers 10 and 11 bytes long */
+static esp_err_t s_hdr_trunc_err[2];
+static char s_hdr_trunc_val[2][11];
+
+static esp_err_t hdr_lookup_handler(httpd_req_t *req)
+{
+    for (size_t i = 0; i < HDR_LOOKUPS; i++) {
+        hdr_lookup_t *res = &s_hdr_results[i];
+        memset(res->val, 0, sizeof(res->val));
+        res->len = httpd_req_get_hdr_value_len(req, s_hdr_lookups[i]);
+        res->err = httpd_req_get_hdr_value_str(req, s_hdr_lookups[i], res->val, sizeof(res->val));
+    }
+    for (int i = 0; i < 2; i++) {
+        memset(s_hdr_trunc_val[i], 0, sizeof(s_hdr_trunc_val[i]));
+        s_hdr_trunc_err[i] = httpd_req_get_hdr_value_str(req, "X-Trunc", s_hdr_trunc_val[i], 10 + i);
+    }
+    return httpd_resp_send(req, "OK", HTTPD_RESP_USE_STRLEN);
+}
+
+/* Sends a request to the server on the loopback interface and waits for the response */
+static void test_hdr_request(uint16_t port, const char *request)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(sock >= 0);
+    TEST_ASSERT_EQUAL(0, connect(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(strlen(request), send(sock, request, strlen(request), 0));
+
+    char resp[128] = "";
+    int len = 0, ret;
+    while (len < (int)sizeof(resp) - 1 &&
+           (ret = recv(sock, resp + len, sizeof(resp) - 1 - len, 0)) > 0) {
+        len += ret;
+        resp[len] = '\0';
+        if (strstr(resp, "\r\n\r\nOK")) {
+            break;
+        }
+    }
+    close(sock);
+    TEST_ASSERT_NOT_NULL(strstr(resp, "200 OK"));
+}
+
+static void test_hdr_results(void)
+{
+    /* The first header of a field name wins */
+    TEST_ASSERT_EQUAL(ESP_OK, s_hdr_results[0].err);
+    TEST_ASSERT_EQUAL_STRING("first", s_hdr_results[0].val);
+    TEST_ASSERT_EQUAL(5, s_hdr_results[0].len);
+
+    /* Field names are case insensitive */
+    for (int i = 1; i <= 2; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, s_hdr_results[i].err);
+        TEST_ASSERT_EQUAL_STRING("yes", s_hdr_results[i].val);
+        TEST_ASSERT_EQUAL(3, s_hdr_results[i].len);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, s_hdr_results[3].err);
+    TEST_ASSERT_EQUAL_STRING("0123456789", s_hdr_results[3].val);
+    TEST_ASSERT_EQUAL(10, s_hdr_results[3].len);
+
+    TEST_ASSERT_EQUAL(ESP_OK, s_hdr_results[4].err);
+    TEST_ASSERT_EQUAL_STRING("last", s_hdr_results[4].val);
+    TEST_ASSERT_EQUAL(4, s_hdr_results[4].len);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, s_hdr_results[5].err);
+    TEST_ASSERT_EQUAL(0, s_hdr_results[5].len);
+
+    /* The value is truncated to fit the buffer together with the NULL terminator */
+    TEST_ASSERT_EQUAL(ESP_ERR_HTTPD_RESULT_TRUNC, s_hdr_trunc_err[0]);
+    TEST_ASSERT_EQUAL_STRING("012345678", s_hdr_trunc_val[0]);
+    TEST_ASSERT_EQUAL(ESP_OK, s_hdr_trunc_err[1]);
+    TEST_ASSERT_EQUAL_STRING("0123456789", s_hdr_trunc_val[1]);
+}
+
+TEST_CASE("Request Header Lookup Tests", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+
+    httpd_uri_t uri = {
+        .uri      = "/hdrs",
+        .method   = HTTP_GET,
+        .handler  = hdr_lookup_handler,
+        .user_ctx = NULL,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    /* All headers fit in the index */
+    memset(s_hdr_results, 0, sizeof(s_hdr_results));
+    test_hdr_request(config.server_port,
+                     "GET /hdrs HTTP/1.1\r\n"
+                     "Host: test\r\n"
+                     "X-Dup: first\r\n"
+                     "X-Mixed-Case: yes\r\n"
+                     "x-dup: second\r\n"
+                     "X-Trunc: 0123456789\r\n"
+                     "X-Last: last\r\n"
+                     "\r\n");
+    test_hdr_results();
+
+    /* More headers than the index holds, the last ones are found by searching the headers */
+    char request[400];
+    int len = snprintf(request, sizeof(request),
+                       "GET /hdrs HTTP/1.1\r\n"
+                       "Host: test\r\n"
+                       "X-Dup: first\r\n"
+                       "X-Mixed-Case: yes\r\n"
+                       "x-dup: second\r\n"
+                       "X-Trunc: 0123456789\r\n");
+    for (int i = 0; i < 24; i++) {
+        len += snprintf(request + len, sizeof(request) - len, "F%02d: %d\r\n", i, i);
+    }
+    snprintf(request + len, sizeof(request) - len,
+             "X-DUP: third\r\n"
+             "X-Last: last\r\n"
+             "\r\n");
+    TEST_ASSERT(strlen(request) < sizeof(request) - 1);
+    memset(s_hdr_results, 0, sizeof(s_hdr_results));
+    test_hdr_request(config.server_port, request);
+    test_hdr_results();
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#include "unity.h"
+
+#define TEST_FILE_SIZE  1000
+#define TEST_ETAG       "\"61a0c0de-3e8\""
+
+TEST_CASE("File Range Parser Tests", "[HTTP SERVER]")
+{
+    struct rangetest {
+        const char *range;
+        const char *if_range;
+        size_t size;
+        int result;
+        size_t start;
+        size_t end;
+    };
+
+    struct rangetest ranges[] = {
+        {"bytes=0-99", NULL, TEST_FILE_SIZE, 1, 0, 99},
+        {"bytes=100-100", NULL, TEST_FILE_SIZE, 1, 100, 100},
+        {"bytes=0-", NULL, TEST_FILE_SIZE, 1, 0, 999},
+
+        /* suffix */
+        {"bytes=-100", NULL, TEST_FILE_SIZE, 1, 900, 999},
+        {"bytes=-1000", NULL, TEST_FILE_SIZE, 1, 0, 999},
+        {"bytes=-5000", NULL, TEST_FILE_SIZE, 1, 0, 999},
+        {"bytes=-0", NULL, TEST_FILE_SIZE, -1},
+
+        /* clipped to the end of the file */
+        {"bytes=500-", NULL, TEST_FILE_SIZE, 1, 500, 999},
+        {"bytes=500-5000", NULL, TEST_FILE_SIZE, 1, 500, 999},
+        {"bytes=999-1000", NULL, TEST_FILE_SIZE, 1, 999, 999},
+
+        /* unsatisfiable */
+        {"bytes=1000-", NULL, TEST_FILE_SIZE, -1},
+        {"bytes=1000-1001", NULL, TEST_FILE_SIZE, -1},
+        {"bytes=0-", NULL, 0, -1},
+        {"bytes=-1", NULL, 0, -1},
+
+        /* multiple ranges and invalid values are ignored */
+        {"bytes=0-1,5-6", NULL, TEST_FILE_SIZE, 0},
+        {"bytes=0-1, 900-", NULL, TEST_FILE_SIZE, 0},
+        {"bytes=5-2", NULL, TEST_FILE_SIZE, 0},
+        {"bytes=-", NULL, TEST_FILE_SIZE, 0},
+        {"bytes=abc", NULL, TEST_FILE_SIZE, 0},
+        {"bytes=1-2x", NULL, TEST_FILE_SIZE, 0},
+        {"items=0-1", NULL, TEST_FILE_SIZE, 0},
+
+        /* If-Range */
+        {"bytes=0-99", TEST_ETAG, TEST_FILE_SIZE, 1, 0, 99},
+        {"bytes=2000-", TEST_ETAG, TEST_FILE_SIZE, -1},
+        {"bytes=0-99", "\"61a0c0de-3e9\"", TEST_FILE_SIZE, 0},
+        {"bytes=0-99", "W/" TEST_ETAG, TEST_FILE_SIZE, 0},
+        {"bytes=0-99", "Sat, 20 Nov 2021 10:00:00 GMT", TEST_FILE_SIZE, 0},
+        {"bytes=2000-", "\"61a0c0de-3e9\"", TEST_FILE_SIZE, 0},
+        {}
+    };
+
+    for (struct rangetest *rt = &ranges[0]; rt->range != NULL; rt++) {
+        size_t start = SIZE_MAX, end = SIZE_MAX;
+        int result = httpd_file_parse_range(rt->range, rt->if_range, TEST_ETAG, rt->size, &start, &end);
+        TEST_ASSERT_EQUAL_MESSAGE(rt->result, result, rt->range);
+        if (result > 0) {
+            TEST_ASSERT_EQUAL_MESSAGE(rt->start, start, rt->range);
+            TEST_ASSERT_EQUAL_MESSAGE(rt->end, end, rt->range);
+        }
+    }
+}
+
+TEST_CASE("File Accept-Encoding Tests", "[HTTP SERVER]")
+{
+    struct gziptest {
+        const char *accept;
+        bool gzip;
+    };
+
+    struct gziptest accepts[] = {
+        {"gzip", true},
+        {"GZip", true},
+        {"gzip, deflate, br", true},
+        {"deflate,gzip", true},
+        {"gzip;q=0.5", true},
+        {"br;q=0, gzip", true},
+        {"gzip;q=0", false},
+        {"gzip; q=0", false},
+        {"deflate, gzip;q=0", false},
+        {"gzip;q=0.0, deflate", false},
+        {"gzip;q=0, *", false},
+        {"deflate, br", false},
+        {"x-gzip", false},
+        {"gzipped", false},
+        {"", false},
+        {}
+    };
+
+    for (struct gziptest *gt = &accepts[0]; gt->accept != NULL; gt++) {
+        TEST_ASSERT_MESSAGE(httpd_file_accepts_gzip(gt->accept) == gt->gzip, gt->accept);
+    }
+}
+
+TEST_CASE("File If-None-Match Tests", "[HTTP SERVER]")
+{
+    TEST_ASSERT_TRUE(httpd_file_etag_match(TEST_ETAG, TEST_ETAG));
+    TEST_ASSERT_TRUE(httpd_file_etag_match("*", TEST_ETAG));
+    TEST_ASSERT_TRUE(httpd_file_etag_match("W/" TEST_ETAG, TEST_ETAG));
+    TEST_ASSERT_TRUE(httpd_file_etag_match("\"1-2\", " TEST_ETAG, TEST_ETAG));
+    TEST_ASSERT_TRUE(httpd_file_etag_match(TEST_ETAG ", \"1-2\"", TEST_ETAG));
+    TEST_ASSERT_FALSE(httpd_file_etag_match("\"61a0c0de-3e9\"", TEST_ETAG));
+    TEST_ASSERT_FALSE(httpd_file_etag_match("\"61a0c0de-3e8a\"", TEST_ETAG));
+    TEST_ASSERT_FALSE(httpd_file_etag_match("", TEST_ETAG));
+}
+
+TEST_CASE("File Read Size Tests", "[HTTP SERVER]")
+{
+    /* The first read after the headers can't end aligned, the second one gets back */
+    TEST_ASSERT_EQUAL(3896, httpd_file_read_size(0, 3896, 4096));
+    TEST_ASSERT_EQUAL(200, httpd_file_read_size(3896, 4096, 4096));
+    TEST_ASSERT_EQUAL(4096, httpd_file_read_size(4096, 4096, 4096));
+    /* Ranges starting in the middle of a sector */
+    TEST_ASSERT_EQUAL(3000, httpd_file_read_size(5192, 3896, 4096));
+    TEST_ASSERT_EQUAL(8192, httpd_file_read_size(8192, 8192, 4096));
+    /* Buffers which aren't a multiple of the alignment */
+    TEST_ASSERT_EQUAL(4096, httpd_file_read_size(0, 6144, 4096));
+    TEST_ASSERT_EQUAL(4096, httpd_file_read_size(4096, 6144, 4096));
+}
@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_timer.h>
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#include "unity.h"
+#include "test_utils.h"
+
+static esp_err_t trie_test_handler(httpd_req_t *req)
+{
+    return ESP_OK;
+}
+
+static bool uri_match_simple(const char *uri1, const char *uri2, size_t len2)
+{
+    return strlen(uri1) == len2 && strncmp(uri1, uri2, len2) == 0;
+}
+
+/* The search which the trie replaces: the first handler (in the order of
+ * registration) whose template matches the URI and whose method matches */
+static httpd_uri_t *uri_find_linear(httpd_uri_t *uris, int count, bool wildcard,
+                                    const char *uri, size_t uri_len,
+                                    httpd_method_t method, httpd_err_code_t *err)
+{
+    *err = HTTPD_404_NOT_FOUND;
+    for (int i = 0; i < count; i++) {
+        if (wildcard ? httpd_uri_match_wildcard(uris[i].uri, uri, uri_len) :
+                uri_match_simple(uris[i].uri, uri, uri_len)) {
+            if (uris[i].method == method) {
+                *err = 0;
+                return &uris[i];
+            }
+            *err = HTTPD_405_METHOD_NOT_ALLOWED;
+        }
+    }
+    return NULL;
+}
+
+static void random_str(char *str, size_t max_len, const char *chars)
+{
+    size_t len = rand() % (max_len + 1);
+    for (size_t i = 0; i < len; i++) {
+        str[i] = chars[rand() % strlen(chars)];
+    }
+    str[len] = 0;
+}
+
+#define TRIE_TEST_HANDLERS  32
+#define TRIE_TEST_TPL_LEN   6
+
+TEST_CASE("URI trie finds the same handlers as the linear search", "[HTTP SERVER]")
+{
+    /* Few characters, so that the templates and URIs share prefixes and
+     * URIs containing the wildcard characters are tested too */
+    const char *chars = "/ab*?";
+    static char templates[TRIE_TEST_HANDLERS][TRIE_TEST_TPL_LEN + 1];
+    httpd_uri_t uris[TRIE_TEST_HANDLERS];
+
+    srand(1);
+    for (int round = 0; round < 400; round++) {
+        const bool wildcard = round & 1;
+        const int count = rand() % (TRIE_TEST_HANDLERS + 1);
+        httpd_uri_trie_t *trie = httpd_uri_trie_create();
+        TEST_ASSERT_NOT_NULL(trie);
+        for (int i = 0; i < count; i++) {
+            random_str(templates[i], TRIE_TEST_TPL_LEN, chars);
+            uris[i] = (httpd_uri_t) {
+                .uri = templates[i],
+                .method = rand() % 3,
+                .handler = trie_test_handler,
+            };
+            TEST_ASSERT_EQUAL(ESP_OK, httpd_uri_trie_add(trie, &uris[i], i, wildcard));
+        }
+
+        for (int i = 0; i < 200; i++) {
+            char uri[TRIE_TEST_TPL_LEN + 3];
+            random_str(uri, sizeof(uri) - 1, chars);
+            const httpd_method_t method = rand() % 3;
+            httpd_err_code_t expected_err, err;
+            httpd_uri_t *expected = uri_find_linear(uris, count, wildcard, uri, strlen(uri), method, &expected_err);
+            httpd_uri_t *found = httpd_uri_trie_find(trie, uri, strlen(uri), method, &err);
+            if (found != expected || err != expected_err) {
+                printf("URI '%s' method %d wildcard %d: expected %s (%d), found %s (%d)\n", uri, method, wildcard,
+                       expected ? expected->uri : "-", expected_err, found ? found->uri : "-", err);
+            }
+            TEST_ASSERT_EQUAL_PTR(expected, found);
+            TEST_ASSERT_EQUAL(expected_err, err);
+        }
+        httpd_uri_trie_delete(trie);
+    }
+}
+
+#define TRIE_BENCH_URIS         64
+#define TRIE_BENCH_LOOKUPS      1000000
+#define TRIE_BENCH_LINEAR_LOOKUPS 10000
+
+/* Routes of a REST API: one of 10 handlers is a wildcard one serving
+ * static files, the others have fixed paths */
+static void bench_template(char *buf, size_t size, int i)
+{
+    if (i % 10 == 9) {
+        snprintf(buf, size, "/static/app%d/*", i);
+    } else {
+        snprintf(buf, size, "/api/v%d/resource%d/item", i % 3, i);
+    }
+}
+
+TEST_CASE("URI trie routing benchmark", "[HTTP SERVER][timeout=120]")
+{
+    const int handler_counts[] = { 10, 100, 500 };
+    char (*templates)[32] = malloc(500 * 32);
+    char (*bench_uris)[48] = malloc(TRIE_BENCH_URIS * 48);
+    httpd_method_t bench_methods[TRIE_BENCH_URIS];
+    httpd_uri_t *uris = calloc(500, sizeof(httpd_uri_t));
+    TEST_ASSERT(templates && bench_uris && uris);
+
+    srand(2);
+    for (int c = 0; c < sizeof(handler_counts) / sizeof(handler_counts[0]); c++) {
+        const int count = handler_counts[c];
+        httpd_uri_trie_t *trie = httpd_uri_trie_create();
+        TEST_ASSERT_NOT_NULL(trie);
+        for (int i = 0; i < count; i++) {
+            bench_template(templates[i], sizeof(templates[i]), i);
+            uris[i] = (httpd_uri_t) {
+                .uri = templates[i],
+                .method = (i % 4 == 3) ? HTTP_POST : HTTP_GET,
+                .handler = trie_test_handler,
+            };
+            TEST_ASSERT_EQUAL(ESP_OK, httpd_uri_trie_add(trie, &uris[i], i, true));
+        }
+
+        /* Mostly found, some with a wrong method (405) and some not found (404) */
+        for (int i = 0; i < TRIE_BENCH_URIS; i++) {
+            int h = rand() % count;
+            bench_methods[i] = (i % 8 == 7) ? HTTP_PUT : uris[h].method;
+            if (i % 8 == 6) {
+                snprintf(bench_uris[i], sizeof(bench_uris[i]), "/api/v1/missing%d/item", h);
+            } else if (h % 10 == 9) {
+                snprintf(bench_uris[i], sizeof(bench_uris[i]), "/static/app%d/js/main.js", h);
+            } else {
+                bench_template(bench_uris[i], sizeof(bench_uris[i]), h);
+            }
+        }
+
+        int found = 0;
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < TRIE_BENCH_LOOKUPS; i++) {
+            const char *uri = bench_uris[i % TRIE_BENCH_URIS];
+            found += httpd_uri_trie_find(trie, uri, strlen(uri), bench_methods[i % TRIE_BENCH_URIS], NULL) != NULL;
+        }
+        const int64_t trie_us = esp_timer_get_time() - start;
+
+        int linear_found = 0;
+        start = esp_timer_get_time();
+        for (int i = 0; i < TRIE_BENCH_LINEAR_LOOKUPS; i++) {
+            const char *uri = bench_uris[i % TRIE_BENCH_URIS];
+            httpd_err_code_t err;
+            linear_found += uri_find_linear(uris, count, true, uri, strlen(uri), bench_methods[i % TRIE_BENCH_URIS], &err) != NULL;
+        }
+        const int64_t linear_us = esp_timer_get_time() - start;
+
+        /* The lookups go over the same URIs */
+        TEST_ASSERT_EQUAL(found / (TRIE_BENCH_LOOKUPS / TRIE_BENCH_LINEAR_LOOKUPS), linear_found);
+
+        char item[32];
+        snprintf(item, sizeof(item), "httpd_uri_trie_%d", count);
+        IDF_LOG_PERFORMANCE(item, "%d ns/lookup", (int) (trie_us * 1000 / TRIE_BENCH_LOOKUPS));
+        snprintf(item, sizeof(item), "httpd_uri_linear_%d", count);
+        IDF_LOG_PERFORMANCE(item, "%d ns/lookup", (int) (linear_us * 1000 / TRIE_BENCH_LINEAR_LOOKUPS));
+        httpd_uri_trie_delete(trie);
+    }
+    free(uris);
+    free(bench_uris);
+    free(templates);
+}
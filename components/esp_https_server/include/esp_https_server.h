@@ -115,6 +115,7 @@ typedef struct httpd_ssl_config httpd_ssl_config_t;
         .lru_purge_enable   = true,               \
         .recv_wait_timeout  = 5,                  \
         .send_wait_timeout  = 5,                  \
+        .worker_count       = 0,                  \
         .global_user_ctx = NULL,                  \
         .global_user_ctx_free_fn = NULL,          \
         .global_transport_ctx = NULL,             \
@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Binary semaphores and the tick count for running esp_ringbuf on the Linux host.
+ *
+ * Only queues without items (semaphores) are supported. A semaphore handle points to
+ * memory holding a pointer to the semaphore's state, so that the handle of a statically
+ * created semaphore is the address of its StaticSemaphore_t, as in FreeRTOS.
+ * The tick period is 1 ms (portTICK_PERIOD_MS).
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    bool is_static;
+} host_semaphore_t;
+
+_Static_assert(sizeof(StaticQueue_t) >= sizeof(host_semaphore_t *), "StaticQueue_t can't hold a pointer");
+
+static host_semaphore_t *semaphore_get(QueueHandle_t xQueue)
+{
+    return *(host_semaphore_t **)xQueue;
+}
+
+static QueueHandle_t semaphore_create(UBaseType_t uxQueueLength, UBaseType_t uxItemSize, void *handle_mem, bool is_static)
+{
+    configASSERT(uxItemSize == 0);  // only semaphores are supported
+    host_semaphore_t *sem = calloc(1, sizeof(host_semaphore_t));
+    if (sem == NULL) {
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sem->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&sem->lock, NULL);
+    sem->max_count = uxQueueLength;
+    sem->is_static = is_static;
+    *(host_semaphore_t **)handle_mem = sem;
+    return (QueueHandle_t)handle_mem;
+}
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+    host_semaphore_t **handle_mem = malloc(sizeof(host_semaphore_t *));
+    if (handle_mem == NULL) {
+        return NULL;
+    }
+    QueueHandle_t handle = semaphore_create(uxQueueLength, uxItemSize, handle_mem, false);
+    if (handle == NULL) {
+        free(handle_mem);
+    }
+    return handle;
+}
+
+QueueHandle_t xQueueGenericCreateStatic(const UBaseType_t uxQueueLength,
+                                        const UBaseType_t uxItemSize,
+                                        uint8_t *pucQueueStorage,
+                                        StaticQueue_t *pxStaticQueue,
+                                        const uint8_t ucQueueType)
+{
+    return semaphore_create(uxQueueLength, uxItemSize, pxStaticQueue, true);
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    host_semaphore_t *sem = semaphore_get(xQueue);
+    bool is_static = sem->is_static;
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+    if (!is_static) {
+        free(xQueue);
+    }
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void *const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition)
+{
+    host_semaphore_t *sem = semaphore_get(xQueue);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        pthread_cond_signal(&sem->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t *const pxHigherPriorityTaskWoken)
+{
+    return xQueueGenericSend(xQueue, NULL, 0, queueSEND_TO_BACK);
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+    host_semaphore_t *sem = semaphore_get(xQueue);
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += xTicksToWait / 1000;
+    deadline.tv_nsec += (xTicksToWait % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0 && xTicksToWait != 0) {
+        int err = (xTicksToWait == portMAX_DELAY) ? pthread_cond_wait(&sem->cond, &sem->lock)
+                  : pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline);
+        if (err == ETIMEDOUT) {
+            break;
+        }
+    }
+    BaseType_t ret = pdFALSE;
+    if (sem->count > 0) {
+        sem->count--;
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t xQueueOrSemaphore, QueueSetHandle_t xQueueSet)
+{
+    return pdFAIL;  // queue sets are not supported
+}
+
+BaseType_t xQueueRemoveFromSet(QueueSetMemberHandle_t xQueueOrSemaphore, QueueSetHandle_t xQueueSet)
+{
+    return pdFAIL;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
@@ -0,0 +1,318 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* Ring buffer unit tests on the Linux host */
+#define CATCH_CONFIG_MAIN
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+static vector<uint8_t> make_data(size_t size)
+{
+    vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+/* Sends data in chunks of up to chunk_size bytes from one thread, and receives it in another.
+   Returns the number of bytes received intact. */
+static size_t transfer(RingbufHandle_t rb, bool byte_buffer, const vector<uint8_t> &data, size_t chunk_size)
+{
+    // Catch assertions are not thread safe, so the sender only reports whether all its sends succeeded
+    bool sent_all = true;
+    thread sender([&]() {
+        size_t sent = 0;
+        while (sent < data.size() && sent_all) {
+            size_t len = min(chunk_size - (sent % 3), data.size() - sent);
+            sent_all = xRingbufferSend(rb, data.data() + sent, len, portMAX_DELAY) == pdTRUE;
+            sent += len;
+        }
+    });
+
+    size_t received = 0;
+    bool intact = true;
+    while (received < data.size()) {
+        size_t len;
+        void *item = byte_buffer ? xRingbufferReceiveUpTo(rb, &len, portMAX_DELAY, chunk_size)
+                     : xRingbufferReceive(rb, &len, portMAX_DELAY);
+        REQUIRE(item != nullptr);
+        intact = intact && received + len <= data.size() && memcmp(item, data.data() + received, len) == 0;
+        received += len;
+        vRingbufferReturnItem(rb, item);
+    }
+    sender.join();
+    CHECK(sent_all);
+    return intact ? received : 0;
+}
+
+TEST_CASE("SPSC no-split buffer keeps items in order across wrap-around")
+{
+    RingbufHandle_t rb = xRingbufferCreateSPSC(256, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE(rb != nullptr);
+    // An item and its header may take up at most half of the buffer
+    size_t max_item_size = xRingbufferGetMaxItemSize(rb);
+    CHECK(max_item_size >= 128 - 2 * sizeof(size_t) - 4);
+    CHECK(max_item_size <= 128 - sizeof(size_t));
+
+    vector<uint8_t> data = make_data(max_item_size + 1);
+    CHECK(xRingbufferSend(rb, data.data(), max_item_size + 1, 0) == pdFALSE);
+    for (int i = 0; i < 1000; i++) {
+        // Keep two items in the buffer, so that they are received in pairs at all offsets
+        size_t size1 = i % (max_item_size / 2);
+        size_t size2 = (i * 13) % (max_item_size / 2);
+        REQUIRE(xRingbufferSend(rb, data.data(), size1, 0) == pdTRUE);
+        REQUIRE(xRingbufferSend(rb, data.data() + 1, size2, 0) == pdTRUE);
+
+        size_t len1, len2;
+        void *item1 = xRingbufferReceive(rb, &len1, 0);
+        void *item2 = xRingbufferReceive(rb, &len2, 0);
+        REQUIRE(item1 != nullptr);
+        REQUIRE(item2 != nullptr);
+        CHECK(len1 == size1);
+        CHECK(len2 == size2);
+        CHECK(memcmp(item1, data.data(), size1) == 0);
+        CHECK(memcmp(item2, data.data() + 1, size2) == 0);
+        CHECK(xRingbufferReceive(rb, &len1, 0) == nullptr);
+        vRingbufferReturnItem(rb, item1);
+        vRingbufferReturnItem(rb, item2);
+
+        // An item of the reported free size always fits
+        size_t free_size = xRingbufferGetCurFreeSize(rb);
+        CHECK(free_size == max_item_size);
+    }
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("SPSC no-split buffer reports the free size an item can use")
+{
+    RingbufHandle_t rb = xRingbufferCreateSPSC(128, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE(rb != nullptr);
+    vector<uint8_t> data = make_data(128);
+
+    for (int i = 0; i < 500; i++) {
+        REQUIRE(xRingbufferSend(rb, data.data(), (i * 5) % 40, 0) == pdTRUE);
+        size_t free_size = xRingbufferGetCurFreeSize(rb);
+        if (free_size > 0) {
+            CHECK(xRingbufferSend(rb, data.data(), free_size, 0) == pdTRUE);
+        }
+        CHECK(xRingbufferSend(rb, data.data(), free_size + 4, 0) == pdFALSE);
+
+        size_t len;
+        void *item;
+        while ((item = xRingbufferReceive(rb, &len, 0)) != nullptr) {
+            vRingbufferReturnItem(rb, item);
+        }
+    }
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("SPSC byte buffer returns contiguous data up to the write pointer")
+{
+    RingbufHandle_t rb = xRingbufferCreateSPSC(100, RINGBUF_TYPE_BYTEBUF);
+    REQUIRE(rb != nullptr);
+    CHECK(xRingbufferGetMaxItemSize(rb) == 99);
+    CHECK(xRingbufferGetCurFreeSize(rb) == 99);
+
+    vector<uint8_t> data = make_data(60);
+    REQUIRE(xRingbufferSend(rb, data.data(), 60, 0) == pdTRUE);
+    CHECK(xRingbufferSend(rb, data.data(), 40, 0) == pdFALSE);
+    CHECK(xRingbufferGetCurFreeSize(rb) == 39);
+
+    size_t len;
+    void *item = xRingbufferReceiveUpTo(rb, &len, 0, 50);
+    REQUIRE(item != nullptr);
+    CHECK(len == 50);
+    // Only one piece of data can be outstanding
+    CHECK(xRingbufferReceive(rb, &len, 0) == nullptr);
+    vRingbufferReturnItem(rb, item);
+
+    // The next 60 bytes wrap around the end of the buffer, and are received in two pieces
+    REQUIRE(xRingbufferSend(rb, data.data(), 60, 0) == pdTRUE);
+    item = xRingbufferReceive(rb, &len, 0);
+    REQUIRE(item != nullptr);
+    CHECK(len == 50);
+    CHECK(memcmp(item, data.data() + 50, 10) == 0);
+    CHECK(memcmp((uint8_t *)item + 10, data.data(), 40) == 0);
+    vRingbufferReturnItem(rb, item);
+    item = xRingbufferReceive(rb, &len, 0);
+    REQUIRE(item != nullptr);
+    CHECK(len == 20);
+    CHECK(memcmp(item, data.data() + 40, 20) == 0);
+    vRingbufferReturnItem(rb, item);
+    CHECK(xRingbufferReceive(rb, &len, 0) == nullptr);
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("SPSC buffer send and receive time out")
+{
+    RingbufHandle_t rb = xRingbufferCreateSPSC(64, RINGBUF_TYPE_BYTEBUF);
+    REQUIRE(rb != nullptr);
+    vector<uint8_t> data = make_data(63);
+
+    size_t len;
+    auto start = chrono::steady_clock::now();
+    CHECK(xRingbufferReceive(rb, &len, 20) == nullptr);
+    REQUIRE(xRingbufferSend(rb, data.data(), 63, 0) == pdTRUE);
+    CHECK(xRingbufferSend(rb, data.data(), 1, 20) == pdFALSE);
+    CHECK(chrono::steady_clock::now() - start >= chrono::milliseconds(40));
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("SPSC buffers block until the other side makes progress")
+{
+    vector<uint8_t> data = make_data(1 << 20);
+
+    RingbufHandle_t rb = xRingbufferCreateSPSC(512, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE(rb != nullptr);
+    CHECK(transfer(rb, false, data, xRingbufferGetMaxItemSize(rb)) == data.size());
+    vRingbufferDelete(rb);
+
+    rb = xRingbufferCreateSPSC(512, RINGBUF_TYPE_BYTEBUF);
+    REQUIRE(rb != nullptr);
+    CHECK(transfer(rb, true, data, 200) == data.size());
+    vRingbufferDelete(rb);
+
+    StaticRingbuffer_t rb_struct;
+    static uint8_t storage[1000];
+    rb = xRingbufferCreateStaticSPSC(sizeof(storage), RINGBUF_TYPE_BYTEBUF, storage, &rb_struct);
+    REQUIRE(rb != nullptr);
+    CHECK(transfer(rb, true, data, 64) == data.size());
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("Items are sent from segments and received in batches")
+{
+    const uint8_t header[] = {0xa5, 0x01, 0x02};
+    vector<uint8_t> payload = make_data(200);
+
+    for (bool spsc : {false, true}) {
+        RingbufHandle_t rb = spsc ? xRingbufferCreateSPSC(512, RINGBUF_TYPE_NOSPLIT) : xRingbufferCreate(512, RINGBUF_TYPE_NOSPLIT);
+        REQUIRE(rb != nullptr);
+
+        for (int i = 0; i < 100; i++) {
+            // Each item is a header followed by a payload of varying size, sent as three segments
+            size_t split = i % 40;
+            size_t payload_size = 20 + i % 50;
+            RingbufferIovec_t iov[] = {
+                {header, sizeof(header)},
+                {payload.data(), split},
+                {payload.data() + split, payload_size - split},
+            };
+            int count = 1 + i % 4;
+            for (int j = 0; j < count; j++) {
+                REQUIRE(xRingbufferSendv(rb, iov, 3, 0) == pdTRUE);
+            }
+
+            void *items[8];
+            size_t sizes[8];
+            REQUIRE(xRingbufferReceiveMany(rb, items, sizes, 8, 0) == count);
+            for (int j = 0; j < count; j++) {
+                CHECK(sizes[j] == sizeof(header) + payload_size);
+                CHECK(memcmp(items[j], header, sizeof(header)) == 0);
+                CHECK(memcmp((uint8_t *)items[j] + sizeof(header), payload.data(), payload_size) == 0);
+            }
+            CHECK(xRingbufferReceiveMany(rb, items, sizes, 8, 0) == 0);
+            vRingbufferReturnItems(rb, items, count);
+        }
+
+        // Segments whose total length overflows are rejected, nothing is copied
+        RingbufferIovec_t overflow_iov[] = {
+            {header, sizeof(header)},
+            {payload.data(), SIZE_MAX - sizeof(header) + 1},
+        };
+        CHECK(xRingbufferSendv(rb, overflow_iov, 2, 0) == pdFALSE);
+        size_t size;
+        CHECK(xRingbufferReceive(rb, &size, 0) == nullptr);
+        vRingbufferDelete(rb);
+    }
+}
+
+TEST_CASE("Segmented items are split and wrapped like other items")
+{
+    vector<uint8_t> data = make_data(300);
+    RingbufferIovec_t iov[] = {
+        {data.data(), 7},
+        {nullptr, 0},
+        {data.data() + 7, 50},
+        {data.data() + 57, 43},
+    };
+
+    RingbufHandle_t rb = xRingbufferCreate(256, RINGBUF_TYPE_ALLOWSPLIT);
+    REQUIRE(rb != nullptr);
+    for (int i = 0; i < 50; i++) {
+        REQUIRE(xRingbufferSendv(rb, iov, 4, 0) == pdTRUE);
+        void *head, *tail;
+        size_t head_size, tail_size;
+        REQUIRE(xRingbufferReceiveSplit(rb, &head, &tail, &head_size, &tail_size, 0) == pdTRUE);
+        CHECK(memcmp(head, data.data(), head_size) == 0);
+        if (tail != nullptr) {
+            CHECK(memcmp(tail, data.data() + head_size, tail_size) == 0);
+            vRingbufferReturnItem(rb, tail);
+        } else {
+            tail_size = 0;
+        }
+        CHECK(head_size + tail_size == 100);
+        vRingbufferReturnItem(rb, head);
+    }
+    vRingbufferDelete(rb);
+
+    for (bool spsc : {false, true}) {
+        rb = spsc ? xRingbufferCreateSPSC(256, RINGBUF_TYPE_BYTEBUF) : xRingbufferCreate(256, RINGBUF_TYPE_BYTEBUF);
+        REQUIRE(rb != nullptr);
+        for (int i = 0; i < 50; i++) {
+            REQUIRE(xRingbufferSendv(rb, iov, 4, 0) == pdTRUE);
+            size_t received = 0;
+            while (received < 100) {
+                size_t len;
+                void *item = xRingbufferReceive(rb, &len, 0);
+                REQUIRE(item != nullptr);
+                CHECK(memcmp(item, data.data() + received, len) == 0);
+                received += len;
+                vRingbufferReturnItem(rb, item);
+            }
+            CHECK(received == 100);
+        }
+        vRingbufferDelete(rb);
+    }
+}
+
+static double transfer_mb_per_s(RingbufHandle_t rb, bool byte_buffer, const vector<uint8_t> &data, size_t chunk_size)
+{
+    auto start = chrono::steady_clock::now();
+    size_t received = transfer(rb, byte_buffer, data, chunk_size);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    CHECK(received == data.size());
+    vRingbufferDelete(rb);
+    return received / elapsed.count() / 1e6;
+}
+
+TEST_CASE("SPSC ring buffer throughput", "[bench]")
+{
+    const size_t buffer_size = 4096;
+    vector<uint8_t> data = make_data(16 << 20);
+
+    for (size_t chunk_size : {16, 128, 1024}) {
+        double bytebuf = transfer_mb_per_s(xRingbufferCreate(buffer_size, RINGBUF_TYPE_BYTEBUF), true, data, chunk_size);
+        double spsc_bytebuf = transfer_mb_per_s(xRingbufferCreateSPSC(buffer_size, RINGBUF_TYPE_BYTEBUF), true, data, chunk_size);
+        double nosplit = transfer_mb_per_s(xRingbufferCreate(buffer_size, RINGBUF_TYPE_NOSPLIT), false, data, chunk_size);
+        double spsc_nosplit = transfer_mb_per_s(xRingbufferCreateSPSC(buffer_size, RINGBUF_TYPE_NOSPLIT), false, data, chunk_size);
+        printf("%4zu byte chunks: byte buffer %.0f MB/s, SPSC byte buffer %.0f MB/s, "
+               "no-split %.0f MB/s, SPSC no-split %.0f MB/s\n",
+               chunk_size, bytebuf, spsc_bytebuf, nosplit, spsc_nosplit);
+    }
+}
@@ -48,6 +48,14 @@ typedef enum {
     RINGBUF_TYPE_MAX,
 } RingbufferType_t;
 
+/**
+ * @brief Segment of an item sent with xRingbufferSendv()
+ */
+typedef struct {
+    const void *pvBase;     /**< Pointer to the data of the segment. NULL is allowed if xLen is 0. */
+    size_t xLen;            /**< Length of the segment in bytes */
+} RingbufferIovec_t;
+
 /**
  * @brief Struct that is equivalent in size to the ring buffer's data structure
  *
@@ -62,8 +70,8 @@ typedef struct xSTATIC_RINGBUFFER {
     /** @cond */    //Doxygen command to hide this structure from API Reference
     size_t xDummy1[2];
     UBaseType_t uxDummy2;
-    BaseType_t xDummy3;
     void *pvDummy4[11];
+    BaseType_t xDummy3[3];
     StaticSemaphore_t xDummy5[2];
     portMUX_TYPE muxDummy;
     /** @endcond */
@@ -96,6 +104,36 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferTy
  */
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
 
+/**
+ * @brief       Create a ring buffer with a single sender and a single receiver
+ *
+ * The buffer is used the same way as a buffer created by xRingbufferCreate(),
+ * but items are sent and received without taking the ring buffer's spinlock,
+ * and its semaphores are only used when the sender or the receiver has to block.
+ * This is suited to drivers where one task or ISR produces data and one task
+ * or ISR consumes it.
+ *
+ * The following restrictions apply to these buffers:
+ *  - At any time, at most one task or ISR may be sending (or acquiring and
+ *    completing items) and at most one task or ISR may be receiving and
+ *    returning items.
+ *  - Items of no-split buffers must be returned in the order they were received,
+ *    and acquired items must be sent in the order they were acquired.
+ *  - The buffers can't be added to queue sets. vRingbufferGetInfo() always
+ *    reports zero items waiting.
+ *
+ * @param[in]   xBufferSize Size of the buffer in bytes
+ * @param[in]   xBufferType RINGBUF_TYPE_NOSPLIT or RINGBUF_TYPE_BYTEBUF
+ *
+ * @note    The buffer is never filled completely. The largest item of a byte buffer
+ *          is one byte smaller than xBufferSize, and the largest item of a no-split
+ *          buffer is slightly smaller than with xRingbufferCreate(). Use
+ *          xRingbufferGetMaxItemSize() to get it.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error.
+ */
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, RingbufferType_t xBufferType);
+
 
 /**
  * @brief       Create a ring buffer but manually provide the required memory
@@ -118,6 +156,29 @@ RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize,
                                         StaticRingbuffer_t *pxStaticRingbuffer);
 #endif
 
+/**
+ * @brief       Create a ring buffer with a single sender and a single receiver, but manually provide the required memory
+ *
+ * See xRingbufferCreateSPSC() and xRingbufferCreateStatic().
+ *
+ * @param[in]   xBufferSize Size of the buffer in bytes.
+ * @param[in]   xBufferType RINGBUF_TYPE_NOSPLIT or RINGBUF_TYPE_BYTEBUF
+ * @param[in]   pucRingbufferStorage Pointer to the ring buffer's storage area.
+ *              Storage area must have the same size as specified by xBufferSize
+ * @param[in]   pxStaticRingbuffer Pointed to a struct of type StaticRingbuffer_t
+ *              which will be used to hold the ring buffer's data structure
+ *
+ * @note    xBufferSize of no-split buffers MUST be 32-bit aligned.
+ *
+ * @return  A handle to the created ring buffer
+ */
+#if ( configSUPPORT_STATIC_ALLOCATION == 1)
+RingbufHandle_t xRingbufferCreateStaticSPSC(size_t xBufferSize,
+                                            RingbufferType_t xBufferType,
+                                            uint8_t *pucRingbufferStorage,
+                                            StaticRingbuffer_t *pxStaticRingbuffer);
+#endif
+
 /**
  * @brief       Insert an item into the ring buffer
  *
@@ -212,6 +273,31 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
  */
 BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem);
 
+/**
+ * @brief       Insert an item made of several segments into the ring buffer
+ *
+ * Works like xRingbufferSend(), but the data of the item is gathered from
+ * uxIovCount segments, in order. This allows for example a protocol header and
+ * a payload stored in different places to be sent as one item, without copying
+ * them to a temporary buffer first. The item is copied into the ring buffer in
+ * one go, and is received as a single item.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the item into
+ * @param[in]   pxIov           Array of segments making up the item
+ * @param[in]   uxIovCount      Number of segments in pxIov
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note    For byte buffers, the data of all segments is simply appended to the buffer.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the data is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendv(RingbufHandle_t xRingbuffer,
+                            const RingbufferIovec_t *pxIov,
+                            UBaseType_t uxIovCount,
+                            TickType_t xTicksToWait);
+
 /**
  * @brief   Retrieve an item from the ring buffer
  *
@@ -356,6 +442,32 @@ void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer,
  */
 void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize, size_t xMaxSize);
 
+/**
+ * @brief   Retrieve several items from a no-split ring buffer at once
+ *
+ * Attempt to retrieve up to uxMaxItems items from a no-split ring buffer. This
+ * function will block until at least one item is available for retrieval or
+ * until it times out, and then retrieves all the items available (up to
+ * uxMaxItems) at once.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  ppvItems        Array of at least uxMaxItems elements, to which pointers to the retrieved items will be written
+ * @param[out]  pxItemSizes     Array of at least uxMaxItems elements, to which the sizes of the retrieved items will be written
+ * @param[in]   uxMaxItems      Maximum number of items to retrieve
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    The items are written to ppvItems in the order they were sent. Each of them
+ *          must be returned by vRingbufferReturnItem() or vRingbufferReturnItems().
+ * @note    This function should only be called on no-split buffers
+ *
+ * @return  Number of items retrieved, or 0 on timeout.
+ */
+UBaseType_t xRingbufferReceiveMany(RingbufHandle_t xRingbuffer,
+                                   void **ppvItems,
+                                   size_t *pxItemSizes,
+                                   UBaseType_t uxMaxItems,
+                                   TickType_t xTicksToWait);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer
  *
@@ -378,6 +490,17 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
  */
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief   Return several previously-retrieved items to the ring buffer at once
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   ppvItems    Items that were received earlier, for example by xRingbufferReceiveMany()
+ * @param[in]   uxItemCount Number of items in ppvItems
+ *
+ * @note    For ring buffers created by xRingbufferCreateSPSC(), the items must be in the order they were received
+ */
+void vRingbufferReturnItems(RingbufHandle_t xRingbuffer, void *const *ppvItems, UBaseType_t uxItemCount);
+
 /**
  * @brief   Delete a ring buffer
  *
@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
@@ -14,13 +16,14 @@
 //32-bit alignment macros
 #define rbALIGN_MASK (0x03)
 #define rbALIGN_SIZE( xSize )       ( ( xSize + rbALIGN_MASK ) & ~rbALIGN_MASK )
-#define rbCHECK_ALIGNED( pvPtr )    ( ( ( UBaseType_t ) ( pvPtr ) & rbALIGN_MASK ) == 0 )
+#define rbCHECK_ALIGNED( pvPtr )    ( ( ( uintptr_t ) ( pvPtr ) & rbALIGN_MASK ) == 0 )
 
 //Ring buffer flags
 #define rbALLOW_SPLIT_FLAG          ( ( UBaseType_t ) 1 )   //The ring buffer allows items to be split
 #define rbBYTE_BUFFER_FLAG          ( ( UBaseType_t ) 2 )   //The ring buffer is a byte buffer
 #define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
 #define rbBUFFER_STATIC_FLAG        ( ( UBaseType_t ) 8 )   //The ring buffer is statically allocated
+#define rbSPSC_FLAG                 ( ( UBaseType_t ) 16 )  //The ring buffer has a single sender and a single receiver, and doesn't use the spinlock
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
@@ -44,9 +47,13 @@ typedef struct {
 } ItemHeader_t;
 
 #define rbHEADER_SIZE     sizeof(ItemHeader_t)
+
+//Access to the pointers shared by the sender and the receiver of SPSC ring buffers
+#define rbSPSC_LOAD( ppucPointer )              __atomic_load_n( ppucPointer, __ATOMIC_ACQUIRE )
+#define rbSPSC_PUBLISH( ppucPointer, pucValue ) __atomic_store_n( ppucPointer, pucValue, __ATOMIC_RELEASE )
 typedef struct RingbufferDefinition Ringbuffer_t;
 typedef BaseType_t (*CheckItemFitsFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
-typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const uint8_t *pcItem, size_t xItemSize);
+typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize);
 typedef BaseType_t (*CheckItemAvailFunction_t) (Ringbuffer_t *pxRingbuffer);
 typedef void *(*GetItemFunction_t)(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xMaxSize, size_t *pxItemSize);
 typedef void (*ReturnItemFunction_t)(Ringbuffer_t *pxRingbuffer, uint8_t *pvItem);
@@ -71,6 +78,8 @@ typedef struct RingbufferDefinition {
     uint8_t *pucTail;                           //Pointer to the end of the ring buffer storage area
 
     BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read
+    BaseType_t xSenderWaiting;                  //SPSC only. The sender is about to block on TransSem
+    BaseType_t xReceiverWaiting;                //SPSC only. The receiver is about to block on RecvSem
     /*
      * TransSem: Binary semaphore used to indicate to a blocked transmitting tasks
      *           that more free space has become available or that the block has
@@ -120,6 +129,7 @@ which is quite high and so would waste a fair amount of memory.
 //Initialize a ring buffer after space has been allocated for it
 static void prvInitializeNewRingbuffer(size_t xBufferSize,
                                        RingbufferType_t xBufferType,
+                                       BaseType_t xSPSC,
                                        Ringbuffer_t *pxNewRingbuffer,
                                        uint8_t *pucRingbufferStorage);
 
@@ -129,6 +139,9 @@ static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer);
 //Checks if an item/data is currently available for retrieval
 static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer);
 
+//Copies the next xLen bytes of an item made of the segments in *pxIov, and advances *pxIov and *pxOffset past them
+static void prvCopyFromIov(uint8_t *pucDest, const RingbufferIovec_t **pxIov, size_t *pxOffset, size_t xLen);
+
 //Checks if an item will currently fit in a no-split/allow-split ring buffer
 static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 
@@ -144,7 +157,7 @@ Exit:
     - pucAcquire and pucWrite updated.
     - Dummy item added if necessary
 */
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize);
 
 /*
 Copies an item to a allow-split ring buffer
@@ -155,10 +168,10 @@ Exit:
     - pucAcquire and pucWrite updated
     - Item may be split
 */
-static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize);
 
 //Copies an item to a byte buffer. Only call this function  after calling prvCheckItemFitsByteBuffer()
-static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize);
 
 //Retrieve item from no-split/allow-split ring buffer. *pxIsSplit is set to pdTRUE if the retrieved item is split
 /*
@@ -227,6 +240,7 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
 
 static void prvInitializeNewRingbuffer(size_t xBufferSize,
                                        RingbufferType_t xBufferType,
+                                       BaseType_t xSPSC,
                                        Ringbuffer_t *pxNewRingbuffer,
                                        uint8_t *pucRingbufferStorage)
 {
@@ -239,6 +253,8 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
     pxNewRingbuffer->pucWrite = pucRingbufferStorage;
     pxNewRingbuffer->pucAcquire = pucRingbufferStorage;
     pxNewRingbuffer->xItemsWaiting = 0;
+    pxNewRingbuffer->xSenderWaiting = pdFALSE;
+    pxNewRingbuffer->xReceiverWaiting = pdFALSE;
     pxNewRingbuffer->uxRingbufferFlags = 0;
 
     //Initialize type dependent values and function pointers
@@ -272,10 +288,41 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
         pxNewRingbuffer->xMaxItemSize = pxNewRingbuffer->xSize;
         pxNewRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeByteBuf;
     }
-    xSemaphoreGive(rbGET_TX_SEM_HANDLE(pxNewRingbuffer));
+    if (xSPSC) {
+        pxNewRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG;
+        if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
+            //An item of this size fits into an empty buffer wherever the pointers are, see prvSPSCCheckItemFitsNoSplit()
+            pxNewRingbuffer->xMaxItemSize = ((pxNewRingbuffer->xSize / 2) & ~rbALIGN_MASK) - rbHEADER_SIZE;
+        } else {
+            //One byte of a byte buffer is always kept free
+            pxNewRingbuffer->xMaxItemSize = pxNewRingbuffer->xSize - 1;
+        }
+    } else {
+        xSemaphoreGive(rbGET_TX_SEM_HANDLE(pxNewRingbuffer));
+    }
     portMUX_INITIALIZE(&pxNewRingbuffer->mux);
 }
 
+static void prvCopyFromIov(uint8_t *pucDest, const RingbufferIovec_t **pxIov, size_t *pxOffset, size_t xLen)
+{
+    while (xLen > 0) {
+        size_t xCopyLen = (*pxIov)->xLen - *pxOffset;
+        if (xCopyLen > xLen) {
+            xCopyLen = xLen;
+        }
+        if (xCopyLen > 0) {     //Segments of zero length may have a NULL pvBase
+            memcpy(pucDest, (const uint8_t *)(*pxIov)->pvBase + *pxOffset, xCopyLen);
+            pucDest += xCopyLen;
+            xLen -= xCopyLen;
+            *pxOffset += xCopyLen;
+        }
+        if (*pxOffset == (*pxIov)->xLen) {
+            (*pxIov)++;         //Move on to the next segment
+            *pxOffset = 0;
+        }
+    }
+}
+
 static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
 {
     size_t xReturn;
@@ -422,15 +469,17 @@ static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t* pucItem)
     }
 }
 
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize)
 {
+    size_t xOffset = 0;
     uint8_t* item_addr = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
-    memcpy(item_addr, pucItem, xItemSize);
+    prvCopyFromIov(item_addr, &pxIov, &xOffset, xItemSize);
     prvSendItemDoneNoSplit(pxRingbuffer, item_addr);
 }
 
-static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize)
 {
+    size_t xOffset = 0;                                                 //Offset into the current segment of the item
     //Check arguments and buffer state
     size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
     size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
@@ -447,10 +496,9 @@ static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *puc
         pxRingbuffer->pucAcquire += rbHEADER_SIZE;            //Advance pucAcquire past header
         xRemLen -= rbHEADER_SIZE;
         if (xRemLen > 0) {
-            memcpy(pxRingbuffer->pucAcquire, pucItem, xRemLen);
+            prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xRemLen);
             pxRingbuffer->xItemsWaiting++;
             //Update item arguments to account for data already copied
-            pucItem += xRemLen;
             xItemSize -= xRemLen;
             xAlignedItemSize -= xRemLen;
             pxFirstHeader->uxItemFlags |= rbITEM_SPLIT_FLAG;        //There must be more data
@@ -466,7 +514,7 @@ static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *puc
     pxSecondHeader->xItemLen = xItemSize;
     pxSecondHeader->uxItemFlags = 0;
     pxRingbuffer->pucAcquire += rbHEADER_SIZE;     //Advance acquire pointer past header
-    memcpy(pxRingbuffer->pucAcquire, pucItem, xItemSize);
+    prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xItemSize);
     pxRingbuffer->xItemsWaiting++;
     pxRingbuffer->pucAcquire += xAlignedItemSize;  //Advance pucAcquire past item to next aligned address
 
@@ -484,23 +532,23 @@ static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *puc
     pxRingbuffer->pucWrite = pxRingbuffer->pucAcquire;
 }
 
-static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize)
 {
+    size_t xOffset = 0;                                                 //Offset into the current segment of the item
     //Check arguments and buffer state
     configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
 
     size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
     if (xRemLen < xItemSize) {
         //Copy as much as possible into remaining length
-        memcpy(pxRingbuffer->pucAcquire, pucItem, xRemLen);
+        prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xRemLen);
         pxRingbuffer->xItemsWaiting += xRemLen;
         //Update item arguments to account for data already written
-        pucItem += xRemLen;
         xItemSize -= xRemLen;
         pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;     //Reset acquire pointer to start of buffer
     }
     //Copy all or remaining portion of the item
-    memcpy(pxRingbuffer->pucAcquire, pucItem, xItemSize);
+    prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xItemSize);
     pxRingbuffer->xItemsWaiting += xItemSize;
     pxRingbuffer->pucAcquire += xItemSize;
 
@@ -759,6 +807,310 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer)
     return xFreeSize;
 }
 
+/*
+ * SPSC ring buffers
+ *
+ * Ring buffers created by xRingbufferCreateSPSC() have exactly one sender and one
+ * receiver, and never take the spinlock. The sender owns pucAcquire and pucWrite,
+ * the receiver owns pucRead and pucFree. Each side publishes the pointer read by
+ * the other side (pucWrite and pucFree) with a release store once the data behind
+ * it is in place. An SPSC buffer is never filled completely, so pucWrite == pucFree
+ * always means that it is empty and neither rbBUFFER_FULL_FLAG nor xItemsWaiting
+ * are maintained.
+ *
+ * A side that has to block sets its waiting flag, checks the buffer again and takes
+ * its semaphore. The other side gives the semaphore only if it finds the flag set
+ * after publishing its pointer, so the semaphores are only used when a task
+ * actually blocks.
+ */
+
+static BaseType_t prvSPSCCheckItemFitsNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    uint8_t *pucFree = rbSPSC_LOAD(&pxRingbuffer->pucFree);
+    size_t xTotalItemSize = rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE;    //Rounded up aligned item size with header
+
+    if (pxRingbuffer->pucAcquire < pucFree) {
+        //Free space does not wrap around. The item must not reach pucFree
+        return (xTotalItemSize < pucFree - pxRingbuffer->pucAcquire) ? pdTRUE : pdFALSE;
+    }
+    //Free space wraps around, or the buffer is empty
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;
+    if (xTotalItemSize <= xRemLen) {
+        //Item fits at the end. pucAcquire will wrap around if less than a header is left, it must not land on pucFree
+        return (xRemLen - xTotalItemSize >= rbHEADER_SIZE || pucFree != pxRingbuffer->pucHead) ? pdTRUE : pdFALSE;
+    }
+    //Item has to be stored at the head of the buffer
+    return (xTotalItemSize < pucFree - pxRingbuffer->pucHead) ? pdTRUE : pdFALSE;
+}
+
+//Free bytes between pucAcquire and pucFree. pucAcquire == pucFree means empty, there is no full flag
+static size_t prvSPSCGetFreeSize(Ringbuffer_t *pxRingbuffer)
+{
+    BaseType_t xFreeSize = rbSPSC_LOAD(&pxRingbuffer->pucFree) - pxRingbuffer->pucAcquire;
+    if (xFreeSize <= 0) {
+        xFreeSize += pxRingbuffer->xSize;
+    }
+    return xFreeSize;
+}
+
+static BaseType_t prvSPSCCheckItemFitsByteBuf(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    //One byte is always kept free
+    return (xItemSize < prvSPSCGetFreeSize(pxRingbuffer)) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t prvSPSCCheckItemFits(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        return prvSPSCCheckItemFitsByteBuf(pxRingbuffer, xItemSize);
+    }
+    return prvSPSCCheckItemFitsNoSplit(pxRingbuffer, xItemSize);
+}
+
+//Only called by the sender. Must have already guaranteed the item fits by calling prvSPSCCheckItemFitsNoSplit()
+static uint8_t *prvSPSCAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
+
+    //If remaining length can't fit item, set as dummy data and wrap around
+    if (pxRingbuffer->pucTail - pxRingbuffer->pucAcquire < xAlignedItemSize + rbHEADER_SIZE) {
+        ItemHeader_t *pxDummy = (ItemHeader_t *)pxRingbuffer->pucAcquire;
+        pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;
+        pxDummy->xItemLen = 0;
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
+    }
+
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
+    pxHeader->xItemLen = xItemSize;
+    pxHeader->uxItemFlags = 0;
+    uint8_t *pucItem = pxRingbuffer->pucAcquire + rbHEADER_SIZE;
+    pxRingbuffer->pucAcquire += rbHEADER_SIZE + xAlignedItemSize;
+    //If current remaining length can't fit a header, wrap around acquire pointer
+    if (pxRingbuffer->pucTail - pxRingbuffer->pucAcquire < rbHEADER_SIZE) {
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
+    }
+    return pucItem;
+}
+
+//Only called by the sender. Items must be sent in the order they were acquired
+static void prvSPSCSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    uint8_t *pucWrite = pxRingbuffer->pucWrite;
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucWrite;
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pucWrite = pxRingbuffer->pucHead;
+        pxHeader = (ItemHeader_t *)pucWrite;
+    }
+    configASSERT(pucWrite + rbHEADER_SIZE == pucItem);
+
+    pucWrite += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+    if (pxRingbuffer->pucTail - pucWrite < rbHEADER_SIZE) {
+        pucWrite = pxRingbuffer->pucHead;
+    }
+    rbSPSC_PUBLISH(&pxRingbuffer->pucWrite, pucWrite);
+}
+
+//Only called by the sender. Must have already guaranteed the item fits by calling prvSPSCCheckItemFits()
+static void prvSPSCCopyItem(Ringbuffer_t *pxRingbuffer, const RingbufferIovec_t *pxIov, size_t xItemSize)
+{
+    size_t xOffset = 0;
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0) {
+        uint8_t *pucDest = prvSPSCAcquireItemNoSplit(pxRingbuffer, xItemSize);
+        prvCopyFromIov(pucDest, &pxIov, &xOffset, xItemSize);
+        prvSPSCSendItemDoneNoSplit(pxRingbuffer, pucDest);
+        return;
+    }
+
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
+    if (xRemLen < xItemSize) {
+        prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xRemLen);
+        xItemSize -= xRemLen;
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
+    }
+    prvCopyFromIov(pxRingbuffer->pucAcquire, &pxIov, &xOffset, xItemSize);
+    pxRingbuffer->pucAcquire += xItemSize;
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucTail) {
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
+    }
+    rbSPSC_PUBLISH(&pxRingbuffer->pucWrite, pxRingbuffer->pucAcquire);
+}
+
+//Only called by the receiver
+static BaseType_t prvSPSCCheckItemAvail(Ringbuffer_t *pxRingbuffer)
+{
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && pxRingbuffer->pucRead != pxRingbuffer->pucFree) {
+        return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
+    }
+    return (rbSPSC_LOAD(&pxRingbuffer->pucWrite) != pxRingbuffer->pucRead) ? pdTRUE : pdFALSE;
+}
+
+//Only called by the receiver. Must have already guaranteed that an item is available by calling prvSPSCCheckItemAvail()
+static void *prvSPSCGetItem(Ringbuffer_t *pxRingbuffer, size_t xMaxSize, size_t *pxItemSize)
+{
+    uint8_t *pucReturn;
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        //Return contiguous data from the read pointer up to the write pointer or buffer tail, or xMaxSize
+        uint8_t *pucWrite = rbSPSC_LOAD(&pxRingbuffer->pucWrite);
+        size_t xSize = (pxRingbuffer->pucRead < pucWrite) ? pucWrite - pxRingbuffer->pucRead : pxRingbuffer->pucTail - pxRingbuffer->pucRead;
+        if (xMaxSize != 0 && xSize > xMaxSize) {
+            xSize = xMaxSize;
+        }
+        pucReturn = pxRingbuffer->pucRead;
+        *pxItemSize = xSize;
+        pxRingbuffer->pucRead += xSize;
+        if (pxRingbuffer->pucRead == pxRingbuffer->pucTail) {
+            pxRingbuffer->pucRead = pxRingbuffer->pucHead;
+        }
+        return pucReturn;
+    }
+
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+    //Wrap around if dummy data (dummy data indicates wrap around in no-split buffers)
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pxRingbuffer->pucRead = pxRingbuffer->pucHead;
+        pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+    }
+    configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    pucReturn = pxRingbuffer->pucRead + rbHEADER_SIZE;
+    *pxItemSize = pxHeader->xItemLen;
+    pxRingbuffer->pucRead += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+    if (pxRingbuffer->pucTail - pxRingbuffer->pucRead < rbHEADER_SIZE) {
+        pxRingbuffer->pucRead = pxRingbuffer->pucHead;
+    }
+    return pucReturn;
+}
+
+//Only called by the receiver. Items must be returned in the order they were received
+static void prvSPSCReturnItem(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    uint8_t *pucFree = pxRingbuffer->pucFree;
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        configASSERT(pucItem == pucFree);
+        rbSPSC_PUBLISH(&pxRingbuffer->pucFree, pxRingbuffer->pucRead);
+        return;
+    }
+
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucFree;
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        pucFree = pxRingbuffer->pucHead;
+        pxHeader = (ItemHeader_t *)pucFree;
+    }
+    configASSERT(pucFree + rbHEADER_SIZE == pucItem);
+
+    pucFree += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+    if (pxRingbuffer->pucTail - pucFree < rbHEADER_SIZE) {
+        pucFree = pxRingbuffer->pucHead;
+    }
+    rbSPSC_PUBLISH(&pxRingbuffer->pucFree, pucFree);
+}
+
+static size_t prvSPSCGetCurMaxSize(Ringbuffer_t *pxRingbuffer)
+{
+    uint8_t *pucFree = rbSPSC_LOAD(&pxRingbuffer->pucFree);
+    BaseType_t xFreeSize;
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        xFreeSize = pucFree - pxRingbuffer->pucAcquire;
+        if (xFreeSize <= 0) {
+            xFreeSize += pxRingbuffer->xSize;
+        }
+        return xFreeSize - 1;
+    }
+
+    //Same limits as prvSPSCCheckItemFitsNoSplit(), an item must end at least one aligned word before pucFree
+    if (pxRingbuffer->pucAcquire < pucFree) {
+        xFreeSize = pucFree - pxRingbuffer->pucAcquire - rbALIGN_SIZE(1);
+    } else {
+        BaseType_t xSize1 = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;
+        BaseType_t xSize2 = pucFree - pxRingbuffer->pucHead - rbALIGN_SIZE(1);
+        if (pucFree == pxRingbuffer->pucHead) {
+            xSize1 -= rbHEADER_SIZE;
+        }
+        xFreeSize = (xSize1 > xSize2) ? xSize1 : xSize2;
+    }
+    xFreeSize -= rbHEADER_SIZE;
+    if (xFreeSize < 0) {
+        xFreeSize = 0;
+    } else if (xFreeSize > pxRingbuffer->xMaxItemSize) {
+        xFreeSize = pxRingbuffer->xMaxItemSize;
+    }
+    return xFreeSize;
+}
+
+static inline BaseType_t prvSPSCReady(Ringbuffer_t *pxRingbuffer, BaseType_t xSender, size_t xItemSize)
+{
+    return xSender ? prvSPSCCheckItemFits(pxRingbuffer, xItemSize) : prvSPSCCheckItemAvail(pxRingbuffer);
+}
+
+/*
+ * Block the sender until xItemSize bytes fit (xSender == pdTRUE), or the receiver
+ * until an item is available, or until timeout.
+ */
+static BaseType_t prvSPSCWait(Ringbuffer_t *pxRingbuffer, BaseType_t xSender, size_t xItemSize, TickType_t xTicksToWait)
+{
+    BaseType_t *pxWaiting = xSender ? &pxRingbuffer->xSenderWaiting : &pxRingbuffer->xReceiverWaiting;
+    SemaphoreHandle_t xSemaphore = xSender ? rbGET_TX_SEM_HANDLE(pxRingbuffer) : rbGET_RX_SEM_HANDLE(pxRingbuffer);
+
+    if (prvSPSCReady(pxRingbuffer, xSender, xItemSize) == pdTRUE) {
+        return pdTRUE;
+    }
+    if (xTicksToWait == 0) {
+        return pdFALSE;
+    }
+
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait && xTicksRemaining != 0) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        __atomic_store_n(pxWaiting, pdTRUE, __ATOMIC_RELAXED);
+        //Order the store to the flag before checking the buffer again, pairs with the fence in prvSPSCWake()
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (prvSPSCReady(pxRingbuffer, xSender, xItemSize) == pdTRUE) {
+            __atomic_store_n(pxWaiting, pdFALSE, __ATOMIC_RELAXED);
+            return pdTRUE;
+        }
+        //The other side clears the flag when it gives the semaphore. A semaphore given after the
+        //check above succeeded is taken later as a spurious wake up, and the buffer is checked again.
+        xSemaphoreTake(xSemaphore, xTicksRemaining);
+        if (prvSPSCReady(pxRingbuffer, xSender, xItemSize) == pdTRUE) {
+            __atomic_store_n(pxWaiting, pdFALSE, __ATOMIC_RELAXED);
+            return pdTRUE;
+        }
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+    __atomic_store_n(pxWaiting, pdFALSE, __ATOMIC_RELAXED);
+    return pdFALSE;
+}
+
+//Called after publishing pucWrite or pucFree, wakes the other side if it is blocked
+static void prvSPSCWake(Ringbuffer_t *pxRingbuffer, BaseType_t xWakeSender, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    BaseType_t *pxWaiting = xWakeSender ? &pxRingbuffer->xSenderWaiting : &pxRingbuffer->xReceiverWaiting;
+    SemaphoreHandle_t xSemaphore = xWakeSender ? rbGET_TX_SEM_HANDLE(pxRingbuffer) : rbGET_RX_SEM_HANDLE(pxRingbuffer);
+
+    //Order the publishing store before loading the flag, pairs with the fence in prvSPSCWait()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(pxWaiting, __ATOMIC_RELAXED) && __atomic_exchange_n(pxWaiting, pdFALSE, __ATOMIC_RELAXED)) {
+        if (xFromISR) {
+            xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken);
+        } else {
+            xSemaphoreGive(xSemaphore);
+        }
+    }
+}
+
+static BaseType_t prvSPSCReceive(Ringbuffer_t *pxRingbuffer, void **pvItem, size_t *pxItemSize, size_t xMaxSize, TickType_t xTicksToWait)
+{
+    if (prvSPSCWait(pxRingbuffer, pdFALSE, 0, xTicksToWait) != pdTRUE) {
+        return pdFALSE;
+    }
+    *pvItem = prvSPSCGetItem(pxRingbuffer, xMaxSize, pxItemSize);
+    return pdTRUE;
+}
+
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                                     void **pvItem1,
                                     void **pvItem2,
@@ -767,6 +1119,10 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                                     size_t xMaxSize,
                                     TickType_t xTicksToWait)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSPSCReceive(pxRingbuffer, pvItem1, xItemSize1, xMaxSize, xTicksToWait);
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
     TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
@@ -831,6 +1187,10 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
                                            size_t *xItemSize2,
                                            size_t xMaxSize)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSPSCReceive(pxRingbuffer, pvItem1, xItemSize1, xMaxSize, 0);
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
 
@@ -867,9 +1227,64 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
     return xReturn;
 }
 
+static UBaseType_t prvReceiveMany(Ringbuffer_t *pxRingbuffer,
+                                  void **ppvItems,
+                                  size_t *pxItemSizes,
+                                  UBaseType_t uxMaxItems,
+                                  TickType_t xTicksToWait)
+{
+    UBaseType_t uxCount = 0;
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvSPSCWait(pxRingbuffer, pdFALSE, 0, xTicksToWait) != pdTRUE) {
+            return 0;
+        }
+        do {
+            ppvItems[uxCount] = prvSPSCGetItem(pxRingbuffer, 0, &pxItemSizes[uxCount]);
+            uxCount++;
+        } while (uxCount < uxMaxItems && prvSPSCCheckItemAvail(pxRingbuffer) == pdTRUE);
+        return uxCount;
+    }
+
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until an item becomes available or timeout
+        if (xSemaphoreTake(rbGET_RX_SEM_HANDLE(pxRingbuffer), xTicksRemaining) != pdTRUE) {
+            break;      //Timed out attempting to get semaphore
+        }
+
+        //Semaphore obtained, retrieve as many items as are available in one critical section
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        while (uxCount < uxMaxItems && prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+            BaseType_t xIsSplit;
+            ppvItems[uxCount] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItemSizes[uxCount]);
+            uxCount++;
+        }
+        if (uxCount > 0) {
+            if (pxRingbuffer->xItemsWaiting > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            break;
+        }
+        //No item available for retrieval, adjust ticks and take the semaphore again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(rbGET_RX_SEM_HANDLE(pxRingbuffer));  //Give semaphore back so other tasks can retrieve
+    }
+    return uxCount;
+}
+
 /* --------------------------- Public Definitions --------------------------- */
 
-RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType)
+static RingbufHandle_t prvCreateRingbuffer(size_t xBufferSize, RingbufferType_t xBufferType, BaseType_t xSPSC)
 {
     configASSERT(xBufferSize > 0);
     configASSERT(xBufferType < RINGBUF_TYPE_MAX);
@@ -903,7 +1318,7 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferTy
     }
 #endif
 
-    prvInitializeNewRingbuffer(xBufferSize, xBufferType, pxNewRingbuffer, pucRingbufferStorage);
+    prvInitializeNewRingbuffer(xBufferSize, xBufferType, xSPSC, pxNewRingbuffer, pucRingbufferStorage);
     return (RingbufHandle_t)pxNewRingbuffer;
 
 err:
@@ -913,16 +1328,29 @@ err:
     return NULL;
 }
 
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType)
+{
+    return prvCreateRingbuffer(xBufferSize, xBufferType, pdFALSE);
+}
+
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, RingbufferType_t xBufferType)
+{
+    //Allow-split buffers are not supported
+    configASSERT(xBufferType == RINGBUF_TYPE_NOSPLIT || xBufferType == RINGBUF_TYPE_BYTEBUF);
+    return prvCreateRingbuffer(xBufferSize, xBufferType, pdTRUE);
+}
+
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum)
 {
     return xRingbufferCreate((rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE) * xItemNum, RINGBUF_TYPE_NOSPLIT);
 }
 
 #if ( configSUPPORT_STATIC_ALLOCATION == 1 )
-RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize,
-                                        RingbufferType_t xBufferType,
-                                        uint8_t *pucRingbufferStorage,
-                                        StaticRingbuffer_t *pxStaticRingbuffer)
+static RingbufHandle_t prvCreateRingbufferStatic(size_t xBufferSize,
+                                                 RingbufferType_t xBufferType,
+                                                 BaseType_t xSPSC,
+                                                 uint8_t *pucRingbufferStorage,
+                                                 StaticRingbuffer_t *pxStaticRingbuffer)
 {
     //Check arguments
     configASSERT(xBufferSize > 0);
@@ -936,10 +1364,28 @@ RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize,
     Ringbuffer_t *pxNewRingbuffer = (Ringbuffer_t *)pxStaticRingbuffer;
     xSemaphoreCreateBinaryStatic(&(pxNewRingbuffer->xTransSemStatic));
     xSemaphoreCreateBinaryStatic(&(pxNewRingbuffer->xRecvSemStatic));
-    prvInitializeNewRingbuffer(xBufferSize, xBufferType, pxNewRingbuffer, pucRingbufferStorage);
+    prvInitializeNewRingbuffer(xBufferSize, xBufferType, xSPSC, pxNewRingbuffer, pucRingbufferStorage);
     pxNewRingbuffer->uxRingbufferFlags |= rbBUFFER_STATIC_FLAG;
     return (RingbufHandle_t)pxNewRingbuffer;
 }
+
+RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize,
+                                        RingbufferType_t xBufferType,
+                                        uint8_t *pucRingbufferStorage,
+                                        StaticRingbuffer_t *pxStaticRingbuffer)
+{
+    return prvCreateRingbufferStatic(xBufferSize, xBufferType, pdFALSE, pucRingbufferStorage, pxStaticRingbuffer);
+}
+
+RingbufHandle_t xRingbufferCreateStaticSPSC(size_t xBufferSize,
+                                            RingbufferType_t xBufferType,
+                                            uint8_t *pucRingbufferStorage,
+                                            StaticRingbuffer_t *pxStaticRingbuffer)
+{
+    //Allow-split buffers are not supported
+    configASSERT(xBufferType == RINGBUF_TYPE_NOSPLIT || xBufferType == RINGBUF_TYPE_BYTEBUF);
+    return prvCreateRingbufferStatic(xBufferSize, xBufferType, pdTRUE, pucRingbufferStorage, pxStaticRingbuffer);
+}
 #endif
 
 BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
@@ -958,6 +1404,13 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvSPSCWait(pxRingbuffer, pdTRUE, xItemSize, xTicksToWait) != pdTRUE) {
+            return pdFALSE;
+        }
+        *ppvItem = prvSPSCAcquireItemNoSplit(pxRingbuffer, xItemSize);
+        return pdTRUE;
+    }
 
     //Attempt to send an item
     BaseType_t xReturn = pdFALSE;
@@ -1009,6 +1462,12 @@ BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
     configASSERT(pvItem != NULL);
     configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvSPSCSendItemDoneNoSplit(pxRingbuffer, pvItem);
+        prvSPSCWake(pxRingbuffer, pdFALSE, pdFALSE, NULL);
+        return pdTRUE;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     prvSendItemDoneNoSplit(pxRingbuffer, pvItem);
     portEXIT_CRITICAL(&pxRingbuffer->mux);
@@ -1017,21 +1476,25 @@ BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
     return pdTRUE;
 }
 
-BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
-                           const void *pvItem,
-                           size_t xItemSize,
-                           TickType_t xTicksToWait)
+static BaseType_t prvSendGeneric(Ringbuffer_t *pxRingbuffer,
+                                 const RingbufferIovec_t *pxIov,
+                                 size_t xItemSize,
+                                 TickType_t xTicksToWait)
 {
-    //Check arguments
-    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
-    configASSERT(pxRingbuffer);
-    configASSERT(pvItem != NULL || xItemSize == 0);
     if (xItemSize > pxRingbuffer->xMaxItemSize) {
         return pdFALSE;     //Data will never ever fit in the queue.
     }
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvSPSCWait(pxRingbuffer, pdTRUE, xItemSize, xTicksToWait) != pdTRUE) {
+            return pdFALSE;
+        }
+        prvSPSCCopyItem(pxRingbuffer, pxIov, xItemSize);
+        prvSPSCWake(pxRingbuffer, pdFALSE, pdFALSE, NULL);
+        return pdTRUE;
+    }
 
     //Attempt to send an item
     BaseType_t xReturn = pdFALSE;
@@ -1048,7 +1511,7 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
         portENTER_CRITICAL(&pxRingbuffer->mux);
         if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
             //Item will fit, copy item
-            pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+            pxRingbuffer->vCopyItem(pxRingbuffer, pxIov, xItemSize);
             xReturn = pdTRUE;
             //Check if the free semaphore should be returned to allow other tasks to send
             if (prvGetFreeSize(pxRingbuffer) > 0) {
@@ -1078,6 +1541,42 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
     return xReturn;
 }
 
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
+                           const void *pvItem,
+                           size_t xItemSize,
+                           TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pvItem != NULL || xItemSize == 0);
+
+    RingbufferIovec_t xIov = {.pvBase = pvItem, .xLen = xItemSize};
+    return prvSendGeneric(pxRingbuffer, &xIov, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendv(RingbufHandle_t xRingbuffer,
+                            const RingbufferIovec_t *pxIov,
+                            UBaseType_t uxIovCount,
+                            TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pxIov != NULL || uxIovCount == 0);
+
+    //The item is the concatenation of all segments
+    size_t xItemSize = 0;
+    for (UBaseType_t i = 0; i < uxIovCount; i++) {
+        configASSERT(pxIov[i].pvBase != NULL || pxIov[i].xLen == 0);
+        if (pxIov[i].xLen > SIZE_MAX - xItemSize) {
+            return pdFALSE;     //The total size overflows, the item can never fit
+        }
+        xItemSize += pxIov[i].xLen;
+    }
+    return prvSendGeneric(pxRingbuffer, pxIov, xItemSize, xTicksToWait);
+}
+
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
                                   const void *pvItem,
                                   size_t xItemSize,
@@ -1093,13 +1592,22 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    RingbufferIovec_t xIov = {.pvBase = pvItem, .xLen = xItemSize};
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvSPSCCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+            return pdFALSE;
+        }
+        prvSPSCCopyItem(pxRingbuffer, &xIov, xItemSize);
+        prvSPSCWake(pxRingbuffer, pdFALSE, pdTRUE, pxHigherPriorityTaskWoken);
+        return pdTRUE;
+    }
 
     //Attempt to send an item
     BaseType_t xReturn;
     BaseType_t xReturnSemaphore = pdFALSE;
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     if (pxRingbuffer->xCheckItemFits(xRingbuffer, xItemSize) == pdTRUE) {
-        pxRingbuffer->vCopyItem(xRingbuffer, pvItem, xItemSize);
+        pxRingbuffer->vCopyItem(pxRingbuffer, &xIov, xItemSize);
         xReturn = pdTRUE;
         //Check if the free semaphore should be returned to allow other tasks to send
         if (prvGetFreeSize(pxRingbuffer) > 0) {
@@ -1285,12 +1793,37 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
     }
 }
 
+UBaseType_t xRingbufferReceiveMany(RingbufHandle_t xRingbuffer,
+                                   void **ppvItems,
+                                   size_t *pxItemSizes,
+                                   UBaseType_t uxMaxItems,
+                                   TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL && pxItemSizes != NULL);
+    //This function should only be called for no-split buffers
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
+    if (uxMaxItems == 0) {
+        return 0;
+    }
+
+    return prvReceiveMany(pxRingbuffer, ppvItems, pxItemSizes, uxMaxItems, xTicksToWait);
+}
+
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvSPSCReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvSPSCWake(pxRingbuffer, pdTRUE, pdFALSE, NULL);
+        return;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL(&pxRingbuffer->mux);
@@ -1303,12 +1836,45 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvSPSCReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvSPSCWake(pxRingbuffer, pdTRUE, pdTRUE, pxHigherPriorityTaskWoken);
+        return;
+    }
+
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
     xSemaphoreGiveFromISR(rbGET_TX_SEM_HANDLE(pxRingbuffer), pxHigherPriorityTaskWoken);
 }
 
+void vRingbufferReturnItems(RingbufHandle_t xRingbuffer, void *const *ppvItems, UBaseType_t uxItemCount)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL || uxItemCount == 0);
+    if (uxItemCount == 0) {
+        return;
+    }
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        for (UBaseType_t i = 0; i < uxItemCount; i++) {
+            configASSERT(ppvItems[i] != NULL);
+            prvSPSCReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+        }
+        prvSPSCWake(pxRingbuffer, pdTRUE, pdFALSE, NULL);
+        return;
+    }
+
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    for (UBaseType_t i = 0; i < uxItemCount; i++) {
+        configASSERT(ppvItems[i] != NULL);
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+    }
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    xSemaphoreGive(rbGET_TX_SEM_HANDLE(pxRingbuffer));
+}
+
 void vRingbufferDelete(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -1339,6 +1905,10 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSPSCGetCurMaxSize(pxRingbuffer);
+    }
+
     size_t xFreeSize;
     portENTER_CRITICAL(&pxRingbuffer->mux);
     xFreeSize = pxRingbuffer->xGetCurMaxSize(pxRingbuffer);
@@ -1350,6 +1920,8 @@ BaseType_t xRingbufferAddToQueueSetRead(RingbufHandle_t xRingbuffer, QueueSetHan
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    //The read semaphore of SPSC buffers is only given to wake a blocked receiver
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) == 0);
 
     BaseType_t xReturn;
     portENTER_CRITICAL(&pxRingbuffer->mux);
@@ -1423,10 +1995,11 @@ void xRingbufferPrintInfo(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    size_t xFreeSize = (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) ? prvSPSCGetFreeSize(pxRingbuffer) : prvGetFreeSize(pxRingbuffer);
     printf("Rb size:%d\tfree: %d\trptr: %d\tfreeptr: %d\twptr: %d, aptr: %d\n",
-           pxRingbuffer->xSize, prvGetFreeSize(pxRingbuffer),
-           pxRingbuffer->pucRead - pxRingbuffer->pucHead,
-           pxRingbuffer->pucFree - pxRingbuffer->pucHead,
-           pxRingbuffer->pucWrite - pxRingbuffer->pucHead,
-           pxRingbuffer->pucAcquire - pxRingbuffer->pucHead);
+           (int)pxRingbuffer->xSize, (int)xFreeSize,
+           (int)(pxRingbuffer->pucRead - pxRingbuffer->pucHead),
+           (int)(pxRingbuffer->pucFree - pxRingbuffer->pucHead),
+           (int)(pxRingbuffer->pucWrite - pxRingbuffer->pucHead),
+           (int)(pxRingbuffer->pucAcquire - pxRingbuffer->pucHead));
 }
@@ -617,6 +617,38 @@ TEST_CASE("TC#3: Byte buffer", "[esp_ringbuf]")
     vRingbufferDelete(buffer_handle);
 }
 
+TEST_CASE("Test ring buffer vectored send and batched receive", "[esp_ringbuf]")
+{
+    //Each item is the small item followed by the large item, sent as two segments
+    RingbufferIovec_t iov[2] = {{small_item, SMALL_ITEM_SIZE}, {large_item, LARGE_ITEM_SIZE}};
+    RingbufHandle_t buffer_handle = xRingbufferCreate(BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    TEST_ASSERT_MESSAGE(buffer_handle != NULL, "Failed to create test buffer");
+
+    for (int iter = 0; iter < 10; iter++) {
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_MESSAGE(xRingbufferSendv(buffer_handle, iov, 2, TIMEOUT_TICKS) == pdTRUE, "Failed to send item");
+        }
+
+        void *items[4];
+        size_t sizes[4];
+        TEST_ASSERT_EQUAL(3, xRingbufferReceiveMany(buffer_handle, items, sizes, 4, TIMEOUT_TICKS));
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_EQUAL(SMALL_ITEM_SIZE + LARGE_ITEM_SIZE, sizes[i]);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(small_item, items[i], SMALL_ITEM_SIZE);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(large_item, (uint8_t *)items[i] + SMALL_ITEM_SIZE, LARGE_ITEM_SIZE);
+        }
+        vRingbufferReturnItems(buffer_handle, items, 3);
+        TEST_ASSERT_EQUAL(0, xRingbufferReceiveMany(buffer_handle, items, sizes, 4, 0));
+    }
+
+    //Segments whose total length overflows are rejected
+    RingbufferIovec_t overflow_iov[2] = {{small_item, SMALL_ITEM_SIZE}, {large_item, SIZE_MAX - SMALL_ITEM_SIZE + 1}};
+    TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSendv(buffer_handle, overflow_iov, 2, 0));
+
+    //Cleanup
+    vRingbufferDelete(buffer_handle);
+}
+
 /* ----------------------- Ring buffer queue sets test ------------------------
  * The following test case will test receiving from ring buffers that have been
  * added to a queue set. The test case will do the following...
@@ -1026,6 +1058,38 @@ TEST_CASE("Test static ring buffer SMP", "[esp_ringbuf]")
 }
 #endif
 
+TEST_CASE("Test SPSC ring buffer SMP", "[esp_ringbuf]")
+{
+    const RingbufferType_t buf_types[] = {RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_BYTEBUF};
+
+    setup();
+    for (int type_idx = 0; type_idx < sizeof(buf_types) / sizeof(buf_types[0]); type_idx++) {
+        //Create buffer
+        task_args_t task_args;
+        task_args.buffer = xRingbufferCreateSPSC(CONT_DATA_TEST_BUFF_LEN, buf_types[type_idx]);
+        task_args.type = buf_types[type_idx];
+        TEST_ASSERT_MESSAGE(task_args.buffer != NULL, "Failed to create ring buffer");
+
+        for (int prior_mod = -1; prior_mod < 2; prior_mod++) {  //Test different relative priorities
+            //Test every permutation of core affinity
+            for (int send_core = 0; send_core < portNUM_PROCESSORS; send_core++) {
+                for (int rec_core = 0; rec_core < portNUM_PROCESSORS; rec_core ++) {
+                    esp_rom_printf("Type: %d (SPSC), PM: %d, SC: %d, RC: %d\n", task_args.type, prior_mod, send_core, rec_core);
+                    xTaskCreatePinnedToCore(send_task, "send tsk", 2048, (void *)&task_args, 10 + prior_mod, NULL, send_core);
+                    xTaskCreatePinnedToCore(rec_task, "rec tsk", 2048, (void *)&task_args, 10, NULL, rec_core);
+                    xSemaphoreTake(tasks_done, portMAX_DELAY);
+                    vTaskDelay(5);  //Allow idle to clean up
+                }
+            }
+        }
+
+        //Delete ring buffer
+        vRingbufferDelete(task_args.buffer);
+        vTaskDelay(10);
+    }
+    cleanup();
+}
+
 /* -------------------------- Test ring buffer IRAM ------------------------- */
 
 static IRAM_ATTR __attribute__((noinline)) bool iram_ringbuf_test(void)
@@ -0,0 +1,234 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* Unit tests and benchmark of the data structures used for armed esp_timers, on the Linux host */
+#define CATCH_CONFIG_MAIN
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include <sys/queue.h>
+#include "esp_timer_heap.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+struct test_timer {
+    uint64_t alarm;
+    esp_timer_heap_node_t heap_node;
+    LIST_ENTRY(test_timer) list_entry;
+};
+
+static test_timer *timer_of(esp_timer_heap_node_t *node)
+{
+    return (test_timer *)((char *)node - offsetof(test_timer, heap_node));
+}
+
+static void heap_arm(esp_timer_heap_t *heap, test_timer *t, uint64_t alarm)
+{
+    t->alarm = alarm;
+    t->heap_node.key = alarm;
+    esp_timer_heap_insert(heap, &t->heap_node);
+}
+
+static size_t heap_count(const esp_timer_heap_t *heap)
+{
+    size_t count = 0;
+    for (esp_timer_heap_node_t *node = esp_timer_heap_min(heap); node != NULL; node = esp_timer_heap_next(node)) {
+        count++;
+    }
+    return count;
+}
+
+/* Same as timer_insert() in esp_timer.c, when armed timers are kept in a sorted list */
+LIST_HEAD(test_timer_list, test_timer);
+
+static void list_arm(test_timer_list *list, test_timer *t, uint64_t alarm)
+{
+    test_timer *it, *last = NULL;
+    t->alarm = alarm;
+    if (LIST_FIRST(list) == NULL) {
+        LIST_INSERT_HEAD(list, t, list_entry);
+    } else {
+        LIST_FOREACH(it, list, list_entry) {
+            if (t->alarm < it->alarm) {
+                LIST_INSERT_BEFORE(it, t, list_entry);
+                break;
+            }
+            last = it;
+        }
+        if (it == NULL) {
+            LIST_INSERT_AFTER(last, t, list_entry);
+        }
+    }
+}
+
+TEST_CASE("pairing heap pops nodes in the order of keys")
+{
+    mt19937 rng(1);
+    vector<test_timer> timers(1000);
+    esp_timer_heap_t heap = {};
+
+    CHECK(esp_timer_heap_min(&heap) == NULL);
+    for (test_timer &t : timers) {
+        heap_arm(&heap, &t, rng() % 500);
+    }
+    CHECK(heap_count(&heap) == timers.size());
+
+    uint64_t last = 0;
+    size_t popped = 0;
+    while (esp_timer_heap_min(&heap) != NULL) {
+        test_timer *t = timer_of(esp_timer_heap_min(&heap));
+        CHECK(t->alarm >= last);
+        last = t->alarm;
+        esp_timer_heap_remove(&heap, &t->heap_node);
+        popped++;
+    }
+    CHECK(popped == timers.size());
+}
+
+TEST_CASE("pairing heap matches a sorted reference under random arm, disarm and pop")
+{
+    mt19937 rng(2);
+    vector<test_timer> timers(200);
+    vector<bool> armed(timers.size());
+    multiset<uint64_t> reference;
+    esp_timer_heap_t heap = {};
+    uint64_t now = 0;
+
+    for (int i = 0; i < 200000; i++) {
+        size_t idx = rng() % timers.size();
+        test_timer &t = timers[idx];
+        switch (rng() % 3) {
+        case 0: // arm, or re-arm if already armed
+            if (armed[idx]) {
+                esp_timer_heap_remove(&heap, &t.heap_node);
+                reference.erase(reference.find(t.alarm));
+            }
+            heap_arm(&heap, &t, now + rng() % 1000);
+            reference.insert(t.alarm);
+            armed[idx] = true;
+            break;
+        case 1: // disarm
+            if (armed[idx]) {
+                esp_timer_heap_remove(&heap, &t.heap_node);
+                reference.erase(reference.find(t.alarm));
+                armed[idx] = false;
+            }
+            break;
+        default: { // expire the earliest timer, like timer_process_alarm() does
+            esp_timer_heap_node_t *node = esp_timer_heap_min(&heap);
+            if (node != NULL) {
+                test_timer *first = timer_of(node);
+                REQUIRE(first->alarm == *reference.begin());
+                now = first->alarm;
+                esp_timer_heap_remove(&heap, node);
+                reference.erase(reference.begin());
+                armed[first - timers.data()] = false;
+            }
+            break;
+        }
+        }
+
+        if (reference.empty()) {
+            REQUIRE(esp_timer_heap_min(&heap) == NULL);
+        } else {
+            REQUIRE(esp_timer_heap_min(&heap) != NULL);
+            REQUIRE(esp_timer_heap_min(&heap)->key == *reference.begin());
+        }
+        if (i % 1000 == 0) {
+            REQUIRE(heap_count(&heap) == reference.size());
+        }
+    }
+}
+
+TEST_CASE("pairing heap handles equal keys")
+{
+    vector<test_timer> timers(100);
+    esp_timer_heap_t heap = {};
+    for (test_timer &t : timers) {
+        heap_arm(&heap, &t, 42);
+    }
+    // remove some nodes from the middle of the heap
+    for (size_t i = 1; i < timers.size(); i += 3) {
+        esp_timer_heap_remove(&heap, &timers[i].heap_node);
+    }
+    size_t popped = 0;
+    while (esp_timer_heap_min(&heap) != NULL) {
+        CHECK(esp_timer_heap_min(&heap)->key == 42);
+        esp_timer_heap_remove(&heap, esp_timer_heap_min(&heap));
+        popped++;
+    }
+    CHECK(popped == timers.size() - timers.size() / 3);
+}
+
+/* Re-arms random timers (stop + start), and expires the earliest timer then re-arms it (a periodic timer).
+   Returns millions of operations per second for the pairing heap and for the sorted list. */
+static void bench_arm_cancel(size_t timer_count, double *heap_mops, double *list_mops)
+{
+    const int ops = 1000000;
+    mt19937 rng(3);
+    vector<uint64_t> delays(ops);
+    vector<size_t> indexes(ops);
+    for (int i = 0; i < ops; i++) {
+        delays[i] = 1 + rng() % 100000;
+        indexes[i] = rng() % timer_count;
+    }
+
+    vector<test_timer> timers(timer_count);
+    esp_timer_heap_t heap = {};
+    uint64_t now = 0;
+    for (test_timer &t : timers) {
+        heap_arm(&heap, &t, now + delays[&t - timers.data()]);
+    }
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ops; i++) {
+        test_timer *t;
+        if (i % 2) {
+            t = &timers[indexes[i]];
+        } else {
+            t = timer_of(esp_timer_heap_min(&heap));
+            now = t->alarm;
+        }
+        esp_timer_heap_remove(&heap, &t->heap_node);
+        heap_arm(&heap, t, now + delays[i]);
+    }
+    chrono::duration<double> heap_time = chrono::steady_clock::now() - start;
+
+    test_timer_list list = LIST_HEAD_INITIALIZER(list);
+    now = 0;
+    for (test_timer &t : timers) {
+        list_arm(&list, &t, now + delays[&t - timers.data()]);
+    }
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < ops; i++) {
+        test_timer *t;
+        if (i % 2) {
+            t = &timers[indexes[i]];
+        } else {
+            t = LIST_FIRST(&list);
+            now = t->alarm;
+        }
+        LIST_REMOVE(t, list_entry);
+        list_arm(&list, t, now + delays[i]);
+    }
+    chrono::duration<double> list_time = chrono::steady_clock::now() - start;
+
+    *heap_mops = ops / heap_time.count() / 1e6;
+    *list_mops = ops / list_time.count() / 1e6;
+}
+
+TEST_CASE("armed timer queue throughput", "[bench]")
+{
+    for (size_t timer_count : {10, 100, 1000}) {
+        double heap_mops, list_mops;
+        bench_arm_cancel(timer_count, &heap_mops, &list_mops);
+        printf("%4zu armed timers: sorted list %.2f M re-arms/s, pairing heap %.2f M re-arms/s\n",
+               timer_count, list_mops, heap_mops);
+    }
+}
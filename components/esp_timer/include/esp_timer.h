@@ -165,6 +165,41 @@ esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
  */
 esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
 
+/**
+ * @brief Start one-shot timer, allowing its callback to be delayed
+ *
+ * Same as esp_timer_start_once, except that the callback may be dispatched up to
+ * 'slack_us' microseconds after the timeout. This allows the callback to be dispatched
+ * together with the callbacks of other timers, from the same timer interrupt, which
+ * reduces the number of interrupts and of wake-ups of the esp_timer task.
+ *
+ * @param timer timer handle created using esp_timer_create
+ * @param timeout_us timer timeout, in microseconds relative to the current moment
+ * @param slack_us maximum delay of the callback after the timeout, in microseconds
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the handle is invalid
+ *      - ESP_ERR_INVALID_STATE if the timer is already running
+ */
+esp_err_t esp_timer_start_once_with_slack(esp_timer_handle_t timer, uint64_t timeout_us, uint32_t slack_us);
+
+/**
+ * @brief Start a periodic timer, allowing its callbacks to be delayed
+ *
+ * Same as esp_timer_start_periodic, except that each callback may be dispatched up to
+ * 'slack_us' microseconds after it is due. The delay does not accumulate: the timer
+ * still triggers every 'period' microseconds on average.
+ *
+ * @param timer timer handle created using esp_timer_create
+ * @param period timer period, in microseconds
+ * @param slack_us maximum delay of each callback, in microseconds
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the handle is invalid
+ *      - ESP_ERR_INVALID_STATE if the timer is already running
+ */
+esp_err_t esp_timer_start_periodic_with_slack(esp_timer_handle_t timer, uint64_t period, uint32_t slack_us);
+
 /**
  * @brief Stop the timer
  *
@@ -199,6 +234,9 @@ int64_t esp_timer_get_time(void);
 
 /**
  * @brief Get the timestamp when the next timeout is expected to occur
+ *
+ * For timers started with slack, this is the latest time when the callback can be dispatched.
+ *
  * @return Timestamp of the nearest timer event, in microseconds.
  *         The timebase is the same as for the values returned by esp_timer_get_time.
  */
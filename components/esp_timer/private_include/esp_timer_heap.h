@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/**
+ * @file private_include/esp_timer_heap.h
+ *
+ * @brief Intrusive pairing heap used to keep armed esp_timers ordered by alarm time.
+ *
+ * Inserting a node takes constant time. Removing the minimum or an arbitrary node
+ * takes O(log n) amortized time, but a single removal takes O(n) time in the worst
+ * case: when the root has many children, e.g. after n nodes have been inserted with
+ * increasing keys, all of them are paired up. Nodes with equal keys are not guaranteed
+ * to be removed in insertion order.
+ *
+ * The functions are not thread safe, the caller has to hold the lock protecting the heap.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_timer_heap_node {
+    uint64_t key;                       //!< Sort key (alarm time), must not change while the node is in a heap
+    struct esp_timer_heap_node* child;  //!< First child
+    struct esp_timer_heap_node* next;   //!< Next sibling
+    struct esp_timer_heap_node* prev;   //!< Previous sibling, or parent if this is the first child
+} esp_timer_heap_node_t;
+
+typedef struct {
+    esp_timer_heap_node_t* root;        //!< Node with the smallest key, NULL if the heap is empty
+} esp_timer_heap_t;
+
+/**
+ * @brief Insert a node into the heap
+ * @param heap  heap to insert into
+ * @param node  node to insert, with its key set. Must not be in any heap.
+ */
+void esp_timer_heap_insert(esp_timer_heap_t* heap, esp_timer_heap_node_t* node);
+
+/**
+ * @brief Remove a node from the heap
+ * @param heap  heap containing the node
+ * @param node  node to remove
+ */
+void esp_timer_heap_remove(esp_timer_heap_t* heap, esp_timer_heap_node_t* node);
+
+/**
+ * @brief Get the node with the smallest key
+ * @return node with the smallest key, or NULL if the heap is empty
+ */
+static inline esp_timer_heap_node_t* esp_timer_heap_min(const esp_timer_heap_t* heap)
+{
+    return heap->root;
+}
+
+/**
+ * @brief Iterate over all nodes of the heap, in no particular order
+ *
+ * Start with the node returned by esp_timer_heap_min(). The heap must not be
+ * modified during the iteration.
+ *
+ * @param node  current node
+ * @return next node, or NULL if all nodes have been visited
+ */
+esp_timer_heap_node_t* esp_timer_heap_next(const esp_timer_heap_node_t* node);
+
+#ifdef __cplusplus
+}
+#endif
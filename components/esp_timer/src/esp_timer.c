@@ -18,6 +18,9 @@
 #include "soc/spinlock.h"
 #include "esp_timer.h"
 #include "esp_timer_impl.h"
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+#include "esp_timer_heap.h"
+#endif
 
 #include "esp_private/startup_internal.h"
 #include "esp_private/esp_timer_private.h"
@@ -65,13 +68,18 @@ struct esp_timer {
         uint32_t event_id;
     };
     void* arg;
+    uint32_t slack;     // callback may be delayed up to 'slack' us after 'alarm', to run together with other timers
 #if WITH_PROFILING
     const char* name;
     size_t times_triggered;
     size_t times_armed;
     size_t times_skipped;
+    size_t times_coalesced;
     uint64_t total_callback_run_time;
 #endif // WITH_PROFILING
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    esp_timer_heap_node_t heap_node;
+#endif
     LIST_ENTRY(esp_timer) list_entry;
 };
 
@@ -79,6 +87,11 @@ static inline bool is_initialized(void);
 static esp_err_t timer_insert(esp_timer_handle_t timer, bool without_update_alarm);
 static esp_err_t timer_remove(esp_timer_handle_t timer);
 static bool timer_armed(esp_timer_handle_t timer);
+static uint64_t timer_deadline(esp_timer_handle_t timer);
+static esp_timer_handle_t timer_queue_first(esp_timer_dispatch_t dispatch_method);
+static esp_timer_handle_t timer_queue_next(esp_timer_handle_t timer);
+static void timer_enqueue(esp_timer_handle_t timer);
+static void timer_dequeue(esp_timer_handle_t timer);
 static void timer_list_lock(esp_timer_dispatch_t timer_type);
 static void timer_list_unlock(esp_timer_dispatch_t timer_type);
 
@@ -93,6 +106,12 @@ __attribute__((unused)) static const char* TAG = "esp_timer";
 static LIST_HEAD(esp_timer_list, esp_timer) s_timers[ESP_TIMER_MAX] = {
     [0 ... (ESP_TIMER_MAX - 1)] = LIST_HEAD_INITIALIZER(s_timers)
 };
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+// heap of currently armed timers with TASK dispatch method, used instead of s_timers[ESP_TIMER_TASK].
+// ISR timers stay in the sorted list: the heap may take O(n) time to remove the next timer,
+// which must not happen in the timer interrupt.
+static esp_timer_heap_t s_task_timers;
+#endif
 #if WITH_PROFILING
 // lists of unarmed timers for two dispatch methods: ISR and TASK,
 // used only to be able to dump statistics about all the timers
@@ -108,6 +127,12 @@ static portMUX_TYPE s_timer_lock[ESP_TIMER_MAX] = {
     [0 ... (ESP_TIMER_MAX - 1)] = portMUX_INITIALIZER_UNLOCKED
 };
 
+#if WITH_PROFILING
+// number of alarms which dispatched at least one callback, and number of callbacks dispatched
+static size_t s_alarms_processed[ESP_TIMER_MAX];
+static size_t s_callbacks_dispatched[ESP_TIMER_MAX];
+#endif
+
 #ifdef CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
 // For ISR dispatch method, a callback function of the timer may require a context switch
 static volatile BaseType_t s_isr_dispatch_need_yield = pdFALSE;
@@ -143,6 +168,11 @@ esp_err_t esp_timer_create(const esp_timer_create_args_t* args,
 }
 
 esp_err_t IRAM_ATTR esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return esp_timer_start_once_with_slack(timer, timeout_us, 0);
+}
+
+esp_err_t IRAM_ATTR esp_timer_start_once_with_slack(esp_timer_handle_t timer, uint64_t timeout_us, uint32_t slack_us)
 {
     if (timer == NULL) {
         return ESP_ERR_INVALID_ARG;
@@ -155,6 +185,7 @@ esp_err_t IRAM_ATTR esp_timer_start_once(esp_timer_handle_t timer, uint64_t time
     timer_list_lock(dispatch_method);
     timer->alarm = alarm;
     timer->period = 0;
+    timer->slack = slack_us;
 #if WITH_PROFILING
     timer->times_armed++;
 #endif
@@ -164,6 +195,11 @@ esp_err_t IRAM_ATTR esp_timer_start_once(esp_timer_handle_t timer, uint64_t time
 }
 
 esp_err_t IRAM_ATTR esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return esp_timer_start_periodic_with_slack(timer, period_us, 0);
+}
+
+esp_err_t IRAM_ATTR esp_timer_start_periodic_with_slack(esp_timer_handle_t timer, uint64_t period_us, uint32_t slack_us)
 {
     if (timer == NULL) {
         return ESP_ERR_INVALID_ARG;
@@ -177,6 +213,7 @@ esp_err_t IRAM_ATTR esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t
     timer_list_lock(dispatch_method);
     timer->alarm = alarm;
     timer->period = period_us;
+    timer->slack = slack_us;
 #if WITH_PROFILING
     timer->times_armed++;
     timer->times_skipped = 0;
@@ -215,6 +252,8 @@ esp_err_t esp_timer_delete(esp_timer_handle_t timer)
     timer->event_id = EVENT_ID_DELETE_TIMER;
     timer->alarm = alarm;
     timer->period = 0;
+    // the slack of the last start must not postpone freeing the timer
+    timer->slack = 0;
     timer_insert(timer, false);
     timer_list_unlock(ESP_TIMER_TASK);
     return ESP_OK;
@@ -225,25 +264,10 @@ static IRAM_ATTR esp_err_t timer_insert(esp_timer_handle_t timer, bool without_u
 #if WITH_PROFILING
     timer_remove_inactive(timer);
 #endif
-    esp_timer_handle_t it, last = NULL;
     esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
-    if (LIST_FIRST(&s_timers[dispatch_method]) == NULL) {
-        LIST_INSERT_HEAD(&s_timers[dispatch_method], timer, list_entry);
-    } else {
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            if (timer->alarm < it->alarm) {
-                LIST_INSERT_BEFORE(it, timer, list_entry);
-                break;
-            }
-            last = it;
-        }
-        if (it == NULL) {
-            assert(last);
-            LIST_INSERT_AFTER(last, timer, list_entry);
-        }
-    }
-    if (without_update_alarm == false && timer == LIST_FIRST(&s_timers[dispatch_method])) {
-        esp_timer_impl_set_alarm_id(timer->alarm, dispatch_method);
+    timer_enqueue(timer);
+    if (without_update_alarm == false && timer == timer_queue_first(dispatch_method)) {
+        esp_timer_impl_set_alarm_id(timer_deadline(timer), dispatch_method);
     }
     return ESP_OK;
 }
@@ -252,15 +276,15 @@ static IRAM_ATTR esp_err_t timer_remove(esp_timer_handle_t timer)
 {
     esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
     timer_list_lock(dispatch_method);
-    esp_timer_handle_t first_timer = LIST_FIRST(&s_timers[dispatch_method]);
-    LIST_REMOVE(timer, list_entry);
+    esp_timer_handle_t first_timer = timer_queue_first(dispatch_method);
+    timer_dequeue(timer);
     timer->alarm = 0;
     timer->period = 0;
     if (timer == first_timer) { // if this timer was the first in the list.
         uint64_t next_timestamp = UINT64_MAX;
-        first_timer = LIST_FIRST(&s_timers[dispatch_method]);
+        first_timer = timer_queue_first(dispatch_method);
         if (first_timer) { // if after removing the timer from the list, this list is not empty.
-            next_timestamp = first_timer->alarm;
+            next_timestamp = timer_deadline(first_timer);
         }
         esp_timer_impl_set_alarm_id(next_timestamp, dispatch_method);
     }
@@ -302,6 +326,89 @@ static IRAM_ATTR bool timer_armed(esp_timer_handle_t timer)
     return timer->alarm > 0;
 }
 
+// Latest time at which the callback should be dispatched. The hardware alarm is set to
+// the earliest deadline of the armed timers; when it fires, all timers whose 'alarm'
+// has passed are dispatched together, even if their deadlines are still in the future.
+static IRAM_ATTR uint64_t timer_deadline(esp_timer_handle_t timer)
+{
+    return timer->alarm + timer->slack;
+}
+
+/* Armed timers are kept either in a list sorted by deadline, or in a pairing
+ * heap (CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP, for TASK timers only). The functions
+ * below hide the difference.
+ */
+
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+#define TIMER_QUEUE_IS_HEAP(dispatch_method)    ((dispatch_method) == ESP_TIMER_TASK)
+#else
+#define TIMER_QUEUE_IS_HEAP(dispatch_method)    false
+#endif
+
+// Get the armed timer with the earliest deadline, or NULL if there are no armed timers
+static IRAM_ATTR esp_timer_handle_t timer_queue_first(esp_timer_dispatch_t dispatch_method)
+{
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    if (TIMER_QUEUE_IS_HEAP(dispatch_method)) {
+        esp_timer_heap_node_t* node = esp_timer_heap_min(&s_task_timers);
+        return (node != NULL) ? __containerof(node, struct esp_timer, heap_node) : NULL;
+    }
+#endif
+    return LIST_FIRST(&s_timers[dispatch_method]);
+}
+
+// Get the next armed timer with the same dispatch method. Timers are visited in the
+// order of their deadlines only if they are kept in a list.
+static IRAM_ATTR esp_timer_handle_t timer_queue_next(esp_timer_handle_t timer)
+{
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    if (TIMER_QUEUE_IS_HEAP(timer->flags & FL_ISR_DISPATCH_METHOD)) {
+        esp_timer_heap_node_t* node = esp_timer_heap_next(&timer->heap_node);
+        return (node != NULL) ? __containerof(node, struct esp_timer, heap_node) : NULL;
+    }
+#endif
+    return LIST_NEXT(timer, list_entry);
+}
+
+static IRAM_ATTR void timer_enqueue(esp_timer_handle_t timer)
+{
+    esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    if (TIMER_QUEUE_IS_HEAP(dispatch_method)) {
+        timer->heap_node.key = timer_deadline(timer);
+        esp_timer_heap_insert(&s_task_timers, &timer->heap_node);
+        return;
+    }
+#endif
+    esp_timer_handle_t it, last = NULL;
+    if (LIST_FIRST(&s_timers[dispatch_method]) == NULL) {
+        LIST_INSERT_HEAD(&s_timers[dispatch_method], timer, list_entry);
+    } else {
+        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+            if (timer_deadline(timer) < timer_deadline(it)) {
+                LIST_INSERT_BEFORE(it, timer, list_entry);
+                break;
+            }
+            last = it;
+        }
+        if (it == NULL) {
+            assert(last);
+            LIST_INSERT_AFTER(last, timer, list_entry);
+        }
+    }
+}
+
+static IRAM_ATTR void timer_dequeue(esp_timer_handle_t timer)
+{
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    if (TIMER_QUEUE_IS_HEAP(timer->flags & FL_ISR_DISPATCH_METHOD)) {
+        esp_timer_heap_remove(&s_task_timers, &timer->heap_node);
+        return;
+    }
+#endif
+    LIST_REMOVE(timer, list_entry);
+}
+
 static IRAM_ATTR void timer_list_lock(esp_timer_dispatch_t timer_type)
 {
     portENTER_CRITICAL_SAFE(&s_timer_lock[timer_type]);
@@ -320,15 +427,21 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
 {
     timer_list_lock(dispatch_method);
     bool processed = false;
+#if WITH_PROFILING
+    size_t callbacks_dispatched = 0;
+#endif
     esp_timer_handle_t it;
     while (1) {
-        it = LIST_FIRST(&s_timers[dispatch_method]);
+        it = timer_queue_first(dispatch_method);
         int64_t now = esp_timer_impl_get_time();
+        // Timers are ordered by deadline. Besides the timers whose deadline has passed,
+        // this also dispatches the following timers which are within their slack window,
+        // so that they don't need an alarm of their own.
         if (it == NULL || it->alarm > now) {
             break;
         }
         processed = true;
-        LIST_REMOVE(it, list_entry);
+        timer_dequeue(it);
         if (it->event_id == EVENT_ID_DELETE_TIMER) {
             // It is handled only by ESP_TIMER_TASK (see esp_timer_delete()).
             // All the ESP_TIMER_ISR timers which should be deleted are moved by esp_timer_delete() to the ESP_TIMER_TASK list.
@@ -336,6 +449,12 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
             free(it);
             it = NULL;
         } else {
+#if WITH_PROFILING
+            if (now < timer_deadline(it)) {
+                it->times_coalesced++;
+            }
+            callbacks_dispatched++;
+#endif
             if (it->period > 0) {
                 int skipped = (now - it->alarm) / it->period;
                 if ((it->flags & FL_SKIP_UNHANDLED_EVENTS) && (skipped > 1)) {
@@ -367,9 +486,15 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
 #endif
         }
     } // while(1)
+#if WITH_PROFILING
+    if (callbacks_dispatched > 0) {
+        s_alarms_processed[dispatch_method]++;
+        s_callbacks_dispatched[dispatch_method] += callbacks_dispatched;
+    }
+#endif
     if (it) {
         if (dispatch_method == ESP_TIMER_TASK || (dispatch_method != ESP_TIMER_TASK && processed == true)) {
-            esp_timer_impl_set_alarm_id(it->alarm, dispatch_method);
+            esp_timer_impl_set_alarm_id(timer_deadline(it), dispatch_method);
         }
     } else {
         if (processed) {
@@ -469,7 +594,7 @@ esp_err_t esp_timer_deinit(void)
 
     /* Check if there are any active timers */
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
-        if (!LIST_EMPTY(&s_timers[dispatch_method])) {
+        if (timer_queue_first(dispatch_method) != NULL) {
             return ESP_ERR_INVALID_STATE;
         }
     }
@@ -502,11 +627,11 @@ static void print_timer_info(esp_timer_handle_t t, char** dst, size_t* dst_size)
     } else {
         cb = snprintf(*dst, *dst_size, "timer@%-10p  ", t);
     }
-    cb += snprintf(*dst + cb, *dst_size + cb, "%-10lld  %-12lld  %-12d  %-12d  %-12d  %-12lld\n",
+    cb += snprintf(*dst + cb, *dst_size + cb, "%-10lld  %-12lld  %-12d  %-12d  %-12d  %-12d  %-12lld\n",
                     (uint64_t)t->period, t->alarm, t->times_armed,
-                    t->times_triggered, t->times_skipped, t->total_callback_run_time);
+                    t->times_triggered, t->times_skipped, t->times_coalesced, t->total_callback_run_time);
     /* keep this in sync with the format string, used in esp_timer_dump */
-#define TIMER_INFO_LINE_LEN 90
+#define TIMER_INFO_LINE_LEN 104
 #else
     size_t cb = snprintf(*dst, *dst_size, "timer@%-14p  %-10lld  %-12lld\n", t, (uint64_t)t->period, t->alarm);
 #define TIMER_INFO_LINE_LEN 46
@@ -515,6 +640,15 @@ static void print_timer_info(esp_timer_handle_t t, char** dst, size_t* dst_size)
     *dst_size -= cb;
 }
 
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+static int timer_deadline_cmp(const void* a, const void* b)
+{
+    uint64_t deadline_a = timer_deadline(*(const esp_timer_handle_t*) a);
+    uint64_t deadline_b = timer_deadline(*(const esp_timer_handle_t*) b);
+    return (deadline_a > deadline_b) - (deadline_a < deadline_b);
+}
+#endif
+
 
 esp_err_t esp_timer_dump(FILE* stream)
 {
@@ -530,7 +664,7 @@ esp_err_t esp_timer_dump(FILE* stream)
     size_t timer_count = 0;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+        for (it = timer_queue_first(dispatch_method); it != NULL; it = timer_queue_next(it)) {
             ++timer_count;
         }
 #if WITH_PROFILING
@@ -551,13 +685,43 @@ esp_err_t esp_timer_dump(FILE* stream)
     if (print_buf == NULL) {
         return ESP_ERR_NO_MEM;
     }
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    /* The heap is not ordered by deadline, armed timers are sorted before printing */
+    esp_timer_handle_t* sorted = calloc(timer_count + 1, sizeof(esp_timer_handle_t));
+    if (sorted == NULL) {
+        free(print_buf);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
 
     /* Print to the buffer */
     char* pos = print_buf;
+#if WITH_PROFILING
+    size_t alarms_processed = 0;
+    size_t callbacks_dispatched = 0;
+#endif
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            print_timer_info(it, &pos, &buf_size);
+#if WITH_PROFILING
+        alarms_processed += s_alarms_processed[dispatch_method];
+        callbacks_dispatched += s_callbacks_dispatched[dispatch_method];
+#endif
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+        if (TIMER_QUEUE_IS_HEAP(dispatch_method)) {
+            size_t sorted_count = 0;
+            for (it = timer_queue_first(dispatch_method); it != NULL && sorted_count <= timer_count; it = timer_queue_next(it)) {
+                sorted[sorted_count++] = it;
+            }
+            qsort(sorted, sorted_count, sizeof(esp_timer_handle_t), timer_deadline_cmp);
+            for (size_t i = 0; i < sorted_count; ++i) {
+                print_timer_info(sorted[i], &pos, &buf_size);
+            }
+        }
+#endif
+        if (!TIMER_QUEUE_IS_HEAP(dispatch_method)) {
+            LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+                print_timer_info(it, &pos, &buf_size);
+            }
         }
 #if WITH_PROFILING
         LIST_FOREACH(it, &s_inactive_timers[dispatch_method], list_entry) {
@@ -570,16 +734,22 @@ esp_err_t esp_timer_dump(FILE* stream)
     if (stream != NULL) {
         fprintf(stream, "Timer stats:\n");
 #if WITH_PROFILING
-        fprintf(stream, "%-20s  %-10s  %-12s  %-12s  %-12s  %-12s  %-12s\n",
-                "Name", "Period", "Alarm", "Times_armed", "Times_trigg", "Times_skip", "Cb_exec_time");
+        fprintf(stream, "%-20s  %-10s  %-12s  %-12s  %-12s  %-12s  %-12s  %-12s\n",
+                "Name", "Period", "Alarm", "Times_armed", "Times_trigg", "Times_skip", "Times_coal", "Cb_exec_time");
 #else
         fprintf(stream, "%-20s  %-10s  %-12s\n", "Name", "Period", "Alarm");
 #endif
 
         /* Print the buffer */
         fputs(print_buf, stream);
+#if WITH_PROFILING
+        fprintf(stream, "Callbacks dispatched: %d, in %d alarms\n", callbacks_dispatched, alarms_processed);
+#endif
     }
 
+#if CONFIG_ESP_TIMER_QUEUE_PAIRING_HEAP
+    free(sorted);
+#endif
     free(print_buf);
     return ESP_OK;
 }
@@ -589,10 +759,10 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm(void)
     int64_t next_alarm = INT64_MAX;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        esp_timer_handle_t it = LIST_FIRST(&s_timers[dispatch_method]);
+        esp_timer_handle_t it = timer_queue_first(dispatch_method);
         if (it) {
-            if (next_alarm > it->alarm) {
-                next_alarm = it->alarm;
+            if (next_alarm > timer_deadline(it)) {
+                next_alarm = timer_deadline(it);
             }
         }
         timer_list_unlock(dispatch_method);
@@ -606,13 +776,16 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm_for_wake_up(void)
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
         esp_timer_handle_t it = NULL;
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+        for (it = timer_queue_first(dispatch_method); it != NULL; it = timer_queue_next(it)) {
             // timers with the SKIP_UNHANDLED_EVENTS flag do not want to wake up CPU from a sleep mode.
             if ((it->flags & FL_SKIP_UNHANDLED_EVENTS) == 0) {
-                if (next_alarm > it->alarm) {
-                    next_alarm = it->alarm;
+                if (next_alarm > timer_deadline(it)) {
+                    next_alarm = timer_deadline(it);
+                }
+                if (!TIMER_QUEUE_IS_HEAP(dispatch_method)) {
+                    // the list is sorted, the first suitable timer has the earliest deadline
+                    break;
                 }
-                break;
             }
         }
         timer_list_unlock(dispatch_method);
@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+#include "esp_attr.h"
+#include "esp_timer_heap.h"
+
+/* Functions of this file are called from esp_timer functions placed in IRAM,
+ * including the timer ISR, so they are placed in IRAM as well.
+ */
+
+// Link two heaps, the root with the larger key becomes the first child of the other one.
+// On equal keys, 'a' stays the root. This doesn't keep timers with equal alarm times in the
+// order they were armed, as the pairing passes don't link siblings in that order.
+static IRAM_ATTR esp_timer_heap_node_t* heap_link(esp_timer_heap_node_t* a, esp_timer_heap_node_t* b)
+{
+    if (b->key < a->key) {
+        esp_timer_heap_node_t* tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->prev = a;
+    b->next = a->child;
+    if (a->child) {
+        a->child->prev = b;
+    }
+    a->child = b;
+    return a;
+}
+
+// Two-pass pairing of a list of sibling heaps into a single heap.
+// Takes time linear in the number of siblings: up to n - 1 for the children of the root, e.g. after
+// n timers have been armed with increasing alarm times. The following removals are cheap again.
+static IRAM_ATTR esp_timer_heap_node_t* heap_merge_pairs(esp_timer_heap_node_t* first)
+{
+    if (first == NULL) {
+        return NULL;
+    }
+
+    // First pass, left to right: link siblings in pairs, collect the results in reverse order
+    esp_timer_heap_node_t* pairs = NULL;
+    while (first) {
+        esp_timer_heap_node_t* a = first;
+        esp_timer_heap_node_t* b = a->next;
+        if (b == NULL) {
+            first = NULL;
+        } else {
+            first = b->next;
+            a = heap_link(a, b);
+        }
+        a->next = pairs;
+        pairs = a;
+    }
+
+    // Second pass, right to left: link each pair into the accumulated heap
+    esp_timer_heap_node_t* root = pairs;
+    pairs = pairs->next;
+    while (pairs) {
+        esp_timer_heap_node_t* next = pairs->next;
+        root = heap_link(pairs, root);
+        pairs = next;
+    }
+    root->next = NULL;
+    root->prev = NULL;
+    return root;
+}
+
+void IRAM_ATTR esp_timer_heap_insert(esp_timer_heap_t* heap, esp_timer_heap_node_t* node)
+{
+    node->child = NULL;
+    node->next = NULL;
+    node->prev = NULL;
+    if (heap->root == NULL) {
+        heap->root = node;
+    } else {
+        heap->root = heap_link(heap->root, node);
+    }
+}
+
+void IRAM_ATTR esp_timer_heap_remove(esp_timer_heap_t* heap, esp_timer_heap_node_t* node)
+{
+    if (node == heap->root) {
+        heap->root = heap_merge_pairs(node->child);
+    } else {
+        // Unlink the node from its siblings, then link its children back in
+        if (node->prev->child == node) {
+            node->prev->child = node->next;
+        } else {
+            node->prev->next = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        }
+        esp_timer_heap_node_t* children = heap_merge_pairs(node->child);
+        if (children) {
+            heap->root = heap_link(heap->root, children);
+        }
+    }
+    node->child = NULL;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+esp_timer_heap_node_t* IRAM_ATTR esp_timer_heap_next(const esp_timer_heap_node_t* node)
+{
+    // Pre-order traversal: children first, then siblings, then the siblings of the ancestors
+    if (node->child) {
+        return node->child;
+    }
+    while (node) {
+        if (node->next) {
+            return node->next;
+        }
+        // Go back to the first sibling, its 'prev' is the parent (NULL for the root)
+        while (node->prev && node->prev->child != node) {
+            node = node->prev;
+        }
+        node = node->prev;
+    }
+    return NULL;
+}
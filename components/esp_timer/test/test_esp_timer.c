@@ -424,6 +424,62 @@ TEST_CASE("esp_timer for very short intervals", "[esp_timer]")
     TEST_ESP_OK(esp_timer_delete(timer2));
 }
 
+typedef struct {
+    int64_t t_start;
+    int64_t t_cb[2];
+    SemaphoreHandle_t done;
+} test_slack_args_t;
+
+static test_slack_args_t s_slack_args;
+
+static void test_slack_timer_func(void* arg)
+{
+    int index = (int) arg;
+    s_slack_args.t_cb[index] = esp_timer_get_time() - s_slack_args.t_start;
+    xSemaphoreGive(s_slack_args.done);
+}
+
+TEST_CASE("esp_timer dispatches timers with slack together with other timers", "[esp_timer]")
+{
+    s_slack_args.done = xSemaphoreCreateCounting(2, 0);
+    esp_timer_create_args_t timer_args = {
+            .callback = &test_slack_timer_func,
+            .arg = (void*) 0,
+            .name = "no_slack"
+    };
+    esp_timer_handle_t timer1, timer2;
+    TEST_ESP_OK(esp_timer_create(&timer_args, &timer1));
+    timer_args.arg = (void*) 1;
+    timer_args.name = "slack";
+    TEST_ESP_OK(esp_timer_create(&timer_args, &timer2));
+
+    /* timer2 is due after 15 ms, but may be delayed by up to 10 ms,
+     * so it is dispatched after timer1, from the same alarm.
+     */
+    s_slack_args.t_start = esp_timer_get_time();
+    TEST_ESP_OK(esp_timer_start_once(timer1, 20 * 1000));
+    TEST_ESP_OK(esp_timer_start_once_with_slack(timer2, 15 * 1000, 10 * 1000));
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(s_slack_args.done, 100 / portTICK_PERIOD_MS));
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(s_slack_args.done, 100 / portTICK_PERIOD_MS));
+    printf("timer1 %lld us, timer2 %lld us\n", s_slack_args.t_cb[0], s_slack_args.t_cb[1]);
+    TEST_ASSERT_INT_WITHIN(1000, 20 * 1000, s_slack_args.t_cb[0]);
+    TEST_ASSERT_GREATER_OR_EQUAL(s_slack_args.t_cb[0], s_slack_args.t_cb[1]);
+    TEST_ASSERT_INT_WITHIN(1000, s_slack_args.t_cb[0], s_slack_args.t_cb[1]);
+
+    /* Without another timer to run with, the callback is dispatched at the end of the slack window */
+    s_slack_args.t_start = esp_timer_get_time();
+    TEST_ESP_OK(esp_timer_start_periodic_with_slack(timer2, 15 * 1000, 10 * 1000));
+    TEST_ASSERT_EQUAL(pdPASS, xSemaphoreTake(s_slack_args.done, 100 / portTICK_PERIOD_MS));
+    TEST_ESP_OK(esp_timer_stop(timer2));
+    printf("timer2 %lld us\n", s_slack_args.t_cb[1]);
+    TEST_ASSERT_INT_WITHIN(1000, 25 * 1000, s_slack_args.t_cb[1]);
+
+    TEST_ESP_OK(esp_timer_dump(stdout));
+    TEST_ESP_OK(esp_timer_delete(timer1));
+    TEST_ESP_OK(esp_timer_delete(timer2));
+    vSemaphoreDelete(s_slack_args.done);
+}
+
 
 TEST_CASE("esp_timer_get_time call takes less than 1us", "[esp_timer]")
 {
@@ -13,10 +13,16 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include "diskio_impl.h"
+#include "diskio_cache.h"
 #include "ffconf.h"
 #include "ff.h"
+#include "esp_log.h"
+
+static const char* TAG = "ff_diskio";
 
 static ff_diskio_impl_t * s_impls[FF_VOLUMES] = { NULL };
+static ff_diskio_cache_t * s_caches[FF_VOLUMES] = { NULL };
+static UINT s_cache_sizes[FF_VOLUMES] = { [0 ... FF_VOLUMES - 1] = CONFIG_FATFS_DISK_CACHE_SECTORS };
 
 #if FF_MULTI_PARTITION		/* Multiple partition configuration */
 PARTITION VolToPart[] = {
@@ -37,10 +43,22 @@ esp_err_t ff_diskio_get_drive(BYTE* out_pdrv)
     return ESP_ERR_NOT_FOUND;
 }
 
+static void delete_cache(BYTE pdrv)
+{
+    if (s_caches[pdrv]) {
+        if (ff_diskio_cache_flush(s_caches[pdrv]) != RES_OK) {
+            ESP_LOGE(TAG, "failed to write cached sectors of drive %d", pdrv);
+        }
+        ff_diskio_cache_delete(s_caches[pdrv]);
+        s_caches[pdrv] = NULL;
+    }
+}
+
 void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
 {
     assert(pdrv < FF_VOLUMES);
 
+    delete_cache(pdrv);
     if (s_impls[pdrv]) {
         ff_diskio_impl_t* im = s_impls[pdrv];
         s_impls[pdrv] = NULL;
@@ -57,9 +75,32 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
     s_impls[pdrv] = impl;
 }
 
+esp_err_t ff_diskio_set_cache_size(BYTE pdrv, UINT sector_count)
+{
+    if (pdrv >= FF_VOLUMES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_cache_sizes[pdrv] = sector_count;
+    return ESP_OK;
+}
+
 DSTATUS ff_disk_initialize (BYTE pdrv)
 {
-    return s_impls[pdrv]->init(pdrv);
+    DSTATUS status = s_impls[pdrv]->init(pdrv);
+    if (status & STA_NOINIT) {
+        return status;
+    }
+    const UINT cache_size = s_cache_sizes[pdrv];
+    if (s_caches[pdrv] && ff_diskio_cache_sector_count(s_caches[pdrv]) != cache_size) {
+        delete_cache(pdrv);
+    }
+    if (cache_size > 0 && !s_caches[pdrv]) {
+        s_caches[pdrv] = ff_diskio_cache_create(s_impls[pdrv], pdrv, cache_size, CONFIG_FATFS_DISK_CACHE_BURST_SECTORS);
+        if (!s_caches[pdrv]) {
+            ESP_LOGW(TAG, "drive %d is used without the sector cache", pdrv);
+        }
+    }
+    return status;
 }
 DSTATUS ff_disk_status (BYTE pdrv)
 {
@@ -67,14 +108,26 @@ DSTATUS ff_disk_status (BYTE pdrv)
 }
 DRESULT ff_disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
 {
+    if (s_caches[pdrv]) {
+        return ff_diskio_cache_read(s_caches[pdrv], buff, sector, count);
+    }
     return s_impls[pdrv]->read(pdrv, buff, sector, count);
 }
 DRESULT ff_disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
 {
+    if (s_caches[pdrv]) {
+        return ff_diskio_cache_write(s_caches[pdrv], buff, sector, count);
+    }
     return s_impls[pdrv]->write(pdrv, buff, sector, count);
 }
 DRESULT ff_disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
 {
+    if (cmd == CTRL_SYNC && s_caches[pdrv]) {
+        DRESULT res = ff_diskio_cache_flush(s_caches[pdrv]);
+        if (res != RES_OK) {
+            return res;
+        }
+    }
     return s_impls[pdrv]->ioctl(pdrv, cmd, buff);
 }
 
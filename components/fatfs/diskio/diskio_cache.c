@@ -0,0 +1,300 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <sys/param.h>
+#include "diskio_cache.h"
+#include "ff.h"
+#include "esp_log.h"
+
+static const char* TAG = "ff_diskio_cache";
+
+#define CACHE_MAX_BURST 16
+
+typedef struct {
+    DWORD sector;
+    uint32_t last_use;      // value of use_counter when the entry was last used, 0 if not used yet
+    bool valid;
+    bool dirty;
+} cache_entry_t;
+
+struct ff_diskio_cache {
+    const ff_diskio_impl_t* impl;
+    BYTE pdrv;
+    UINT sector_size;
+    DWORD drive_sectors;    // size of the drive in sectors, 0 if unknown (no read-ahead then)
+    UINT entry_count;
+    UINT burst;
+    uint32_t use_counter;
+    DWORD next_sector;      // sector following the last read of a sequential stream
+    BYTE* data;             // entry_count sectors
+    BYTE* burst_buf;        // burst sectors, NULL if burst is 1
+    UINT* order;            // entry_count indexes, used to sort the dirty entries
+    cache_entry_t entries[];
+};
+
+static inline BYTE* entry_data(ff_diskio_cache_t* cache, UINT idx)
+{
+    return cache->data + idx * cache->sector_size;
+}
+
+static inline void entry_touch(ff_diskio_cache_t* cache, UINT idx)
+{
+    cache->entries[idx].last_use = ++cache->use_counter;
+}
+
+static int cache_find(const ff_diskio_cache_t* cache, DWORD sector)
+{
+    for (UINT i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].valid && cache->entries[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+ff_diskio_cache_t* ff_diskio_cache_create(const ff_diskio_impl_t* impl, BYTE pdrv, UINT sector_count, UINT burst)
+{
+    WORD sector_size = 0;
+    if (impl->ioctl(pdrv, GET_SECTOR_SIZE, &sector_size) != RES_OK || sector_size == 0) {
+        ESP_LOGW(TAG, "drive %d doesn't report its sector size", pdrv);
+        return NULL;
+    }
+    DWORD drive_sectors = 0;
+    if (impl->ioctl(pdrv, GET_SECTOR_COUNT, &drive_sectors) != RES_OK) {
+        drive_sectors = 0;
+    }
+    // Read-ahead may take at most half of the cache, so that it doesn't evict the FAT sectors being used
+    burst = MAX(1, MIN(MIN(burst, sector_count / 2), CACHE_MAX_BURST));
+
+    ff_diskio_cache_t* cache = ff_memalloc(sizeof(ff_diskio_cache_t) + sector_count * sizeof(cache_entry_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(ff_diskio_cache_t) + sector_count * sizeof(cache_entry_t));
+    cache->impl = impl;
+    cache->pdrv = pdrv;
+    cache->sector_size = sector_size;
+    cache->drive_sectors = drive_sectors;
+    cache->entry_count = sector_count;
+    cache->burst = burst;
+    cache->next_sector = (DWORD) -1;
+    cache->data = ff_memalloc(sector_count * sector_size);
+    cache->order = ff_memalloc(sector_count * sizeof(UINT));
+    if (burst > 1) {
+        cache->burst_buf = ff_memalloc(burst * sector_size);
+    }
+    if (cache->data == NULL || cache->order == NULL || (burst > 1 && cache->burst_buf == NULL)) {
+        ff_diskio_cache_delete(cache);
+        return NULL;
+    }
+    ESP_LOGD(TAG, "drive %d: caching %u sectors of %d bytes, burst %u", pdrv, sector_count, sector_size, burst);
+    return cache;
+}
+
+void ff_diskio_cache_delete(ff_diskio_cache_t* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    ff_memfree(cache->data);
+    ff_memfree(cache->order);
+    ff_memfree(cache->burst_buf);
+    ff_memfree(cache);
+}
+
+UINT ff_diskio_cache_sector_count(const ff_diskio_cache_t* cache)
+{
+    return cache->entry_count;
+}
+
+DRESULT ff_diskio_cache_flush(ff_diskio_cache_t* cache)
+{
+    // Sort the dirty entries by sector number (insertion sort, there are few entries)
+    UINT dirty_count = 0;
+    for (UINT i = 0; i < cache->entry_count; i++) {
+        if (!cache->entries[i].dirty) {
+            continue;
+        }
+        UINT pos = dirty_count++;
+        while (pos > 0 && cache->entries[cache->order[pos - 1]].sector > cache->entries[i].sector) {
+            cache->order[pos] = cache->order[pos - 1];
+            pos--;
+        }
+        cache->order[pos] = i;
+    }
+
+    // Write the runs of consecutive sectors in one call each
+    for (UINT i = 0; i < dirty_count; ) {
+        const DWORD first = cache->entries[cache->order[i]].sector;
+        UINT run = 1;
+        while (i + run < dirty_count && run < cache->burst &&
+                cache->entries[cache->order[i + run]].sector == first + run) {
+            run++;
+        }
+        DRESULT res;
+        if (run == 1) {
+            res = cache->impl->write(cache->pdrv, entry_data(cache, cache->order[i]), first, 1);
+        } else {
+            for (UINT j = 0; j < run; j++) {
+                memcpy(cache->burst_buf + j * cache->sector_size, entry_data(cache, cache->order[i + j]), cache->sector_size);
+            }
+            res = cache->impl->write(cache->pdrv, cache->burst_buf, first, run);
+        }
+        if (res != RES_OK) {
+            return res;
+        }
+        for (UINT j = 0; j < run; j++) {
+            cache->entries[cache->order[i + j]].dirty = false;
+        }
+        i += run;
+    }
+    return RES_OK;
+}
+
+// Returns the least recently used entry, invalidated and marked as used.
+// If the entry is dirty, all dirty entries are written back first.
+static int cache_take_victim(ff_diskio_cache_t* cache)
+{
+    UINT victim = 0;
+    for (UINT i = 1; i < cache->entry_count; i++) {
+        if (cache->entries[i].last_use < cache->entries[victim].last_use) {
+            victim = i;
+        }
+    }
+    if (cache->entries[victim].dirty && ff_diskio_cache_flush(cache) != RES_OK) {
+        return -1;
+    }
+    cache->entries[victim].valid = false;
+    entry_touch(cache, victim);
+    return victim;
+}
+
+static DRESULT cache_read_sector(ff_diskio_cache_t* cache, BYTE* buff, DWORD sector)
+{
+    int idx = cache_find(cache, sector);
+    if (idx >= 0) {
+        memcpy(buff, entry_data(cache, idx), cache->sector_size);
+        entry_touch(cache, idx);
+        // Hits of other sectors (e.g. of the FAT while a file is read) don't break the sequential stream
+        if (sector == cache->next_sector) {
+            cache->next_sector = sector + 1;
+        }
+        return RES_OK;
+    }
+
+    // Read ahead if this read continues the previous one, up to the next cached sector or the end of the drive
+    UINT count = 1;
+    if (sector == cache->next_sector && cache->drive_sectors > sector) {
+        count = MIN(cache->burst, cache->drive_sectors - sector);
+        for (UINT i = 1; i < count; i++) {
+            if (cache_find(cache, sector + i) >= 0) {
+                count = i;
+                break;
+            }
+        }
+    }
+
+    // Take the victims first, evicting a dirty entry uses burst_buf
+    UINT victims[CACHE_MAX_BURST];
+    for (UINT i = 0; i < count; i++) {
+        idx = cache_take_victim(cache);
+        if (idx < 0) {
+            return RES_ERROR;
+        }
+        victims[i] = idx;
+    }
+
+    BYTE* dst = (count == 1) ? entry_data(cache, victims[0]) : cache->burst_buf;
+    DRESULT res = cache->impl->read(cache->pdrv, dst, sector, count);
+    if (res != RES_OK) {
+        for (UINT i = 0; i < count; i++) {
+            cache->entries[victims[i]].last_use = 0;
+        }
+        return res;
+    }
+    for (UINT i = 0; i < count; i++) {
+        cache_entry_t* entry = &cache->entries[victims[i]];
+        if (count > 1) {
+            memcpy(entry_data(cache, victims[i]), cache->burst_buf + i * cache->sector_size, cache->sector_size);
+        }
+        entry->sector = sector + i;
+        entry->valid = true;
+        entry->dirty = false;
+    }
+    // the requested sector is the most recently used one
+    entry_touch(cache, victims[0]);
+    memcpy(buff, entry_data(cache, victims[0]), cache->sector_size);
+    cache->next_sector = sector + 1;
+    return RES_OK;
+}
+
+DRESULT ff_diskio_cache_read(ff_diskio_cache_t* cache, BYTE* buff, DWORD sector, UINT count)
+{
+    if (count == 1) {
+        return cache_read_sector(cache, buff, sector);
+    }
+
+    // Multi-sector reads are mostly file data read into the user buffer, don't let them evict the cache.
+    // Read the runs of sectors which are not cached directly, copy the cached ones (they may be dirty).
+    const DWORD end = sector + count;
+    DWORD s = sector;
+    while (s < end) {
+        BYTE* dst = buff + (s - sector) * cache->sector_size;
+        int idx = cache_find(cache, s);
+        if (idx >= 0) {
+            memcpy(dst, entry_data(cache, idx), cache->sector_size);
+            s++;
+            continue;
+        }
+        DWORD run_end = s + 1;
+        while (run_end < end && cache_find(cache, run_end) < 0) {
+            run_end++;
+        }
+        DRESULT res = cache->impl->read(cache->pdrv, dst, s, run_end - s);
+        if (res != RES_OK) {
+            return res;
+        }
+        s = run_end;
+    }
+    cache->next_sector = end;
+    return RES_OK;
+}
+
+DRESULT ff_diskio_cache_write(ff_diskio_cache_t* cache, const BYTE* buff, DWORD sector, UINT count)
+{
+    if (count == 1) {
+        int idx = cache_find(cache, sector);
+        if (idx < 0) {
+            idx = cache_take_victim(cache);
+            if (idx < 0) {
+                return RES_ERROR;
+            }
+            cache->entries[idx].sector = sector;
+            cache->entries[idx].valid = true;
+        } else {
+            entry_touch(cache, idx);
+        }
+        memcpy(entry_data(cache, idx), buff, cache->sector_size);
+        cache->entries[idx].dirty = true;
+        return RES_OK;
+    }
+
+    // Write multi-sector writes through, and update the cached copies of the written sectors
+    DRESULT res = cache->impl->write(cache->pdrv, buff, sector, count);
+    if (res != RES_OK) {
+        return res;
+    }
+    for (UINT i = 0; i < cache->entry_count; i++) {
+        cache_entry_t* entry = &cache->entries[i];
+        if (entry->valid && entry->sector >= sector && entry->sector < sector + count) {
+            memcpy(entry_data(cache, i), buff + (entry->sector - sector) * cache->sector_size, cache->sector_size);
+            entry->dirty = false;
+        }
+    }
+    return RES_OK;
+}
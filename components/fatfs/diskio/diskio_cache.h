@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "diskio_impl.h"
+
+/**
+ * Sector cache placed between FatFS and a diskio driver, see CONFIG_FATFS_DISK_CACHE_SECTORS.
+ *
+ * - Single sector reads are cached. When a read continues the previous one, the following
+ *   sectors are read ahead in the same driver call.
+ * - Multi-sector reads go to the driver directly, except for the sectors found in the cache.
+ * - Single sector writes are kept in the cache until ff_diskio_cache_flush is called or
+ *   the entry is evicted. Dirty sectors with consecutive numbers are written in one driver call.
+ * - Multi-sector writes go to the driver directly, cached copies of the sectors are updated.
+ *
+ * The functions are not thread safe, FatFS calls them with the volume locked.
+ */
+typedef struct ff_diskio_cache ff_diskio_cache_t;
+
+/**
+ * Create a sector cache for a drive
+ *
+ * @param impl          diskio driver of the drive
+ * @param pdrv          drive number
+ * @param sector_count  number of sectors to cache
+ * @param burst         maximum number of sectors read ahead or written back in one driver call
+ *
+ * @return the cache, or NULL if out of memory or the driver doesn't report the sector size
+ */
+ff_diskio_cache_t* ff_diskio_cache_create(const ff_diskio_impl_t* impl, BYTE pdrv, UINT sector_count, UINT burst);
+
+/**
+ * Delete a sector cache, without writing the dirty sectors
+ */
+void ff_diskio_cache_delete(ff_diskio_cache_t* cache);
+
+/**
+ * Number of sectors the cache was created with
+ */
+UINT ff_diskio_cache_sector_count(const ff_diskio_cache_t* cache);
+
+DRESULT ff_diskio_cache_read(ff_diskio_cache_t* cache, BYTE* buff, DWORD sector, UINT count);
+
+DRESULT ff_diskio_cache_write(ff_diskio_cache_t* cache, const BYTE* buff, DWORD sector, UINT count);
+
+/**
+ * Write all dirty sectors to the drive
+ */
+DRESULT ff_diskio_cache_flush(ff_diskio_cache_t* cache);
+
+#ifdef __cplusplus
+}
+#endif
@@ -55,6 +55,22 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl);
 
 #define ff_diskio_unregister(pdrv_) ff_diskio_register(pdrv_, NULL)
 
+/**
+ * Set the number of sectors cached for given drive number.
+ *
+ * The default is CONFIG_FATFS_DISK_CACHE_SECTORS. The new size takes effect when
+ * FATFS initializes the drive the next time, i.e. when the volume is mounted.
+ * Dirty sectors are written to the drive on f_sync, f_close and when the drive
+ * is unregistered.
+ *
+ * @param pdrv drive number
+ * @param sector_count number of sectors to cache, 0 to disable the cache
+ *
+ * @return  ESP_OK              on success
+ *          ESP_ERR_INVALID_ARG if the drive number is not valid
+ */
+esp_err_t ff_diskio_set_cache_size(BYTE pdrv, UINT sector_count);
+
 
 /**
  * Get next available drive number
@@ -467,6 +467,44 @@ void test_fatfs_link_rename(const char* filename_prefix)
     TEST_ASSERT_EQUAL(0, fclose(fdst));
 }
 
+void test_fatfs_copy_file(const char* filename_prefix)
+{
+    char name_src[64];
+    char name_dst[64];
+    char name_missing[64];
+    snprintf(name_src, sizeof(name_src), "%s_src.bin", filename_prefix);
+    snprintf(name_dst, sizeof(name_dst), "%s_dst.bin", filename_prefix);
+    snprintf(name_missing, sizeof(name_missing), "%s_none.bin", filename_prefix);
+
+    unlink(name_src);
+    unlink(name_dst);
+
+    // larger than the copy buffer, and not a multiple of the sector size
+    const size_t size = 100 * 1024 + 123;
+    FILE* f = fopen(name_src, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    for (size_t i = 0; i < size; ++i) {
+        TEST_ASSERT_NOT_EQUAL(EOF, fputc((int) (i * 7 + i / 511), f));
+    }
+    TEST_ASSERT_EQUAL(0, fclose(f));
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_vfs_fat_copy_file(name_src, name_dst));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_fat_copy_file(name_src, name_dst));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, esp_vfs_fat_copy_file(name_missing, name_dst));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_fat_copy_file("/nonexistent/file", name_dst));
+
+    f = fopen(name_dst, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    for (size_t i = 0; i < size; ++i) {
+        TEST_ASSERT_EQUAL_HEX8((uint8_t) (i * 7 + i / 511), fgetc(f));
+    }
+    TEST_ASSERT_EQUAL(EOF, fgetc(f));
+    TEST_ASSERT_EQUAL(0, fclose(f));
+
+    TEST_ASSERT_EQUAL(0, unlink(name_src));
+    TEST_ASSERT_EQUAL(0, unlink(name_dst));
+}
+
 void test_fatfs_mkdir_rmdir(const char* filename_prefix)
 {
     char name_dir1[64];
@@ -59,6 +59,8 @@ void test_fatfs_unlink(const char* filename);
 
 void test_fatfs_link_rename(const char* filename_prefix);
 
+void test_fatfs_copy_file(const char* filename_prefix);
+
 void test_fatfs_concurrent(const char* filename_prefix);
 
 void test_fatfs_mkdir_rmdir(const char* filename_prefix);
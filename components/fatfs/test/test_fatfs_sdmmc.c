@@ -171,6 +171,13 @@ TEST_CASE("(SD) link copies a file, rename moves a file", "[fatfs][test_env=UT_T
     test_teardown();
 }
 
+TEST_CASE("(SD) esp_vfs_fat_copy_file copies a file", "[fatfs][test_env=UT_T1_SDMODE][timeout=60]")
+{
+    test_setup();
+    test_fatfs_copy_file("/sdcard/copy");
+    test_teardown();
+}
+
 TEST_CASE("(SD) can create and remove directories", "[fatfs][test_env=UT_T1_SDMODE][timeout=60]")
 {
     test_setup();
@@ -146,6 +146,13 @@ TEST_CASE("(WL) link copies a file, rename moves a file", "[fatfs][wear_levellin
     test_teardown();
 }
 
+TEST_CASE("(WL) esp_vfs_fat_copy_file copies a file", "[fatfs][wear_levelling]")
+{
+    test_setup();
+    test_fatfs_copy_file("/spiflash/copy");
+    test_teardown();
+}
+
 TEST_CASE("(WL) can create and remove directories", "[fatfs][wear_levelling]")
 {
     test_setup();
@@ -13,3 +13,5 @@
 #define CONFIG_SPI_FLASH_USE_LEGACY_IMPL 1
 
 #define CONFIG_FATFS_VOLUME_COUNT 2
+#define CONFIG_FATFS_DISK_CACHE_SECTORS 0
+#define CONFIG_FATFS_DISK_CACHE_BURST_SECTORS 4
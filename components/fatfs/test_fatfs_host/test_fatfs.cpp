@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "ff.h"
 #include "esp_partition.h"
@@ -91,3 +92,268 @@ TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
     free(read);
     free(data);
 }
+
+// RAM drive counting the driver calls, to test the sector cache of diskio.c
+static const UINT s_ram_sector_size = 512;
+static const DWORD s_ram_sector_count = 256;
+static BYTE s_ram_drive[s_ram_sector_size * s_ram_sector_count];
+static int s_ram_reads, s_ram_writes;
+
+static DSTATUS ram_initialize(BYTE pdrv)
+{
+    return 0;
+}
+
+static DSTATUS ram_status(BYTE pdrv)
+{
+    return 0;
+}
+
+static DRESULT ram_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    REQUIRE(sector + count <= s_ram_sector_count);
+    memcpy(buff, s_ram_drive + sector * s_ram_sector_size, count * s_ram_sector_size);
+    s_ram_reads++;
+    return RES_OK;
+}
+
+static DRESULT ram_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    REQUIRE(sector + count <= s_ram_sector_count);
+    memcpy(s_ram_drive + sector * s_ram_sector_size, buff, count * s_ram_sector_size);
+    s_ram_writes++;
+    return RES_OK;
+}
+
+static DRESULT ram_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    switch (cmd) {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *((DWORD *) buff) = s_ram_sector_count;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *((WORD *) buff) = s_ram_sector_size;
+        return RES_OK;
+    }
+    return RES_ERROR;
+}
+
+static const ff_diskio_impl_t s_ram_impl = {
+    .init = &ram_initialize,
+    .status = &ram_status,
+    .read = &ram_read,
+    .write = &ram_write,
+    .ioctl = &ram_ioctl
+};
+
+TEST_CASE("sector cache reads ahead and coalesces writes", "[fatfs][cache]")
+{
+    BYTE pdrv;
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    ff_diskio_register(pdrv, &s_ram_impl);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, 8) == ESP_OK);
+    REQUIRE(disk_initialize(pdrv) == 0);
+
+    for (DWORD i = 0; i < s_ram_sector_count; i++) {
+        memset(s_ram_drive + i * s_ram_sector_size, (BYTE) i, s_ram_sector_size);
+    }
+    BYTE buf[s_ram_sector_size * 4];
+
+    // sequential single sector reads: the first one is read alone, then 4 sectors per driver call
+    s_ram_reads = 0;
+    for (DWORD i = 10; i < 19; i++) {
+        REQUIRE(disk_read(pdrv, buf, i, 1) == RES_OK);
+        REQUIRE(buf[0] == (BYTE) i);
+        REQUIRE(buf[s_ram_sector_size - 1] == (BYTE) i);
+    }
+    CHECK(s_ram_reads == 3);
+
+    // cached sectors are not read again
+    REQUIRE(disk_read(pdrv, buf, 12, 1) == RES_OK);
+    CHECK(s_ram_reads == 3);
+
+    // single sector writes stay in the cache until sync, consecutive sectors are written together
+    s_ram_writes = 0;
+    for (DWORD i : {40, 41, 42, 50, 40}) {
+        memset(buf, 0xA0 + (i & 0xf), s_ram_sector_size);
+        REQUIRE(disk_write(pdrv, buf, i, 1) == RES_OK);
+    }
+    CHECK(s_ram_writes == 0);
+    CHECK(s_ram_drive[40 * s_ram_sector_size] == 40);
+
+    // a multi-sector read sees the dirty sectors
+    REQUIRE(disk_read(pdrv, buf, 39, 4) == RES_OK);
+    CHECK(buf[0] == 39);
+    CHECK(buf[s_ram_sector_size] == 0xA8);
+    CHECK(buf[2 * s_ram_sector_size] == 0xA9);
+    CHECK(buf[3 * s_ram_sector_size] == 0xAA);
+
+    REQUIRE(disk_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(s_ram_writes == 2);
+    CHECK(s_ram_drive[40 * s_ram_sector_size] == 0xA8);
+    CHECK(s_ram_drive[42 * s_ram_sector_size] == 0xAA);
+    CHECK(s_ram_drive[50 * s_ram_sector_size] == 0xA2);
+
+    // a multi-sector write goes to the drive and updates the cached copy
+    memset(buf, 0x55, sizeof(buf));
+    REQUIRE(disk_write(pdrv, buf, 49, 2) == RES_OK);
+    CHECK(s_ram_writes == 3);
+    REQUIRE(disk_read(pdrv, buf, 50, 1) == RES_OK);
+    CHECK(buf[0] == 0x55);
+
+    // dirty sectors are written when the drive is unregistered
+    memset(buf, 0x77, s_ram_sector_size);
+    REQUIRE(disk_write(pdrv, buf, 100, 1) == RES_OK);
+    ff_diskio_unregister(pdrv);
+    CHECK(s_ram_drive[100 * s_ram_sector_size] == 0x77);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, CONFIG_FATFS_DISK_CACHE_SECTORS) == ESP_OK);
+}
+
+TEST_CASE("sector cache matches the drive contents under random access", "[fatfs][cache]")
+{
+    BYTE pdrv;
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    ff_diskio_register(pdrv, &s_ram_impl);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, 8) == ESP_OK);
+    REQUIRE(disk_initialize(pdrv) == 0);
+
+    static BYTE reference[sizeof(s_ram_drive)];
+    memset(s_ram_drive, 0, sizeof(s_ram_drive));
+    memset(reference, 0, sizeof(reference));
+    BYTE buf[s_ram_sector_size * 4];
+
+    srand(1);
+    for (int i = 0; i < 20000; i++) {
+        UINT count = (rand() % 4 == 0) ? 1 + rand() % 4 : 1;
+        // access a small area mostly, so that the cache is hit, and evicted
+        DWORD sector = (rand() % 2) ? rand() % 24 : rand() % (s_ram_sector_count - count);
+        if (rand() % 2) {
+            for (UINT j = 0; j < count * s_ram_sector_size; j += 4) {
+                *(uint32_t *) (buf + j) = rand();
+            }
+            REQUIRE(disk_write(pdrv, buf, sector, count) == RES_OK);
+            memcpy(reference + sector * s_ram_sector_size, buf, count * s_ram_sector_size);
+        } else {
+            REQUIRE(disk_read(pdrv, buf, sector, count) == RES_OK);
+            REQUIRE(memcmp(reference + sector * s_ram_sector_size, buf, count * s_ram_sector_size) == 0);
+        }
+        if (i % 1000 == 0) {
+            REQUIRE(disk_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK);
+            REQUIRE(memcmp(reference, s_ram_drive, sizeof(reference)) == 0);
+        }
+    }
+    ff_diskio_unregister(pdrv);
+    REQUIRE(memcmp(reference, s_ram_drive, sizeof(reference)) == 0);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, CONFIG_FATFS_DISK_CACHE_SECTORS) == ESP_OK);
+}
+
+// Wear levelling driver functions of diskio_wl.c, wrapped to count the calls
+extern "C" DRESULT ff_wl_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+extern "C" DRESULT ff_wl_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+extern "C" DRESULT ff_wl_ioctl(BYTE pdrv, BYTE cmd, void *buff);
+static int s_wl_reads, s_wl_writes;
+
+static DRESULT counting_wl_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    s_wl_reads++;
+    return ff_wl_read(pdrv, buff, sector, count);
+}
+
+static DRESULT counting_wl_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    s_wl_writes++;
+    return ff_wl_write(pdrv, buff, sector, count);
+}
+
+/* Runs a sequential and a random workload on a FAT volume on the wear levelled flash,
+   prints the number of driver calls. Each write call erases the written flash sectors. */
+static void bench_workloads(UINT cache_sectors)
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+    wl_handle_t wl_handle;
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    BYTE pdrv;
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    // same driver, with counting read and write functions
+    static const ff_diskio_impl_t counting_impl = {
+        .init = [](BYTE pdrv) -> DSTATUS { return 0; },
+        .status = [](BYTE pdrv) -> DSTATUS { return 0; },
+        .read = &counting_wl_read,
+        .write = &counting_wl_write,
+        .ioctl = &ff_wl_ioctl
+    };
+    ff_diskio_register(pdrv, &counting_impl);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, cache_sectors) == ESP_OK);
+
+    FATFS fs;
+    FIL file;
+    UINT bw;
+    BYTE work_area[FF_MAX_SS];
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    REQUIRE(f_mkfs(drv, FM_ANY, 0, work_area, sizeof(work_area)) == FR_OK);
+    REQUIRE(f_mount(&fs, drv, 1) == FR_OK);
+
+    const size_t file_size = 256 * 1024;
+    const size_t chunk = 128;
+    char path[16];
+    snprintf(path, sizeof(path), "%s/seq.bin", drv);
+    char data[chunk];
+    memset(data, 0x5a, sizeof(data));
+
+    s_wl_reads = s_wl_writes = 0;
+    REQUIRE(f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    for (size_t i = 0; i < file_size; i += chunk) {
+        REQUIRE(f_write(&file, data, chunk, &bw) == FR_OK);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    int write_reads = s_wl_reads, write_writes = s_wl_writes;
+
+    s_wl_reads = s_wl_writes = 0;
+    REQUIRE(f_open(&file, path, FA_READ) == FR_OK);
+    for (size_t i = 0; i < file_size; i += chunk) {
+        REQUIRE(f_read(&file, data, chunk, &bw) == FR_OK);
+        REQUIRE(bw == chunk);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    int read_reads = s_wl_reads;
+
+    // random small writes into a few files, synced every 16 writes
+    s_wl_reads = s_wl_writes = 0;
+    FIL files[4];
+    for (int i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "%s/r%d.bin", drv, i);
+        REQUIRE(f_open(&files[i], path, FA_CREATE_ALWAYS | FA_WRITE | FA_READ) == FR_OK);
+    }
+    srand(2);
+    for (int i = 0; i < 2000; i++) {
+        FIL *f = &files[rand() % 4];
+        REQUIRE(f_lseek(f, rand() % (32 * 1024)) == FR_OK);
+        REQUIRE(f_write(f, data, 1 + rand() % chunk, &bw) == FR_OK);
+        if (i % 16 == 15) {
+            REQUIRE(f_sync(f) == FR_OK);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(f_close(&files[i]) == FR_OK);
+    }
+
+    printf("cache %2u sectors: sequential write %4d reads %4d writes, sequential read %4d reads, "
+           "random write %4d reads %4d writes\n",
+           cache_sectors, write_reads, write_writes, read_reads, s_wl_reads, s_wl_writes);
+
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    ff_diskio_unregister(pdrv);
+    REQUIRE(ff_diskio_set_cache_size(pdrv, CONFIG_FATFS_DISK_CACHE_SECTORS) == ESP_OK);
+    wl_unmount(wl_handle);
+}
+
+TEST_CASE("sector cache effect on sequential and random workloads", "[fatfs][cache][bench]")
+{
+    for (UINT cache_sectors : {0, 4, 16}) {
+        bench_workloads(cache_sectors);
+    }
+}
@@ -68,6 +68,28 @@ esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive,
  */
 esp_err_t esp_vfs_fat_unregister_path(const char* base_path);
 
+/**
+ * @brief Copy a file on FAT filesystems registered in VFS
+ *
+ * The destination file is allocated in one block of contiguous clusters when
+ * the filesystem has such a free block, then the data is copied using a buffer
+ * of several clusters. This is faster than copying with read() and write(), and
+ * the copy doesn't fragment the FAT. link() on a FAT filesystem uses this function.
+ *
+ * The source and the destination may be on different FAT filesystems.
+ *
+ * @param src  path of the file to copy, including the base path (e.g. "/spiflash/log.txt")
+ * @param dst  path of the new file, including the base path. The file must not exist.
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if a path is not on a FAT filesystem registered in VFS
+ *      - ESP_ERR_NOT_FOUND if the source file doesn't exist
+ *      - ESP_ERR_INVALID_STATE if the destination file already exists
+ *      - ESP_ERR_NO_MEM if not enough memory
+ *      - ESP_FAIL on other errors, including a full filesystem
+ */
+esp_err_t esp_vfs_fat_copy_file(const char* src, const char* dst);
+
 
 /**
  * @brief Configuration arguments for esp_vfs_fat_sdmmc_mount and esp_vfs_fat_spiflash_mount functions
@@ -11,6 +11,7 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/lock.h>
+#include <sys/param.h>
 #include "esp_vfs.h"
 #include "esp_log.h"
 #include "ff.h"
@@ -57,6 +58,15 @@ typedef union {
 
 static const char* TAG = "vfs_fat";
 
+/* Largest buffer used by esp_vfs_fat_copy_file and link(), smaller buffers are used for smaller files or if memory is short */
+#define FAT_COPY_BUF_SIZE_MAX   (32 * 1024)
+
+#if FF_MAX_SS != FF_MIN_SS
+#define FAT_SECTOR_SIZE(fs)     ((fs)->ssize)
+#else
+#define FAT_SECTOR_SIZE(fs)     FF_MAX_SS
+#endif
+
 static ssize_t vfs_fat_write(void* p, int fd, const void * data, size_t size);
 static off_t vfs_fat_lseek(void* p, int fd, off_t size, int mode);
 static ssize_t vfs_fat_read(void* ctx, int fd, void * dst, size_t size);
@@ -98,6 +108,29 @@ static size_t find_context_index_by_path(const char* base_path)
     return FF_VOLUMES;
 }
 
+/* Returns the context of the filesystem which contains the VFS path, and the path relative to its base path */
+static vfs_fat_ctx_t* find_context_by_vfs_path(const char* path, const char** out_path)
+{
+    vfs_fat_ctx_t* found = NULL;
+    size_t found_len = 0;
+    for(size_t i=0; i<FF_VOLUMES; i++) {
+        vfs_fat_ctx_t* ctx = s_fat_ctxs[i];
+        if (ctx == NULL) {
+            continue;
+        }
+        size_t len = strlen(ctx->base_path);
+        if (strncmp(path, ctx->base_path, len) == 0 && path[len] == '/' &&
+                (found == NULL || len > found_len)) {
+            found = ctx;
+            found_len = len;
+        }
+    }
+    if (found) {
+        *out_path = path + found_len;
+    }
+    return found;
+}
+
 static size_t find_unused_context_index(void)
 {
     for(size_t i=0; i<FF_VOLUMES; i++) {
@@ -286,6 +319,137 @@ static void prepend_drive_to_path(vfs_fat_ctx_t * ctx, const char ** path, const
     }
 }
 
+static FRESULT open_with_drive(vfs_fat_ctx_t* ctx, FIL* fp, const char* path, BYTE mode)
+{
+    _lock_acquire(&ctx->lock);
+    prepend_drive_to_path(ctx, &path, NULL);
+    FRESULT res = f_open(fp, path, mode);
+    _lock_release(&ctx->lock);
+    return res;
+}
+
+/**
+ * @brief Copy a file to a new file, possibly on another filesystem
+ *
+ * The clusters of the new file are allocated in one contiguous block if possible,
+ * then the data is copied in chunks of up to FAT_COPY_BUF_SIZE_MAX bytes. As the chunks
+ * are made of whole sectors, FatFS reads and writes them without its sector buffer,
+ * with one disk operation per cluster. The contexts are only locked while the files
+ * are opened.
+ *
+ * @param src_ctx context of the source file
+ * @param src path of the source file, relative to the base path of src_ctx
+ * @param dst_ctx context of the new file
+ * @param dst path of the new file, relative to the base path of dst_ctx
+ */
+static FRESULT copy_file(vfs_fat_ctx_t* src_ctx, const char* src, vfs_fat_ctx_t* dst_ctx, const char* dst)
+{
+    FRESULT res;
+    void* buf = NULL;
+    FIL* pf1 = (FIL*) ff_memalloc(sizeof(FIL));
+    FIL* pf2 = (FIL*) ff_memalloc(sizeof(FIL));
+    if (pf1 == NULL || pf2 == NULL) {
+        ESP_LOGD(TAG, "alloc failed, pf1=%p, pf2=%p", pf1, pf2);
+        res = FR_NOT_ENOUGH_CORE;
+        goto fail1;
+    }
+    memset(pf1, 0, sizeof(*pf1));
+    memset(pf2, 0, sizeof(*pf2));
+    res = open_with_drive(src_ctx, pf1, src, FA_READ | FA_OPEN_EXISTING);
+    if (res != FR_OK) {
+        goto fail1;
+    }
+    res = open_with_drive(dst_ctx, pf2, dst, FA_WRITE | FA_CREATE_NEW);
+    if (res != FR_OK) {
+        goto fail2;
+    }
+
+    const FSIZE_t size = f_size(pf1);
+    if (size > 0) {
+        res = f_expand(pf2, size, 1);
+        if (res == FR_DENIED) {
+            // No free block of contiguous clusters is large enough, f_write will allocate the clusters
+            ESP_LOGD(TAG, "%s: no contiguous space for %u bytes", __func__, (unsigned) size);
+            res = FR_OK;
+        } else if (res != FR_OK) {
+            goto fail3;
+        }
+    }
+
+    const size_t sector_size = FAT_SECTOR_SIZE(&dst_ctx->fs);
+    size_t buf_size = MIN(FAT_COPY_BUF_SIZE_MAX, (size + sector_size - 1) / sector_size * sector_size);
+    buf_size = MAX(buf_size, sector_size);
+    while ((buf = ff_memalloc(buf_size)) == NULL && buf_size > sector_size) {
+        buf_size = MAX(sector_size, buf_size / 2 / sector_size * sector_size);
+    }
+    if (buf == NULL) {
+        res = FR_NOT_ENOUGH_CORE;
+        goto fail3;
+    }
+
+    FSIZE_t size_left = size;
+    while (size_left > 0) {
+        UINT will_copy = (size_left < buf_size) ? (UINT) size_left : (UINT) buf_size;
+        UINT read;
+        res = f_read(pf1, buf, will_copy, &read);
+        if (res != FR_OK) {
+            goto fail3;
+        } else if (read != will_copy) {
+            res = FR_DISK_ERR;
+            goto fail3;
+        }
+        UINT written;
+        res = f_write(pf2, buf, will_copy, &written);
+        if (res != FR_OK) {
+            goto fail3;
+        } else if (written != will_copy) {
+            res = FR_DISK_ERR;
+            goto fail3;
+        }
+        size_left -= will_copy;
+    }
+fail3:
+    if (f_close(pf2) != FR_OK && res == FR_OK) {
+        res = FR_DISK_ERR;
+    }
+    if (res != FR_OK) {
+        // Don't leave a partial copy behind, after f_expand it would have the size of the source
+        _lock_acquire(&dst_ctx->lock);
+        prepend_drive_to_path(dst_ctx, &dst, NULL);
+        f_unlink(dst);
+        _lock_release(&dst_ctx->lock);
+    }
+fail2:
+    f_close(pf1);
+fail1:
+    free(buf);
+    free(pf2);
+    free(pf1);
+    if (res != FR_OK) {
+        ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+    }
+    return res;
+}
+
+esp_err_t esp_vfs_fat_copy_file(const char* src, const char* dst)
+{
+    const char* src_path;
+    const char* dst_path;
+    vfs_fat_ctx_t* src_ctx = find_context_by_vfs_path(src, &src_path);
+    vfs_fat_ctx_t* dst_ctx = find_context_by_vfs_path(dst, &dst_path);
+    if (src_ctx == NULL || dst_ctx == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    switch (copy_file(src_ctx, src_path, dst_ctx, dst_path)) {
+        case FR_OK:                 return ESP_OK;
+        case FR_NO_FILE:
+        case FR_NO_PATH:            return ESP_ERR_NOT_FOUND;
+        case FR_EXIST:              return ESP_ERR_INVALID_STATE;
+        case FR_NOT_ENOUGH_CORE:    return ESP_ERR_NO_MEM;
+        default:                    return ESP_FAIL;
+    }
+}
+
 static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
 {
     ESP_LOGV(TAG, "%s: path=\"%s\", flags=%x, mode=%x", __func__, path, flags, mode);
@@ -621,65 +785,8 @@ static int vfs_fat_unlink(void* ctx, const char *path)
 static int vfs_fat_link(void* ctx, const char* n1, const char* n2)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
-    _lock_acquire(&fat_ctx->lock);
-    prepend_drive_to_path(fat_ctx, &n1, &n2);
-    const size_t copy_buf_size = fat_ctx->fs.csize;
-    FRESULT res;
-    FIL* pf1 = (FIL*) ff_memalloc(sizeof(FIL));
-    FIL* pf2 = (FIL*) ff_memalloc(sizeof(FIL));
-    void* buf = ff_memalloc(copy_buf_size);
-    if (buf == NULL || pf1 == NULL || pf2 == NULL) {
-        _lock_release(&fat_ctx->lock);
-        ESP_LOGD(TAG, "alloc failed, pf1=%p, pf2=%p, buf=%p", pf1, pf2, buf);
-        free(pf1);
-        free(pf2);
-        free(buf);
-        errno = ENOMEM;
-        return -1;
-    }
-    memset(pf1, 0, sizeof(*pf1));
-    memset(pf2, 0, sizeof(*pf2));
-    res = f_open(pf1, n1, FA_READ | FA_OPEN_EXISTING);
+    FRESULT res = copy_file(fat_ctx, n1, fat_ctx, n2);
     if (res != FR_OK) {
-        _lock_release(&fat_ctx->lock);
-        goto fail1;
-    }
-    res = f_open(pf2, n2, FA_WRITE | FA_CREATE_NEW);
-    _lock_release(&fat_ctx->lock);
-    if (res != FR_OK) {
-        goto fail2;
-    }
-    size_t size_left = f_size(pf1);
-    while (size_left > 0) {
-        size_t will_copy = (size_left < copy_buf_size) ? size_left : copy_buf_size;
-        size_t read;
-        res = f_read(pf1, buf, will_copy, &read);
-        if (res != FR_OK) {
-            goto fail3;
-        } else if (read != will_copy) {
-            res = FR_DISK_ERR;
-            goto fail3;
-        }
-        size_t written;
-        res = f_write(pf2, buf, will_copy, &written);
-        if (res != FR_OK) {
-            goto fail3;
-        } else if (written != will_copy) {
-            res = FR_DISK_ERR;
-            goto fail3;
-        }
-        size_left -= will_copy;
-    }
-fail3:
-    f_close(pf2);
-fail2:
-    f_close(pf1);
-fail1:
-    free(buf);
-    free(pf2);
-    free(pf1);
-    if (res != FR_OK) {
-        ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
         return -1;
     }
@@ -27,6 +27,26 @@ typedef uint32_t TickType_t;
 
 typedef int portMUX_TYPE;
 
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portMUX_INITIALIZE(mux)         (*(mux) = portMUX_INITIALIZER_UNLOCKED)
+
+/* There are no interrupts on Linux, critical sections only need to keep other threads out */
+static inline void vPortEnterCriticalLinux(portMUX_TYPE *mux)
+{
+    while (__atomic_exchange_n(mux, 1, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline void vPortExitCriticalLinux(portMUX_TYPE *mux)
+{
+    __atomic_store_n(mux, portMUX_INITIALIZER_UNLOCKED, __ATOMIC_RELEASE);
+}
+
+#define portENTER_CRITICAL(mux)         vPortEnterCriticalLinux(mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCriticalLinux(mux)
+#define portENTER_CRITICAL_ISR(mux)     vPortEnterCriticalLinux(mux)
+#define portEXIT_CRITICAL_ISR(mux)      vPortExitCriticalLinux(mux)
+
 #define portTICK_PERIOD_MS			( ( TickType_t ) 1 )
 
 #ifdef __cplusplus
@@ -80,6 +80,59 @@ bool heap_caps_match(const heap_t *heap, uint32_t caps)
     return heap->heap != NULL && ((get_all_caps(heap) & caps) == caps);
 }
 
+/* Allocate from a heap, going through its per-CPU cache for small sizes */
+IRAM_ATTR static inline void *heap_malloc(heap_t *heap, size_t size)
+{
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    if (heap->cache != NULL && size <= MULTI_HEAP_CACHE_MAX_SIZE) {
+        return multi_heap_cache_malloc(heap->cache, size);
+    }
+#endif
+    return multi_heap_malloc(heap->heap, size);
+}
+
+IRAM_ATTR static inline void heap_free(heap_t *heap, void *ptr)
+{
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    if (heap->cache != NULL && multi_heap_cache_free(heap->cache, ptr)) {
+        return;
+    }
+#endif
+    multi_heap_free(heap->heap, ptr);
+}
+
+/* Give the blocks held in the caches of all heaps with the given caps back to their heaps.
+   Returns true if anything was released, so that a failed allocation is worth retrying. */
+IRAM_ATTR static bool heap_caps_flush_caches(uint32_t caps)
+{
+    bool released = false;
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        if (heap->cache != NULL && heap_caps_match(heap, caps)) {
+            released |= (multi_heap_cache_flush(heap->cache) > 0);
+        }
+    }
+#endif
+    return released;
+}
+
+/* Get info for a single heap, counting cached blocks as free */
+static void heap_get_info(heap_t *heap, multi_heap_info_t *info)
+{
+    multi_heap_get_info(heap->heap, info);
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    if (heap->cache != NULL) {
+        multi_heap_cache_stats_t stats;
+        multi_heap_cache_get_stats(heap->cache, &stats);
+        info->total_free_bytes += stats.cached_bytes;
+        info->total_allocated_bytes -= MIN(stats.cached_bytes, info->total_allocated_bytes);
+        info->free_blocks += stats.cached_blocks;
+        info->allocated_blocks -= MIN(stats.cached_blocks, info->allocated_blocks);
+    }
+#endif
+}
+
 
 /*
 This function should not be called directly as it does not
@@ -136,7 +189,7 @@ IRAM_ATTR static void *heap_caps_malloc_base( size_t size, uint32_t caps)
                         }
                     } else {
                         //Just try to alloc, nothing special.
-                        ret = multi_heap_malloc(heap->heap, size);
+                        ret = heap_malloc(heap, size);
                         if (ret != NULL) {
                             return ret;
                         }
@@ -146,6 +199,11 @@ IRAM_ATTR static void *heap_caps_malloc_base( size_t size, uint32_t caps)
         }
     }
 
+    //Small free blocks held by the per-CPU caches may be what is in the way, release them and try again.
+    if (heap_caps_flush_caches(caps)) {
+        return heap_caps_malloc_base(size, caps);
+    }
+
     //Nothing usable found.
     return NULL;
 }
@@ -329,7 +387,7 @@ IRAM_ATTR void heap_caps_free( void *ptr)
 
     heap_t *heap = find_containing_heap(ptr);
     assert(heap != NULL && "free() target pointer is outside heap areas");
-    multi_heap_free(heap->heap, ptr);
+    heap_free(heap, ptr);
 }
 
 /*
@@ -456,6 +514,13 @@ size_t heap_caps_get_free_size( uint32_t caps )
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
             ret += multi_heap_free_size(heap->heap);
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+            if (heap->cache != NULL) {
+                multi_heap_cache_stats_t stats;
+                multi_heap_cache_get_stats(heap->cache, &stats);
+                ret += stats.cached_bytes;
+            }
+#endif
         }
     }
     return ret;
@@ -488,7 +553,7 @@ void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps )
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
             multi_heap_info_t hinfo;
-            multi_heap_get_info(heap->heap, &hinfo);
+            heap_get_info(heap, &hinfo);
 
             info->total_free_bytes += hinfo.total_free_bytes;
             info->total_allocated_bytes += hinfo.total_allocated_bytes;
@@ -509,7 +574,7 @@ void heap_caps_print_heap_info( uint32_t caps )
     heap_t *heap;
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
-            multi_heap_get_info(heap->heap, &info);
+            heap_get_info(heap, &info);
 
             printf("  At 0x%08x len %d free %d allocated %d min_free %d\n",
                    heap->start, heap->end - heap->start, info.total_free_bytes, info.total_allocated_bytes, info.minimum_free_bytes);
@@ -620,6 +685,10 @@ IRAM_ATTR void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t
         }
     }
 
+    if (heap_caps_flush_caches(caps)) {
+        return heap_caps_aligned_alloc(alignment, size, caps);
+    }
+
     heap_caps_alloc_failed(size, caps, __func__);
 
     //Nothing usable found.
@@ -37,6 +37,17 @@ static void register_heap(heap_t *region)
     }
 }
 
+/* Put a per-CPU cache of small blocks in front of byte-accessible heaps */
+static void enable_heap_cache(heap_t *heap)
+{
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    heap->cache = NULL;
+    if (heap_caps_match(heap, MALLOC_CAP_8BIT)) {
+        heap->cache = multi_heap_cache_create(heap->heap, CONFIG_HEAP_ALLOC_CACHE_SIZE);
+    }
+#endif
+}
+
 void heap_caps_enable_nonos_stack_heaps(void)
 {
     heap_t *heap;
@@ -47,6 +58,7 @@ void heap_caps_enable_nonos_stack_heaps(void)
             register_heap(heap);
             if (heap->heap != NULL) {
                 multi_heap_set_lock(heap->heap, &heap->heap_mux);
+                enable_heap_cache(heap);
             }
         }
     }
@@ -144,6 +156,7 @@ void heap_caps_init(void)
         if (heaps_array[i].heap != NULL) {
             multi_heap_set_lock(heaps_array[i].heap, &heaps_array[i].heap_mux);
         }
+        enable_heap_cache(&heaps_array[i]);
         if (i == 0) {
             SLIST_INSERT_HEAD(&registered_heaps, &heaps_array[0], next);
         } else {
@@ -222,6 +235,7 @@ esp_err_t heap_caps_add_region_with_caps(const uint32_t caps[], intptr_t start,
         goto done;
     }
     multi_heap_set_lock(p_new->heap, &p_new->heap_mux);
+    enable_heap_cache(p_new);
 
     /* (This insertion is atomic to registered_heaps, so
        we don't need to worry about thread safety for readers,
@@ -0,0 +1,264 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/param.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+#include "multi_heap.h"
+#include "multi_heap_internal.h"
+#include "multi_heap_platform.h"
+#include "multi_heap_config.h"
+
+/*
+This file implements pools of fixed-size objects on top of the capabilities-based allocator. A pool takes memory
+from the heap in slabs holding a number of object slots, and keeps its free slots in a singly linked list threaded
+through the slots themselves, so that allocating and freeing an object is a push or pop under the pool's spinlock.
+
+Each slot starts with a word naming the pool it belongs to, with the low bit set while the slot is free. This lets
+heap_caps_pool_free() reject pointers which aren't objects handed out by the pool, including objects freed twice,
+in constant time.
+
+With heap poisoning enabled each slot has room for the same head and tail canaries as a heap block, and objects are
+checked when they are given back to the pool.
+*/
+
+#define ALIGN_UP(num, align) (((num) + ((align) - 1)) & ~((align) - 1))
+
+#define POOL_SLOT_FREE  1
+
+typedef struct pool_slot {
+    uintptr_t owner;            // pool handle, ORed with POOL_SLOT_FREE while the slot is free
+    struct pool_slot *next;     // while the slot is free, overlaps the object otherwise
+} pool_slot_t;
+
+typedef struct pool_slab {
+    struct pool_slab *next;
+} pool_slab_t;
+
+struct heap_caps_pool {
+    multi_heap_lock_t lock;
+    pool_slot_t *free_list;
+    pool_slab_t *slabs;
+    uint32_t caps;
+    size_t obj_size;
+    size_t slot_size;       // object size plus owner word and poisoning overhead, aligned
+    size_t slab_count;      // slots per slab
+    size_t max_count;       // 0 if the pool can grow without limit
+    size_t total_objects;
+    size_t growing_objects; // slots of slabs being allocated by heap_caps_pool_alloc()
+    size_t free_objects;
+    size_t peak_used_objects;
+    size_t slab_total;
+    size_t failed_allocs;
+};
+
+static inline size_t pool_overhead(void)
+{
+#ifdef MULTI_HEAP_POISONING
+    return multi_heap_internal_poison_overhead();
+#else
+    return 0;
+#endif
+}
+
+/* Offset of an object within its slot */
+static inline size_t pool_obj_offset(void)
+{
+#ifdef MULTI_HEAP_POISONING
+    return sizeof(uintptr_t) + multi_heap_internal_poison_head_size();
+#else
+    return sizeof(uintptr_t);
+#endif
+}
+
+/* Allocate a slab from the heap and thread its slots together. Returns the first slot, *last is set to the last one. */
+IRAM_ATTR static pool_slab_t *slab_create(heap_caps_pool_handle_t pool, pool_slot_t **first, pool_slot_t **last)
+{
+    size_t header_size = ALIGN_UP(sizeof(pool_slab_t), sizeof(void *));
+    pool_slab_t *slab = heap_caps_malloc(header_size + pool->slot_size * pool->slab_count, pool->caps);
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    uint8_t *slots = (uint8_t *)slab + header_size;
+#ifdef MULTI_HEAP_POISONING_SLOW
+    multi_heap_internal_poison_fill_region(slots, pool->slot_size * pool->slab_count, true);
+#endif
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        pool_slot_t *slot = (pool_slot_t *)(slots + i * pool->slot_size);
+        slot->owner = (uintptr_t)pool | POOL_SLOT_FREE;
+        slot->next = (i + 1 < pool->slab_count) ? (pool_slot_t *)(slots + (i + 1) * pool->slot_size) : NULL;
+    }
+    *first = (pool_slot_t *)slots;
+    *last = (pool_slot_t *)(slots + (pool->slab_count - 1) * pool->slot_size);
+    return slab;
+}
+
+heap_caps_pool_handle_t heap_caps_pool_create_growable(size_t obj_size, size_t slab_count, size_t max_count, uint32_t caps)
+{
+    if (obj_size == 0 || slab_count == 0 || (max_count != 0 && max_count < slab_count)) {
+        return NULL;
+    }
+
+    size_t slot_size = ALIGN_UP(MAX(sizeof(uintptr_t) + obj_size + pool_overhead(), sizeof(pool_slot_t)), sizeof(void *));
+    if (slot_size < obj_size || slab_count > (SIZE_MAX - sizeof(pool_slab_t)) / slot_size) {
+        return NULL;
+    }
+
+    // The pool's spinlock may be taken with the flash cache disabled, keep it in internal RAM
+    heap_caps_pool_handle_t pool = heap_caps_calloc(1, sizeof(struct heap_caps_pool), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    MULTI_HEAP_LOCK_INIT(&pool->lock);
+    pool->caps = caps;
+    pool->obj_size = obj_size;
+    pool->slot_size = slot_size;
+    pool->slab_count = slab_count;
+    pool->max_count = max_count;
+
+    pool_slot_t *first, *last;
+    pool_slab_t *slab = slab_create(pool, &first, &last);
+    if (slab == NULL) {
+        heap_caps_free(pool);
+        return NULL;
+    }
+    slab->next = NULL;
+    pool->slabs = slab;
+    pool->free_list = first;
+    pool->total_objects = slab_count;
+    pool->free_objects = slab_count;
+    pool->slab_total = 1;
+    return pool;
+}
+
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, size_t count, uint32_t caps)
+{
+    return heap_caps_pool_create_growable(obj_size, count, count, caps);
+}
+
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    assert(pool->free_objects == pool->total_objects && "pool deleted with objects in use");
+
+    pool_slab_t *slab = pool->slabs;
+    while (slab != NULL) {
+        pool_slab_t *next = slab->next;
+        heap_caps_free(slab);
+        slab = next;
+    }
+    heap_caps_free(pool);
+}
+
+IRAM_ATTR static inline pool_slot_t *pool_pop(heap_caps_pool_handle_t pool)
+{
+    pool_slot_t *slot = pool->free_list;
+    if (slot != NULL) {
+        pool->free_list = slot->next;
+        slot->owner = (uintptr_t)pool;
+        pool->free_objects--;
+        size_t used = pool->total_objects - pool->free_objects;
+        if (used > pool->peak_used_objects) {
+            pool->peak_used_objects = used;
+        }
+    }
+    return slot;
+}
+
+IRAM_ATTR void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool)
+{
+    bool grow = false;
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    pool_slot_t *slot = pool_pop(pool);
+    if (slot == NULL && (pool->max_count == 0
+                         || pool->total_objects + pool->growing_objects + pool->slab_count <= pool->max_count)) {
+        // Reserve the room for the new slab now, so concurrent callers don't overshoot max_count
+        pool->growing_objects += pool->slab_count;
+        grow = true;
+    }
+    MULTI_HEAP_UNLOCK(&pool->lock);
+
+    if (grow) {
+        pool_slot_t *first, *last;
+        pool_slab_t *slab = slab_create(pool, &first, &last);
+
+        MULTI_HEAP_LOCK(&pool->lock);
+        pool->growing_objects -= pool->slab_count;
+        if (slab != NULL) {
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->slab_total++;
+            last->next = pool->free_list;
+            pool->free_list = first;
+            pool->total_objects += pool->slab_count;
+            pool->free_objects += pool->slab_count;
+            slot = pool_pop(pool);
+        }
+        MULTI_HEAP_UNLOCK(&pool->lock);
+    }
+
+    if (slot == NULL) {
+        MULTI_HEAP_LOCK(&pool->lock);
+        pool->failed_allocs++;
+        MULTI_HEAP_UNLOCK(&pool->lock);
+        return NULL;
+    }
+
+#ifdef MULTI_HEAP_POISONING
+    return multi_heap_internal_poison_object((uint8_t *)slot + sizeof(uintptr_t), pool->obj_size);
+#else
+    return (uint8_t *)slot + sizeof(uintptr_t);
+#endif
+}
+
+IRAM_ATTR esp_err_t heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr)
+{
+    if (ptr == NULL) {
+        return ESP_OK;
+    }
+    if ((uintptr_t)ptr % sizeof(void *) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pool_slot_t *slot = (pool_slot_t *)((uint8_t *)ptr - pool_obj_offset());
+    MULTI_HEAP_LOCK(&pool->lock);
+    // Not an object of this pool, or one which is already free
+    if (slot->owner != (uintptr_t)pool) {
+        MULTI_HEAP_UNLOCK(&pool->lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+#ifdef MULTI_HEAP_POISONING
+    multi_heap_internal_unpoison_object(ptr);
+#endif
+    slot->owner = (uintptr_t)pool | POOL_SLOT_FREE;
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+    pool->free_objects++;
+    MULTI_HEAP_UNLOCK(&pool->lock);
+    return ESP_OK;
+}
+
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, heap_caps_pool_info_t *info)
+{
+    MULTI_HEAP_LOCK(&pool->lock);
+    info->obj_size = pool->obj_size;
+    info->total_objects = pool->total_objects;
+    info->free_objects = pool->free_objects;
+    info->peak_used_objects = pool->peak_used_objects;
+    info->slabs = pool->slab_total;
+    info->failed_allocs = pool->failed_allocs;
+    MULTI_HEAP_UNLOCK(&pool->lock);
+}
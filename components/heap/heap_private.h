@@ -18,6 +18,7 @@
 #include <soc/soc_memory_layout.h>
 #include "multi_heap.h"
 #include "multi_heap_platform.h"
+#include "multi_heap_cache.h"
 #include "sys/queue.h"
 
 #ifdef __cplusplus
@@ -37,6 +38,9 @@ typedef struct heap_t_ {
     intptr_t end;
     multi_heap_lock_t heap_mux;
     multi_heap_handle_t heap;
+#ifdef CONFIG_HEAP_ALLOC_CACHE
+    multi_heap_cache_t *cache; ///< Per-CPU cache of small free blocks, NULL if the heap has none
+#endif
     SLIST_ENTRY(heap_t_) next;
 } heap_t;
 
@@ -13,12 +13,14 @@
 // limitations under the License.
 #include <string.h>
 #include <sdkconfig.h>
+#include <sys/param.h>
 
 #define HEAP_TRACE_SRCFILE /* don't warn on inclusion here */
 #include "esp_heap_trace.h"
 #undef HEAP_TRACE_SRCFILE
 
 #include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -32,6 +34,9 @@ static bool tracing;
 static heap_trace_mode_t mode;
 
 /* Buffer used for records, starting at offset 0
+
+   The records in use are buffer[0..count), not in the order they were logged:
+   a record freed in leak trace mode is replaced by the last one in the buffer.
 */
 static heap_trace_record_t *buffer;
 static size_t total_records;
@@ -42,6 +47,71 @@ static size_t total_records;
 */
 static size_t count;
 
+/* Index of the records, allocated by heap_trace_init_standalone().
+
+   The records are linked in the order they were logged, from 'head' (oldest)
+   to 'tail'. The hash table maps the addresses of the allocations which haven't
+   been freed to their records, using linear probing. It is at least twice as
+   large as the buffer, so lookups stay short even with a full buffer.
+*/
+#define INDEX_NONE      UINT16_MAX
+#define INDEX_MAX_RECORDS (INDEX_NONE - 1)
+
+typedef struct {
+    uint16_t prev;
+    uint16_t next;
+} record_link_t;
+
+static record_link_t *links;
+static uint16_t *hash_table;
+static size_t hash_mask;
+static unsigned hash_shift;
+static uint16_t head = INDEX_NONE;
+static uint16_t tail = INDEX_NONE;
+
+/* Position of the last record returned by heap_trace_get(), so that
+   reading the records in order doesn't walk the list from the start
+   every time. Reset whenever the list changes. */
+static size_t cursor_index;
+static uint16_t cursor_slot = INDEX_NONE;
+
+/* Statistics of the call sites in HEAP_TRACE_SUMMARY mode, allocated by
+   heap_trace_start(). The sites are in the order they first allocated memory,
+   'site_hash' maps call stacks to them like 'hash_table' maps addresses to
+   records.
+*/
+#define SITES_MAX CONFIG_HEAP_TRACING_SUMMARY_SITES
+
+static heap_trace_site_t *sites;
+static uint16_t *site_hash;
+static size_t site_hash_mask;
+static unsigned site_hash_shift;
+static size_t site_count;
+
+/* Allocations from call sites which didn't fit in the table */
+static size_t site_misses;
+
+/* Allocations not freed when their records were evicted from the full buffer in
+   HEAP_TRACE_SUMMARY mode, so that their frees are still counted by their call
+   sites. Allocated with the call sites, it's a hash table of the addresses using
+   linear probing, at most half full.
+*/
+#define EVICTED_MAX CONFIG_HEAP_TRACING_SUMMARY_EVICTED
+
+typedef struct {
+    void *address;      /* NULL if the entry is empty */
+    size_t size;
+    uint16_t site;
+} evicted_t;
+
+static evicted_t *evicted;
+static size_t evicted_mask;
+static unsigned evicted_shift;
+static size_t evicted_count;
+
+/* Evicted allocations which didn't fit in the table, their frees are missed */
+static size_t evicted_misses;
+
 /* Actual number of allocations logged */
 static size_t total_allocations;
 
@@ -56,23 +126,112 @@ esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t
     if (tracing) {
         return ESP_ERR_INVALID_STATE;
     }
+    if (num_records > INDEX_MAX_RECORDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Not traced, as tracing is stopped */
+    heap_caps_free(links);
+    heap_caps_free(sites);
+    sites = NULL;
+    evicted = NULL;
+    evicted_count = 0;
+    links = NULL;
+    hash_table = NULL;
+    buffer = NULL;
+    total_records = 0;
+    count = 0;
+    head = INDEX_NONE;
+    tail = INDEX_NONE;
+    cursor_slot = INDEX_NONE;
+    if (record_buffer == NULL || num_records == 0) {
+        return ESP_OK;
+    }
+
+    size_t hash_size = 2;
+    hash_shift = 31;
+    while (hash_size < 2 * num_records) {
+        hash_size <<= 1;
+        hash_shift--;
+    }
+    /* Accessed with the interrupts disabled, like the buffer */
+    links = heap_caps_malloc(num_records * sizeof(record_link_t) + hash_size * sizeof(uint16_t),
+                             MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (links == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    hash_table = (uint16_t *)&links[num_records];
+    hash_mask = hash_size - 1;
+
     buffer = record_buffer;
     total_records = num_records;
     memset(buffer, 0, num_records * sizeof(heap_trace_record_t));
     return ESP_OK;
 }
 
+static void clear_records(void);
+
+static esp_err_t alloc_sites(void)
+{
+    size_t hash_size = 2;
+    unsigned hash_shift = 31;
+    while (hash_size < 2 * SITES_MAX) {
+        hash_size <<= 1;
+        hash_shift--;
+    }
+    size_t evicted_size = 2;
+    unsigned evicted_size_shift = 31;
+    while (evicted_size < 2 * EVICTED_MAX) {
+        evicted_size <<= 1;
+        evicted_size_shift--;
+    }
+    /* Allocated while tracing may be running, it's set up with trace_mux held */
+    heap_trace_site_t *new_sites = heap_caps_malloc(SITES_MAX * sizeof(heap_trace_site_t)
+                                                    + evicted_size * sizeof(evicted_t)
+                                                    + hash_size * sizeof(uint16_t),
+                                                    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (new_sites == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&trace_mux);
+    if (sites == NULL) {
+        sites = new_sites;
+        evicted = (evicted_t *)&sites[SITES_MAX];
+        evicted_mask = evicted_size - 1;
+        evicted_shift = evicted_size_shift;
+        site_hash = (uint16_t *)&evicted[evicted_size];
+        site_hash_mask = hash_size - 1;
+        site_hash_shift = hash_shift;
+        new_sites = NULL;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+    heap_caps_free(new_sites);
+    return ESP_OK;
+}
+
 esp_err_t heap_trace_start(heap_trace_mode_t mode_param)
 {
     if (buffer == NULL || total_records == 0) {
         return ESP_ERR_INVALID_STATE;
     }
+    if (mode_param == HEAP_TRACE_SUMMARY && sites == NULL && alloc_sites() != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
 
     portENTER_CRITICAL(&trace_mux);
 
     tracing = false;
     mode = mode_param;
-    count = 0;
+    clear_records();
+    if (sites != NULL) {
+        site_count = 0;
+        site_misses = 0;
+        memset(site_hash, 0xff, (site_hash_mask + 1) * sizeof(uint16_t));
+        evicted_count = 0;
+        evicted_misses = 0;
+        memset(evicted, 0, (evicted_mask + 1) * sizeof(evicted_t));
+    }
     total_allocations = 0;
     total_frees = 0;
     has_overflowed = false;
@@ -117,7 +276,16 @@ esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
     if (index >= count) {
         result = ESP_ERR_INVALID_ARG; /* out of range for 'count' */
     } else {
-        memcpy(record, &buffer[index], sizeof(heap_trace_record_t));
+        /* Walk the list from the last record returned if it's not past the one asked for */
+        if (cursor_slot == INDEX_NONE || cursor_index > index) {
+            cursor_index = 0;
+            cursor_slot = head;
+        }
+        while (cursor_index < index) {
+            cursor_slot = links[cursor_slot].next;
+            cursor_index++;
+        }
+        memcpy(record, &buffer[cursor_slot], sizeof(heap_trace_record_t));
     }
     portEXIT_CRITICAL(&trace_mux);
     return result;
@@ -132,9 +300,10 @@ void heap_trace_dump(void)
            count, total_records);
     size_t start_count = count;
     for (int i = 0; i < count; i++) {
-        heap_trace_record_t *rec = &buffer[i];
+        heap_trace_record_t record;
+        heap_trace_record_t *rec = &record;
 
-        if (rec->address != NULL) {
+        if (heap_trace_get(i, rec) == ESP_OK && rec->address != NULL) {
             printf("%d bytes (@ %p) allocated CPU %d ccount 0x%08x caller ",
                    rec->size, rec->address, rec->ccount & 1, rec->ccount & ~3);
             for (int j = 0; j < STACK_DEPTH && rec->alloced_by[j] != 0; j++) {
@@ -170,6 +339,257 @@ void heap_trace_dump(void)
     }
 }
 
+esp_err_t heap_trace_summary_get(size_t index, heap_trace_site_t *site)
+{
+    if (site == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sites == NULL || mode != HEAP_TRACE_SUMMARY) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t result = ESP_OK;
+
+    portENTER_CRITICAL(&trace_mux);
+    if (index >= site_count) {
+        result = ESP_ERR_INVALID_ARG; /* out of range for 'site_count' */
+    } else {
+        memcpy(site, &sites[index], sizeof(heap_trace_site_t));
+    }
+    portEXIT_CRITICAL(&trace_mux);
+    return result;
+}
+
+void heap_trace_summary_dump(void)
+{
+    if (sites == NULL || mode != HEAP_TRACE_SUMMARY) {
+        printf("No call site statistics, heap tracing wasn't started in HEAP_TRACE_SUMMARY mode\n");
+        return;
+    }
+
+    size_t num_sites = site_count;
+    size_t live_size = 0;
+    size_t prev = 0;
+    size_t prev_bytes = 0;
+    printf("%u call sites (%u site table)\n", num_sites, SITES_MAX);
+    for (size_t n = 0; n < num_sites; n++) {
+        /* The sites are ordered by live bytes, largest first, then by index. Each one is found by
+           a scan for the first after the previous one, rather than sorted in a shared array, so
+           that dumps can run concurrently. The order may be off if tracing is running. */
+        size_t next = SIZE_MAX;
+        size_t next_bytes = 0;
+        for (size_t i = 0; i < num_sites; i++) {
+            size_t bytes = sites[i].live_bytes;
+            bool after_prev = n == 0 || bytes < prev_bytes || (bytes == prev_bytes && i > prev);
+            if (after_prev && (next == SIZE_MAX || bytes > next_bytes)) {
+                next = i;
+                next_bytes = bytes;
+            }
+        }
+        heap_trace_site_t site;
+        if (next == SIZE_MAX || heap_trace_summary_get(next, &site) != ESP_OK) {
+            break;
+        }
+        prev = next;
+        prev_bytes = next_bytes;
+        live_size += site.live_bytes;
+        printf("%u bytes live (peak %u) in %u allocations (%u freed) caller ",
+               site.live_bytes, site.peak_bytes, site.alloc_count, site.free_count);
+        for (int j = 0; j < STACK_DEPTH && site.alloced_by[j] != 0; j++) {
+            printf("%p%s", site.alloced_by[j],
+                   (j < STACK_DEPTH - 1) ? ":" : "");
+        }
+        printf("\n");
+    }
+    printf("%u bytes live in trace\n", live_size);
+    printf("total allocations %u total frees %u\n", total_allocations, total_frees);
+    if (site_misses) {
+        printf("(NB: Site table is full, %u allocations from other call sites were not counted.)\n", site_misses);
+    }
+    if (evicted_misses) {
+        printf("(NB: Buffer and evicted allocation table have overflowed, frees of %u allocations were missed, so live bytes may be too high.)\n", evicted_misses);
+    } else if (has_overflowed) {
+        printf("(NB: Buffer has overflowed, the oldest allocations are only counted in their call sites.)\n");
+    }
+}
+
+static IRAM_ATTR size_t index_hash(const void *address)
+{
+    /* Fibonacci hashing, the low bits of the address are mostly the same */
+    return ((uint32_t)(uintptr_t)address * 2654435769u) >> hash_shift;
+}
+
+/* Position of the address in the hash table, SIZE_MAX if it isn't there */
+static IRAM_ATTR size_t index_find(const void *address)
+{
+    for (size_t pos = index_hash(address); hash_table[pos] != INDEX_NONE; pos = (pos + 1) & hash_mask) {
+        if (buffer[hash_table[pos]].address == address) {
+            return pos;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/* Make the address of the record at 'slot' map to it. An address logged
+   before and not freed since (while tracing) maps to the newest record. */
+static IRAM_ATTR void index_insert(uint16_t slot)
+{
+    const void *address = buffer[slot].address;
+    size_t pos = index_hash(address);
+    while (hash_table[pos] != INDEX_NONE && buffer[hash_table[pos]].address != address) {
+        pos = (pos + 1) & hash_mask;
+    }
+    hash_table[pos] = slot;
+}
+
+/* Remove the entry at 'pos' from the hash table, moving back the following
+   entries of the probe sequence so that lookups don't stop early */
+static IRAM_ATTR void index_delete(size_t pos)
+{
+    for (size_t next = (pos + 1) & hash_mask; hash_table[next] != INDEX_NONE; next = (next + 1) & hash_mask) {
+        size_t home = index_hash(buffer[hash_table[next]].address);
+        if (((next - home) & hash_mask) >= ((next - pos) & hash_mask)) {
+            hash_table[pos] = hash_table[next];
+            pos = next;
+        }
+    }
+    hash_table[pos] = INDEX_NONE;
+}
+
+/* Remove the address of the record at 'slot' from the hash table, if it maps to it */
+static IRAM_ATTR void index_remove(uint16_t slot)
+{
+    size_t pos = index_find(buffer[slot].address);
+    if (pos != SIZE_MAX && hash_table[pos] == slot) {
+        index_delete(pos);
+    }
+}
+
+static IRAM_ATTR void list_append(uint16_t slot)
+{
+    links[slot].prev = tail;
+    links[slot].next = INDEX_NONE;
+    if (tail != INDEX_NONE) {
+        links[tail].next = slot;
+    } else {
+        head = slot;
+    }
+    tail = slot;
+    cursor_slot = INDEX_NONE;
+}
+
+static IRAM_ATTR void list_unlink(uint16_t slot)
+{
+    if (links[slot].prev != INDEX_NONE) {
+        links[links[slot].prev].next = links[slot].next;
+    } else {
+        head = links[slot].next;
+    }
+    if (links[slot].next != INDEX_NONE) {
+        links[links[slot].next].prev = links[slot].prev;
+    } else {
+        tail = links[slot].prev;
+    }
+    cursor_slot = INDEX_NONE;
+}
+
+static IRAM_ATTR size_t site_hash_pos(void * const *callers)
+{
+    uint32_t hash = 0;
+    for (int i = 0; i < STACK_DEPTH; i++) {
+        hash = (hash ^ (uint32_t)(uintptr_t)callers[i]) * 16777619u;
+    }
+    return (hash * 2654435769u) >> site_hash_shift;
+}
+
+/* Call site statistics of a call stack, added to the table if 'add' is set
+   and it isn't full. NULL if there are none. */
+static IRAM_ATTR heap_trace_site_t *find_site(void * const *callers, bool add)
+{
+    size_t pos = site_hash_pos(callers);
+    while (site_hash[pos] != INDEX_NONE) {
+        heap_trace_site_t *site = &sites[site_hash[pos]];
+        if (memcmp(site->alloced_by, callers, sizeof(void *) * STACK_DEPTH) == 0) {
+            return site;
+        }
+        pos = (pos + 1) & site_hash_mask;
+    }
+    if (!add || site_count == SITES_MAX) {
+        return NULL;
+    }
+
+    heap_trace_site_t *site = &sites[site_count];
+    memset(site, 0, sizeof(heap_trace_site_t));
+    memcpy(site->alloced_by, callers, sizeof(void *) * STACK_DEPTH);
+    site_hash[pos] = site_count++;
+    return site;
+}
+
+static IRAM_ATTR size_t evicted_hash(const void *address)
+{
+    return ((uint32_t)(uintptr_t)address * 2654435769u) >> evicted_shift;
+}
+
+/* Position of the address in the evicted allocation table, SIZE_MAX if it isn't there */
+static IRAM_ATTR size_t evicted_find(const void *address)
+{
+    for (size_t pos = evicted_hash(address); evicted[pos].address != NULL; pos = (pos + 1) & evicted_mask) {
+        if (evicted[pos].address == address) {
+            return pos;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/* Remove the entry at 'pos' from the evicted allocation table, as index_delete() does */
+static IRAM_ATTR void evicted_delete(size_t pos)
+{
+    for (size_t next = (pos + 1) & evicted_mask; evicted[next].address != NULL; next = (next + 1) & evicted_mask) {
+        size_t home = evicted_hash(evicted[next].address);
+        if (((next - home) & evicted_mask) >= ((next - pos) & evicted_mask)) {
+            evicted[pos] = evicted[next];
+            pos = next;
+        }
+    }
+    evicted[pos].address = NULL;
+    evicted_count--;
+}
+
+/* Keep the allocation of the record at 'slot', about to be evicted from the buffer,
+   in the evicted allocation table so that its free is counted by its call site */
+static IRAM_ATTR void evicted_insert(uint16_t slot)
+{
+    size_t pos = index_find(buffer[slot].address);
+    if (pos == SIZE_MAX || hash_table[pos] != slot) {
+        return; /* not the newest allocation at this address, its free was missed */
+    }
+    heap_trace_site_t *site = find_site(buffer[slot].alloced_by, false);
+    if (site == NULL) {
+        return;
+    }
+    if (evicted_count == EVICTED_MAX) {
+        evicted_misses++;
+        return;
+    }
+    pos = evicted_hash(buffer[slot].address);
+    while (evicted[pos].address != NULL) {
+        pos = (pos + 1) & evicted_mask;
+    }
+    evicted[pos].address = buffer[slot].address;
+    evicted[pos].size = buffer[slot].size;
+    evicted[pos].site = site - sites;
+    evicted_count++;
+}
+
+/* Called with trace_mux held */
+static void clear_records(void)
+{
+    count = 0;
+    head = INDEX_NONE;
+    tail = INDEX_NONE;
+    cursor_slot = INDEX_NONE;
+    memset(hash_table, 0xff, (hash_mask + 1) * sizeof(uint16_t));
+}
+
 /* Add a new allocation to the heap trace records */
 static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 {
@@ -179,28 +599,46 @@ static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 
     portENTER_CRITICAL(&trace_mux);
     if (tracing) {
+        uint16_t slot;
         if (count == total_records) {
             has_overflowed = true;
-            /* Move the whole buffer back one slot.
-
-               This is a bit slow, compared to treating this buffer as a ringbuffer and rotating a head pointer.
-
-               However, ringbuffer code gets tricky when we remove elements in mid-buffer (for leak trace mode) while
-               trying to keep track of an item count that may overflow.
-            */
-            memmove(&buffer[0], &buffer[1], sizeof(heap_trace_record_t) * (total_records -1));
-            count--;
+            /* Reuse the slot of the oldest record */
+            slot = head;
+            if (mode == HEAP_TRACE_SUMMARY) {
+                evicted_insert(slot);
+            }
+            index_remove(slot);
+            list_unlink(slot);
+        } else {
+            slot = count++;
         }
         // Copy new record into place
-        memcpy(&buffer[count], record, sizeof(heap_trace_record_t));
-        count++;
+        memcpy(&buffer[slot], record, sizeof(heap_trace_record_t));
+        list_append(slot);
+        index_insert(slot);
         total_allocations++;
+
+        if (mode == HEAP_TRACE_SUMMARY) {
+            /* An evicted allocation at the same address was freed while tracing was stopped */
+            size_t pos = evicted_count ? evicted_find(record->address) : SIZE_MAX;
+            if (pos != SIZE_MAX) {
+                evicted_delete(pos);
+            }
+            heap_trace_site_t *site = find_site(record->alloced_by, true);
+            if (site != NULL) {
+                site->alloc_count++;
+                site->live_bytes += record->size;
+                site->peak_bytes = MAX(site->peak_bytes, site->live_bytes);
+            } else {
+                site_misses++;
+            }
+        }
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
 // remove a record, used when freeing
-static void remove_record(int index);
+static void remove_record(uint16_t slot);
 
 /* record a free event in the heap trace log
 
@@ -214,39 +652,66 @@ static IRAM_ATTR void record_free(void *p, void **callers)
     }
 
     portENTER_CRITICAL(&trace_mux);
-    if (tracing && count > 0) {
+    if (tracing && (count > 0 || evicted_count > 0)) {
         total_frees++;
-        /* search backwards for the allocation record matching this free */
-        int i;
-        for (i = count - 1; i >= 0; i--) {
-            if (buffer[i].address == p) {
-                break;
+        /* look up the allocation record matching this free */
+        size_t pos = index_find(p);
+
+        if (pos != SIZE_MAX) {
+            uint16_t slot = hash_table[pos];
+            index_delete(pos);
+            if (mode == HEAP_TRACE_SUMMARY) {
+                heap_trace_site_t *site = find_site(buffer[slot].alloced_by, false);
+                if (site != NULL) {
+                    site->free_count++;
+                    site->live_bytes -= buffer[slot].size;
+                }
             }
-        }
-
-        if (i >= 0) {
             if (mode == HEAP_TRACE_ALL) {
-                memcpy(buffer[i].freed_by, callers, sizeof(void *) * STACK_DEPTH);
-            } else { // HEAP_TRACE_LEAKS
+                memcpy(buffer[slot].freed_by, callers, sizeof(void *) * STACK_DEPTH);
+            } else { // HEAP_TRACE_LEAKS or HEAP_TRACE_SUMMARY
                 // Leak trace mode, once an allocation is freed we remove it from the list
-                remove_record(i);
+                remove_record(slot);
+            }
+        } else if (mode == HEAP_TRACE_SUMMARY && evicted_count > 0) {
+            /* The allocation may have been evicted from the buffer */
+            pos = evicted_find(p);
+            if (pos != SIZE_MAX) {
+                heap_trace_site_t *site = &sites[evicted[pos].site];
+                site->free_count++;
+                site->live_bytes -= evicted[pos].size;
+                evicted_delete(pos);
             }
         }
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-/* remove the entry at 'index' from the ringbuffer of saved records */
-static IRAM_ATTR void remove_record(int index)
+/* remove the entry at 'slot' from the saved records, the last record in the buffer takes its place */
+static IRAM_ATTR void remove_record(uint16_t slot)
 {
-    if (index < count - 1) {
-        // Remove the buffer entry from the list
-        memmove(&buffer[index], &buffer[index+1],
-                sizeof(heap_trace_record_t) * (total_records - index - 1));
-    } else {
-        // For last element, just zero it out to avoid ambiguity
-        memset(&buffer[index], 0, sizeof(heap_trace_record_t));
+    uint16_t last = count - 1;
+    list_unlink(slot);
+    if (slot != last) {
+        size_t pos = index_find(buffer[last].address);
+        if (pos != SIZE_MAX && hash_table[pos] == last) {
+            hash_table[pos] = slot;
+        }
+        memcpy(&buffer[slot], &buffer[last], sizeof(heap_trace_record_t));
+        links[slot] = links[last];
+        if (links[slot].prev != INDEX_NONE) {
+            links[links[slot].prev].next = slot;
+        } else {
+            head = slot;
+        }
+        if (links[slot].next != INDEX_NONE) {
+            links[links[slot].next].prev = slot;
+        } else {
+            tail = slot;
+        }
     }
+    // Zero out the last element to avoid ambiguity
+    memset(&buffer[last], 0, sizeof(heap_trace_record_t));
     count--;
 }
 
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Handle to a pool of fixed-size objects
+ */
+typedef struct heap_caps_pool *heap_caps_pool_handle_t;
+
+/**
+ * @brief Statistics of an object pool
+ */
+typedef struct {
+    size_t obj_size;            ///< Size of each object, in bytes
+    size_t total_objects;       ///< Number of objects in all slabs of the pool
+    size_t free_objects;        ///< Number of objects available for allocation
+    size_t peak_used_objects;   ///< Largest number of objects in use at the same time
+    size_t slabs;               ///< Number of slabs allocated from the heap
+    size_t failed_allocs;       ///< Number of allocations which failed because the pool was exhausted
+} heap_caps_pool_info_t;
+
+/**
+ * @brief Create a pool of fixed-size objects
+ *
+ * All objects are allocated up front, in a single slab of memory with the given capabilities.
+ * Allocating and freeing objects from the pool takes constant time and doesn't touch the heap.
+ *
+ * When heap poisoning is enabled, every object is poisoned the same way as a heap allocation.
+ *
+ * @param obj_size Size of each object, in bytes
+ * @param count Number of objects in the pool
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory for the objects
+ *
+ * @return Handle to the pool, or NULL if the arguments are invalid or there is not enough memory
+ */
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, size_t count, uint32_t caps);
+
+/**
+ * @brief Create a pool of fixed-size objects which grows on demand
+ *
+ * Like heap_caps_pool_create(), but when all objects are in use another slab of ``slab_count`` objects
+ * is allocated from the heap, until the pool holds ``max_count`` objects. Slabs are kept until the pool
+ * is deleted.
+ *
+ * @param obj_size Size of each object, in bytes
+ * @param slab_count Number of objects allocated at once, including the first slab allocated here
+ * @param max_count Maximum number of objects in the pool, or 0 for no limit
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory for the objects
+ *
+ * @return Handle to the pool, or NULL if the arguments are invalid or there is not enough memory
+ */
+heap_caps_pool_handle_t heap_caps_pool_create_growable(size_t obj_size, size_t slab_count, size_t max_count, uint32_t caps);
+
+/**
+ * @brief Delete a pool and give its memory back to the heap
+ *
+ * All objects must have been freed before. Deleting a pool with objects in use is an error.
+ *
+ * @param pool Pool to delete
+ */
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from a pool
+ *
+ * This function can be called from an ISR, unless the pool has to grow.
+ *
+ * @param pool Pool to allocate from
+ *
+ * @return Pointer to an object of the pool's object size, or NULL if the pool is exhausted
+ */
+void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Give an object back to its pool
+ *
+ * A pointer which is not an object handed out by this pool, or an object which was already freed, is
+ * rejected, so that it can't end up on the pool's free list. The check takes constant time.
+ *
+ * @param pool Pool the object was allocated from
+ * @param ptr Object returned by heap_caps_pool_alloc(), or NULL
+ *
+ * @return
+ *      - ESP_OK The object was given back to the pool, or ptr is NULL
+ *      - ESP_ERR_INVALID_ARG ptr is not an object of this pool in use
+ */
+esp_err_t heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr);
+
+/**
+ * @brief Get statistics of a pool
+ *
+ * @param pool Pool to query
+ * @param info Pointer to a structure filled with the pool's statistics
+ */
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, heap_caps_pool_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -32,6 +32,7 @@ extern "C" {
 typedef enum {
     HEAP_TRACE_ALL,
     HEAP_TRACE_LEAKS,
+    HEAP_TRACE_SUMMARY,
 } heap_trace_mode_t;
 
 /**
@@ -45,6 +46,17 @@ typedef struct {
     void *freed_by[CONFIG_HEAP_TRACING_STACK_DEPTH];   ///< Call stack of the caller which freed the memory (all zero if not freed.)
 } heap_trace_record_t;
 
+/**
+ * @brief Call site statistics data type. Sums up the allocations made from one call stack, in HEAP_TRACE_SUMMARY mode.
+ */
+typedef struct {
+    void *alloced_by[CONFIG_HEAP_TRACING_STACK_DEPTH]; ///< Call stack of the allocations.
+    size_t live_bytes;    ///< Bytes allocated and not freed yet.
+    size_t peak_bytes;    ///< Highest value of live_bytes since heap tracing was started.
+    uint32_t alloc_count; ///< Number of allocations.
+    uint32_t free_count;  ///< Number of allocations freed.
+} heap_trace_site_t;
+
 /**
  * @brief Initialise heap tracing in standalone mode.
  *
@@ -52,12 +64,17 @@ typedef struct {
  *
  * To disable heap tracing and allow the buffer to be freed, stop tracing and then call heap_trace_init_standalone(NULL, 0);
  *
+ * @note An index of the records is allocated from internal memory, 8 to 12 bytes per record, so that the record of
+ * a freed address is found without searching the buffer.
+ *
  * @param record_buffer Provide a buffer to use for heap trace data. Must remain valid any time heap tracing is enabled, meaning
  * it must be allocated from internal memory not in PSRAM.
- * @param num_records Size of the heap trace buffer, as number of record structures.
+ * @param num_records Size of the heap trace buffer, as number of record structures. At most 65534.
  * @return
  *  - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing enabled in menuconfig.
  *  - ESP_ERR_INVALID_STATE Heap tracing is currently in progress.
+ *  - ESP_ERR_INVALID_ARG num_records is too large.
+ *  - ESP_ERR_NO_MEM Not enough memory for the index of the records.
  *  - ESP_OK Heap tracing initialised successfully.
  */
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records);
@@ -83,9 +100,13 @@ esp_err_t heap_trace_init_tohost(void);
  * @param mode Mode for tracing.
  * - HEAP_TRACE_ALL means all heap allocations and frees are traced.
  * - HEAP_TRACE_LEAKS means only suspected memory leaks are traced. (When memory is freed, the record is removed from the trace buffer.)
+ * - HEAP_TRACE_SUMMARY means the allocations are traced as for HEAP_TRACE_LEAKS, and statistics are kept for each call
+ *   stack allocating memory, see heap_trace_summary_dump(). The trace buffer only needs to hold the allocations not
+ *   freed. Standalone mode only.
  * @return
  * - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing enabled in menuconfig.
  * - ESP_ERR_INVALID_STATE A non-zero-length buffer has not been set via heap_trace_init_standalone().
+ * - ESP_ERR_NO_MEM Not enough memory for the call site statistics (HEAP_TRACE_SUMMARY mode).
  * - ESP_OK Tracing is started.
  */
 esp_err_t heap_trace_start(heap_trace_mode_t mode);
@@ -149,6 +170,33 @@ esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record);
  */
 void heap_trace_dump(void);
 
+/**
+ * @brief Return the statistics of a call site, in HEAP_TRACE_SUMMARY mode
+ *
+ * The call sites are numbered in the order they first allocated memory since heap_trace_start() was called.
+ *
+ * @note It is safe to call this function while heap tracing is running.
+ *
+ * @param index Index (zero-based) of the call site to return.
+ * @param[out] site Where the statistics of the call site will be copied.
+ * @return
+ * - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing enabled in menuconfig, or in host-based mode.
+ * - ESP_ERR_INVALID_STATE Heap tracing was not started in HEAP_TRACE_SUMMARY mode.
+ * - ESP_ERR_INVALID_ARG Index is out of bounds for the current number of call sites, or site is NULL.
+ * - ESP_OK Statistics returned successfully.
+ */
+esp_err_t heap_trace_summary_get(size_t index, heap_trace_site_t *site);
+
+/**
+ * @brief Dump the statistics of the call sites to stdout, in HEAP_TRACE_SUMMARY mode
+ *
+ * The call sites are sorted by the number of bytes they allocated and didn't free yet, largest first.
+ *
+ * @note It is safe to call this function while heap tracing is running, however the statistics may change while
+ * they are dumped unless heap tracing is stopped first.
+ */
+void heap_trace_summary_dump(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,6 +42,9 @@ void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size)
 size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
     __attribute__((alias("multi_heap_get_allocated_size_impl")));
 
+size_t multi_heap_internal_get_usable_size(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_get_allocated_size_impl")));
+
 multi_heap_handle_t multi_heap_register(void *start, size_t size)
     __attribute__((alias("multi_heap_register_impl")));
 
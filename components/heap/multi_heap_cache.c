@@ -0,0 +1,232 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/param.h>
+#include <multi_heap.h>
+#include "multi_heap_internal.h"
+#include "multi_heap_cache.h"
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Defines compile-time configuration macros */
+#include "multi_heap_config.h"
+
+#define CACHE_CLASS_SHIFT 4
+#define CACHE_CLASS_SIZE(CLASS) (((size_t)(CLASS) + 1) << CACHE_CLASS_SHIFT)
+#define CACHE_CLASS_COUNT (MULTI_HEAP_CACHE_MAX_SIZE >> CACHE_CLASS_SHIFT)
+
+/* Maximum number of blocks moved between a free list and the heap under one heap lock */
+#define CACHE_BATCH 8
+
+/* A cached block, the link lives in the (otherwise unused) block data */
+typedef struct cache_block {
+    struct cache_block *next;
+} cache_block_t;
+
+typedef struct {
+    cache_block_t *head;
+    size_t count;
+} cache_bin_t;
+
+typedef struct {
+    multi_heap_lock_t lock;
+    size_t bytes;
+    size_t blocks;
+    size_t hits;
+    size_t refills;
+    size_t drains;
+    cache_bin_t bins[CACHE_CLASS_COUNT];
+} cache_slot_t;
+
+struct multi_heap_cache {
+    multi_heap_handle_t heap;
+    size_t slot_capacity;
+    cache_slot_t slots[MULTI_HEAP_CACHE_SLOTS];
+};
+
+multi_heap_cache_t *multi_heap_cache_create(multi_heap_handle_t heap, size_t slot_capacity)
+{
+    if (heap == NULL) {
+        return NULL;
+    }
+
+    multi_heap_cache_t *cache = multi_heap_malloc(heap, sizeof(multi_heap_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(multi_heap_cache_t));
+    cache->heap = heap;
+    cache->slot_capacity = slot_capacity;
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        MULTI_HEAP_LOCK_INIT(&cache->slots[i].lock);
+    }
+    return cache;
+}
+
+static inline cache_slot_t *current_slot(multi_heap_cache_t *cache)
+{
+    return &cache->slots[MULTI_HEAP_CACHE_CURRENT_SLOT()];
+}
+
+/* With comprehensive poisoning, cached blocks hold the free pattern behind the link, like free heap memory,
+   so that writes to a block after it was freed are still caught when the block is handed out again */
+static inline void push_block(cache_slot_t *slot, cache_bin_t *bin, cache_block_t *block, size_t size)
+{
+#ifdef MULTI_HEAP_POISONING_SLOW
+    multi_heap_internal_poison_cached_block(block, size, sizeof(cache_block_t));
+#endif
+    block->next = bin->head;
+    bin->head = block;
+    bin->count++;
+    slot->blocks++;
+    slot->bytes += size;
+}
+
+/* Fill an empty free list with up to CACHE_BATCH blocks of the class size, taking the heap lock once.
+   Called with the slot locked. */
+static void refill_bin(multi_heap_cache_t *cache, cache_slot_t *slot, size_t class)
+{
+    cache_bin_t *bin = &slot->bins[class];
+    size_t class_size = CACHE_CLASS_SIZE(class);
+    /* Only take half of the room left, the blocks handed out are coming back to this slot */
+    size_t room = (slot->bytes < cache->slot_capacity) ? (cache->slot_capacity - slot->bytes) / (2 * class_size) : 0;
+    size_t count = MAX(1, MIN(room, CACHE_BATCH));
+
+    multi_heap_internal_lock(cache->heap);
+    for (size_t i = 0; i < count; i++) {
+        cache_block_t *block = multi_heap_malloc(cache->heap, class_size);
+        if (block == NULL) {
+            break;
+        }
+        push_block(slot, bin, block, multi_heap_internal_get_usable_size(cache->heap, block));
+    }
+    multi_heap_internal_unlock(cache->heap);
+    slot->refills++;
+}
+
+/* Give up to count blocks of a free list back to the heap, taking the heap lock once.
+   Called with the slot locked. */
+static void drain_bin(multi_heap_cache_t *cache, cache_slot_t *slot, cache_bin_t *bin, size_t count)
+{
+    multi_heap_internal_lock(cache->heap);
+    for (size_t i = 0; i < count && bin->head != NULL; i++) {
+        cache_block_t *block = bin->head;
+        bin->head = block->next;
+        bin->count--;
+        slot->blocks--;
+        slot->bytes -= multi_heap_internal_get_usable_size(cache->heap, block);
+        multi_heap_free(cache->heap, block);
+    }
+    multi_heap_internal_unlock(cache->heap);
+    slot->drains++;
+}
+
+void *multi_heap_cache_malloc(multi_heap_cache_t *cache, size_t size)
+{
+    if (size == 0 || size > MULTI_HEAP_CACHE_MAX_SIZE) {
+        return NULL;
+    }
+
+    size_t class = (size - 1) >> CACHE_CLASS_SHIFT;
+    cache_slot_t *slot = current_slot(cache);
+    cache_bin_t *bin = &slot->bins[class];
+
+    MULTI_HEAP_LOCK(&slot->lock);
+    if (bin->head != NULL) {
+        slot->hits++;
+    } else {
+        refill_bin(cache, slot, class);
+    }
+    cache_block_t *block = bin->head;
+    size_t block_size = 0;
+    if (block != NULL) {
+        block_size = multi_heap_internal_get_usable_size(cache->heap, block);
+        bin->head = block->next;
+        bin->count--;
+        slot->blocks--;
+        slot->bytes -= block_size;
+    }
+    MULTI_HEAP_UNLOCK(&slot->lock);
+
+    if (block == NULL) {
+        /* No block of the class size left in the heap, a smaller one may still fit */
+        return multi_heap_malloc(cache->heap, size);
+    }
+#ifdef MULTI_HEAP_POISONING_SLOW
+    multi_heap_internal_unpoison_cached_block(block, block_size, sizeof(cache_block_t));
+#else
+    (void)block_size;
+#endif
+    return block;
+}
+
+bool multi_heap_cache_free(multi_heap_cache_t *cache, void *p)
+{
+    size_t size = multi_heap_internal_get_usable_size(cache->heap, p);
+    if (size < CACHE_CLASS_SIZE(0) || size >= CACHE_CLASS_SIZE(CACHE_CLASS_COUNT)) {
+        return false;
+    }
+
+    /* A block goes to the largest class it can serve */
+    size_t class = (size >> CACHE_CLASS_SHIFT) - 1;
+    cache_slot_t *slot = current_slot(cache);
+    cache_bin_t *bin = &slot->bins[MIN(class, CACHE_CLASS_COUNT - 1)];
+    bool cached = false;
+
+    MULTI_HEAP_LOCK(&slot->lock);
+    if (slot->bytes + size > cache->slot_capacity && bin->count > 0) {
+        drain_bin(cache, slot, bin, MAX(1, bin->count / 2));
+    }
+    if (slot->bytes + size <= cache->slot_capacity) {
+        push_block(slot, bin, p, size);
+        cached = true;
+    }
+    MULTI_HEAP_UNLOCK(&slot->lock);
+
+    return cached;
+}
+
+size_t multi_heap_cache_flush(multi_heap_cache_t *cache)
+{
+    size_t released = 0;
+
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        MULTI_HEAP_LOCK(&slot->lock);
+        released += slot->bytes;
+        for (int class = 0; class < CACHE_CLASS_COUNT; class++) {
+            cache_bin_t *bin = &slot->bins[class];
+            if (bin->count > 0) {
+                drain_bin(cache, slot, bin, bin->count);
+            }
+        }
+        MULTI_HEAP_UNLOCK(&slot->lock);
+    }
+    return released;
+}
+
+void multi_heap_cache_get_stats(multi_heap_cache_t *cache, multi_heap_cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(multi_heap_cache_stats_t));
+
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        MULTI_HEAP_LOCK(&slot->lock);
+        stats->cached_bytes += slot->bytes;
+        stats->cached_blocks += slot->blocks;
+        stats->hits += slot->hits;
+        stats->refills += slot->refills;
+        stats->drains += slot->drains;
+        MULTI_HEAP_UNLOCK(&slot->lock);
+    }
+}
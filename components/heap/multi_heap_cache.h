@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multi_heap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-CPU cache of small free blocks, sitting in front of a multi_heap.
+
+   Each slot (one per CPU, or per thread on the host) keeps free lists of blocks sorted
+   into 16 byte size classes up to MULTI_HEAP_CACHE_MAX_SIZE. Allocations and frees of
+   small blocks only take the lock of the calling CPU's slot; the heap lock is taken
+   when a free list is refilled from, or drained back to, the heap, a batch at a time.
+
+   The cache works on top of the public multi_heap API, so heap poisoning still checks
+   every block handed out. Cached blocks stay allocated as far as the heap is concerned.
+*/
+
+/* Largest allocation size served from the cache */
+#define MULTI_HEAP_CACHE_MAX_SIZE 256
+
+typedef struct multi_heap_cache multi_heap_cache_t;
+
+/** @brief Cache statistics, summed over all slots */
+typedef struct {
+    size_t cached_bytes;    ///< Bytes held in cached free blocks
+    size_t cached_blocks;   ///< Number of cached free blocks
+    size_t hits;            ///< Allocations served from a free list without taking the heap lock
+    size_t refills;         ///< Batches of blocks taken from the heap
+    size_t drains;          ///< Batches of blocks given back to the heap
+} multi_heap_cache_stats_t;
+
+/* Create a cache for a heap. The cache bookkeeping is allocated from the heap itself.
+
+   slot_capacity is the number of bytes each slot may hold in free blocks before it starts
+   giving blocks back to the heap.
+
+   Returns NULL if there is not enough memory in the heap.
+*/
+multi_heap_cache_t *multi_heap_cache_create(multi_heap_handle_t heap, size_t slot_capacity);
+
+/* Allocate size bytes (0 < size <= MULTI_HEAP_CACHE_MAX_SIZE) through the cache.
+
+   Falls back to the heap directly if a free list cannot be refilled.
+*/
+void *multi_heap_cache_malloc(multi_heap_cache_t *cache, size_t size);
+
+/* Put a block allocated from the cache's heap into the cache.
+
+   Returns false if the block is too big or too small to be cached, or the slot is full.
+   In that case the caller must free it to the heap as usual.
+*/
+bool multi_heap_cache_free(multi_heap_cache_t *cache, void *p);
+
+/* Give all cached blocks back to the heap. Returns the number of bytes released. */
+size_t multi_heap_cache_flush(multi_heap_cache_t *cache);
+
+/* Get statistics for the cache */
+void multi_heap_cache_get_stats(multi_heap_cache_t *cache, multi_heap_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -41,6 +41,10 @@ size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap);
 size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p);
 void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block);
 
+/* Number of bytes the caller may use in a block returned by multi_heap_malloc().
+   Unlike multi_heap_get_allocated_size(), this excludes the heap poisoning overhead. */
+size_t multi_heap_internal_get_usable_size(multi_heap_handle_t heap, void *p);
+
 /* Some internal functions for heap poisoning use */
 
 /* Check an allocated block's poison bytes are correct. Called by multi_heap_check(). */
@@ -51,6 +55,30 @@ bool multi_heap_internal_check_block_poisoning(void *start, size_t size, bool is
 */
 void multi_heap_internal_poison_fill_region(void *start, size_t size, bool is_free);
 
+/* Poisoning for objects handed out by heap_caps_pool_*(), which don't come from a heap.
+
+   Each object slot has multi_heap_internal_poison_overhead() bytes more than the object size.
+   multi_heap_internal_poison_object() fills in the poison head and tail around an object at the start of
+   a slot and returns the object pointer, which is multi_heap_internal_poison_head_size() bytes into the slot. multi_heap_internal_unpoison_object() verifies them (aborting if
+   they are corrupt) and returns the start of the slot.
+
+   With comprehensive poisoning, free slots must be filled with the free pattern
+   (see multi_heap_internal_poison_fill_region()), except for the poison head.
+*/
+size_t multi_heap_internal_poison_overhead(void);
+size_t multi_heap_internal_poison_head_size(void);
+void *multi_heap_internal_poison_object(void *slot, size_t size);
+void *multi_heap_internal_unpoison_object(void *data);
+
+/* Comprehensive poisoning of the free blocks held by multi_heap_cache, which the heap still sees as allocated.
+
+   multi_heap_internal_poison_cached_block() fills a block with the free pattern, except for the first 'skip' bytes
+   (the cache's own link). multi_heap_internal_unpoison_cached_block() verifies the pattern, aborting if the block
+   was written to while it was cached, and fills it with the malloc pattern before it is handed out again.
+*/
+void multi_heap_internal_poison_cached_block(void *data, size_t size, size_t skip);
+void multi_heap_internal_unpoison_cached_block(void *data, size_t size, size_t skip);
+
 /* Allow heap poisoning to lock/unlock the heap to avoid race conditions
    if multi_heap_check() is running concurrently.
 */
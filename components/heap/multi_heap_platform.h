@@ -41,6 +41,12 @@ typedef portMUX_TYPE multi_heap_lock_t;
 
 #define MULTI_HEAP_LOCK_STATIC_INITIALIZER     portMUX_INITIALIZER_UNLOCKED
 
+/* The small block cache (multi_heap_cache.c) has one slot per CPU. Each slot has its own
+   lock, so a task which migrates to the other CPU while using a slot just contends
+   for that lock. */
+#define MULTI_HEAP_CACHE_SLOTS portNUM_PROCESSORS
+#define MULTI_HEAP_CACHE_CURRENT_SLOT() xPortGetCoreID()
+
 /* Not safe to use std i/o while in a portmux critical section,
    can deadlock, so we use the ROM equivalent functions. */
 
@@ -83,13 +89,51 @@ inline static void multi_heap_assert(bool condition, const char *format, int lin
 #else // MULTI_HEAP_FREERTOS
 
 #include <assert.h>
+#include <pthread.h>
+
+typedef pthread_mutex_t multi_heap_lock_t;
 
 #define MULTI_HEAP_PRINTF printf
 #define MULTI_HEAP_STDERR_PRINTF(MSG, ...) fprintf(stderr, MSG, __VA_ARGS__)
-#define MULTI_HEAP_LOCK(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_UNLOCK(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_LOCK_INIT(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_LOCK_STATIC_INITIALIZER  0
+
+/* Heaps are not locked on the host unless a lock is set with multi_heap_set_lock().
+   Locks are recursive, like the portmux spinlocks used on the target. */
+#define MULTI_HEAP_LOCK(PLOCK) do {                         \
+        if((PLOCK) != NULL) {                               \
+            pthread_mutex_lock((PLOCK));                    \
+        }                                                   \
+    } while(0)
+
+#define MULTI_HEAP_UNLOCK(PLOCK) do {                       \
+        if ((PLOCK) != NULL) {                              \
+            pthread_mutex_unlock((PLOCK));                  \
+        }                                                   \
+    } while(0)
+
+#define MULTI_HEAP_LOCK_INIT(PLOCK) do {                    \
+        pthread_mutexattr_t attr;                           \
+        pthread_mutexattr_init(&attr);                      \
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); \
+        pthread_mutex_init((PLOCK), &attr);                 \
+        pthread_mutexattr_destroy(&attr);                   \
+    } while(0)
+
+#define MULTI_HEAP_LOCK_STATIC_INITIALIZER  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+
+/* Threads stand in for CPUs on the host, each thread is given a cache slot the first time it needs one */
+#define MULTI_HEAP_CACHE_SLOTS 4
+
+static inline int multi_heap_host_cache_slot(void)
+{
+    static __thread int slot = -1;
+    static int next_slot;
+    if (slot < 0) {
+        slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) % MULTI_HEAP_CACHE_SLOTS;
+    }
+    return slot;
+}
+
+#define MULTI_HEAP_CACHE_CURRENT_SLOT() multi_heap_host_cache_slot()
 
 #define MULTI_HEAP_ASSERT(CONDITION, ADDRESS) assert((CONDITION) && "Heap corrupt")
 
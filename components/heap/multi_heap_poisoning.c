@@ -359,6 +359,13 @@ size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
     return result;
 }
 
+size_t multi_heap_internal_get_usable_size(multi_heap_handle_t heap, void *p)
+{
+    poison_head_t *head = verify_allocated_region(p, true);
+    assert(head != NULL);
+    return head->alloc_size;
+}
+
 void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
 {
     multi_heap_get_info_impl(heap, info);
@@ -388,6 +395,50 @@ size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
 
 /* Internal hooks used by multi_heap to manage poisoning, while keeping some modularity */
 
+size_t multi_heap_internal_poison_overhead(void)
+{
+    return POISON_OVERHEAD;
+}
+
+size_t multi_heap_internal_poison_head_size(void)
+{
+    return sizeof(poison_head_t);
+}
+
+void *multi_heap_internal_poison_object(void *slot, size_t size)
+{
+    uint8_t *data = poison_allocated_region((poison_head_t *)slot, size);
+#ifdef SLOW
+    bool ret = verify_fill_pattern(data, size, true, true, true);
+    assert( ret );
+#endif
+    return data;
+}
+
+void *multi_heap_internal_unpoison_object(void *data)
+{
+    poison_head_t *head = verify_allocated_region(data, true);
+    assert(head != NULL);
+#ifdef SLOW
+    memset(head, FREE_FILL_PATTERN, head->alloc_size + POISON_OVERHEAD);
+#endif
+    return head;
+}
+
+#ifdef SLOW
+void multi_heap_internal_poison_cached_block(void *data, size_t size, size_t skip)
+{
+    memset((uint8_t *)data + skip, FREE_FILL_PATTERN, size - skip);
+}
+
+void multi_heap_internal_unpoison_cached_block(void *data, size_t size, size_t skip)
+{
+    bool ret = verify_fill_pattern((uint8_t *)data + skip, size - skip, true, true, true);
+    assert( ret );
+    memset(data, MALLOC_FILL_PATTERN, skip);
+}
+#endif
+
 bool multi_heap_internal_check_block_poisoning(void *start, size_t size, bool is_free, bool print_errors)
 {
     if (is_free) {
@@ -123,6 +123,44 @@ TEST_CASE("heap trace wrapped buffer check", "[heap]")
     heap_trace_stop();
 }
 
+static void *alloc_in_loop(size_t size)
+{
+    return malloc(size);
+}
+
+TEST_CASE("heap trace summary counts call sites", "[heap]")
+{
+    const size_t N = 16;
+    heap_trace_record_t recs[N];
+    heap_trace_init_standalone(recs, N);
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_trace_start(HEAP_TRACE_SUMMARY));
+
+    void *ptrs[3];
+    for (int i = 0; i < 3; i++) {
+        ptrs[i] = alloc_in_loop(77);
+    }
+    free(ptrs[0]);
+
+    heap_trace_stop();
+    heap_trace_summary_dump();
+
+    // other allocations may happen, find the site of this loop by its numbers
+    bool saw_site = false;
+    heap_trace_site_t site;
+    for (int i = 0; heap_trace_summary_get(i, &site) == ESP_OK; i++) {
+        if (site.alloc_count == 3 && site.free_count == 1 && site.live_bytes == 2 * 77) {
+            TEST_ASSERT_EQUAL(3 * 77, site.peak_bytes);
+            saw_site = true;
+        }
+    }
+    TEST_ASSERT(saw_site);
+
+    free(ptrs[1]);
+    free(ptrs[2]);
+    heap_trace_init_standalone(NULL, 0);
+}
+
 static void print_floats_task(void *ignore)
 {
     heap_trace_start(HEAP_TRACE_ALL);
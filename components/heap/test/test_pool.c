@@ -0,0 +1,109 @@
+/*
+ Tests for the fixed-size object pool allocator.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+
+TEST_CASE("Fixed pool hands out each object once", "[heap]")
+{
+    const size_t count = 8;
+    void *objs[count];
+    heap_caps_pool_info_t info;
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(24, count, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    for (int i = 0; i < count; i++) {
+        objs[i] = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(objs[i]);
+        memset(objs[i], i, 24);
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_NOT_EQUAL(objs[j], objs[i]);
+        }
+    }
+    TEST_ASSERT_NULL(heap_caps_pool_alloc(pool));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(24, info.obj_size);
+    TEST_ASSERT_EQUAL(count, info.total_objects);
+    TEST_ASSERT_EQUAL(0, info.free_objects);
+    TEST_ASSERT_EQUAL(count, info.peak_used_objects);
+    TEST_ASSERT_EQUAL(1, info.slabs);
+    TEST_ASSERT_EQUAL(1, info.failed_allocs);
+
+    for (int i = 0; i < count; i++) {
+        uint8_t expected[24];
+        memset(expected, i, sizeof(expected));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, objs[i], sizeof(expected));
+        TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_free(pool, objs[i]));
+    }
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(count, info.free_objects);
+
+    heap_caps_pool_delete(pool);
+    TEST_ASSERT_EQUAL(free_before, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+TEST_CASE("Growable pool adds slabs up to its limit", "[heap]")
+{
+    void *objs[10];
+    heap_caps_pool_info_t info;
+
+    TEST_ASSERT_NULL(heap_caps_pool_create_growable(16, 4, 3, MALLOC_CAP_8BIT));
+
+    heap_caps_pool_handle_t pool = heap_caps_pool_create_growable(16, 4, 10, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    for (int i = 0; i < 8; i++) {
+        objs[i] = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(objs[i]);
+    }
+    /* a third slab would go over the limit of 10 objects */
+    TEST_ASSERT_NULL(heap_caps_pool_alloc(pool));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(8, info.total_objects);
+    TEST_ASSERT_EQUAL(2, info.slabs);
+
+    for (int i = 0; i < 8; i++) {
+        heap_caps_pool_free(pool, objs[i]);
+    }
+    heap_caps_pool_delete(pool);
+}
+
+TEST_CASE("Pool rejects objects it didn't hand out", "[heap]")
+{
+    heap_caps_pool_info_t info;
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(16, 2, MALLOC_CAP_8BIT);
+    heap_caps_pool_handle_t other = heap_caps_pool_create(16, 2, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_NOT_NULL(other);
+
+    void *obj = heap_caps_pool_alloc(pool);
+    void *other_obj = heap_caps_pool_alloc(other);
+    void *heap_obj = heap_caps_malloc(16, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(obj);
+    TEST_ASSERT_NOT_NULL(other_obj);
+    TEST_ASSERT_NOT_NULL(heap_obj);
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_free(pool, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, heap_caps_pool_free(pool, other_obj));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, heap_caps_pool_free(pool, heap_obj));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, heap_caps_pool_free(pool, (uint8_t *)obj + 1));
+    TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_free(pool, obj));
+    /* freed twice */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, heap_caps_pool_free(pool, obj));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(2, info.free_objects);
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_free(other, other_obj));
+    heap_caps_free(heap_obj);
+    heap_caps_pool_delete(other);
+    heap_caps_pool_delete(pool);
+}
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Any return address of the host program is a valid caller */
+static inline bool esp_ptr_executable(const void *p)
+{
+    return p != NULL;
+}
+
+static inline uint32_t cpu_hal_get_cycle_count(void)
+{
+    return 0;
+}
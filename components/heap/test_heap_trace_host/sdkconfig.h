@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#define CONFIG_HEAP_TRACING 1
+#define CONFIG_HEAP_TRACING_STANDALONE 1
+#define CONFIG_HEAP_TRACING_STACK_DEPTH 2
+#define CONFIG_FREERTOS_UNICORE 1
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_HEAP_TRACING_SUMMARY_SITES 16
+#define CONFIG_HEAP_TRACING_SUMMARY_EVICTED 16
@@ -0,0 +1,453 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "catch.hpp"
+#include "esp_heap_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <random>
+#include <vector>
+
+/* heap_trace_standalone.c sees these as the heap functions wrapped by the
+   linker, here they are plain libc ones */
+extern "C" {
+void *__wrap_malloc(size_t size);
+void __wrap_free(void *p);
+void *__wrap_realloc(void *p, size_t size);
+
+void *__real_heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void *__real_heap_caps_malloc_default(size_t size)
+{
+    return malloc(size);
+}
+
+void *__real_heap_caps_realloc(void *p, size_t size, uint32_t caps)
+{
+    return realloc(p, size);
+}
+
+void *__real_heap_caps_realloc_default(void *p, size_t size)
+{
+    return realloc(p, size);
+}
+
+void __real_heap_caps_free(void *p)
+{
+    free(p);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void heap_caps_free(void *p)
+{
+    free(p);
+}
+}
+
+static std::vector<void *> get_addresses(void)
+{
+    std::vector<void *> addresses;
+    for (size_t i = 0; i < heap_trace_get_count(); i++) {
+        heap_trace_record_t rec;
+        REQUIRE( heap_trace_get(i, &rec) == ESP_OK );
+        addresses.push_back(rec.address);
+    }
+    return addresses;
+}
+
+TEST_CASE("heap trace leak mode keeps the allocations not freed", "[heap_trace]")
+{
+    heap_trace_record_t recs[8];
+    REQUIRE( heap_trace_init_standalone(recs, 8) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_LEAKS) == ESP_OK );
+
+    void *p[5];
+    for (int i = 0; i < 5; i++) {
+        p[i] = __wrap_malloc(10 + i);
+    }
+    __wrap_free(p[1]);
+    __wrap_free(p[3]);
+    p[1] = __wrap_realloc(p[4], 100);
+
+    REQUIRE( heap_trace_get_count() == 3 );
+    REQUIRE( get_addresses() == std::vector<void *>({ p[0], p[2], p[1] }) );
+    heap_trace_record_t rec;
+    REQUIRE( heap_trace_get(2, &rec) == ESP_OK );
+    REQUIRE( rec.size == 100 );
+    REQUIRE( rec.alloced_by[0] != NULL );
+    REQUIRE( heap_trace_get(3, &rec) == ESP_ERR_INVALID_ARG );
+
+    /* The records in use stay at the start of the buffer */
+    for (int i = 0; i < 3; i++) {
+        REQUIRE( recs[i].address != NULL );
+    }
+    REQUIRE( recs[3].address == NULL );
+
+    REQUIRE( heap_trace_stop() == ESP_OK );
+    __wrap_free(p[0]);
+    __wrap_free(p[1]);
+    __wrap_free(p[2]);
+    REQUIRE( heap_trace_get_count() == 3 );
+    heap_trace_dump();
+}
+
+TEST_CASE("heap trace all mode records the frees", "[heap_trace]")
+{
+    heap_trace_record_t recs[4];
+    REQUIRE( heap_trace_init_standalone(recs, 4) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_ALL) == ESP_OK );
+
+    void *a = __wrap_malloc(32);
+    void *b = __wrap_malloc(32);
+    __wrap_free(a);
+    void *c = __wrap_malloc(32);
+    __wrap_free(c);
+    void *d = __wrap_malloc(32);
+    void *e = __wrap_malloc(32);
+
+    /* The oldest record is dropped */
+    REQUIRE( get_addresses() == std::vector<void *>({ b, c, d, e }) );
+    heap_trace_record_t rec;
+    REQUIRE( heap_trace_get(0, &rec) == ESP_OK );
+    REQUIRE( rec.freed_by[0] == NULL );
+    REQUIRE( heap_trace_get(1, &rec) == ESP_OK );
+    REQUIRE( rec.freed_by[0] != NULL );
+
+    /* A freed record isn't marked again by a free of a new allocation at the same address */
+    __wrap_free(d);
+    void *f = __wrap_malloc(32);
+    REQUIRE( heap_trace_get(1, &rec) == ESP_OK );
+    REQUIRE( rec.address == d );
+    void *d_freed_by = rec.freed_by[0];
+    REQUIRE( d_freed_by != NULL );
+    __wrap_free(f);
+    REQUIRE( get_addresses() == std::vector<void *>({ c, d, e, f }) );
+    REQUIRE( heap_trace_get(1, &rec) == ESP_OK );
+    REQUIRE( rec.freed_by[0] == d_freed_by );
+    REQUIRE( heap_trace_get(3, &rec) == ESP_OK );
+    REQUIRE( rec.address == f );
+    REQUIRE( rec.freed_by[0] != NULL );
+
+    heap_trace_dump();
+    REQUIRE( heap_trace_stop() == ESP_OK );
+    __wrap_free(b);
+    __wrap_free(e);
+}
+
+/* The records kept by the linear search heap_trace_standalone.c did before the index */
+struct reference_trace {
+    std::deque<heap_trace_record_t> records;
+    size_t size;
+    heap_trace_mode_t mode;
+
+    void alloc(void *p, size_t len)
+    {
+        if (records.size() == size) {
+            records.pop_front();
+        }
+        heap_trace_record_t rec = {};
+        rec.address = p;
+        rec.size = len;
+        records.push_back(rec);
+    }
+
+    void free(void *p)
+    {
+        for (auto it = records.rbegin(); it != records.rend(); ++it) {
+            if (it->address == p) {
+                if (mode == HEAP_TRACE_ALL) {
+                    it->freed_by[0] = (void *)1;
+                } else {
+                    records.erase(std::next(it).base());
+                }
+                return;
+            }
+        }
+    }
+};
+
+TEST_CASE("heap trace records match the linear search", "[heap_trace]")
+{
+    const size_t N = 64;
+    heap_trace_record_t recs[N];
+    std::mt19937 rng(1);
+
+    for (heap_trace_mode_t mode : { HEAP_TRACE_ALL, HEAP_TRACE_LEAKS }) {
+        REQUIRE( heap_trace_init_standalone(recs, N) == ESP_OK );
+        REQUIRE( heap_trace_start(mode) == ESP_OK );
+        reference_trace ref = { {}, N, mode };
+        std::vector<void *> live;
+
+        for (int i = 0; i < 20000; i++) {
+            /* More allocations than frees for a while, so that the buffer overflows */
+            size_t target = (i / 2000) % 2 ? 16 : 96;
+            if (!live.empty() && rng() % (2 * target) < live.size()) {
+                size_t n = rng() % live.size();
+                __wrap_free(live[n]);
+                ref.free(live[n]);
+                live[n] = live.back();
+                live.pop_back();
+            } else {
+                size_t len = 1 + rng() % 64;
+                void *p = __wrap_malloc(len);
+                ref.alloc(p, len);
+                live.push_back(p);
+            }
+
+            if (i % 97 == 0) {
+                REQUIRE( heap_trace_get_count() == ref.records.size() );
+                for (size_t j = 0; j < ref.records.size(); j++) {
+                    heap_trace_record_t rec;
+                    REQUIRE( heap_trace_get(j, &rec) == ESP_OK );
+                    REQUIRE( rec.address == ref.records[j].address );
+                    REQUIRE( rec.size == ref.records[j].size );
+                    REQUIRE( (rec.freed_by[0] != NULL) == (ref.records[j].freed_by[0] != NULL) );
+                }
+            }
+        }
+
+        REQUIRE( heap_trace_stop() == ESP_OK );
+        for (void *p : live) {
+            __wrap_free(p);
+        }
+    }
+}
+
+/* Each instance is a call site of its own */
+template<int N>
+__attribute__((noinline)) void *alloc_from_site(size_t size)
+{
+    return __wrap_malloc(size + N);
+}
+
+static void *(*const alloc_sites[])(size_t) = {
+    alloc_from_site<0>, alloc_from_site<1>, alloc_from_site<2>, alloc_from_site<3>,
+    alloc_from_site<4>, alloc_from_site<5>, alloc_from_site<6>, alloc_from_site<7>,
+    alloc_from_site<8>, alloc_from_site<9>, alloc_from_site<10>, alloc_from_site<11>,
+    alloc_from_site<12>, alloc_from_site<13>, alloc_from_site<14>, alloc_from_site<15>,
+    alloc_from_site<16>, alloc_from_site<17>, alloc_from_site<18>, alloc_from_site<19>,
+};
+
+static std::string capture_summary_dump(void)
+{
+    char path[] = "/tmp/heap_trace_summaryXXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE( fd >= 0 );
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    heap_trace_summary_dump();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    std::string out(8192, 0);
+    out.resize(pread(fd, &out[0], out.size(), 0));
+    close(fd);
+    unlink(path);
+    return out;
+}
+
+TEST_CASE("heap trace summary counts the allocations of each call site", "[heap_trace][summary]")
+{
+    heap_trace_record_t recs[32];
+    heap_trace_site_t site;
+    REQUIRE( heap_trace_init_standalone(recs, 32) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_ALL) == ESP_OK );
+    REQUIRE( heap_trace_summary_get(0, &site) == ESP_ERR_INVALID_STATE );
+    REQUIRE( heap_trace_start(HEAP_TRACE_SUMMARY) == ESP_OK );
+    REQUIRE( heap_trace_summary_get(0, NULL) == ESP_ERR_INVALID_ARG );
+
+    void *a[10];
+    void *b[5];
+    for (int i = 0; i < 10; i++) {
+        a[i] = alloc_sites[0](100);
+    }
+    for (int i = 0; i < 5; i++) {
+        b[i] = alloc_sites[1](39);
+    }
+    for (int i = 0; i < 4; i++) {
+        __wrap_free(a[i]);
+    }
+    void *c = alloc_sites[2](698);
+
+    /* In the order the sites were seen */
+    REQUIRE( heap_trace_summary_get(0, &site) == ESP_OK );
+    REQUIRE( site.alloc_count == 10 );
+    REQUIRE( site.free_count == 4 );
+    REQUIRE( site.live_bytes == 600 );
+    REQUIRE( site.peak_bytes == 1000 );
+    REQUIRE( site.alloced_by[0] != NULL );
+    REQUIRE( heap_trace_summary_get(1, &site) == ESP_OK );
+    REQUIRE( site.alloc_count == 5 );
+    REQUIRE( site.free_count == 0 );
+    REQUIRE( site.live_bytes == 200 );
+    REQUIRE( heap_trace_summary_get(2, &site) == ESP_OK );
+    REQUIRE( site.live_bytes == 700 );
+    REQUIRE( heap_trace_summary_get(3, &site) == ESP_ERR_INVALID_ARG );
+
+    /* The live allocations are traced like leaks */
+    REQUIRE( heap_trace_get_count() == 12 );
+
+    /* Sorted by live bytes */
+    std::string out = capture_summary_dump();
+    size_t pos_c = out.find("700 bytes live (peak 700) in 1 allocations (0 freed)");
+    size_t pos_a = out.find("600 bytes live (peak 1000) in 10 allocations (4 freed)");
+    size_t pos_b = out.find("200 bytes live (peak 200) in 5 allocations (0 freed)");
+    REQUIRE( pos_c != std::string::npos );
+    REQUIRE( pos_a != std::string::npos );
+    REQUIRE( pos_b != std::string::npos );
+    REQUIRE( pos_c < pos_a );
+    REQUIRE( pos_a < pos_b );
+    REQUIRE( out.find("1500 bytes live in trace") != std::string::npos );
+
+    REQUIRE( heap_trace_stop() == ESP_OK );
+    for (int i = 4; i < 10; i++) {
+        __wrap_free(a[i]);
+    }
+    for (int i = 0; i < 5; i++) {
+        __wrap_free(b[i]);
+    }
+    __wrap_free(c);
+}
+
+TEST_CASE("heap trace summary has a bounded number of call sites", "[heap_trace][summary]")
+{
+    const int num_sites = sizeof(alloc_sites) / sizeof(alloc_sites[0]);
+    heap_trace_record_t recs[64];
+    REQUIRE( heap_trace_init_standalone(recs, 64) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_SUMMARY) == ESP_OK );
+
+    /* The sites are the call stacks, so each function is called from one place */
+    void *p[num_sites][2];
+    for (int i = 0; i < 2 * num_sites; i++) {
+        p[i / 2][i % 2] = alloc_sites[i / 2](16);
+    }
+    for (int i = 0; i < num_sites; i++) {
+        __wrap_free(p[i][0]);
+    }
+
+    heap_trace_site_t site;
+    size_t live_bytes = 0;
+    int i;
+    for (i = 0; heap_trace_summary_get(i, &site) == ESP_OK; i++) {
+        REQUIRE( site.alloc_count == 2 );
+        REQUIRE( site.free_count == 1 );
+        live_bytes += site.live_bytes;
+    }
+    REQUIRE( i == CONFIG_HEAP_TRACING_SUMMARY_SITES );
+    REQUIRE( live_bytes == (16 + 16 + i - 1) * i / 2 );
+
+    std::string out = capture_summary_dump();
+    REQUIRE( out.find("16 call sites (16 site table)") == 0 );
+    REQUIRE( out.find("8 allocations from other call sites were not counted") != std::string::npos );
+
+    REQUIRE( heap_trace_stop() == ESP_OK );
+    for (int i = 0; i < num_sites; i++) {
+        __wrap_free(p[i][1]);
+    }
+}
+
+TEST_CASE("heap trace summary counts the frees of allocations evicted from the buffer", "[heap_trace][summary]")
+{
+    const int n = 4 + CONFIG_HEAP_TRACING_SUMMARY_EVICTED + 2;
+    heap_trace_record_t recs[4];
+    REQUIRE( heap_trace_init_standalone(recs, 4) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_SUMMARY) == ESP_OK );
+
+    /* The oldest allocations are evicted from the buffer, the ones which don't fit in the table are lost */
+    void *p[n];
+    for (int i = 0; i < n; i++) {
+        p[i] = alloc_sites[0](10);
+    }
+    REQUIRE( heap_trace_get_count() == 4 );
+    for (int i = 0; i < n; i++) {
+        __wrap_free(p[i]);
+    }
+
+    heap_trace_site_t site;
+    REQUIRE( heap_trace_summary_get(0, &site) == ESP_OK );
+    REQUIRE( site.alloc_count == n );
+    REQUIRE( site.free_count == n - 2 );
+    REQUIRE( site.live_bytes == 20 );
+    std::string out = capture_summary_dump();
+    REQUIRE( out.find("frees of 2 allocations were missed") != std::string::npos );
+
+    /* All the frees are counted if the table is large enough */
+    REQUIRE( heap_trace_start(HEAP_TRACE_SUMMARY) == ESP_OK );
+    for (int i = 0; i < n - 2; i++) {
+        p[i] = alloc_sites[0](10);
+    }
+    for (int i = n - 3; i >= 0; i--) {
+        __wrap_free(p[i]);
+    }
+    REQUIRE( heap_trace_summary_get(0, &site) == ESP_OK );
+    REQUIRE( site.free_count == n - 2 );
+    REQUIRE( site.live_bytes == 0 );
+    REQUIRE( heap_trace_get_count() == 0 );
+    out = capture_summary_dump();
+    REQUIRE( out.find("were missed") == std::string::npos );
+    REQUIRE( out.find("Buffer has overflowed") != std::string::npos );
+
+    REQUIRE( heap_trace_stop() == ESP_OK );
+}
+
+/* Average time of a malloc and a free with a few thousand allocations alive, as in a leak trace
+   of a busy application */
+static double bench_ns(void)
+{
+    const int live_count = 1500;
+    const int rounds = 200000;
+    std::vector<void *> live(live_count);
+    std::mt19937 rng(2);
+
+    for (int i = 0; i < live_count; i++) {
+        live[i] = __wrap_malloc(1 + rng() % 128);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        /* Frees of recent allocations are found quickly by a backwards search, old ones aren't */
+        int n = rng() % live_count;
+        __wrap_free(live[n]);
+        live[n] = __wrap_malloc(1 + rng() % 128);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    for (int i = 0; i < live_count; i++) {
+        __wrap_free(live[i]);
+    }
+    return elapsed.count() / rounds;
+}
+
+TEST_CASE("heap trace malloc/free overhead", "[heap_trace][bench]")
+{
+    const size_t N = 2000;
+    static heap_trace_record_t recs[N];
+    REQUIRE( heap_trace_init_standalone(recs, N) == ESP_OK );
+
+    printf("mode      ns per malloc+free\n");
+    printf("%-9s %18.0f\n", "off", bench_ns());
+    REQUIRE( heap_trace_start(HEAP_TRACE_LEAKS) == ESP_OK );
+    printf("%-9s %18.0f\n", "leaks", bench_ns());
+    REQUIRE( heap_trace_start(HEAP_TRACE_ALL) == ESP_OK );
+    printf("%-9s %18.0f\n", "all", bench_ns());
+    REQUIRE( heap_trace_start(HEAP_TRACE_SUMMARY) == ESP_OK );
+    printf("%-9s %18.0f\n", "summary", bench_ns());
+    REQUIRE( heap_trace_stop() == ESP_OK );
+
+    REQUIRE( heap_trace_init_standalone(NULL, 0) == ESP_OK );
+    REQUIRE( heap_trace_start(HEAP_TRACE_LEAKS) == ESP_ERR_INVALID_STATE );
+}
@@ -0,0 +1,244 @@
+#include "catch.hpp"
+#include "multi_heap.h"
+
+#include "../multi_heap_config.h"
+#include "../multi_heap_cache.h"
+
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <chrono>
+
+/* Insurance against accidentally using libc heap functions in tests */
+#undef free
+#define free #error
+#undef malloc
+#define malloc #error
+#undef calloc
+#define calloc #error
+#undef realloc
+#define realloc #error
+
+/* Recursive, like the portmux spinlocks protecting heaps on the target */
+static void init_heap_lock(pthread_mutex_t *lock)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+TEST_CASE("multi_heap cache serves small allocations", "[multi_heap][cache]")
+{
+    static uint8_t heap_mem[64 * 1024];
+    pthread_mutex_t lock;
+    init_heap_lock(&lock);
+
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, sizeof(heap_mem));
+    multi_heap_set_lock(heap, &lock);
+    multi_heap_cache_t *cache = multi_heap_cache_create(heap, 1024);
+    REQUIRE( cache != NULL );
+
+    const size_t free_before = multi_heap_free_size(heap);
+    void *p[20];
+    multi_heap_cache_stats_t stats;
+
+    REQUIRE( multi_heap_cache_malloc(cache, 0) == NULL );
+    REQUIRE( multi_heap_cache_malloc(cache, MULTI_HEAP_CACHE_MAX_SIZE + 1) == NULL );
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 20; i++) {
+            p[i] = multi_heap_cache_malloc(cache, 40);
+            REQUIRE( p[i] != NULL );
+            REQUIRE( multi_heap_get_allocated_size(heap, p[i]) >= 40 );
+            memset(p[i], i, 40);
+        }
+        for (int i = 0; i < 20; i++) {
+            uint8_t expected[40];
+            memset(expected, i, sizeof(expected));
+            REQUIRE( memcmp(p[i], expected, sizeof(expected)) == 0 );
+            REQUIRE( multi_heap_cache_free(cache, p[i]) );
+        }
+    }
+
+    multi_heap_cache_get_stats(cache, &stats);
+    printf("cached %zu bytes in %zu blocks, %zu hits, %zu refills, %zu drains\n",
+           stats.cached_bytes, stats.cached_blocks, stats.hits, stats.refills, stats.drains);
+    REQUIRE( stats.cached_blocks > 0 );
+    REQUIRE( stats.cached_blocks <= 20 );
+    REQUIRE( stats.cached_bytes <= 1024 );
+    REQUIRE( stats.hits > 20 );
+    REQUIRE( stats.refills < 20 );
+    REQUIRE( multi_heap_free_size(heap) + stats.cached_bytes <= free_before );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    REQUIRE( multi_heap_cache_flush(cache) == stats.cached_bytes );
+    multi_heap_cache_get_stats(cache, &stats);
+    REQUIRE( stats.cached_blocks == 0 );
+    REQUIRE( stats.cached_bytes == 0 );
+    REQUIRE( multi_heap_free_size(heap) == free_before );
+    REQUIRE( multi_heap_check(heap, true) );
+}
+
+TEST_CASE("multi_heap cache gives blocks back when full", "[multi_heap][cache]")
+{
+    static uint8_t heap_mem[64 * 1024];
+    pthread_mutex_t lock;
+    init_heap_lock(&lock);
+
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, sizeof(heap_mem));
+    multi_heap_set_lock(heap, &lock);
+    multi_heap_cache_t *cache = multi_heap_cache_create(heap, 256);
+    REQUIRE( cache != NULL );
+
+    const size_t free_before = multi_heap_free_size(heap);
+    void *p[64];
+    multi_heap_cache_stats_t stats;
+
+    for (int i = 0; i < 64; i++) {
+        p[i] = multi_heap_cache_malloc(cache, 32);
+        REQUIRE( p[i] != NULL );
+    }
+    int cached = 0;
+    for (int i = 0; i < 64; i++) {
+        if (multi_heap_cache_free(cache, p[i])) {
+            cached++;
+        } else {
+            multi_heap_free(heap, p[i]);
+        }
+    }
+
+    multi_heap_cache_get_stats(cache, &stats);
+    REQUIRE( stats.cached_bytes <= 256 );
+    REQUIRE( stats.drains > 0 );
+    REQUIRE( cached > (int)stats.cached_blocks );
+
+    /* Blocks too big for the cache are left to the caller */
+    void *big = multi_heap_malloc(heap, 1024);
+    REQUIRE( big != NULL );
+    REQUIRE( !multi_heap_cache_free(cache, big) );
+    multi_heap_free(heap, big);
+
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_free_size(heap) == free_before );
+    REQUIRE( multi_heap_check(heap, true) );
+}
+
+#ifdef MULTI_HEAP_POISONING_SLOW
+TEST_CASE("multi_heap cache keeps cached blocks poisoned", "[multi_heap][cache]")
+{
+    static uint8_t heap_mem[64 * 1024];
+    pthread_mutex_t lock;
+    init_heap_lock(&lock);
+
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, sizeof(heap_mem));
+    multi_heap_set_lock(heap, &lock);
+    multi_heap_cache_t *cache = multi_heap_cache_create(heap, 1024);
+    REQUIRE( cache != NULL );
+
+    uint8_t *p = (uint8_t *)multi_heap_cache_malloc(cache, 48);
+    REQUIRE( p != NULL );
+    memset(p, 0x55, 48);
+    REQUIRE( multi_heap_cache_free(cache, p) );
+
+    /* A cached block holds the free pattern behind the cache's link... */
+    for (size_t i = sizeof(void *); i < 48; i++) {
+        REQUIRE( p[i] == 0xfe );
+    }
+
+    /* ...and is handed out again with the malloc pattern, like a block from the heap */
+    uint8_t *q = (uint8_t *)multi_heap_cache_malloc(cache, 48);
+    REQUIRE( q == p );
+    for (size_t i = 0; i < 48; i++) {
+        REQUIRE( q[i] == 0xce );
+    }
+    REQUIRE( multi_heap_cache_free(cache, q) );
+
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_check(heap, true) );
+}
+#endif
+
+#define BENCH_ALLOCS_PER_ROUND 16
+#define BENCH_ROUNDS 20000
+
+typedef struct {
+    multi_heap_handle_t heap;
+    multi_heap_cache_t *cache;
+    size_t failed;
+} bench_arg_t;
+
+static void *bench_task(void *arg)
+{
+    bench_arg_t *bench = (bench_arg_t *)arg;
+    void *p[BENCH_ALLOCS_PER_ROUND];
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_ALLOCS_PER_ROUND; i++) {
+            size_t size = 16 + ((round + i * 7) % 16) * 15;
+            if (bench->cache != NULL) {
+                p[i] = multi_heap_cache_malloc(bench->cache, size);
+            } else {
+                p[i] = multi_heap_malloc(bench->heap, size);
+            }
+            if (p[i] == NULL) {
+                bench->failed++;
+            }
+        }
+        for (int i = 0; i < BENCH_ALLOCS_PER_ROUND; i++) {
+            if (p[i] != NULL && (bench->cache == NULL || !multi_heap_cache_free(bench->cache, p[i]))) {
+                multi_heap_free(bench->heap, p[i]);
+            }
+        }
+    }
+    return NULL;
+}
+
+static double run_bench(multi_heap_handle_t heap, multi_heap_cache_t *cache, int threads)
+{
+    pthread_t tid[4];
+    bench_arg_t args[4];
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++) {
+        args[i] = { heap, cache, 0 };
+        REQUIRE( pthread_create(&tid[i], NULL, bench_task, &args[i]) == 0 );
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+        REQUIRE( args[i].failed == 0 );
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double)threads * BENCH_ROUNDS * BENCH_ALLOCS_PER_ROUND / elapsed.count();
+}
+
+TEST_CASE("multi_heap cache allocation throughput", "[multi_heap][cache][bench]")
+{
+    static uint8_t heap_mem[256 * 1024];
+    pthread_mutex_t lock;
+    init_heap_lock(&lock);
+
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, sizeof(heap_mem));
+    multi_heap_set_lock(heap, &lock);
+    multi_heap_cache_t *cache = multi_heap_cache_create(heap, 4096);
+    REQUIRE( cache != NULL );
+
+    const size_t free_before = multi_heap_free_size(heap);
+
+    printf("threads   heap allocs/s   cached allocs/s\n");
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        double direct = run_bench(heap, NULL, threads);
+        double cached = run_bench(heap, cache, threads);
+        printf("%7d %15.0f %17.0f\n", threads, direct, cached);
+    }
+
+    multi_heap_cache_stats_t stats;
+    multi_heap_cache_get_stats(cache, &stats);
+    printf("cache: %zu hits, %zu refills, %zu drains\n", stats.hits, stats.refills, stats.drains);
+
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_free_size(heap) == free_before );
+    REQUIRE( multi_heap_check(heap, true) );
+}
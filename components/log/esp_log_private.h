@@ -1,6 +1,31 @@
 #pragma once
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "esp_log.h"
 
 void esp_log_impl_lock(void);
 bool esp_log_impl_lock_timeout(void);
 void esp_log_impl_unlock(void);
+
+#if CONFIG_LOG_DEFERRED && !BOOTLOADER_BUILD
+// Deferred logging (log_deferred.c)
+#if CONFIG_IDF_TARGET_LINUX || CONFIG_FREERTOS_UNICORE
+#define ESP_LOG_DEFERRED_BUFFERS 1
+#else
+#include "soc/soc_caps.h"
+#define ESP_LOG_DEFERRED_BUFFERS SOC_CPU_CORES_NUM
+#endif
+
+bool esp_log_deferred_writev(esp_log_level_t level, const char *tag, const char *format, va_list args);
+void esp_log_print_str(const char *str);
+
+// Keep other writers out of the deferred log buffer of the current CPU, and return the index of that buffer.
+// Must not block, may be called from any task.
+unsigned esp_log_impl_deferred_enter(uint32_t *state);
+void esp_log_impl_deferred_exit(uint32_t state);
+// Start printing deferred log messages in the background, if the platform supports it.
+void esp_log_impl_deferred_start(void);
+// Let a task which is flushing deferred log messages run, e.g. by sleeping for a short time.
+void esp_log_impl_deferred_wait(void);
+#endif
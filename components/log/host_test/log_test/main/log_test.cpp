@@ -10,6 +10,10 @@
 #include <cstdio>
 #include <regex>
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
 #include "esp_log.h"
 
 #include "catch.hpp"
@@ -267,3 +271,215 @@ TEST_CASE("changing early log level")
     ESP_EARLY_LOGI(TEST_TAG, "must indeed be printed");
     CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
 }
+
+TEST_CASE("deferred log is printed on flush")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const std::regex test_print("I \\([0-9]*\\) test: deferred 42 -7 str 1.50 0x1234567890 'x' 100%", std::regex::ECMAScript);
+
+    esp_log_set_deferred(true);
+    char str[] = "str";
+    ESP_LOGI(TEST_TAG, "deferred %d %*d %s %.2f 0x%llx '%c' 100%%", 42, 2, -7, str, 1.5, 0x1234567890ULL, 'x');
+    ESP_LOGD(TEST_TAG, "must not be recorded");
+    str[0] = 'X'; // the string was copied when logging
+    CHECK(fix.get_print_buffer_string().size() == 0);
+
+    CHECK(esp_log_deferred_flush() == 1);
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    CHECK(esp_log_deferred_flush() == 0);
+    esp_log_set_deferred(false);
+}
+
+TEST_CASE("deferred log copies strings up to their precision")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const std::regex test_print("I \\([0-9]*\\) test: abcd \\[abc\\] \\[  ab\\] \\[\\] abcdefgh end", std::regex::ECMAScript);
+
+    // Not terminated, a read past the end of the buffer is caught by the address sanitizer
+    char *buf = new char[8];
+    memcpy(buf, "abcdefgh", 8);
+
+    esp_log_set_deferred(true);
+    ESP_LOGI(TEST_TAG, "%.4s [%.*s] [%*.*s] [%.*s] %.8s end", buf, 3, buf, 4, 2, buf, 0, buf, buf);
+    delete[] buf;
+
+    CHECK(esp_log_deferred_flush() == 1);
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    esp_log_set_deferred(false);
+}
+
+TEST_CASE("deferred log drops messages when its buffer is full")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const std::regex test_print("I \\([0-9]*\\) test: last message", std::regex::ECMAScript);
+    uint32_t dropped = esp_log_deferred_get_dropped();
+    const int count = CONFIG_LOG_DEFERRED_BUFFER_SIZE / 16;
+
+    esp_log_set_deferred(true);
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TEST_TAG, "message %d", i);
+    }
+    size_t printed = esp_log_deferred_flush();
+    CHECK(printed > 0);
+    CHECK(printed < (size_t) count);
+    CHECK(esp_log_deferred_get_dropped() - dropped == count - printed);
+
+    // There is room again after the flush
+    ESP_LOGI(TEST_TAG, "last message");
+    CHECK(esp_log_deferred_flush() == 1);
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    esp_log_set_deferred(false);
+}
+
+static std::atomic<bool> s_in_slow_flush;
+static string s_slow_output;
+
+static int slow_print(const char *format, va_list args)
+{
+    char line[256];
+    int ret = vsnprintf(line, sizeof(line), format, args);
+    s_slow_output += line;
+    if (!s_in_slow_flush.exchange(true)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return ret;
+}
+
+TEST_CASE("switching deferred log off waits for a running flush")
+{
+    BasicLogFixture fix(ESP_LOG_INFO);
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(slow_print);
+    s_in_slow_flush = false;
+    s_slow_output.clear();
+
+    esp_log_set_deferred(true);
+    ESP_LOGI(TEST_TAG, "first");
+    std::thread flusher([] { esp_log_deferred_flush(); });
+    while (!s_in_slow_flush) {
+        std::this_thread::yield();
+    }
+    // Not seen by the running flush any more
+    ESP_LOGI(TEST_TAG, "second");
+    esp_log_set_deferred(false);
+    flusher.join();
+    esp_log_set_vprintf(old_vprintf);
+
+    CHECK(s_slow_output.find("test: first") != string::npos);
+    CHECK(s_slow_output.find("test: second") != string::npos);
+}
+
+static int format_to_null(const char *format, va_list args)
+{
+    char buffer[256];
+    return vsnprintf(buffer, sizeof(buffer), format, args);
+}
+
+static double ns_per_log_call(bool deferred, int count)
+{
+    const int batch = 16;
+    std::chrono::nanoseconds elapsed(0);
+
+    for (int i = 0; i < count; i += batch) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < batch; j++) {
+            ESP_LOGI(TEST_TAG, "value %d of %s at %p", i + j, "benchmark", &elapsed);
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+        if (deferred) {
+            esp_log_deferred_flush();
+        }
+    }
+    return (double) elapsed.count() / count;
+}
+
+TEST_CASE("deferred log performance", "[bench]")
+{
+    const int count = 200000;
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(format_to_null);
+    esp_log_level_set("*", ESP_LOG_INFO);
+
+    double immediate_ns = ns_per_log_call(false, count);
+    esp_log_set_deferred(true);
+    uint32_t dropped = esp_log_deferred_get_dropped();
+    double deferred_ns = ns_per_log_call(true, count);
+    CHECK(esp_log_deferred_get_dropped() == dropped);
+    esp_log_set_deferred(false);
+
+    esp_log_set_vprintf(old_vprintf);
+    printf("log call: %.1f ns immediate, %.1f ns deferred\n", immediate_ns, deferred_ns);
+}
+
+TEST_CASE("tag levels are looked up from several threads")
+{
+    const int tag_count = 200;
+    const int thread_count = 4;
+    vector<string> tags;
+    BasicLogFixture fix(ESP_LOG_WARN);
+
+    for (int i = 0; i < tag_count; i++) {
+        tags.push_back("tag" + to_string(i));
+    }
+    // Levels are set with copies of the tags, so that they're matched by string
+    for (int i = 0; i < tag_count; i += 2) {
+        esp_log_level_set(string(tags[i]).c_str(), ESP_LOG_DEBUG);
+    }
+
+    atomic<int> errors(0);
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&tags, &errors, t]() {
+            for (int n = 0; n < 1000; n++) {
+                for (int i = t; i < tag_count; i++) {
+                    esp_log_level_t expected = (i % 2 == 0) ? ESP_LOG_DEBUG : ESP_LOG_WARN;
+                    if (esp_log_level_get(tags[i].c_str()) != expected) {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    CHECK(errors == 0);
+
+    esp_log_level_set("tag1", ESP_LOG_VERBOSE);
+    CHECK(esp_log_level_get(tags[1].c_str()) == ESP_LOG_VERBOSE);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    CHECK(esp_log_level_get(tags[0].c_str()) == ESP_LOG_ERROR);
+    CHECK(esp_log_level_get(tags[1].c_str()) == ESP_LOG_ERROR);
+}
+
+static double filtered_log_calls_per_us(const vector<string> &tags, int thread_count)
+{
+    const int calls_per_thread = 2000000;
+    vector<thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&tags, t]() {
+            for (int n = 0; n < calls_per_thread; n++) {
+                const char *tag = tags[(n + t) % tags.size()].c_str();
+                ESP_LOGD(tag, "filtered out %d", n);
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return calls_per_thread * thread_count / elapsed.count();
+}
+
+TEST_CASE("filtered out log call throughput", "[bench]")
+{
+    vector<string> tags;
+    BasicLogFixture fix(ESP_LOG_INFO);
+
+    for (int i = 0; i < 128; i++) {
+        tags.push_back("bench" + to_string(i));
+    }
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        printf("filtered out log calls, %d threads: %.1f per us\n", threads, filtered_log_calls_per_us(tags, threads));
+    }
+}
@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "sdkconfig.h"
 #include "esp_rom_sys.h"
 #if CONFIG_IDF_TARGET_ESP32
@@ -156,6 +158,51 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
  */
 void esp_log_writev(esp_log_level_t level, const char* tag, const char* format, va_list args);
 
+/**
+ * @brief Switch deferred logging on or off
+ *
+ * In deferred mode, log messages which pass the level check are not formatted by the caller.
+ * The format string pointer, the tag pointer and the arguments are copied into a buffer of the
+ * current CPU, and formatted later by esp_log_deferred_flush(). On FreeRTOS, a low-priority task
+ * calling esp_log_deferred_flush() periodically is created the first time deferred mode is switched on.
+ *
+ * Because only the pointer to the format string is kept, format strings must remain valid until
+ * the message is printed, which is the case for the string literals used by ESP_LOGx macros.
+ * Strings passed as ``%s`` arguments are copied (truncated if very long).
+ *
+ * Messages are printed in order for each CPU. Messages which don't fit into the buffer are dropped,
+ * see esp_log_deferred_get_dropped().
+ *
+ * Switching deferred mode off prints all pending messages. If another task is flushing the messages
+ * at that time, this function waits until it is done.
+ *
+ * @note Only available if CONFIG_LOG_DEFERRED is enabled.
+ *
+ * @param deferred  true to defer log output, false to print messages on the calling task
+ */
+void esp_log_set_deferred(bool deferred);
+
+/**
+ * @brief Print pending deferred log messages
+ *
+ * Formats the messages collected in deferred mode and writes them using the function set by
+ * esp_log_set_vprintf(). If another task is flushing the messages already, returns immediately.
+ *
+ * @note Only available if CONFIG_LOG_DEFERRED is enabled.
+ *
+ * @return Number of messages printed
+ */
+size_t esp_log_deferred_flush(void);
+
+/**
+ * @brief Get the number of deferred log messages dropped because their buffer was full
+ *
+ * @note Only available if CONFIG_LOG_DEFERRED is enabled.
+ *
+ * @return Number of dropped messages since startup
+ */
+uint32_t esp_log_deferred_get_dropped(void);
+
 /** @cond */
 
 #include "esp_log_internal.h"
@@ -13,18 +13,20 @@
  * To avoid looking up log level for given tag each time message is
  * printed, this library caches pointers to tags. Because the suggested
  * way of creating tags uses one 'TAG' constant per file, this caching
- * should be effective. Cache is a binary min-heap of cached_tag_entry_t
- * items, ordering is done on 'generation' member. In this context,
- * generation is an integer which is incremented each time an operation
- * with cache is performed. When cache is full, new item is inserted in
- * place of an oldest item (that is, with smallest 'generation' value).
- * After that, bubble-down operation is performed to fix ordering in the
- * min-heap.
+ * should be effective. The cache is an open-addressing hash table keyed
+ * by tag pointer, which is read without taking any lock:
  *
- * The potential problem with wrap-around of cache generation counter is
- * ignored for now. This will happen if someone happens to output more
- * than 4 billion log entries, at which point wrap-around will not be
- * the biggest problem.
+ * - Slots are only ever filled, never emptied or reused for another tag,
+ *   so once a reader finds its tag pointer in a slot, the slot belongs to
+ *   that tag for good. The level of a slot is a single byte, which
+ *   esp_log_level_set updates in place.
+ * - Slots are filled with esp_log_impl_lock held, after looking up the tag
+ *   in the linked list (tags are hashed to make this quicker). The level is
+ *   written before the tag pointer is published.
+ * - When the table gets half full, a table twice as large is filled and
+ *   published in place of the old one. Old tables are not freed because a
+ *   reader may still be walking them. As tables double in size, the retired
+ *   ones never take more memory than the current table.
  *
  */
 
@@ -35,6 +37,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "esp_log_private.h"
 
@@ -47,26 +50,38 @@
 
 #include "sys/queue.h"
 
-// Number of tags to be cached. Must be 2**n - 1, n >= 2.
-#define TAG_CACHE_SIZE 31
+// Number of slots of the initial, statically allocated tag cache. Must be a power of 2.
+#define TAG_CACHE_INITIAL_BITS 5
+// The cache stops growing at this many slots, tags which don't fit are looked up in the linked list
+#define TAG_CACHE_MAX_BITS 12
 
 typedef struct {
-    const char *tag;
-    uint32_t level : 3;
-    uint32_t generation : 29;
+    _Atomic(const char *) tag;
+    _Atomic uint8_t level;  // esp_log_level_t as uint8_t
 } cached_tag_entry_t;
 
+typedef struct {
+    uint32_t bits;          // the table has 2**bits slots
+    uint32_t count;         // number of slots in use, only accessed with esp_log_impl_lock held
+    cached_tag_entry_t slots[0];
+} tag_cache_t;
+
 typedef struct uncached_tag_entry_ {
     SLIST_ENTRY(uncached_tag_entry_) entries;
+    uint32_t hash;  // hash of the tag string
     uint8_t level;  // esp_log_level_t as uint8_t
     char tag[0];    // beginning of a zero-terminated string
 } uncached_tag_entry_t;
 
 esp_log_level_t esp_log_default_level = CONFIG_LOG_DEFAULT_LEVEL;
 static SLIST_HEAD(log_tags_head, uncached_tag_entry_) s_log_tags = SLIST_HEAD_INITIALIZER(s_log_tags);
-static cached_tag_entry_t s_log_cache[TAG_CACHE_SIZE];
-static uint32_t s_log_cache_max_generation = 0;
-static uint32_t s_log_cache_entry_count = 0;
+static struct {
+    tag_cache_t header;
+    cached_tag_entry_t slots[1 << TAG_CACHE_INITIAL_BITS];
+} s_log_cache_initial = {
+    .header = { .bits = TAG_CACHE_INITIAL_BITS },
+};
+static _Atomic(tag_cache_t *) s_log_cache = &s_log_cache_initial.header;
 static vprintf_like_t s_log_print_func = &vprintf;
 
 #ifdef LOG_BUILTIN_CHECKS
@@ -77,10 +92,10 @@ static uint32_t s_log_cache_misses = 0;
 static inline bool get_cached_log_level(const char *tag, esp_log_level_t *level);
 static inline bool get_uncached_log_level(const char *tag, esp_log_level_t *level);
 static inline void add_to_cache(const char *tag, esp_log_level_t level);
-static void heap_bubble_down(int index);
-static inline void heap_swap(int i, int j);
+static inline uint32_t tag_hash(const char *tag);
 static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag);
 static inline void clear_log_level_list(void);
+static void update_cached_levels(const char *tag, esp_log_level_t level);
 
 vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
 {
@@ -95,18 +110,20 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
 {
     esp_log_impl_lock();
 
-    // for wildcard tag, remove all linked list items and clear the cache
+    // for wildcard tag, remove all linked list items and set the level of all cached tags
     if (strcmp(tag, "*") == 0) {
         esp_log_default_level = level;
         clear_log_level_list();
+        update_cached_levels(NULL, level);
         esp_log_impl_unlock();
         return;
     }
 
     // search for existing tag
+    uint32_t hash = tag_hash(tag);
     uncached_tag_entry_t *it = NULL;
     SLIST_FOREACH(it, &s_log_tags, entries) {
-        if (strcmp(it->tag, tag) == 0) {
+        if (it->hash == hash && strcmp(it->tag, tag) == 0) {
             // one tag in the linked list matched, update the level
             it->level = level;
             // quit with it != NULL
@@ -123,33 +140,26 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
             esp_log_impl_unlock();
             return;
         }
+        new_entry->hash = hash;
         new_entry->level = (uint8_t) level;
         memcpy(new_entry->tag, tag, tag_len); // we know the size and strncpy would trigger a compiler warning here
         SLIST_INSERT_HEAD(&s_log_tags, new_entry, entries);
     }
 
-    // search in the cache and update the entry it if exists
-    for (uint32_t i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (strcmp(s_log_cache[i].tag, tag) == 0) {
-            s_log_cache[i].level = level;
-            break;
-        }
-    }
+    // update the cache entries of all pointers to this tag
+    update_cached_levels(tag, level);
     esp_log_impl_unlock();
 }
 
 
-/* Common code for getting the log level from cache, esp_log_impl_lock()
-   should be called before calling this function. The function unlocks,
-   as indicated in the name.
+/* Common code for getting the log level of a tag missing from the cache,
+   esp_log_impl_lock() should be called before calling this function.
+   The function unlocks, as indicated in the name.
 */
 static esp_log_level_t s_log_level_get_and_unlock(const char *tag)
 {
     esp_log_level_t level_for_tag;
-    // Look for the tag in cache first, then in the linked list of all tags
+    // Another task may have added the tag to the cache in the meantime
     if (!get_cached_log_level(tag, &level_for_tag)) {
         if (!get_uncached_log_level(tag, &level_for_tag)) {
             level_for_tag = esp_log_default_level;
@@ -166,6 +176,10 @@ static esp_log_level_t s_log_level_get_and_unlock(const char *tag)
 
 esp_log_level_t esp_log_level_get(const char *tag)
 {
+    esp_log_level_t level_for_tag;
+    if (get_cached_log_level(tag, &level_for_tag)) {
+        return level_for_tag;
+    }
     esp_log_impl_lock();
     return s_log_level_get_and_unlock(tag);
 }
@@ -177,8 +191,6 @@ void clear_log_level_list(void)
         SLIST_REMOVE_HEAD(&s_log_tags, entries);
         free(it);
     }
-    s_log_cache_entry_count = 0;
-    s_log_cache_max_generation = 0;
 #ifdef LOG_BUILTIN_CHECKS
     s_log_cache_misses = 0;
 #endif
@@ -189,18 +201,41 @@ void esp_log_writev(esp_log_level_t level,
                    const char *format,
                    va_list args)
 {
-    if (!esp_log_impl_lock_timeout()) {
-        return;
+    esp_log_level_t level_for_tag;
+    if (!get_cached_log_level(tag, &level_for_tag)) {
+        if (!esp_log_impl_lock_timeout()) {
+            return;
+        }
+        level_for_tag = s_log_level_get_and_unlock(tag);
     }
-    esp_log_level_t level_for_tag = s_log_level_get_and_unlock(tag);
     if (!should_output(level, level_for_tag)) {
         return;
     }
+#if CONFIG_LOG_DEFERRED && !BOOTLOADER_BUILD
+    if (esp_log_deferred_writev(level, tag, format, args)) {
+        return;
+    }
+#endif
 
     (*s_log_print_func)(format, args);
 
 }
 
+#if CONFIG_LOG_DEFERRED && !BOOTLOADER_BUILD
+static void print_formatted(const char *format, ...)
+{
+    va_list list;
+    va_start(list, format);
+    (*s_log_print_func)(format, list);
+    va_end(list);
+}
+
+void esp_log_print_str(const char *str)
+{
+    print_formatted("%s", str);
+}
+#endif
+
 void esp_log_write(esp_log_level_t level,
                    const char *tag,
                    const char *format, ...)
@@ -211,71 +246,99 @@ void esp_log_write(esp_log_level_t level,
     va_end(list);
 }
 
+static inline uint32_t tag_slot(const tag_cache_t *cache, const char *tag)
+{
+    // Fibonacci hashing of the pointer, the upper bits are the best mixed
+    return ((uint32_t) (uintptr_t) tag * 2654435769u) >> (32 - cache->bits);
+}
+
 static inline bool get_cached_log_level(const char *tag, esp_log_level_t *level)
 {
-    // Look for `tag` in cache
-    uint32_t i;
-    for (i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (s_log_cache[i].tag == tag) {
-            break;
+    // Look for `tag` in cache, this doesn't need the lock
+    const tag_cache_t *cache = atomic_load_explicit(&s_log_cache, memory_order_acquire);
+    uint32_t mask = (1 << cache->bits) - 1;
+    for (uint32_t i = tag_slot(cache, tag); ; i = (i + 1) & mask) {
+        const char *slot_tag = atomic_load_explicit(&cache->slots[i].tag, memory_order_acquire);
+        if (slot_tag == tag) {
+            *level = (esp_log_level_t) atomic_load_explicit(&cache->slots[i].level, memory_order_relaxed);
+            return true;
+        }
+        if (slot_tag == NULL) { // Not found in cache
+            return false;
         }
     }
-    if (i == s_log_cache_entry_count) { // Not found in cache
-        return false;
-    }
-    // Return level from cache
-    *level = (esp_log_level_t) s_log_cache[i].level;
-    // If cache has been filled, start taking ordering into account
-    // (other options are: dynamically resize cache, add "dummy" entries
-    //  to the cache; this option was chosen because code is much simpler,
-    //  and the unfair behavior of cache will show it self at most once, when
-    //  it has just been filled)
-    if (s_log_cache_entry_count == TAG_CACHE_SIZE) {
-        // Update item generation
-        s_log_cache[i].generation = s_log_cache_max_generation++;
-        // Restore heap ordering
-        heap_bubble_down(i);
+}
+
+static void insert_into_cache(tag_cache_t *cache, const char *tag, esp_log_level_t level)
+{
+    uint32_t mask = (1 << cache->bits) - 1;
+    uint32_t i = tag_slot(cache, tag);
+    while (atomic_load_explicit(&cache->slots[i].tag, memory_order_relaxed) != NULL) {
+        i = (i + 1) & mask;
     }
-    return true;
+    // Readers may see the slot as soon as the tag is stored, so store the level first
+    atomic_store_explicit(&cache->slots[i].level, level, memory_order_relaxed);
+    atomic_store_explicit(&cache->slots[i].tag, tag, memory_order_release);
+    cache->count++;
 }
 
 static inline void add_to_cache(const char *tag, esp_log_level_t level)
 {
-    uint32_t generation = s_log_cache_max_generation++;
-    // First consider the case when cache is not filled yet.
-    // In this case, just add new entry at the end.
-    // This happens to satisfy binary min-heap ordering.
-    if (s_log_cache_entry_count < TAG_CACHE_SIZE) {
-        s_log_cache[s_log_cache_entry_count] = (cached_tag_entry_t) {
-            .generation = generation,
-            .level = level,
-            .tag = tag
-        };
-        ++s_log_cache_entry_count;
-        return;
+    tag_cache_t *cache = atomic_load_explicit(&s_log_cache, memory_order_relaxed);
+    // Keep the cache at most half full, so that lookups of missing tags stay short
+    if ((cache->count + 1) * 2 > (1u << cache->bits)) {
+        if (cache->bits == TAG_CACHE_MAX_BITS) {
+            return;
+        }
+        uint32_t bits = cache->bits + 1;
+        tag_cache_t *new_cache = calloc(1, sizeof(tag_cache_t) + sizeof(cached_tag_entry_t) * (1 << bits));
+        if (new_cache == NULL) {
+            return;
+        }
+        new_cache->bits = bits;
+        for (uint32_t i = 0; i < (1u << cache->bits); i++) {
+            const char *slot_tag = atomic_load_explicit(&cache->slots[i].tag, memory_order_relaxed);
+            if (slot_tag != NULL) {
+                insert_into_cache(new_cache, slot_tag, atomic_load_explicit(&cache->slots[i].level, memory_order_relaxed));
+            }
+        }
+        // The old table is kept, readers may still be using it
+        atomic_store_explicit(&s_log_cache, new_cache, memory_order_release);
+        cache = new_cache;
     }
+    insert_into_cache(cache, tag, level);
+}
+
+/* Set the level of all cached tags equal to `tag`, or of all of them if `tag` is NULL */
+static void update_cached_levels(const char *tag, esp_log_level_t level)
+{
+    tag_cache_t *cache = atomic_load_explicit(&s_log_cache, memory_order_relaxed);
+    for (uint32_t i = 0; i < (1u << cache->bits); i++) {
+        const char *slot_tag = atomic_load_explicit(&cache->slots[i].tag, memory_order_relaxed);
+        if (slot_tag != NULL && (tag == NULL || strcmp(slot_tag, tag) == 0)) {
+            atomic_store_explicit(&cache->slots[i].level, level, memory_order_relaxed);
+        }
+    }
+}
 
-    // Cache is full, so we replace the oldest entry (which is at index 0
-    // because this is a min-heap) with the new one, and do bubble-down
-    // operation to restore min-heap ordering.
-    s_log_cache[0] = (cached_tag_entry_t) {
-        .tag = tag,
-        .level = level,
-        .generation = generation
-    };
-    heap_bubble_down(0);
+static inline uint32_t tag_hash(const char *tag)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*tag) {
+        hash = (hash ^ (uint8_t) *tag++) * 16777619u;
+    }
+    return hash;
 }
 
 static inline bool get_uncached_log_level(const char *tag, esp_log_level_t *level)
 {
     // Walk the linked list of all tags and see if given tag is present in the list.
-    // This is slow because tags are compared as strings.
+    // Tags are compared as strings only if their hashes match.
+    uint32_t hash = tag_hash(tag);
     uncached_tag_entry_t *it;
     SLIST_FOREACH(it, &s_log_tags, entries) {
-        if (strcmp(tag, it->tag) == 0) {
+        if (it->hash == hash && strcmp(tag, it->tag) == 0) {
             *level = it->level;
             return true;
         }
@@ -287,21 +350,3 @@ static inline bool should_output(esp_log_level_t level_for_message, esp_log_leve
 {
     return level_for_message <= level_for_tag;
 }
-
-static void heap_bubble_down(int index)
-{
-    while (index < TAG_CACHE_SIZE / 2) {
-        int left_index = index * 2 + 1;
-        int right_index = left_index + 1;
-        int next = (s_log_cache[left_index].generation < s_log_cache[right_index].generation) ? left_index : right_index;
-        heap_swap(index, next);
-        index = next;
-    }
-}
-
-static inline void heap_swap(int i, int j)
-{
-    cached_tag_entry_t tmp = s_log_cache[i];
-    s_log_cache[i] = s_log_cache[j];
-    s_log_cache[j] = tmp;
-}
@@ -0,0 +1,531 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Deferred logging.
+ *
+ * In deferred mode, esp_log_writev() doesn't format the message. It parses the
+ * format string only to learn the types of the arguments, and copies a record
+ * made of the format string pointer, the tag pointer and the raw argument values
+ * into a ring buffer of the current CPU. esp_log_deferred_flush() later walks the
+ * format string again and formats the record one conversion at a time.
+ *
+ * Each ring has a single consumer (the flushing task, serialized by s_flushing)
+ * and is written only by its own CPU, with the platform layer keeping other
+ * writers of that CPU out while a record is copied (see esp_log_impl_deferred_enter).
+ * Head and tail are free-running byte counters, so the buffer size must be a power
+ * of two. Records never wrap around the end of the buffer: when a record doesn't
+ * fit at the end, the rest of the buffer is filled with a padding record.
+ */
+
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_log_private.h"
+
+_Static_assert((CONFIG_LOG_DEFERRED_BUFFER_SIZE & (CONFIG_LOG_DEFERRED_BUFFER_SIZE - 1)) == 0,
+               "CONFIG_LOG_DEFERRED_BUFFER_SIZE must be a power of two");
+
+#define BUFFER_MASK             (CONFIG_LOG_DEFERRED_BUFFER_SIZE - 1)
+// Largest space taken by the arguments of a message. Longer strings are truncated to fit.
+#define RECORD_ARGS_MAX         192
+// Longest string argument copied into a record
+#define RECORD_STR_MAX          UINT8_MAX
+// Longest line printed by esp_log_deferred_flush()
+#define LINE_MAX_LEN            256
+
+// Size of the part of the header present in padding records
+#define RECORD_PAD_SIZE         4
+
+#define RECORD_FLAG_PAD         (1 << 0)    // skip to the start of the buffer
+#define RECORD_FLAG_TRUNCATED   (1 << 1)    // some arguments didn't fit into the record
+
+#define ALIGN_UP(num, align)    (((num) + ((align) - 1)) & ~((align) - 1))
+
+typedef struct {
+    uint16_t size;          // size of the record including this header, multiple of 4
+    uint8_t level;
+    uint8_t flags;
+    // padding records end here, RECORD_PAD_SIZE bytes
+    const char *format;
+    const char *tag;
+} record_header_t;
+
+typedef struct {
+    atomic_uint head;       // advanced by the consumer
+    atomic_uint tail;       // advanced by the writers of this buffer's CPU
+    uint32_t dropped;
+    uint32_t dropped_reported;
+    uint8_t buf[CONFIG_LOG_DEFERRED_BUFFER_SIZE] __attribute__((aligned(4)));
+} log_ring_t;
+
+typedef enum {
+    ARG_NONE,       // no argument (%%, unknown conversions)
+    ARG_SKIP_PTR,   // pointer which is consumed but not recorded (%n, wide strings)
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_INTMAX,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR,
+} arg_type_t;
+
+typedef struct {
+    const char *start;      // the '%' character
+    const char *end;        // one past the conversion character
+    int stars;              // number of '*' width and precision arguments
+    int precision;          // -1 if none, or given by the last '*' argument
+    bool precision_star;
+    arg_type_t type;
+} conversion_t;
+
+static log_ring_t s_rings[ESP_LOG_DEFERRED_BUFFERS];
+static volatile bool s_deferred = false;
+static bool s_started = false;
+static atomic_bool s_flushing = false;
+static char s_line[LINE_MAX_LEN];
+
+/* Find the next conversion specification in a format string, starting at p.
+   Returns false if there are no more conversions. */
+static bool next_conversion(const char *p, conversion_t *conv)
+{
+    p = strchr(p, '%');
+    if (p == NULL) {
+        return false;
+    }
+    conv->start = p++;
+    conv->stars = 0;
+    conv->precision = -1;
+    conv->precision_star = false;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    if (*p == '*') {
+        conv->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            conv->stars++;
+            conv->precision_star = true;
+            p++;
+        } else {
+            conv->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                conv->precision = conv->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    arg_type_t int_type = ARG_INT;
+    bool long_double = false;
+    switch (*p) {
+    case 'h':
+        p += (p[1] == 'h') ? 2 : 1;
+        break;
+    case 'l':
+        int_type = (p[1] == 'l') ? ARG_LLONG : ARG_LONG;
+        p += (p[1] == 'l') ? 2 : 1;
+        break;
+    case 'z':
+        int_type = ARG_SIZE;
+        p++;
+        break;
+    case 't':
+        int_type = ARG_PTRDIFF;
+        p++;
+        break;
+    case 'j':
+        int_type = ARG_INTMAX;
+        p++;
+        break;
+    case 'L':
+        long_double = true;
+        p++;
+        break;
+    default:
+        break;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+        conv->type = int_type;
+        break;
+    case 'c':
+        conv->type = ARG_INT;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        conv->type = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+        break;
+    case 's':
+        conv->type = (int_type == ARG_LONG) ? ARG_SKIP_PTR : ARG_STR;
+        break;
+    case 'p':
+        conv->type = ARG_PTR;
+        break;
+    case 'n':
+        conv->type = ARG_SKIP_PTR;
+        break;
+    case '\0':
+        // A lone '%' at the end of the string, print it as it is
+        conv->type = ARG_NONE;
+        conv->end = p;
+        return true;
+    default:
+        conv->type = ARG_NONE;
+        break;
+    }
+    conv->end = p + 1;
+    return true;
+}
+
+static size_t arg_size(arg_type_t type)
+{
+    switch (type) {
+    case ARG_INT:       return sizeof(int);
+    case ARG_LONG:      return sizeof(long);
+    case ARG_LLONG:     return sizeof(long long);
+    case ARG_SIZE:      return sizeof(size_t);
+    case ARG_PTRDIFF:   return sizeof(ptrdiff_t);
+    case ARG_INTMAX:    return sizeof(intmax_t);
+    case ARG_DOUBLE:    return sizeof(double);
+    case ARG_LDOUBLE:   return sizeof(long double);
+    case ARG_PTR:       return sizeof(void *);
+    default:            return 0;
+    }
+}
+
+/* Copy the arguments of a message into args, in the order of the format string.
+   Returns the number of bytes used, sets *truncated if some of them didn't fit. */
+static size_t encode_args(uint8_t *args, const char *format, va_list list, bool *truncated)
+{
+    size_t pos = 0;
+    conversion_t conv;
+    const char *p = format;
+
+    *truncated = false;
+    while (next_conversion(p, &conv)) {
+        p = conv.end;
+        for (int i = 0; i < conv.stars; i++) {
+            int star = va_arg(list, int);
+            if (pos + sizeof(star) > RECORD_ARGS_MAX) {
+                *truncated = true;
+                return pos;
+            }
+            memcpy(args + pos, &star, sizeof(star));
+            pos += sizeof(star);
+            if (conv.precision_star && i == conv.stars - 1) {
+                // A negative precision is taken as if it were omitted
+                conv.precision = (star >= 0) ? star : -1;
+            }
+        }
+
+        union {
+            int i;
+            long l;
+            long long ll;
+            size_t z;
+            ptrdiff_t t;
+            intmax_t j;
+            double d;
+            long double ld;
+            void *p;
+        } value;
+
+        switch (conv.type) {
+        case ARG_NONE:
+            continue;
+        case ARG_SKIP_PTR:
+            (void) va_arg(list, void *);
+            continue;
+        case ARG_STR: {
+            const char *str = va_arg(list, const char *);
+            if (str == NULL) {
+                str = "(null)";
+            }
+            if (pos + 1 > RECORD_ARGS_MAX) {
+                *truncated = true;
+                return pos;
+            }
+            // Like printf, don't read past the precision, the string needn't be terminated there
+            size_t max_len = RECORD_STR_MAX;
+            if (conv.precision >= 0 && conv.precision < RECORD_STR_MAX) {
+                max_len = conv.precision;
+            }
+            size_t len = strnlen(str, max_len);
+            if (len > RECORD_ARGS_MAX - pos - 1) {
+                len = RECORD_ARGS_MAX - pos - 1;
+            }
+            args[pos++] = (uint8_t) len;
+            memcpy(args + pos, str, len);
+            pos += len;
+            continue;
+        }
+        case ARG_INT:       value.i = va_arg(list, int);                break;
+        case ARG_LONG:      value.l = va_arg(list, long);               break;
+        case ARG_LLONG:     value.ll = va_arg(list, long long);         break;
+        case ARG_SIZE:      value.z = va_arg(list, size_t);             break;
+        case ARG_PTRDIFF:   value.t = va_arg(list, ptrdiff_t);          break;
+        case ARG_INTMAX:    value.j = va_arg(list, intmax_t);           break;
+        case ARG_DOUBLE:    value.d = va_arg(list, double);             break;
+        case ARG_LDOUBLE:   value.ld = va_arg(list, long double);       break;
+        case ARG_PTR:       value.p = va_arg(list, void *);             break;
+        }
+
+        size_t size = arg_size(conv.type);
+        if (pos + size > RECORD_ARGS_MAX) {
+            *truncated = true;
+            return pos;
+        }
+        memcpy(args + pos, &value, size);
+        pos += size;
+    }
+    return pos;
+}
+
+static void append(char *line, size_t *len, const char *str, size_t str_len)
+{
+    size_t room = LINE_MAX_LEN - 1 - *len;
+    if (str_len > room) {
+        str_len = room;
+    }
+    memcpy(line + *len, str, str_len);
+    *len += str_len;
+    line[*len] = '\0';
+}
+
+#define FORMAT_ARG(dst, room, spec, stars, star, value) \
+    ((stars) == 0 ? snprintf(dst, room, spec, value) : \
+     (stars) == 1 ? snprintf(dst, room, spec, star[0], value) : \
+                    snprintf(dst, room, spec, star[0], star[1], value))
+
+/* Format a record into s_line. Returns the length of the line. */
+static size_t format_record(const record_header_t *header, const uint8_t *args, size_t args_len)
+{
+    size_t len = 0;
+    size_t pos = 0;
+    bool complete = true;
+    conversion_t conv;
+    const char *p = header->format;
+
+    s_line[0] = '\0';
+    while (next_conversion(p, &conv)) {
+        append(s_line, &len, p, conv.start - p);
+        p = conv.end;
+
+        int star[2];
+        char spec[24];
+        size_t spec_len = conv.end - conv.start;
+        size_t size = arg_size(conv.type);
+        if (conv.type == ARG_NONE) {
+            if (spec_len == 2 && conv.start[1] == '%') {
+                append(s_line, &len, "%", 1);
+            } else {
+                append(s_line, &len, conv.start, spec_len);
+            }
+            continue;
+        }
+        if (conv.type == ARG_SKIP_PTR) {
+            continue;
+        }
+        if (pos + conv.stars * sizeof(int) + (conv.type == ARG_STR ? 1 : size) > args_len
+                || spec_len >= sizeof(spec)) {
+            complete = false;
+            break;
+        }
+        memcpy(star, args + pos, conv.stars * sizeof(int));
+        pos += conv.stars * sizeof(int);
+        memcpy(spec, conv.start, spec_len);
+        spec[spec_len] = '\0';
+
+        char *dst = s_line + len;
+        size_t room = LINE_MAX_LEN - len;
+        int n = 0;
+        union {
+            int i;
+            long l;
+            long long ll;
+            size_t z;
+            ptrdiff_t t;
+            intmax_t j;
+            double d;
+            long double ld;
+            void *p;
+        } value;
+        if (conv.type == ARG_STR) {
+            char str[RECORD_STR_MAX + 1];
+            size_t str_len = args[pos++];
+            if (pos + str_len > args_len) {
+                complete = false;
+                break;
+            }
+            memcpy(str, args + pos, str_len);
+            str[str_len] = '\0';
+            pos += str_len;
+            n = FORMAT_ARG(dst, room, spec, conv.stars, star, str);
+        } else {
+            memcpy(&value, args + pos, size);
+            pos += size;
+            switch (conv.type) {
+            case ARG_INT:       n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.i);     break;
+            case ARG_LONG:      n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.l);     break;
+            case ARG_LLONG:     n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.ll);    break;
+            case ARG_SIZE:      n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.z);     break;
+            case ARG_PTRDIFF:   n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.t);     break;
+            case ARG_INTMAX:    n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.j);     break;
+            case ARG_DOUBLE:    n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.d);     break;
+            case ARG_LDOUBLE:   n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.ld);    break;
+            case ARG_PTR:       n = FORMAT_ARG(dst, room, spec, conv.stars, star, value.p);     break;
+            default:            break;
+            }
+        }
+        if (n > 0) {
+            len += ((size_t) n < room) ? (size_t) n : room - 1;
+        }
+    }
+
+    if (complete) {
+        append(s_line, &len, p, strlen(p));
+    } else {
+        // Ran out of arguments, the record was truncated
+        append(s_line, &len, "...\n", 4);
+    }
+    if (len == LINE_MAX_LEN - 1 && s_line[len - 1] != '\n') {
+        s_line[len - 1] = '\n';
+    }
+    return len;
+}
+
+bool esp_log_deferred_writev(esp_log_level_t level, const char *tag, const char *format, va_list args)
+{
+    if (!s_deferred) {
+        return false;
+    }
+
+    struct {
+        record_header_t header;
+        uint8_t args[RECORD_ARGS_MAX];
+    } record;
+    bool truncated;
+    size_t args_len = encode_args(record.args, format, args, &truncated);
+    size_t size = ALIGN_UP(sizeof(record_header_t) + args_len, 4);
+    record.header = (record_header_t) {
+        .size = size,
+        .level = level,
+        .flags = truncated ? RECORD_FLAG_TRUNCATED : 0,
+        .format = format,
+        .tag = tag,
+    };
+
+    uint32_t state;
+    log_ring_t *ring = &s_rings[esp_log_impl_deferred_enter(&state)];
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t offset = tail & BUFFER_MASK;
+    uint32_t pad = (offset + size > CONFIG_LOG_DEFERRED_BUFFER_SIZE) ? CONFIG_LOG_DEFERRED_BUFFER_SIZE - offset : 0;
+
+    if (CONFIG_LOG_DEFERRED_BUFFER_SIZE - (tail - head) < pad + size) {
+        ring->dropped++;
+        esp_log_impl_deferred_exit(state);
+        return true;
+    }
+    if (pad != 0) {
+        record_header_t pad_header = { .size = pad, .flags = RECORD_FLAG_PAD };
+        memcpy(ring->buf + offset, &pad_header, RECORD_PAD_SIZE);
+        offset = 0;
+    }
+    memcpy(ring->buf + offset, &record, size);
+    atomic_store_explicit(&ring->tail, tail + pad + size, memory_order_release);
+    esp_log_impl_deferred_exit(state);
+    return true;
+}
+
+/* Print the records of all rings. The caller must have set s_flushing. */
+static size_t flush_rings(void)
+{
+    size_t count = 0;
+    for (int i = 0; i < ESP_LOG_DEFERRED_BUFFERS; i++) {
+        log_ring_t *ring = &s_rings[i];
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        while (head != tail) {
+            const uint8_t *data = ring->buf + (head & BUFFER_MASK);
+            record_header_t header;
+            memcpy(&header, data, RECORD_PAD_SIZE);
+            if (!(header.flags & RECORD_FLAG_PAD)) {
+                memcpy(&header, data, sizeof(header));
+                format_record(&header, data + sizeof(header), header.size - sizeof(header));
+                esp_log_print_str(s_line);
+                count++;
+            }
+            head += header.size;
+            // The space is given back only after the record is formatted, its arguments are read in place
+            atomic_store_explicit(&ring->head, head, memory_order_release);
+        }
+
+        uint32_t dropped = ring->dropped;
+        if (dropped != ring->dropped_reported) {
+            snprintf(s_line, sizeof(s_line), "W: %u deferred log messages dropped\n",
+                     (unsigned) (dropped - ring->dropped_reported));
+            esp_log_print_str(s_line);
+            ring->dropped_reported = dropped;
+        }
+    }
+    return count;
+}
+
+size_t esp_log_deferred_flush(void)
+{
+    if (atomic_exchange(&s_flushing, true)) {
+        return 0;
+    }
+    size_t count = flush_rings();
+    atomic_store(&s_flushing, false);
+    return count;
+}
+
+uint32_t esp_log_deferred_get_dropped(void)
+{
+    uint32_t dropped = 0;
+    for (int i = 0; i < ESP_LOG_DEFERRED_BUFFERS; i++) {
+        dropped += s_rings[i].dropped;
+    }
+    return dropped;
+}
+
+void esp_log_set_deferred(bool deferred)
+{
+    if (deferred && !s_started) {
+        s_started = true;
+        esp_log_impl_deferred_start();
+    }
+    s_deferred = deferred;
+    if (!deferred) {
+        // A flush which is running may have missed the latest messages, wait for it and flush again
+        while (atomic_exchange(&s_flushing, true)) {
+            esp_log_impl_deferred_wait();
+        }
+        flush_rings();
+        atomic_store(&s_flushing, false);
+    }
+}
@@ -26,6 +26,10 @@
 
 static SemaphoreHandle_t s_log_mutex = NULL;
 
+#if CONFIG_LOG_DEFERRED
+static TaskHandle_t s_deferred_task = NULL;
+#endif
+
 void esp_log_impl_lock(void)
 {
     if (unlikely(!s_log_mutex)) {
@@ -56,6 +60,46 @@ void esp_log_impl_unlock(void)
     xSemaphoreGive(s_log_mutex);
 }
 
+#if CONFIG_LOG_DEFERRED
+unsigned esp_log_impl_deferred_enter(uint32_t *state)
+{
+    // With interrupts disabled, nothing else can write to the buffer of this CPU,
+    // and the task can't be moved to the other CPU
+    *state = portSET_INTERRUPT_MASK_FROM_ISR();
+#if ESP_LOG_DEFERRED_BUFFERS > 1
+    return xPortGetCoreID();
+#else
+    return 0;
+#endif
+}
+
+void esp_log_impl_deferred_exit(uint32_t state)
+{
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+static void deferred_log_task(void *arg)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_LOG_DEFERRED_TASK_PERIOD_MS));
+        esp_log_deferred_flush();
+    }
+}
+
+void esp_log_impl_deferred_start(void)
+{
+    if (s_deferred_task == NULL) {
+        xTaskCreate(deferred_log_task, "log_deferred", 3072, NULL, CONFIG_LOG_DEFERRED_TASK_PRIORITY, &s_deferred_task);
+    }
+}
+
+void esp_log_impl_deferred_wait(void)
+{
+    // The flushing task may have a lower priority, block so that it can finish
+    vTaskDelay(1);
+}
+#endif
+
 char *esp_log_system_timestamp(void)
 {
     static char buffer[18] = {0};
@@ -13,13 +13,19 @@
 // limitations under the License.
 
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include "esp_log_private.h"
 
 static pthread_mutex_t mutex1 = PTHREAD_MUTEX_INITIALIZER;
 
+#if CONFIG_LOG_DEFERRED
+static atomic_flag s_deferred_lock = ATOMIC_FLAG_INIT;
+#endif
+
 void esp_log_impl_lock(void)
 {
     assert(pthread_mutex_lock(&mutex1) == 0);
@@ -36,6 +42,32 @@ void esp_log_impl_unlock(void)
     assert(pthread_mutex_unlock(&mutex1) == 0);
 }
 
+#if CONFIG_LOG_DEFERRED
+unsigned esp_log_impl_deferred_enter(uint32_t *state)
+{
+    // There's a single deferred log buffer on the host, shared by all threads
+    while (atomic_flag_test_and_set_explicit(&s_deferred_lock, memory_order_acquire)) {
+    }
+    *state = 0;
+    return 0;
+}
+
+void esp_log_impl_deferred_exit(uint32_t state)
+{
+    atomic_flag_clear_explicit(&s_deferred_lock, memory_order_release);
+}
+
+void esp_log_impl_deferred_start(void)
+{
+    // No background task on the host, messages are printed by esp_log_deferred_flush()
+}
+
+void esp_log_impl_deferred_wait(void)
+{
+    sched_yield();
+}
+#endif
+
 uint32_t esp_log_timestamp(void)
 {
     struct timespec current_time;
@@ -114,6 +114,11 @@ typedef struct {
  */
 typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
 
+/**
+ * Opaque pointer type representing a blob which is read or written in pieces
+ */
+typedef struct nvs_opaque_blob_stream_t *nvs_blob_stream_t;
+
 /**
  * @brief      Open non-volatile storage with a given namespace from the default NVS partition
  *
@@ -497,6 +502,9 @@ esp_err_t nvs_erase_all(nvs_handle_t handle);
  * to non-volatile storage. Individual implementations may write to storage at other times,
  * but this is not guaranteed.
  *
+ * If CONFIG_NVS_FAST_MOUNT is enabled and the partition has been modified since the last
+ * commit, this also writes the summary record which speeds up the next initialization.
+ *
  * @param[in]  handle  Storage handle obtained with nvs_open.
  *                     Handles that were opened read only cannot be used.
  *
@@ -507,6 +515,285 @@ esp_err_t nvs_erase_all(nvs_handle_t handle);
  */
 esp_err_t nvs_commit(nvs_handle_t handle);
 
+/**
+ * @brief      Start a batch of values which are written to storage at once
+ *
+ * Values set with the nvs_batch_set_* functions are staged in RAM until nvs_batch_commit
+ * is called. The commit writes all of them to a single flash page with one write operation,
+ * so either all new values or all old values are found after a power loss.
+ * Only one batch can be in progress per handle.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *                     Handles that were opened read only cannot be used.
+ *
+ * @return
+ *             - ESP_OK if the batch was started
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if storage handle was opened as read only
+ *             - ESP_ERR_INVALID_STATE if a batch is already in progress on this handle
+ *             - ESP_ERR_NO_MEM if memory for the batch couldn't be allocated
+ */
+esp_err_t nvs_batch_begin(nvs_handle_t handle);
+
+/**@{*/
+/**
+ * @brief      stage int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t or uint64_t value
+ *             in the batch of the handle
+ *
+ * A value staged earlier for the same key in this batch is replaced.
+ *
+ * @param[in]  handle  Handle with a batch started by nvs_batch_begin.
+ * @param[in]  key     Key name. Maximal length is (NVS_KEY_NAME_MAX_SIZE-1) characters. Shouldn't be empty.
+ * @param[in]  value   The value to stage.
+ *
+ * @return
+ *             - ESP_OK if value was staged successfully
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_INVALID_STATE if no batch is in progress on this handle
+ *             - ESP_ERR_NVS_KEY_TOO_LONG if key name is too long
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if the staged values wouldn't fit into a single page
+ *             - ESP_ERR_NO_MEM if memory for the batch couldn't be allocated
+ */
+esp_err_t nvs_batch_set_i8 (nvs_handle_t handle, const char* key, int8_t value);
+
+/**
+ * @brief      stage uint8_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_u8 (nvs_handle_t handle, const char* key, uint8_t value);
+
+/**
+ * @brief      stage int16_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_i16 (nvs_handle_t handle, const char* key, int16_t value);
+
+/**
+ * @brief      stage uint16_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_u16 (nvs_handle_t handle, const char* key, uint16_t value);
+
+/**
+ * @brief      stage int32_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_i32 (nvs_handle_t handle, const char* key, int32_t value);
+
+/**
+ * @brief      stage uint32_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_u32 (nvs_handle_t handle, const char* key, uint32_t value);
+
+/**
+ * @brief      stage int64_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_i64 (nvs_handle_t handle, const char* key, int64_t value);
+
+/**
+ * @brief      stage uint64_t value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ */
+esp_err_t nvs_batch_set_u64 (nvs_handle_t handle, const char* key, uint64_t value);
+
+/**
+ * @brief      stage string in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ * Staged strings count against the size of one page, see nvs_batch_commit.
+ */
+esp_err_t nvs_batch_set_str (nvs_handle_t handle, const char* key, const char* value);
+
+/**
+ * @brief      stage variable length binary value in the batch of the handle
+ *
+ * This function is the same as \c nvs_batch_set_i8 except for the data type.
+ * Unlike nvs_set_blob, a staged blob is never split across pages, so it has to fit
+ * into a single page together with the other staged values.
+ */
+esp_err_t nvs_batch_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+/**@}*/
+
+/**
+ * @brief      Write all values staged in the batch of the handle
+ *
+ * The staged values are written to one flash page with a single write operation and
+ * become visible at once; the old values are erased afterwards. Values which are equal
+ * to the stored ones are skipped. All staged entries together must fit into one page
+ * (126 entries of 32 bytes, of which primitive values take one entry).
+ *
+ * The batch is finished when this function returns, even if writing has failed.
+ *
+ * @param[in]  handle  Handle with a batch started by nvs_batch_begin.
+ *
+ * @return
+ *             - ESP_OK if the values were written successfully
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_INVALID_STATE if no batch is in progress on this handle
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space in the
+ *               underlying storage to save the values
+ *             - ESP_ERR_NVS_REMOVE_FAILED if an old value wasn't erased because flash
+ *               write operation has failed. The new values were written however, and
+ *               the update will be finished after re-initialization of nvs, provided that
+ *               flash operation doesn't fail again.
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_batch_commit(nvs_handle_t handle);
+
+/**
+ * @brief      Discard all values staged in the batch of the handle and finish the batch
+ *
+ * @param[in]  handle  Handle with a batch started by nvs_batch_begin.
+ */
+void nvs_batch_abort(nvs_handle_t handle);
+
+/**
+ * @brief      Open a blob for reading it in pieces
+ *
+ * Unlike nvs_get_blob, the blob doesn't have to be read into one buffer at once.
+ * Data is read from flash directly into the buffers passed to nvs_blob_read_at,
+ * so the memory needed doesn't depend on the size of the blob.
+ * The blob must not be modified while the stream is open.
+ *
+ * @param[in]  handle      Handle obtained from nvs_open function.
+ * @param[in]  key         Key name. Maximal length is (NVS_KEY_NAME_MAX_SIZE-1) characters. Shouldn't be empty.
+ * @param[out] out_stream  Stream to be passed to nvs_blob_read_at, nvs_blob_cmp_at and nvs_blob_close.
+ * @param[out] out_length  Length of the blob in bytes.
+ *
+ * @return
+ *             - ESP_OK if the blob was opened successfully
+ *             - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_KEY_TOO_LONG if key name is too long
+ *             - ESP_ERR_NO_MEM if memory for the stream couldn't be allocated
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_open_read(nvs_handle_t handle, const char* key, nvs_blob_stream_t* out_stream, size_t* out_length);
+
+/**
+ * @brief      Read part of a blob opened with nvs_blob_open_read
+ *
+ * Reading sequentially is the fastest way of accessing a blob, since seeking backwards
+ * has to start over at the first chunk of the blob.
+ *
+ * @param[in]  stream     Stream obtained from nvs_blob_open_read.
+ * @param[in]  offset     Offset within the blob of the first byte to read.
+ * @param[out] out_value  Buffer to read the data into.
+ * @param[in]  length     Number of bytes to read.
+ *
+ * @return
+ *             - ESP_OK if the data was read successfully
+ *             - ESP_ERR_NVS_INVALID_LENGTH if the range exceeds the length of the blob
+ *             - ESP_ERR_NVS_INVALID_HANDLE if the handle of the stream has been closed
+ *             - ESP_ERR_NVS_NOT_FOUND if the blob has been modified or corrupted
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_read_at(nvs_blob_stream_t stream, size_t offset, void* out_value, size_t length);
+
+/**
+ * @brief      Compare part of a blob opened with nvs_blob_open_read with the given data
+ *
+ * The data is compared with flash contents directly, without reading the blob into RAM.
+ * This allows to check whether a large blob needs to be rewritten at all.
+ *
+ * @param[in]  stream     Stream obtained from nvs_blob_open_read.
+ * @param[in]  offset     Offset within the blob of the first byte to compare.
+ * @param[in]  value      Data to compare with.
+ * @param[in]  length     Number of bytes to compare.
+ * @param[out] out_equal  Set to true if the data is equal to the blob contents, false otherwise.
+ *
+ * @return
+ *             - ESP_OK if the data was compared successfully
+ *             - ESP_ERR_NVS_INVALID_LENGTH if the range exceeds the length of the blob
+ *             - ESP_ERR_NVS_INVALID_HANDLE if the handle of the stream has been closed
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_cmp_at(nvs_blob_stream_t stream, size_t offset, const void* value, size_t length, bool* out_equal);
+
+/**
+ * @brief      Open a blob for writing it in pieces
+ *
+ * The new blob is built by appending data with nvs_blob_write_next and replaces the stored
+ * blob with the same key once nvs_blob_close is called. Until then, readers still see the
+ * previous value; if power is lost before, the pieces written so far are removed on the
+ * next initialization. The blob must not be modified otherwise while the stream is open.
+ *
+ * @param[in]  handle      Handle obtained from nvs_open function.
+ *                         Handles that were opened read only cannot be used.
+ * @param[in]  key         Key name. Maximal length is (NVS_KEY_NAME_MAX_SIZE-1) characters. Shouldn't be empty.
+ * @param[out] out_stream  Stream to be passed to nvs_blob_write_next and nvs_blob_close or nvs_blob_abort.
+ *
+ * @return
+ *             - ESP_OK if the stream was opened successfully
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if storage handle was opened as read only
+ *             - ESP_ERR_NVS_KEY_TOO_LONG if key name is too long
+ *             - ESP_ERR_NO_MEM if memory for the stream couldn't be allocated
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_open_write(nvs_handle_t handle, const char* key, nvs_blob_stream_t* out_stream);
+
+/**
+ * @brief      Append data to a blob opened with nvs_blob_open_write
+ *
+ * The data is collected in a buffer of one chunk (about 4 kB, allocated by nvs_blob_open_write)
+ * and written to flash whenever it fills the free space of the current page, so the blob is
+ * stored in as few chunks as if it was written at once, whatever the size of the pieces.
+ * The last part of the blob is written by nvs_blob_close.
+ *
+ * @param[in]  stream  Stream obtained from nvs_blob_open_write.
+ * @param[in]  value   Data to append.
+ * @param[in]  length  Number of bytes to append.
+ *
+ * @return
+ *             - ESP_OK if the data was written successfully
+ *             - ESP_ERR_NVS_INVALID_HANDLE if the handle of the stream has been closed
+ *             - ESP_ERR_NVS_INVALID_STATE if a previous write to the stream has failed
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space in the
+ *               underlying storage to save the data
+ *             - ESP_ERR_NVS_VALUE_TOO_LONG if the blob gets too long or consists of too many chunks
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_write_next(nvs_blob_stream_t stream, const void* value, size_t length);
+
+/**
+ * @brief      Close a blob stream and free its resources
+ *
+ * For a stream opened with nvs_blob_open_write, this writes the remaining buffered data
+ * and the blob index, which makes the new blob visible, and erases the previous value. If a write to the stream has
+ * failed, the data written so far is erased instead and the error is returned.
+ *
+ * @param[in]  stream  Stream to close. It must not be used afterwards.
+ *
+ * @return
+ *             - ESP_OK if the stream was closed successfully
+ *             - ESP_ERR_NVS_INVALID_HANDLE if the handle of the stream has been closed
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space in the
+ *               underlying storage to save the rest of the blob or its index
+ *             - ESP_ERR_NVS_REMOVE_FAILED if the previous value wasn't erased because flash
+ *               write operation has failed. The new value was written however, and
+ *               update will be finished after re-initialization of nvs, provided that
+ *               flash operation doesn't fail again.
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_close(nvs_blob_stream_t stream);
+
+/**
+ * @brief      Close a blob stream, discarding any data written to it
+ *
+ * @param[in]  stream  Stream to close. It must not be used afterwards.
+ */
+void nvs_blob_abort(nvs_blob_stream_t stream);
+
 /**
  * @brief      Close the storage handle and free any allocated resources
  *
@@ -49,6 +49,12 @@ private:
 
 uint32_t NVSHandleEntry::s_nvs_next_handle;
 
+struct nvs_opaque_blob_stream_t
+{
+    nvs_handle_t handle;
+    nvs::BlobStream stream;
+};
+
 extern "C" void nvs_dump(const char *partName);
 
 #ifndef LINUX_TARGET
@@ -432,6 +438,241 @@ extern "C" esp_err_t nvs_set_blob(nvs_handle_t c_handle, const char* key, const
     return handle->set_blob(key, value, length);
 }
 
+extern "C" esp_err_t nvs_batch_begin(nvs_handle_t c_handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, static_cast<int>(c_handle));
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->batch_begin();
+}
+
+template<typename T>
+static esp_err_t nvs_batch_set(nvs_handle_t c_handle, const char* key, T value)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s %d %ld", __func__, key, static_cast<int>(sizeof(T)), static_cast<long int>(value));
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->batch_set_item(itemTypeOf(value), key, &value, sizeof(value));
+}
+
+extern "C" esp_err_t nvs_batch_set_i8  (nvs_handle_t handle, const char* key, int8_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_u8  (nvs_handle_t handle, const char* key, uint8_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_i16 (nvs_handle_t handle, const char* key, int16_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_u16 (nvs_handle_t handle, const char* key, uint16_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_i32 (nvs_handle_t handle, const char* key, int32_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_u32 (nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_i64 (nvs_handle_t handle, const char* key, int64_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_u64 (nvs_handle_t handle, const char* key, uint64_t value)
+{
+    return nvs_batch_set(handle, key, value);
+}
+
+extern "C" esp_err_t nvs_batch_set_str(nvs_handle_t c_handle, const char* key, const char* value)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s %s", __func__, key, value);
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->batch_set_item(ItemType::SZ, key, value, strlen(value) + 1);
+}
+
+extern "C" esp_err_t nvs_batch_set_blob(nvs_handle_t c_handle, const char* key, const void* value, size_t length)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s %d", __func__, key, static_cast<int>(length));
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->batch_set_item(ItemType::BLOB, key, value, length);
+}
+
+extern "C" esp_err_t nvs_batch_commit(nvs_handle_t c_handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, static_cast<int>(c_handle));
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->batch_commit();
+}
+
+extern "C" void nvs_batch_abort(nvs_handle_t c_handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, static_cast<int>(c_handle));
+    NVSHandleSimple *handle;
+    if (nvs_find_ns_handle(c_handle, &handle) == ESP_OK) {
+        handle->batch_abort();
+    }
+}
+
+static esp_err_t nvs_blob_open(nvs_handle_t c_handle, const char* key, bool write, nvs_blob_stream_t* out_stream)
+{
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_blob_stream_t blob = new (std::nothrow) nvs_opaque_blob_stream_t;
+    if (!blob) {
+        return ESP_ERR_NO_MEM;
+    }
+    blob->handle = c_handle;
+    err = handle->open_blob_stream(key, write, blob->stream);
+    if (err != ESP_OK) {
+        delete blob;
+        return err;
+    }
+    *out_stream = blob;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_open_read(nvs_handle_t c_handle, const char* key, nvs_blob_stream_t* out_stream, size_t* out_length)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (out_stream == nullptr || out_length == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto err = nvs_blob_open(c_handle, key, false, out_stream);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *out_length = (*out_stream)->stream.dataSize;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_open_write(nvs_handle_t c_handle, const char* key, nvs_blob_stream_t* out_stream)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (out_stream == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return nvs_blob_open(c_handle, key, true, out_stream);
+}
+
+extern "C" esp_err_t nvs_blob_read_at(nvs_blob_stream_t blob, size_t offset, void* out_value, size_t length)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d %d", __func__, static_cast<int>(offset), static_cast<int>(length));
+    if (blob == nullptr || out_value == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(blob->handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->read_blob_stream(blob->stream, offset, out_value, length);
+}
+
+extern "C" esp_err_t nvs_blob_cmp_at(nvs_blob_stream_t blob, size_t offset, const void* value, size_t length, bool* out_equal)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d %d", __func__, static_cast<int>(offset), static_cast<int>(length));
+    if (blob == nullptr || value == nullptr || out_equal == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(blob->handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = handle->cmp_blob_stream(blob->stream, offset, value, length);
+    *out_equal = (err == ESP_OK);
+    if (err == ESP_ERR_NVS_CONTENT_DIFFERS) {
+        return ESP_OK;
+    }
+    return err;
+}
+
+extern "C" esp_err_t nvs_blob_write_next(nvs_blob_stream_t blob, const void* value, size_t length)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, static_cast<int>(length));
+    if (blob == nullptr || value == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(blob->handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->write_blob_stream(blob->stream, value, length);
+}
+
+static esp_err_t nvs_blob_finish(nvs_blob_stream_t blob, bool commit)
+{
+    Lock lock;
+    if (blob == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(blob->handle, &handle);
+    if (err == ESP_OK) {
+        err = handle->close_blob_stream(blob->stream, commit);
+    }
+    delete blob;
+    return err;
+}
+
+extern "C" esp_err_t nvs_blob_close(nvs_blob_stream_t blob)
+{
+    ESP_LOGD(TAG, "%s", __func__);
+    return nvs_blob_finish(blob, true);
+}
+
+extern "C" void nvs_blob_abort(nvs_blob_stream_t blob)
+{
+    ESP_LOGD(TAG, "%s", __func__);
+    nvs_blob_finish(blob, false);
+}
+
 
 template<typename T>
 static esp_err_t nvs_get(nvs_handle_t c_handle, const char* key, T* out_value)
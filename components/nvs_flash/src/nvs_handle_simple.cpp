@@ -92,10 +92,81 @@ esp_err_t NVSHandleSimple::erase_all()
 esp_err_t NVSHandleSimple::commit()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (mReadOnly) return ESP_OK;
+
+    return mStoragePtr->writeSummary();
+}
+
+esp_err_t NVSHandleSimple::batch_begin()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mBatch) return ESP_ERR_INVALID_STATE;
+
+    mBatch.reset(new (std::nothrow) ItemBatch);
+    if (!mBatch) return ESP_ERR_NO_MEM;
 
     return ESP_OK;
 }
 
+esp_err_t NVSHandleSimple::batch_set_item(ItemType datatype, const char *key, const void* data, size_t dataSize)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mBatch) return ESP_ERR_INVALID_STATE;
+
+    return mBatch->add(mNsIndex, datatype, key, data, dataSize);
+}
+
+esp_err_t NVSHandleSimple::batch_commit()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mBatch) return ESP_ERR_INVALID_STATE;
+
+    std::unique_ptr<ItemBatch> batch(std::move(mBatch));
+    return mStoragePtr->writeItems(*batch);
+}
+
+void NVSHandleSimple::batch_abort()
+{
+    mBatch.reset();
+}
+
+esp_err_t NVSHandleSimple::open_blob_stream(const char *key, bool write, BlobStream &stream)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (write && mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+
+    return mStoragePtr->openBlobStream(mNsIndex, key, write, stream);
+}
+
+esp_err_t NVSHandleSimple::read_blob_stream(BlobStream &stream, size_t offset, void* out_blob, size_t len)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+
+    return mStoragePtr->readBlobStream(stream, offset, out_blob, len);
+}
+
+esp_err_t NVSHandleSimple::cmp_blob_stream(BlobStream &stream, size_t offset, const void* blob, size_t len)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+
+    return mStoragePtr->cmpBlobStream(stream, offset, blob, len);
+}
+
+esp_err_t NVSHandleSimple::write_blob_stream(BlobStream &stream, const void* blob, size_t len)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+
+    return mStoragePtr->writeBlobStream(stream, blob, len);
+}
+
+esp_err_t NVSHandleSimple::close_blob_stream(BlobStream &stream, bool commit)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+
+    return mStoragePtr->closeBlobStream(stream, commit);
+}
+
 esp_err_t NVSHandleSimple::get_used_entry_count(size_t& used_entries)
 {
     used_entries = 0;
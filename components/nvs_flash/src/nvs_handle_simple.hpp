@@ -64,6 +64,30 @@ public:
 
     esp_err_t get_used_entry_count(size_t &usedEntries) override;
 
+    /**
+     * Start staging values which are written together by batch_commit().
+     */
+    esp_err_t batch_begin();
+
+    esp_err_t batch_set_item(ItemType datatype, const char *key, const void *data, size_t dataSize);
+
+    /**
+     * Write all staged values to storage at once. The batch is finished afterwards, even if writing failed.
+     */
+    esp_err_t batch_commit();
+
+    void batch_abort();
+
+    esp_err_t open_blob_stream(const char *key, bool write, BlobStream &stream);
+
+    esp_err_t read_blob_stream(BlobStream &stream, size_t offset, void *out_blob, size_t len);
+
+    esp_err_t cmp_blob_stream(BlobStream &stream, size_t offset, const void *blob, size_t len);
+
+    esp_err_t write_blob_stream(BlobStream &stream, const void *blob, size_t len);
+
+    esp_err_t close_blob_stream(BlobStream &stream, bool commit);
+
     esp_err_t getItemDataSize(ItemType datatype, const char *key, size_t &dataSize);
 
     void debugDump();
@@ -100,6 +124,11 @@ private:
      * Upon opening, a handle is valid. It becomes invalid if the underlying storage is de-initialized.
      */
     uint8_t valid;
+
+    /**
+     * Values staged since batch_begin(), nullptr if no batch is in progress.
+     */
+    std::unique_ptr<ItemBatch> mBatch;
 };
 
 } // nvs
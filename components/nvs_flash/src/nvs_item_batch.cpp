@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "nvs_item_batch.hpp"
+#include "nvs_page.hpp"
+#include <new>
+
+namespace nvs
+{
+
+ItemBatch::~ItemBatch()
+{
+    delete[] mEntries;
+}
+
+bool ItemBatch::reserve(size_t count)
+{
+    if (count <= mCapacity) {
+        return true;
+    }
+
+    size_t capacity = (mCapacity == 0) ? MIN_CAPACITY : mCapacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    if (capacity > Page::ENTRY_COUNT) {
+        capacity = Page::ENTRY_COUNT;
+    }
+
+    Item* entries = new (std::nothrow) Item[capacity];
+    if (!entries) {
+        return false;
+    }
+    std::copy_n(mEntries, mCount, entries);
+    delete[] mEntries;
+    mEntries = entries;
+    mCapacity = capacity;
+    return true;
+}
+
+size_t ItemBatch::recordSpan(size_t index) const
+{
+    assert(index < mCount);
+    // blob data chunk is always followed by its index entry
+    if (mEntries[index].datatype == ItemType::BLOB_DATA) {
+        return mEntries[index].span + 1;
+    }
+    return mEntries[index].span;
+}
+
+size_t ItemBatch::find(uint8_t nsIndex, const char* key) const
+{
+    for (size_t i = 0; i < mCount; i += recordSpan(i)) {
+        if (mEntries[i].nsIndex == nsIndex && strncmp(mEntries[i].key, key, Item::MAX_KEY_LENGTH) == 0) {
+            return i;
+        }
+    }
+    return mCount;
+}
+
+void ItemBatch::remove(size_t index)
+{
+    size_t span = recordSpan(index);
+    std::copy(mEntries + index + span, mEntries + mCount, mEntries + index);
+    mCount -= span;
+}
+
+void ItemBatch::setBlobVersion(size_t index, VerOffset chunkStart)
+{
+    Item& chunk = mEntries[index];
+    Item& blobIndex = mEntries[index + chunk.span];
+    assert(chunk.datatype == ItemType::BLOB_DATA && blobIndex.datatype == ItemType::BLOB_IDX);
+
+    chunk.chunkIndex = static_cast<uint8_t>(chunkStart);
+    chunk.crc32 = chunk.calculateCrc32();
+    blobIndex.blobIndex.chunkStart = chunkStart;
+    blobIndex.crc32 = blobIndex.calculateCrc32();
+}
+
+esp_err_t ItemBatch::add(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    const size_t keySize = strlen(key);
+    if (keySize > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    if (dataSize > Page::CHUNK_MAX_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    size_t span = 1;
+    if (isVariableLengthType(datatype)) {
+        span += (dataSize + Page::ENTRY_SIZE - 1) / Page::ENTRY_SIZE;
+    }
+    size_t recordSize = (datatype == ItemType::BLOB) ? span + 1 : span;
+
+    size_t existing = find(nsIndex, key);
+    size_t existingSize = (existing < mCount) ? recordSpan(existing) : 0;
+    if (mCount - existingSize + recordSize > Page::ENTRY_COUNT) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    if (!reserve(mCount - existingSize + recordSize)) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (existing < mCount) {
+        remove(existing);
+    }
+
+    Item* dst = mEntries + mCount;
+    if (!isVariableLengthType(datatype)) {
+        Item item(nsIndex, datatype, span, key);
+        memcpy(item.data, data, dataSize);
+        item.crc32 = item.calculateCrc32();
+        dst[0] = item;
+    } else {
+        ItemType headerType = (datatype == ItemType::BLOB) ? ItemType::BLOB_DATA : datatype;
+        uint8_t chunkIdx = (datatype == ItemType::BLOB) ? static_cast<uint8_t>(VerOffset::VER_0_OFFSET) : Item::CHUNK_ANY;
+        Item item(nsIndex, headerType, span, key, chunkIdx);
+        item.varLength.dataCrc32 = Item::calculateCrc32(static_cast<const uint8_t*>(data), dataSize);
+        item.varLength.dataSize = dataSize;
+        item.varLength.reserved = 0xffff;
+        item.crc32 = item.calculateCrc32();
+        dst[0] = item;
+
+        uint8_t* payload = dst[1].rawData;
+        std::fill_n(payload, (span - 1) * Page::ENTRY_SIZE, 0xff);
+        memcpy(payload, data, dataSize);
+
+        if (datatype == ItemType::BLOB) {
+            Item blobIndex(nsIndex, ItemType::BLOB_IDX, 1, key);
+            blobIndex.blobIndex.dataSize = dataSize;
+            blobIndex.blobIndex.chunkCount = 1;
+            blobIndex.blobIndex.chunkStart = VerOffset::VER_0_OFFSET;
+            blobIndex.crc32 = blobIndex.calculateCrc32();
+            dst[span] = blobIndex;
+        }
+    }
+    mCount += recordSize;
+    return ESP_OK;
+}
+
+} // namespace nvs
@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef nvs_item_batch_hpp
+#define nvs_item_batch_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Staging area for items which are written to storage together by Storage::writeItems().
+ *
+ * Items are kept as ready-to-write page entries (header followed by data entries for variable length items),
+ * so that the whole batch can be written to a page with a single flash write. A blob is staged as a single
+ * BLOB_DATA chunk followed by its BLOB_IDX entry. The batch never grows beyond the entries of one page.
+ *
+ * A record is the group of entries which belong to one staged value: one item, or two items for a blob.
+ */
+class ItemBatch
+{
+public:
+    ItemBatch() { }
+
+    ~ItemBatch();
+
+    /**
+     * Stage a value. A value staged earlier for the same namespace and key is replaced.
+     * Supported types are the primitive types, SZ and BLOB.
+     */
+    esp_err_t add(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    /**
+     * Remove the record starting at the given entry index.
+     */
+    void remove(size_t index);
+
+    /**
+     * Number of entries of the record starting at the given entry index.
+     */
+    size_t recordSpan(size_t index) const;
+
+    /**
+     * Change the version of the blob record starting at the given entry index.
+     */
+    void setBlobVersion(size_t index, VerOffset chunkStart);
+
+    void clear()
+    {
+        mCount = 0;
+    }
+
+    bool empty() const
+    {
+        return mCount == 0;
+    }
+
+    size_t entryCount() const
+    {
+        return mCount;
+    }
+
+    Item* entries()
+    {
+        return mEntries;
+    }
+
+    const Item* entries() const
+    {
+        return mEntries;
+    }
+
+protected:
+    size_t find(uint8_t nsIndex, const char* key) const;
+
+    bool reserve(size_t count);
+
+    static const size_t MIN_CAPACITY = 8;
+
+    Item* mEntries = nullptr;
+    size_t mCount = 0;
+    size_t mCapacity = 0;
+}; // class ItemBatch
+
+} // namespace nvs
+
+#endif /* nvs_item_batch_hpp */
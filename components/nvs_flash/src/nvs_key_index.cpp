@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "nvs_key_index.hpp"
+#include <new>
+
+namespace nvs
+{
+
+KeyIndex::~KeyIndex()
+{
+    delete[] mTable;
+}
+
+void KeyIndex::reset()
+{
+    disable();
+    mActive = (mMaxEntries > 0);
+}
+
+void KeyIndex::disable()
+{
+    delete[] mTable;
+    mTable = nullptr;
+    mCapacity = 0;
+    mCount = 0;
+    mActive = false;
+}
+
+uint32_t KeyIndex::hash(uint8_t nsIndex, const char* key, uint8_t chunkIdx)
+{
+    // same hash as used by the per-page HashList, the data type is not part of it
+    return Item(nsIndex, ItemType::ANY, 0, key, chunkIdx).calculateCrc32WithoutValue();
+}
+
+bool KeyIndex::resize(size_t capacity)
+{
+    Entry* table = new (std::nothrow) Entry[capacity];
+    if (!table) {
+        return false;
+    }
+    std::fill_n(table, capacity, Entry {nullptr, 0});
+
+    const size_t mask = capacity - 1;
+    for (size_t i = 0; i < mCapacity; ++i) {
+        if (mTable[i].mPage == nullptr) {
+            continue;
+        }
+        size_t slot = mTable[i].mHash & mask;
+        while (table[slot].mPage != nullptr) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = mTable[i];
+    }
+
+    delete[] mTable;
+    mTable = table;
+    mCapacity = capacity;
+    return true;
+}
+
+void KeyIndex::insert(uint32_t hash, Page* page)
+{
+    if (!mActive) {
+        return;
+    }
+
+    if (mCount + 1 > mMaxEntries) {
+        disable();
+        return;
+    }
+
+    // keep the load factor below 3/4 so that probe sequences stay short
+    if ((mCount + 1) * 4 > mCapacity * 3) {
+        size_t capacity = (mCapacity == 0) ? MIN_CAPACITY : mCapacity * 2;
+        if (!resize(capacity)) {
+            disable();
+            return;
+        }
+    }
+
+    const size_t mask = mCapacity - 1;
+    size_t slot = hash & mask;
+    while (mTable[slot].mPage != nullptr) {
+        slot = (slot + 1) & mask;
+    }
+    mTable[slot].mPage = page;
+    mTable[slot].mHash = hash;
+    ++mCount;
+}
+
+void KeyIndex::erase(uint32_t hash, Page* page)
+{
+    if (!mActive || mCount == 0) {
+        return;
+    }
+
+    const size_t mask = mCapacity - 1;
+    size_t slot = hash & mask;
+    while (mTable[slot].mPage != page || mTable[slot].mHash != hash) {
+        if (mTable[slot].mPage == nullptr) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // backward shift deletion: move following entries of the probe sequence into the gap
+    size_t next = slot;
+    while (true) {
+        next = (next + 1) & mask;
+        if (mTable[next].mPage == nullptr) {
+            break;
+        }
+        size_t home = mTable[next].mHash & mask;
+        bool inRange = (slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next);
+        if (inRange) {
+            continue;
+        }
+        mTable[slot] = mTable[next];
+        slot = next;
+    }
+    mTable[slot].mPage = nullptr;
+    --mCount;
+}
+
+void KeyIndex::relocate(Page* from, Page* to)
+{
+    for (size_t i = 0; i < mCapacity; ++i) {
+        if (mTable[i].mPage == from) {
+            mTable[i].mPage = to;
+        }
+    }
+}
+
+Page* KeyIndex::find(uint32_t hash, size_t& cursor) const
+{
+    if (mCount == 0) {
+        return nullptr;
+    }
+
+    const size_t mask = mCapacity - 1;
+    while (cursor < mCapacity) {
+        const Entry& e = mTable[(hash + cursor) & mask];
+        ++cursor;
+        if (e.mPage == nullptr) {
+            break;
+        }
+        if (e.mHash == hash) {
+            return e.mPage;
+        }
+    }
+    cursor = mCapacity;
+    return nullptr;
+}
+
+} // namespace nvs
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef nvs_key_index_hpp
+#define nvs_key_index_hpp
+
+#include <cstdint>
+#include <cstddef>
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Storage-wide index which maps the hash of <namespace index, key, chunk index> to the pages holding
+ * an item with this hash. It allows the storage to look up an item by probing only the candidate pages
+ * instead of every page of the partition.
+ *
+ * The index may contain stale entries (they only cost an additional page lookup), but it must never
+ * miss an item which is present on flash. The same <hash, page> pair is stored once per matching item,
+ * so that each successful erase of an item can remove exactly one entry.
+ *
+ * The table uses open addressing with linear probing and backward shift deletion. It grows on demand
+ * up to the configured number of entries. If this limit is exceeded or memory can't be allocated,
+ * the index disables itself and the storage falls back to searching all pages.
+ */
+class KeyIndex
+{
+public:
+    KeyIndex(size_t maxEntries) : mMaxEntries(maxEntries) { }
+
+    ~KeyIndex();
+
+    /**
+     * Drop all entries. The index becomes active if it is allowed to hold entries.
+     */
+    void reset();
+
+    /**
+     * Drop all entries and deactivate the index until the next reset().
+     */
+    void disable();
+
+    bool isActive() const
+    {
+        return mActive;
+    }
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+    void setMaxEntries(size_t maxEntries)
+    {
+        mMaxEntries = maxEntries;
+    }
+
+    static uint32_t hash(uint8_t nsIndex, const char* key, uint8_t chunkIdx);
+
+    void insert(uint32_t hash, Page* page);
+
+    void erase(uint32_t hash, Page* page);
+
+    /**
+     * Move all entries pointing to page 'from' over to page 'to', used after the items of a page
+     * have been copied to a new page.
+     */
+    void relocate(Page* from, Page* to);
+
+    /**
+     * Return the next candidate page for the given hash, or nullptr if there is none.
+     * 'cursor' has to be zero for the first call and is advanced by each call.
+     */
+    Page* find(uint32_t hash, size_t& cursor) const;
+
+protected:
+    struct Entry {
+        Page* mPage;
+        uint32_t mHash;
+    };
+
+    bool resize(size_t capacity);
+
+    static const size_t MIN_CAPACITY = 64;
+
+    Entry* mTable = nullptr;
+    size_t mCapacity = 0;
+    size_t mCount = 0;
+    size_t mMaxEntries;
+    bool mActive = false;
+}; // class KeyIndex
+
+} // namespace nvs
+
+#endif /* nvs_key_index_hpp */
@@ -28,7 +28,7 @@ uint32_t Page::Header::calculateCrc32()
                     offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
 }
 
-esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
+esp_err_t Page::load(Partition *partition, uint32_t sectorNumber, bool deferItems)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
@@ -38,6 +38,7 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     mBaseAddress = sectorNumber * SEC_SIZE;
     mUsedEntryCount = 0;
     mErasedEntryCount = 0;
+    mLoadDeferred = false;
 
     Header header;
     auto rc = mPartition->read_raw(mBaseAddress, &header, sizeof(header));
@@ -47,27 +48,14 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     }
     if (header.mState == PageState::UNINITIALIZED) {
         mState = header.mState;
-        // check if the whole page is really empty
-        // reading the whole page takes ~40 times less than erasing it
-        const int BLOCK_SIZE = 128;
-        uint32_t* block = new (std::nothrow) uint32_t[BLOCK_SIZE];
-
-        if (!block) return ESP_ERR_NO_MEM;
-
-        for (uint32_t i = 0; i < SPI_FLASH_SEC_SIZE; i += 4 * BLOCK_SIZE) {
-            rc = mPartition->read_raw(mBaseAddress + i, block, 4 * BLOCK_SIZE);
+        if (deferItems) {
+            mLoadDeferred = true;
+        } else {
+            rc = mCheckErased();
             if (rc != ESP_OK) {
-                mState = PageState::INVALID;
-                delete[] block;
                 return rc;
             }
-            if (std::any_of(block, block + BLOCK_SIZE, [](uint32_t val) -> bool { return val != 0xffffffff; })) {
-                // page isn't as empty after all, mark it as corrupted
-                mState = PageState::CORRUPT;
-                break;
-            }
         }
-        delete[] block;
     } else if (header.mCrc32 != header.calculateCrc32()) {
         header.mState = PageState::CORRUPT;
     } else {
@@ -87,6 +75,7 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     case PageState::FULL:
     case PageState::ACTIVE:
     case PageState::FREEING:
+        mLoadDeferred = deferItems && mState == PageState::FULL;
         mLoadEntryTable();
         break;
 
@@ -98,6 +87,63 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     return ESP_OK;
 }
 
+esp_err_t Page::loadDeferred()
+{
+    if (!mLoadDeferred) {
+        return ESP_OK;
+    }
+    mLoadDeferred = false;
+
+    if (mState == PageState::UNINITIALIZED) {
+        return mCheckErased();
+    } else if (mState == PageState::FULL || mState == PageState::FREEING) {
+        return mLoadHashList();
+    }
+    return ESP_OK;
+}
+
+esp_err_t Page::mCheckErased()
+{
+    // check if the whole page is really empty
+    // reading the whole page takes ~40 times less than erasing it
+    const int BLOCK_SIZE = 128;
+    uint32_t* block = new (std::nothrow) uint32_t[BLOCK_SIZE];
+
+    if (!block) return ESP_ERR_NO_MEM;
+
+    for (uint32_t i = 0; i < SPI_FLASH_SEC_SIZE; i += 4 * BLOCK_SIZE) {
+        auto rc = mPartition->read_raw(mBaseAddress + i, block, 4 * BLOCK_SIZE);
+        if (rc != ESP_OK) {
+            mState = PageState::INVALID;
+            delete[] block;
+            return rc;
+        }
+        if (std::any_of(block, block + BLOCK_SIZE, [](uint32_t val) -> bool { return val != 0xffffffff; })) {
+            // page isn't as empty after all, mark it as corrupted
+            mState = PageState::CORRUPT;
+            break;
+        }
+    }
+    delete[] block;
+    return ESP_OK;
+}
+
+uint32_t Page::calcStateDigest(uint32_t crc, size_t emptyBegin, size_t emptyEnd) const
+{
+    crc = Item::calculateCrc32(reinterpret_cast<const uint8_t*>(&mBaseAddress), sizeof(mBaseAddress), crc);
+    crc = Item::calculateCrc32(reinterpret_cast<const uint8_t*>(&mState), sizeof(mState), crc);
+    if (mState != PageState::ACTIVE && mState != PageState::FULL && mState != PageState::FREEING) {
+        return crc;
+    }
+
+    TEntryTable entryTable = mEntryTable;
+    for (size_t i = emptyBegin; i < emptyEnd; ++i) {
+        entryTable.set(i, EntryState::EMPTY);
+    }
+    crc = Item::calculateCrc32(reinterpret_cast<const uint8_t*>(&mSeqNumber), sizeof(mSeqNumber), crc);
+    return Item::calculateCrc32(reinterpret_cast<const uint8_t*>(entryTable.data()), entryTable.byteSize(), crc);
+}
+
 esp_err_t Page::writeEntry(const Item& item)
 {
     esp_err_t err;
@@ -266,6 +312,60 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
     return ESP_OK;
 }
 
+esp_err_t Page::writeItems(const Item* entries, size_t entryCount)
+{
+    esp_err_t err;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    if (mState == PageState::UNINITIALIZED) {
+        err = initialize();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (mState == PageState::FULL) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    if (mNextFreeEntry == INVALID_ENTRY || mNextFreeEntry + entryCount > ENTRY_COUNT) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    for (size_t i = 0; i < entryCount; i += entries[i].span) {
+        assert(entries[i].span > 0);
+        err = mHashList.insert(entries[i], mNextFreeEntry + i);
+        if (err != ESP_OK) {
+            for (size_t j = 0; j < i; j += entries[j].span) {
+                mHashList.erase(mNextFreeEntry + j);
+            }
+            return err;
+        }
+    }
+
+    err = mPartition->write(getEntryAddress(mNextFreeEntry), entries, entryCount * ENTRY_SIZE);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+
+    err = alterEntryRangeState(mNextFreeEntry, mNextFreeEntry + entryCount, EntryState::WRITTEN);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+
+    if (mFirstUsedEntry == INVALID_ENTRY) {
+        mFirstUsedEntry = mNextFreeEntry;
+    }
+    mUsedEntryCount += entryCount;
+    mNextFreeEntry += entryCount;
+    return ESP_OK;
+}
+
 esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart)
 {
     size_t index = 0;
@@ -369,6 +469,94 @@ esp_err_t Page::cmpItem(uint8_t nsIndex, ItemType datatype, const char* key, con
     return ESP_OK;
 }
 
+esp_err_t Page::readItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, void* data, size_t dataSize, uint8_t chunkIdx, bool verify)
+{
+    size_t index = 0;
+    Item item;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    assert(isVariableLengthType(datatype));
+    esp_err_t rc = findItem(nsIndex, datatype, key, index, item, chunkIdx);
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
+    const size_t itemSize = item.varLength.dataSize;
+    if (offset > itemSize || dataSize > itemSize - offset) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(data);
+    uint32_t crc = Item::calculateCrc32(nullptr, 0);
+    size_t first = verify ? 0 : offset / ENTRY_SIZE;
+    size_t end = (verify ? itemSize : offset + dataSize);
+    for (size_t pos = first * ENTRY_SIZE; pos < end; pos += ENTRY_SIZE) {
+        Item ditem;
+        rc = readEntry(index + 1 + pos / ENTRY_SIZE, ditem);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        size_t entrySize = (itemSize - pos < ENTRY_SIZE) ? itemSize - pos : ENTRY_SIZE;
+        if (verify) {
+            crc = Item::calculateCrc32(ditem.rawData, entrySize, crc);
+        }
+        // copy the part of the entry which overlaps the requested range
+        size_t copyBegin = std::max(pos, offset);
+        size_t copyEnd = std::min(pos + entrySize, offset + dataSize);
+        if (copyBegin < copyEnd) {
+            memcpy(dst + copyBegin - offset, ditem.rawData + copyBegin - pos, copyEnd - copyBegin);
+        }
+    }
+
+    if (verify && crc != item.varLength.dataCrc32) {
+        rc = eraseEntryAndSpan(index);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Page::cmpItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, const void* data, size_t dataSize, uint8_t chunkIdx)
+{
+    size_t index = 0;
+    Item item;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    assert(isVariableLengthType(datatype));
+    esp_err_t rc = findItem(nsIndex, datatype, key, index, item, chunkIdx);
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
+    const size_t itemSize = item.varLength.dataSize;
+    if (offset > itemSize || dataSize > itemSize - offset) {
+        return ESP_ERR_NVS_CONTENT_DIFFERS;
+    }
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+    for (size_t pos = offset / ENTRY_SIZE * ENTRY_SIZE; pos < offset + dataSize; pos += ENTRY_SIZE) {
+        Item ditem;
+        rc = readEntry(index + 1 + pos / ENTRY_SIZE, ditem);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        size_t cmpBegin = std::max(pos, offset);
+        size_t cmpEnd = std::min(pos + ENTRY_SIZE, offset + dataSize);
+        if (memcmp(src + cmpBegin - offset, ditem.rawData + cmpBegin - pos, cmpEnd - cmpBegin)) {
+            return ESP_ERR_NVS_CONTENT_DIFFERS;
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t Page::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx, VerOffset chunkStart)
 {
     size_t index = 0;
@@ -466,6 +654,12 @@ esp_err_t Page::copyItems(Page& other)
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
+    // corrupted items are only dropped when the items of a page are loaded
+    auto rc = loadDeferred();
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
     if (other.mState == PageState::UNINITIALIZED) {
         auto err = other.initialize();
         if (err != ESP_OK) {
@@ -583,6 +777,34 @@ esp_err_t Page::mLoadEntryTable()
             }
         }
 
+        // multi-entry writes publish their entry states starting from the last entry. If power failed
+        // in between, trailing entries of such a write may be marked as written while the first one is
+        // still empty. Discard them, so that the next free entry is followed by erased flash only.
+        size_t lastWrittenEntry = ENTRY_COUNT;
+        while (lastWrittenEntry > mNextFreeEntry && mEntryTable.get(lastWrittenEntry - 1) == EntryState::EMPTY) {
+            --lastWrittenEntry;
+        }
+        if (lastWrittenEntry > mNextFreeEntry) {
+            for (size_t i = mNextFreeEntry; i < lastWrittenEntry; ++i) {
+                auto oldState = mEntryTable.get(i);
+                if (oldState == EntryState::WRITTEN) {
+                    --mUsedEntryCount;
+                }
+                if (oldState != EntryState::ERASED) {
+                    ++mErasedEntryCount;
+                }
+            }
+            auto err = alterEntryRangeState(mNextFreeEntry, lastWrittenEntry, EntryState::ERASED);
+            if (err != ESP_OK) {
+                mState = PageState::INVALID;
+                return err;
+            }
+            if (mFirstUsedEntry >= mNextFreeEntry) {
+                mFirstUsedEntry = INVALID_ENTRY;
+            }
+            mNextFreeEntry = lastWrittenEntry;
+        }
+
         // check that all variable-length items are written or erased fully
         Item item;
         size_t lastItemIndex = INVALID_ENTRY;
@@ -673,52 +895,58 @@ esp_err_t Page::mLoadEntryTable()
                 }
             }
         }
-    } else if (mState == PageState::FULL || mState == PageState::FREEING) {
-        // We have already filled mHashList for page in active state.
-        // Do the same for the case when page is in full or freeing state.
-        Item item;
-        for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
-            if (mEntryTable.get(i) != EntryState::WRITTEN) {
-                continue;
-            }
+    } else if ((mState == PageState::FULL || mState == PageState::FREEING) && !mLoadDeferred) {
+        return mLoadHashList();
+    }
 
-            auto err = readEntry(i, item);
-            if (err != ESP_OK) {
-                mState = PageState::INVALID;
-                return err;
-            }
+    return ESP_OK;
+}
 
-            if (item.crc32 != item.calculateCrc32()) {
-                err = eraseEntryAndSpan(i);
-                if (err != ESP_OK) {
-                    mState = PageState::INVALID;
-                    return err;
-                }
-                continue;
-            }
+esp_err_t Page::mLoadHashList()
+{
+    // We have already filled mHashList for page in active state.
+    // Do the same for the case when page is in full or freeing state.
+    Item item;
+    for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
+        if (mEntryTable.get(i) != EntryState::WRITTEN) {
+            continue;
+        }
 
-            assert(item.span > 0);
+        auto err = readEntry(i, item);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
 
-            err = mHashList.insert(item, i);
+        if (item.crc32 != item.calculateCrc32()) {
+            err = eraseEntryAndSpan(i);
             if (err != ESP_OK) {
                 mState = PageState::INVALID;
                 return err;
             }
+            continue;
+        }
 
-            size_t span = item.span;
+        assert(item.span > 0);
 
-            if (isVariableLengthType(item.datatype)) {
-                for (size_t j = i + 1; j < i + span; ++j) {
-                    if (mEntryTable.get(j) != EntryState::WRITTEN) {
-                        eraseEntryAndSpan(i);
-                        break;
-                    }
+        err = mHashList.insert(item, i);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+
+        size_t span = item.span;
+
+        if (isVariableLengthType(item.datatype)) {
+            for (size_t j = i + 1; j < i + span; ++j) {
+                if (mEntryTable.get(j) != EntryState::WRITTEN) {
+                    eraseEntryAndSpan(i);
+                    break;
                 }
             }
-
-            i += span - 1;
         }
 
+        i += span - 1;
     }
 
     return ESP_OK;
@@ -814,6 +1042,11 @@ esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, si
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
+    auto err = loadDeferred();
+    if (err != ESP_OK) {
+        return err;
+    }
+
     size_t findBeginIndex = itemIndex;
     if (findBeginIndex >= ENTRY_COUNT) {
         return ESP_ERR_NVS_NOT_FOUND;
@@ -948,6 +1181,7 @@ esp_err_t Page::erase()
     mFirstUsedEntry = INVALID_ENTRY;
     mNextFreeEntry = INVALID_ENTRY;
     mState = PageState::UNINITIALIZED;
+    mLoadDeferred = false;
     mHashList.clear();
     return ESP_OK;
 }
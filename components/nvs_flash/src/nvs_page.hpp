@@ -85,7 +85,24 @@ public:
         return mState;
     }
 
-    esp_err_t load(Partition *partition, uint32_t sectorNumber);
+    /**
+     * Load the page from flash. With deferItems set, the item hash list of a full page and the check
+     * whether an uninitialized page is really erased are skipped until loadDeferred() is called.
+     * Active and freeing pages are always loaded completely.
+     */
+    esp_err_t load(Partition *partition, uint32_t sectorNumber, bool deferItems = false);
+
+    /**
+     * Finish loading a page which was loaded with deferItems set, does nothing otherwise.
+     */
+    esp_err_t loadDeferred();
+
+    /**
+     * Update crc with the state of this page as it is stored in flash: page address, state, sequence number
+     * and entry state table. Entries in the range [emptyBegin, emptyEnd) are taken into account as if they
+     * were empty.
+     */
+    uint32_t calcStateDigest(uint32_t crc, size_t emptyBegin = 0, size_t emptyEnd = 0) const;
 
     esp_err_t getSeqNumber(uint32_t& seqNumber) const;
 
@@ -95,10 +112,30 @@ public:
 
     esp_err_t writeItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY);
 
+    /**
+     * Write prepared entries (item headers followed by their data entries) with a single flash write.
+     * The entries become visible only once all of them are written, which is done by publishing their
+     * states starting from the last entry.
+     */
+    esp_err_t writeItems(const Item* entries, size_t entryCount);
+
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
     esp_err_t cmpItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    /**
+     * Read dataSize bytes starting at offset from the data of a variable length item. Only the entries
+     * holding the requested range are read, unless verify is set: then all entries are read to check the
+     * data CRC of the item.
+     */
+    esp_err_t readItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, bool verify = true);
+
+    /**
+     * Compare dataSize bytes starting at offset of the data of a variable length item with the given data,
+     * reading only the entries holding the requested range.
+     */
+    esp_err_t cmpItemData(uint8_t nsIndex, ItemType datatype, const char* key, size_t offset, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY);
+
     esp_err_t eraseItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
@@ -140,6 +177,11 @@ public:
     }
     size_t getVarDataTailroom() const ;
 
+    /**
+     * Write the header of an activated page, which is otherwise done by the first write to the page.
+     */
+    esp_err_t initialize();
+
     esp_err_t markFull();
 
     esp_err_t markFreeing();
@@ -181,7 +223,9 @@ protected:
 
     esp_err_t mLoadEntryTable();
 
-    esp_err_t initialize();
+    esp_err_t mLoadHashList();
+
+    esp_err_t mCheckErased();
 
     esp_err_t alterEntryState(size_t index, EntryState state);
 
@@ -224,6 +268,7 @@ protected:
     size_t mFirstUsedEntry = INVALID_ENTRY;
     uint16_t mUsedEntryCount = 0;
     uint16_t mErasedEntryCount = 0;
+    bool mLoadDeferred = false;
 
     /**
      * This hash list stores hashes of namespace index, key, and ChunkIndex for quick lookup when searching items.
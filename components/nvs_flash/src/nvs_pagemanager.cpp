@@ -15,7 +15,7 @@
 
 namespace nvs
 {
-esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount)
+esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, bool deferItems)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
@@ -30,7 +30,7 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     if (!mPages) return ESP_ERR_NO_MEM;
 
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        auto err = mPages[i].load(partition, baseSector + i);
+        auto err = mPages[i].load(partition, baseSector + i, deferItems);
         if (err != ESP_OK) {
             return err;
         }
@@ -52,47 +52,19 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
 
     if (mPageList.empty()) {
         mSeqNumber = 0;
-        return activatePage();
+        return deferItems ? ESP_OK : activatePage();
     } else {
         uint32_t lastSeqNo;
         ESP_ERROR_CHECK( mPageList.back().getSeqNumber(lastSeqNo) );
         mSeqNumber = lastSeqNo + 1;
     }
 
-    // if power went out after a new item for the given key was written,
-    // but before the old one was erased, we end up with a duplicate item
-    Page& lastPage = back();
-    size_t lastItemIndex = SIZE_MAX;
-    Item item;
-    size_t itemIndex = 0;
-    while (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
-        itemIndex += item.span;
-        lastItemIndex = itemIndex;
+    if (deferItems) {
+        return mFreePageList.empty() ? ESP_ERR_NVS_NO_FREE_PAGES : ESP_OK;
     }
 
-    if (lastItemIndex != SIZE_MAX) {
-        auto last = PageManager::TPageListIterator(&lastPage);
-        TPageListIterator it;
-
-        for (it = begin(); it != last; ++it) {
-
-            if ((it->state() != Page::PageState::FREEING) &&
-                    (it->eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK)) {
-                break;
-            }
-        }
-        if ((it == last) && (item.datatype == ItemType::BLOB_IDX)) {
-            /* Rare case in which the blob was stored using old format, but power went just after writing
-             * blob index during modification. Loop again and delete the old version blob*/
-            for (it = begin(); it != last; ++it) {
-
-                if ((it->state() != Page::PageState::FREEING) &&
-                        (it->eraseItem(item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex) == ESP_OK)) {
-                    break;
-                }
-            }
-        }
-    }
+    // Items left duplicated by an interrupted write are removed by Storage::init(),
+    // which can look up their old values in its key index.
 
     // check if power went out while page was being freed
     for (auto it = begin(); it!= end(); ++it) {
@@ -139,6 +111,14 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
 
 esp_err_t PageManager::requestNewPage()
 {
+    Page* reclaimedPage;
+    return requestNewPage(reclaimedPage);
+}
+
+esp_err_t PageManager::requestNewPage(Page*& reclaimedPage)
+{
+    reclaimedPage = nullptr;
+
     if (mFreePageList.empty()) {
         return ESP_ERR_NVS_INVALID_STATE;
     }
@@ -196,6 +176,7 @@ esp_err_t PageManager::requestNewPage()
 
     mPageList.erase(maxUnusedItemsPageIt);
     mFreePageList.push_back(erasedPage);
+    reclaimedPage = erasedPage;
 
     return ESP_OK;
 }
@@ -206,8 +187,13 @@ esp_err_t PageManager::activatePage()
         return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
     }
     Page* p = &mFreePageList.front();
+    // a page loaded with deferred items may turn out not to be erased
+    auto err = p->loadDeferred();
+    if (err != ESP_OK) {
+        return err;
+    }
     if (p->state() == Page::PageState::CORRUPT) {
-        auto err = p->erase();
+        err = p->erase();
         if (err != ESP_OK) {
             return err;
         }
@@ -219,6 +205,19 @@ esp_err_t PageManager::activatePage()
     return ESP_OK;
 }
 
+uint32_t PageManager::calcStateDigest(const Page* emptyPage, size_t emptyBegin, size_t emptyEnd) const
+{
+    uint32_t crc = Item::calculateCrc32(reinterpret_cast<const uint8_t*>(&mPageCount), sizeof(mPageCount));
+    for (uint32_t i = 0; i < mPageCount; ++i) {
+        if (&mPages[i] == emptyPage) {
+            crc = mPages[i].calcStateDigest(crc, emptyBegin, emptyEnd);
+        } else {
+            crc = mPages[i].calcStateDigest(crc);
+        }
+    }
+    return crc;
+}
+
 esp_err_t PageManager::fillStats(nvs_stats_t& nvsStats)
 {
     nvsStats.used_entries      = 0;
@@ -31,7 +31,13 @@ public:
 
     PageManager() {}
 
-    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount);
+    /**
+     * Load all pages of the partition. With deferItems set, items of full pages are loaded once the pages
+     * are used (see Page::load()), and the checks for items left over by an interrupted operation are skipped.
+     * This is only allowed if the pages are known to be in a consistent state, otherwise they have to be
+     * loaded again without deferItems.
+     */
+    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, bool deferItems = false);
 
     TPageListIterator begin()
     {
@@ -54,8 +60,20 @@ public:
 
     esp_err_t requestNewPage();
 
+    /**
+     * Same as requestNewPage(), additionally reports the page whose items were moved to the
+     * new page (or nullptr if a free page could be activated without reclaiming a used one).
+     */
+    esp_err_t requestNewPage(Page*& reclaimedPage);
+
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
+    /**
+     * Checksum of the state of all pages (see Page::calcStateDigest()). The entries [emptyBegin, emptyEnd)
+     * of emptyPage are taken into account as if they were empty.
+     */
+    uint32_t calcStateDigest(const Page* emptyPage = nullptr, size_t emptyBegin = 0, size_t emptyEnd = 0) const;
+
     uint32_t getBaseSector()
     {
         return mBaseSector;
@@ -164,6 +164,9 @@ esp_err_t NVSPartitionManager::deinit_partition(const char *partition_label)
         }
     }
 
+    /* Record the state of a cleanly deinitialized partition, so that it can be mounted quickly */
+    storage->writeSummary();
+
     /* Finally delete the storage and its partition */
     nvs_storage_list.erase(storage);
     delete storage;
@@ -11,6 +11,7 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include "sdkconfig.h"
 #include "nvs_storage.hpp"
 
 #ifndef ESP_PLATFORM
@@ -27,6 +28,24 @@
 namespace nvs
 {
 
+#ifdef CONFIG_NVS_KEY_INDEX
+const size_t Storage::KEY_INDEX_MAX_ENTRIES = CONFIG_NVS_KEY_INDEX_MAX_ENTRIES;
+#else
+const size_t Storage::KEY_INDEX_MAX_ENTRIES = 0;
+#endif
+
+#ifdef CONFIG_NVS_FAST_MOUNT
+const bool Storage::FAST_MOUNT = true;
+#else
+const bool Storage::FAST_MOUNT = false;
+#endif
+
+// the summary is a data chunk in the namespace table, which neither collides with namespace entries
+// (U8 items) nor is seen by iterators
+static const char SUMMARY_KEY[] = "nvs.summary";
+static const uint8_t SUMMARY_CHUNK_INDEX = 0;
+static const uint8_t SUMMARY_VERSION = 1;
+
 Storage::~Storage()
 {
     clearNamespaces();
@@ -78,6 +97,11 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
          * 2) VER_1_OFFSET <= chunkIndex < VER_ANY => Version1 chunks
          */
         while (p.findItem(Page::NS_ANY, ItemType::BLOB_DATA, nullptr, itemIndex, item) == ESP_OK) {
+            // the summary has no index, it is dropped as an orphan only if fast mount is disabled
+            if (mFastMount && item.nsIndex == Page::NS_INDEX) {
+                itemIndex += item.span;
+                continue;
+            }
 
             auto iter = std::find_if(blobIdxList.begin(),
                     blobIdxList.end(),
@@ -87,21 +111,74 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
                             && (item.chunkIndex >=  static_cast<uint8_t> (e.chunkStart))
                             && (item.chunkIndex < static_cast<uint8_t> (e.chunkStart) + e.chunkCount);});
             if (iter == std::end(blobIdxList)) {
-                p.eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex);
+                eraseItemFromPage(p, item.nsIndex, item.datatype, item.key, item.chunkIndex);
             }
             itemIndex += item.span;
         }
     }
 }
 
+void Storage::eraseDuplicateItems()
+{
+    // If power went out after new items for the given keys were written, but before the old ones were
+    // erased, we end up with duplicate items. Only the last write can have been interrupted, so only
+    // items of the last page can have old values on other pages. A single write leaves at most its
+    // last item duplicated, a batch write (writeItems) any of its items. The old values are looked up
+    // in the key index, which makes this cheap even if the last page holds many items.
+    if (mPageManager.begin() == mPageManager.end()) {
+        return;
+    }
+    Page& lastPage = mPageManager.back();
+    Item item;
+    size_t itemIndex = 0;
+    while (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        itemIndex += item.span;
+
+        // the page with the lowest sequence number is found first, the old value comes before the new one
+        Page* findPage = nullptr;
+        Item oldItem;
+        if (findItem(item.nsIndex, item.datatype, item.key, findPage, oldItem, item.chunkIndex) == ESP_OK &&
+                findPage != &lastPage) {
+            eraseItemFromPage(*findPage, item.nsIndex, item.datatype, item.key, item.chunkIndex);
+        } else if (item.datatype == ItemType::BLOB_IDX &&
+                findItem(item.nsIndex, ItemType::BLOB, item.key, findPage, oldItem, item.chunkIndex) == ESP_OK &&
+                findPage != &lastPage) {
+            /* Rare case in which the blob was stored using old format, but power went just after writing
+             * blob index during modification. Delete the old version blob */
+            eraseItemFromPage(*findPage, item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex);
+        }
+    }
+}
+
 esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
 {
+    mSummaryPage = nullptr;
+    mKeyIndexDeferred = false;
+    mOpenWriteStreams = 0;
+    mCleanupPending = false;
+
+    if (mFastMount) {
+        // if a valid summary is found, there is nothing left to check or clean up on the pages
+        auto err = mPageManager.load(mPartition, baseSector, sectorCount, true);
+        if (err == ESP_OK && loadSummary() == ESP_OK) {
+            mNamespaceUsage.set(0, true);
+            mNamespaceUsage.set(255, true);
+            mState = StorageState::ACTIVE;
+            mKeyIndex.disable();
+            mKeyIndexDeferred = true;
+            return ESP_OK;
+        }
+    }
+
     auto err = mPageManager.load(mPartition, baseSector, sectorCount);
     if (err != ESP_OK) {
         mState = StorageState::INVALID;
         return err;
     }
 
+    buildKeyIndex();
+    eraseDuplicateItems();
+
     // load namespaces list
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
@@ -148,13 +225,226 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     return ESP_OK;
 }
 
+esp_err_t Storage::loadSummary()
+{
+    clearNamespaces();
+    std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
+
+    // nothing may have been written after the summary, so it has to be on the active page
+    if (mPageManager.begin() == mPageManager.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    Page& page = getCurrentPage();
+    size_t itemIndex = 0;
+    Item item;
+    auto err = page.findItem(Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, itemIndex, item, SUMMARY_CHUNK_INDEX);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const size_t dataSize = item.varLength.dataSize;
+    if (dataSize < sizeof(SummaryHeader)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    std::unique_ptr<uint8_t[]> data(new (std::nothrow) uint8_t[dataSize]);
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = page.readItem(Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, data.get(), dataSize, SUMMARY_CHUNK_INDEX);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    SummaryHeader header;
+    memcpy(&header, data.get(), sizeof(header));
+    if (header.mVersion != SUMMARY_VERSION
+            || header.mPageCount != mPageManager.getPageCount()
+            || dataSize != sizeof(header) + header.mNamespaceCount * sizeof(SummaryNamespace)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    const uint32_t digest = mPageManager.calcStateDigest(&page, itemIndex, itemIndex + item.span);
+    if (header.mDigest != digest) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    const uint8_t* src = data.get() + sizeof(header);
+    for (size_t i = 0; i < header.mNamespaceCount; ++i, src += sizeof(SummaryNamespace)) {
+        SummaryNamespace ns;
+        memcpy(&ns, src, sizeof(ns));
+        NamespaceEntry* entry = new (std::nothrow) NamespaceEntry;
+        if (!entry) {
+            clearNamespaces();
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(entry->mName, ns.mName, sizeof(ns.mName));
+        entry->mName[sizeof(ns.mName)] = 0;
+        entry->mIndex = ns.mIndex;
+        mNamespaces.push_back(entry);
+        mNamespaceUsage.set(entry->mIndex, true);
+    }
+
+    mSummaryPage = &page;
+    mSummaryIndex = itemIndex;
+    mSummarySpan = item.span;
+    mSummaryDigest = digest;
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeSummary()
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    if (!mFastMount) {
+        return ESP_OK;
+    }
+
+    if (mSummaryPage != nullptr
+            && mPageManager.calcStateDigest(mSummaryPage, mSummaryIndex, mSummaryIndex + mSummarySpan) == mSummaryDigest) {
+        return ESP_OK;
+    }
+    mSummaryPage = nullptr;
+
+    // a summary written now would make the next init() skip the cleanup; the stale one no longer matches
+    if (mOpenWriteStreams > 0 || mCleanupPending) {
+        return ESP_OK;
+    }
+
+    Page* findPage;
+    Item item;
+    auto err = findItem(Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, findPage, item, SUMMARY_CHUNK_INDEX);
+    if (err == ESP_OK) {
+        err = eraseItemFromPage(*findPage, Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, SUMMARY_CHUNK_INDEX);
+    }
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+
+    // without a summary, the next init() just loads all pages
+    const size_t dataSize = sizeof(SummaryHeader) + mNamespaces.size() * sizeof(SummaryNamespace);
+    if (dataSize > Page::CHUNK_MAX_SIZE) {
+        return ESP_OK;
+    }
+
+    if (getCurrentPage().getVarDataTailroom() < dataSize) {
+        if (getCurrentPage().state() != Page::PageState::FULL) {
+            err = getCurrentPage().markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    // the digest has to cover the header of the page written by the summary
+    if (getCurrentPage().state() == Page::PageState::UNINITIALIZED) {
+        err = getCurrentPage().initialize();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    std::unique_ptr<uint8_t[]> data(new (std::nothrow) uint8_t[dataSize]);
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    SummaryHeader header;
+    // the entries taken by the summary are still empty, so they are excluded from the digest already
+    header.mDigest = mPageManager.calcStateDigest();
+    header.mPageCount = mPageManager.getPageCount();
+    header.mVersion = SUMMARY_VERSION;
+    header.mNamespaceCount = mNamespaces.size();
+    memcpy(data.get(), &header, sizeof(header));
+    uint8_t* dst = data.get() + sizeof(header);
+    for (auto it = std::begin(mNamespaces); it != std::end(mNamespaces); ++it, dst += sizeof(SummaryNamespace)) {
+        SummaryNamespace ns;
+        ns.mIndex = it->mIndex;
+        strncpy(ns.mName, it->mName, sizeof(ns.mName));
+        memcpy(dst, &ns, sizeof(ns));
+    }
+
+    Page& page = getCurrentPage();
+    err = writeItemToPage(page, Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, data.get(), dataSize, SUMMARY_CHUNK_INDEX);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t itemIndex = 0;
+    err = page.findItem(Page::NS_INDEX, ItemType::BLOB_DATA, SUMMARY_KEY, itemIndex, item, SUMMARY_CHUNK_INDEX);
+    if (err == ESP_OK) {
+        mSummaryPage = &page;
+        mSummaryIndex = itemIndex;
+        mSummarySpan = item.span;
+        mSummaryDigest = header.mDigest;
+    }
+    return ESP_OK;
+}
+
 bool Storage::isValid() const
 {
     return mState == StorageState::ACTIVE;
 }
 
+void Storage::buildKeyIndex()
+{
+    mKeyIndex.reset();
+    for (auto it = mPageManager.begin(); it != mPageManager.end() && mKeyIndex.isActive(); ++it) {
+        size_t itemIndex = 0;
+        Item item;
+        while (it->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+            mKeyIndex.insert(KeyIndex::hash(item.nsIndex, item.key, item.chunkIndex), it);
+            itemIndex += item.span;
+        }
+    }
+}
+
+esp_err_t Storage::findItemIndexed(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    const uint32_t hash = KeyIndex::hash(nsIndex, key, chunkIdx);
+    Page* found = nullptr;
+    uint32_t foundSeqNumber = 0;
+    size_t cursor = 0;
+
+    /* Several pages may hold an item with the same hash. Return the one which comes first in
+     * the page list (i.e. has the lowest sequence number), like the linear search would do. */
+    for (Page* candidate = mKeyIndex.find(hash, cursor); candidate != nullptr; candidate = mKeyIndex.find(hash, cursor)) {
+        uint32_t seqNumber;
+        if (candidate == found || candidate->getSeqNumber(seqNumber) != ESP_OK) {
+            continue;
+        }
+        if (found != nullptr && seqNumber >= foundSeqNumber) {
+            continue;
+        }
+        size_t itemIndex = 0;
+        Item candidateItem;
+        if (candidate->findItem(nsIndex, datatype, key, itemIndex, candidateItem, chunkIdx, chunkStart) == ESP_OK) {
+            found = candidate;
+            foundSeqNumber = seqNumber;
+            item = candidateItem;
+        }
+    }
+
+    if (found == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    page = found;
+    return ESP_OK;
+}
+
 esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
+    if (mKeyIndexDeferred) {
+        mKeyIndexDeferred = false;
+        buildKeyIndex();
+    }
+
+    if (mKeyIndex.isActive() && nsIndex != Page::NS_ANY && datatype != ItemType::ANY && key != nullptr) {
+        return findItemIndexed(nsIndex, datatype, key, page, item, chunkIdx, chunkStart);
+    }
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         size_t itemIndex = 0;
         auto err = it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
@@ -166,6 +456,43 @@ esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key,
     return ESP_ERR_NVS_NOT_FOUND;
 }
 
+esp_err_t Storage::writeItemToPage(Page& page, uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx)
+{
+    size_t usedEntries = page.getUsedEntryCount();
+    auto err = page.writeItem(nsIndex, datatype, key, data, dataSize, chunkIdx);
+    // index the item as soon as anything of it made it to flash, even if the write failed later on
+    if (page.getUsedEntryCount() != usedEntries) {
+        mKeyIndex.insert(KeyIndex::hash(nsIndex, key, chunkIdx), &page);
+    }
+    return err;
+}
+
+esp_err_t Storage::eraseItemFromPage(Page& page, uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    auto err = page.eraseItem(nsIndex, datatype, key, chunkIdx, chunkStart);
+    if (err == ESP_OK) {
+        mKeyIndex.erase(KeyIndex::hash(nsIndex, key, chunkIdx), &page);
+    }
+    return err;
+}
+
+esp_err_t Storage::requestNewPage()
+{
+    Page* reclaimedPage;
+    auto err = mPageManager.requestNewPage(reclaimedPage);
+    if (err != ESP_OK) {
+        // items may have been copied only partially, bring the index in sync with flash again
+        if (mKeyIndex.isActive()) {
+            buildKeyIndex();
+        }
+        return err;
+    }
+    if (reclaimedPage) {
+        mKeyIndex.relocate(reclaimedPage, &getCurrentPage());
+    }
+    return ESP_OK;
+}
+
 esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
 {
     uint8_t chunkCount = 0;
@@ -197,7 +524,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                     return err;
                 }
             }
-            err = mPageManager.requestNewPage();
+            err = requestNewPage();
             if (err != ESP_OK) {
                 return err;
             } else if(getCurrentPage().getVarDataTailroom() == tailroom) {
@@ -216,7 +543,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
         chunkSize = (remainingSize > tailroom)? tailroom : remainingSize;
         remainingSize -= chunkSize;
 
-        err = page.writeItem(nsIndex, ItemType::BLOB_DATA, key,
+        err = writeItemToPage(page, nsIndex, ItemType::BLOB_DATA, key,
                 static_cast<const uint8_t*> (data) + offset, chunkSize, static_cast<uint8_t> (chunkStart) + chunkCount);
         chunkCount++;
         assert(err != ESP_ERR_NVS_PAGE_FULL);
@@ -237,7 +564,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                         break;
                     }
                 }
-                err = mPageManager.requestNewPage();
+                err = requestNewPage();
                 if (err != ESP_OK) {
                     break;
                 }
@@ -252,7 +579,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
             item.blobIndex.chunkCount = chunkCount;
             item.blobIndex.chunkStart = chunkStart;
 
-            err = getCurrentPage().writeItem(nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
+            err = writeItemToPage(getCurrentPage(), nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
             assert(err != ESP_ERR_NVS_PAGE_FULL);
             break;
         }
@@ -262,7 +589,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
         /* Anything failed, then we should erase all the written chunks*/
         int ii=0;
         for (auto it = std::begin(usedPages); it != std::end(usedPages); it++) {
-            it->mPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, ii++);
+            eraseItemFromPage(*it->mPage, nsIndex, ItemType::BLOB_DATA, key, ii++);
         }
     }
     usedPages.clearAndFreeNodes();
@@ -327,6 +654,7 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
             err = eraseMultiPageBlob(nsIndex, key, prevStart);
 
             if (err == ESP_ERR_FLASH_OP_FAIL) {
+                mCleanupPending = true;
                 return ESP_ERR_NVS_REMOVE_FAILED;
             }
             if (err != ESP_OK) {
@@ -351,7 +679,7 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
         }
 
         Page& page = getCurrentPage();
-        err = page.writeItem(nsIndex, datatype, key, data, dataSize);
+        err = writeItemToPage(page, nsIndex, datatype, key, data, dataSize);
         if (err == ESP_ERR_NVS_PAGE_FULL) {
             if (page.state() != Page::PageState::FULL) {
                 err = page.markFull();
@@ -359,12 +687,12 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
                     return err;
                 }
             }
-            err = mPageManager.requestNewPage();
+            err = requestNewPage();
             if (err != ESP_OK) {
                 return err;
             }
 
-            err = getCurrentPage().writeItem(nsIndex, datatype, key, data, dataSize);
+            err = writeItemToPage(getCurrentPage(), nsIndex, datatype, key, data, dataSize);
             if (err == ESP_ERR_NVS_PAGE_FULL) {
                 return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
             }
@@ -381,8 +709,148 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
                 findPage->state() == Page::PageState::INVALID) {
             ESP_ERROR_CHECK(findItem(nsIndex, datatype, key, findPage, item));
         }
-        err = findPage->eraseItem(nsIndex, datatype, key);
+        err = eraseItemFromPage(*findPage, nsIndex, datatype, key);
+        if (err == ESP_ERR_FLASH_OP_FAIL) {
+            mCleanupPending = true;
+            return ESP_ERR_NVS_REMOVE_FAILED;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeItems(ItemBatch& batch)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    enum class OldValue : uint8_t {
+        NONE,
+        ITEM,
+        BLOB,
+        LEGACY_BLOB,
+    };
+    OldValue oldValues[Page::ENTRY_COUNT];
+    Item* entries = batch.entries();
+    esp_err_t err;
+
+    // Look up the stored values of all staged keys. Values which don't change are dropped,
+    // blobs get the version which isn't used by the stored blob.
+    for (size_t i = 0; i < batch.entryCount(); ) {
+        const Item& entry = entries[i];
+        Page* findPage = nullptr;
+        Item item;
+        oldValues[i] = OldValue::NONE;
+
+        if (entry.datatype == ItemType::BLOB_DATA) {
+            err = findItem(entry.nsIndex, ItemType::BLOB_IDX, entry.key, findPage, item);
+            if (err == ESP_OK) {
+                if (cmpMultiPageBlob(entry.nsIndex, entry.key, entries[i + 1].rawData, entry.varLength.dataSize) == ESP_OK) {
+                    batch.remove(i);
+                    continue;
+                }
+                oldValues[i] = OldValue::BLOB;
+                batch.setBlobVersion(i, (item.blobIndex.chunkStart == VerOffset::VER_1_OFFSET) ?
+                        VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET);
+            } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+                batch.setBlobVersion(i, VerOffset::VER_0_OFFSET);
+                /* Support for earlier versions where BLOBS were stored without index */
+                err = findItem(entry.nsIndex, ItemType::BLOB, entry.key, findPage, item);
+                if (err == ESP_OK) {
+                    oldValues[i] = OldValue::LEGACY_BLOB;
+                }
+            }
+        } else {
+            const void* data = entry.data;
+            // size of primitive types is encoded in the lower nibble of the type
+            size_t dataSize = static_cast<uint8_t>(entry.datatype) & 0x0f;
+            if (isVariableLengthType(entry.datatype)) {
+                data = entries[i + 1].rawData;
+                dataSize = entry.varLength.dataSize;
+            }
+            err = findItem(entry.nsIndex, entry.datatype, entry.key, findPage, item);
+            if (err == ESP_OK) {
+                if (findPage->cmpItem(entry.nsIndex, entry.datatype, entry.key, data, dataSize) == ESP_OK) {
+                    batch.remove(i);
+                    continue;
+                }
+                oldValues[i] = OldValue::ITEM;
+            }
+        }
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            return err;
+        }
+        i += batch.recordSpan(i);
+    }
+
+    if (batch.empty()) {
+        return ESP_OK;
+    }
+
+    // All entries go to the same page, request new pages as long as this improves the available room
+    Page* page;
+    while (true) {
+        page = &getCurrentPage();
+        size_t tailroom = page->getVarDataTailroom();
+        err = page->writeItems(entries, batch.entryCount());
+        if (err != ESP_ERR_NVS_PAGE_FULL) {
+            break;
+        }
+        if (page->state() != Page::PageState::FULL) {
+            err = page->markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (getCurrentPage().getVarDataTailroom() <= tailroom) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    // the entries may have made it to flash even if the write failed, stale index entries are harmless
+    for (size_t i = 0; i < batch.entryCount(); i += entries[i].span) {
+        mKeyIndex.insert(KeyIndex::hash(entries[i].nsIndex, entries[i].key, entries[i].chunkIndex), page);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Now erase the old values. If power goes off in between, the duplicates are removed on the next load.
+    for (size_t i = 0; i < batch.entryCount(); i += batch.recordSpan(i)) {
+        const Item& entry = entries[i];
+        Page* findPage = nullptr;
+        Item item;
+
+        err = ESP_OK;
+        if (oldValues[i] == OldValue::ITEM) {
+            // the old value precedes the new one, so it is found first
+            err = findItem(entry.nsIndex, entry.datatype, entry.key, findPage, item);
+            if (err == ESP_OK) {
+                err = eraseItemFromPage(*findPage, entry.nsIndex, entry.datatype, entry.key);
+            }
+        } else if (oldValues[i] == OldValue::BLOB) {
+            VerOffset prevStart = (entry.chunkIndex == static_cast<uint8_t>(VerOffset::VER_1_OFFSET)) ?
+                    VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+            err = eraseMultiPageBlob(entry.nsIndex, entry.key, prevStart);
+        } else if (oldValues[i] == OldValue::LEGACY_BLOB) {
+            err = findItem(entry.nsIndex, ItemType::BLOB, entry.key, findPage, item);
+            if (err == ESP_OK) {
+                err = eraseItemFromPage(*findPage, entry.nsIndex, ItemType::BLOB, entry.key);
+            }
+        }
+
         if (err == ESP_ERR_FLASH_OP_FAIL) {
+            mCleanupPending = true;
             return ESP_ERR_NVS_REMOVE_FAILED;
         }
         if (err != ESP_OK) {
@@ -562,7 +1030,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
         return err;
     }
     /* Erase the index first and make children blobs orphan*/
-    err = findPage->eraseItem(nsIndex, ItemType::BLOB_IDX, key, Page::CHUNK_ANY, chunkStart);
+    err = eraseItemFromPage(*findPage, nsIndex, ItemType::BLOB_IDX, key, Page::CHUNK_ANY, chunkStart);
     if (err != ESP_OK) {
         return err;
     }
@@ -584,7 +1052,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
         } else if (err == ESP_ERR_NVS_NOT_FOUND) {
             continue; // Keep erasing other chunks
         }
-        err = findPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t> (chunkStart) + chunkNum);
+        err = eraseItemFromPage(*findPage, nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t> (chunkStart) + chunkNum);
         if (err != ESP_OK) {
             return err;
         }
@@ -594,6 +1062,338 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
     return ESP_OK;
 }
 
+esp_err_t Storage::openBlobStream(uint8_t nsIndex, const char* key, bool write, BlobStream& stream)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    stream.nsIndex = nsIndex;
+    strncpy(stream.key, key, sizeof(stream.key) - 1);
+    stream.key[sizeof(stream.key) - 1] = 0;
+    stream.write = write;
+    stream.error = ESP_OK;
+    stream.chunkType = ItemType::BLOB_DATA;
+    stream.chunkCount = 0;
+    stream.dataSize = 0;
+    stream.prevStart = VerOffset::VER_ANY;
+    stream.cursorChunk = 0;
+    stream.cursorOffset = 0;
+    stream.verifiedChunk = Page::CHUNK_ANY;
+    stream.buffer.reset();
+    stream.bufferedSize = 0;
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+
+    if (write) {
+        if (err == ESP_OK) {
+            stream.prevStart = item.blobIndex.chunkStart;
+        }
+        /* Toggle the version by changing the offset */
+        stream.chunkStart = (stream.prevStart == VerOffset::VER_0_OFFSET) ? VerOffset::VER_1_OFFSET : VerOffset::VER_0_OFFSET;
+        stream.buffer.reset(new (std::nothrow) uint8_t[Page::CHUNK_MAX_SIZE]);
+        if (!stream.buffer) {
+            return ESP_ERR_NO_MEM;
+        }
+        ++mOpenWriteStreams;
+        return ESP_OK;
+    }
+
+    if (err == ESP_OK) {
+        stream.chunkStart = item.blobIndex.chunkStart;
+        stream.chunkCount = item.blobIndex.chunkCount;
+        stream.dataSize = item.blobIndex.dataSize;
+        return ESP_OK;
+    }
+
+    /* Support for earlier versions where BLOBS were stored without index */
+    err = findItem(nsIndex, ItemType::BLOB, key, findPage, item);
+    if (err != ESP_OK) {
+        return err;
+    }
+    stream.chunkType = ItemType::BLOB;
+    stream.chunkStart = VerOffset::VER_ANY;
+    stream.chunkCount = 1;
+    stream.dataSize = item.varLength.dataSize;
+    return ESP_OK;
+}
+
+esp_err_t Storage::accessBlobStream(BlobStream& stream, size_t offset, uint8_t* readData, const uint8_t* cmpData, size_t dataSize)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (stream.write) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+    if (offset > stream.dataSize || dataSize > stream.dataSize - offset) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    // chunk sizes are only known from their headers, so seeking backwards starts over at the first chunk
+    if (offset < stream.cursorOffset) {
+        stream.cursorChunk = 0;
+        stream.cursorOffset = 0;
+    }
+
+    while (dataSize > 0) {
+        if (stream.cursorChunk >= stream.chunkCount) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        uint8_t chunkIdx = (stream.chunkType == ItemType::BLOB) ?
+                Page::CHUNK_ANY : static_cast<uint8_t>(stream.chunkStart) + stream.cursorChunk;
+        Page* findPage = nullptr;
+        Item item;
+        auto err = findItem(stream.nsIndex, stream.chunkType, stream.key, findPage, item, chunkIdx);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        size_t chunkSize = item.varLength.dataSize;
+        if (offset >= stream.cursorOffset + chunkSize) {
+            stream.cursorOffset += chunkSize;
+            ++stream.cursorChunk;
+            continue;
+        }
+
+        size_t chunkOffset = offset - stream.cursorOffset;
+        size_t size = std::min(dataSize, chunkSize - chunkOffset);
+        if (readData) {
+            // the CRC covers the whole chunk, check it once for each chunk which is read from
+            bool verify = (stream.verifiedChunk != stream.cursorChunk);
+            err = findPage->readItemData(stream.nsIndex, stream.chunkType, stream.key, chunkOffset, readData, size, chunkIdx, verify);
+            if (err == ESP_OK) {
+                stream.verifiedChunk = stream.cursorChunk;
+            }
+            readData += size;
+        } else {
+            err = findPage->cmpItemData(stream.nsIndex, stream.chunkType, stream.key, chunkOffset, cmpData, size, chunkIdx);
+            cmpData += size;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        offset += size;
+        dataSize -= size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::readBlobStream(BlobStream& stream, size_t offset, void* data, size_t dataSize)
+{
+    return accessBlobStream(stream, offset, static_cast<uint8_t*>(data), nullptr, dataSize);
+}
+
+esp_err_t Storage::cmpBlobStream(BlobStream& stream, size_t offset, const void* data, size_t dataSize)
+{
+    return accessBlobStream(stream, offset, nullptr, static_cast<const uint8_t*>(data), dataSize);
+}
+
+esp_err_t Storage::writeBlobStream(BlobStream& stream, const void* data, size_t dataSize)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (!stream.write || stream.error != ESP_OK) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    /* Same limits as for blobs which are written at once, see writeMultiPageBlob */
+    uint32_t max_pages = mPageManager.getPageCount() - 1;
+    if (max_pages > (Page::CHUNK_ANY-1)/2) {
+       max_pages = (Page::CHUNK_ANY-1)/2;
+    }
+    if (stream.dataSize + stream.bufferedSize + dataSize > max_pages * Page::CHUNK_MAX_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    esp_err_t err = ESP_OK;
+    while (dataSize > 0) {
+        size_t size = std::min(dataSize, Page::CHUNK_MAX_SIZE - stream.bufferedSize);
+        memcpy(stream.buffer.get() + stream.bufferedSize, src, size);
+        stream.bufferedSize += size;
+        src += size;
+        dataSize -= size;
+
+        err = flushBlobStream(stream, false);
+        if (err != ESP_OK) {
+            break;
+        }
+    }
+
+    if (err != ESP_OK) {
+        stream.error = err;
+    }
+    return err;
+}
+
+/* Write the buffered data of a write stream as chunks. Unless final is set, only chunks which fill the
+   current page are written and the rest stays buffered; a full buffer always fills at least one page. */
+esp_err_t Storage::flushBlobStream(BlobStream& stream, bool final)
+{
+    const uint8_t* src = stream.buffer.get();
+    size_t dataSize = stream.bufferedSize;
+    esp_err_t err = ESP_OK;
+    while (dataSize > 0) {
+        Page& page = getCurrentPage();
+        size_t tailroom = page.getVarDataTailroom();
+        if (tailroom < dataSize && tailroom < Page::CHUNK_MAX_SIZE/10) {
+            /* Don't start a chunk in the small rest of a page */
+            if (page.state() != Page::PageState::FULL) {
+                err = page.markFull();
+                if (err != ESP_OK) {
+                    break;
+                }
+            }
+            err = requestNewPage();
+            if (err != ESP_OK) {
+                break;
+            } else if (getCurrentPage().getVarDataTailroom() == tailroom) {
+                /* We got the same page or we are not improving.*/
+                err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+                break;
+            }
+            continue;
+        }
+
+        if (!final && dataSize < tailroom) {
+            break;
+        }
+
+        if (stream.chunkCount >= (Page::CHUNK_ANY-1)/2) {
+            err = ESP_ERR_NVS_VALUE_TOO_LONG;
+            break;
+        }
+
+        size_t chunkSize = std::min(dataSize, tailroom);
+        err = writeItemToPage(page, stream.nsIndex, ItemType::BLOB_DATA, stream.key, src, chunkSize,
+                static_cast<uint8_t>(stream.chunkStart) + stream.chunkCount);
+        assert(err != ESP_ERR_NVS_PAGE_FULL);
+        if (err != ESP_OK) {
+            break;
+        }
+        ++stream.chunkCount;
+        stream.dataSize += chunkSize;
+        src += chunkSize;
+        dataSize -= chunkSize;
+
+        /* Keep room for the index entry, or move on to the next page */
+        if ((tailroom - chunkSize) < Page::ENTRY_SIZE) {
+            if (page.state() != Page::PageState::FULL) {
+                err = page.markFull();
+                if (err != ESP_OK) {
+                    break;
+                }
+            }
+            err = requestNewPage();
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+    }
+
+    memmove(stream.buffer.get(), src, dataSize);
+    stream.bufferedSize = dataSize;
+    return err;
+}
+
+void Storage::eraseBlobStreamChunks(BlobStream& stream)
+{
+    for (uint8_t chunkNum = 0; chunkNum < stream.chunkCount; chunkNum++) {
+        Page* findPage = nullptr;
+        Item item;
+        uint8_t chunkIdx = static_cast<uint8_t>(stream.chunkStart) + chunkNum;
+        if (findItem(stream.nsIndex, ItemType::BLOB_DATA, stream.key, findPage, item, chunkIdx) == ESP_OK) {
+            eraseItemFromPage(*findPage, stream.nsIndex, ItemType::BLOB_DATA, stream.key, chunkIdx);
+        }
+    }
+}
+
+esp_err_t Storage::closeBlobStream(BlobStream& stream, bool commit)
+{
+    if (!stream.write) {
+        return ESP_OK;
+    }
+    if (mOpenWriteStreams > 0) {
+        --mOpenWriteStreams;
+    }
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    if (commit && stream.error == ESP_OK) {
+        stream.error = flushBlobStream(stream, true);
+    }
+    stream.buffer.reset();
+
+    if (!commit || stream.error != ESP_OK) {
+        /* Chunks which are left behind e.g. because of a power-off are erased on the next init as orphans */
+        eraseBlobStreamChunks(stream);
+        return stream.error;
+    }
+
+    Item item;
+    std::fill_n(item.data, sizeof(item.data), 0xff);
+    item.blobIndex.dataSize = stream.dataSize;
+    item.blobIndex.chunkCount = stream.chunkCount;
+    item.blobIndex.chunkStart = stream.chunkStart;
+
+    Page* page = &getCurrentPage();
+    auto err = writeItemToPage(*page, stream.nsIndex, ItemType::BLOB_IDX, stream.key, item.data, sizeof(item.data));
+    if (err == ESP_ERR_NVS_PAGE_FULL) {
+        if (page->state() != Page::PageState::FULL) {
+            err = page->markFull();
+        }
+        if (err == ESP_OK) {
+            err = requestNewPage();
+        }
+        if (err == ESP_OK) {
+            err = writeItemToPage(getCurrentPage(), stream.nsIndex, ItemType::BLOB_IDX, stream.key, item.data, sizeof(item.data));
+            if (err == ESP_ERR_NVS_PAGE_FULL) {
+                err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+            }
+        }
+    }
+    if (err != ESP_OK) {
+        eraseBlobStreamChunks(stream);
+        return err;
+    }
+
+    /* Erase the blob with earlier version */
+    if (stream.prevStart != VerOffset::VER_ANY) {
+        err = eraseMultiPageBlob(stream.nsIndex, stream.key, stream.prevStart);
+    } else {
+        /* Support for earlier versions where BLOBS were stored without index */
+        Page* findPage = nullptr;
+        err = findItem(stream.nsIndex, ItemType::BLOB, stream.key, findPage, item);
+        if (err == ESP_OK) {
+            err = eraseItemFromPage(*findPage, stream.nsIndex, ItemType::BLOB, stream.key);
+        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_ERR_FLASH_OP_FAIL) {
+        mCleanupPending = true;
+        return ESP_ERR_NVS_REMOVE_FAILED;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
 esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key)
 {
     if (mState != StorageState::ACTIVE) {
@@ -615,7 +1415,7 @@ esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key
         return eraseMultiPageBlob(nsIndex, key);
     }
 
-    return findPage->eraseItem(nsIndex, datatype, key);
+    return eraseItemFromPage(*findPage, nsIndex, datatype, key);
 }
 
 esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
@@ -625,14 +1425,21 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
     }
 
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
+        size_t itemIndex = 0;
+        Item item;
         while (true) {
-            auto err = it->eraseItem(nsIndex, ItemType::ANY, nullptr);
+            auto err = it->findItem(nsIndex, ItemType::ANY, nullptr, itemIndex, item);
             if (err == ESP_ERR_NVS_NOT_FOUND) {
                 break;
             }
             else if (err != ESP_OK) {
                 return err;
             }
+            // erase by key, so that the item can also be dropped from the key index
+            err = eraseItemFromPage(*it, item.nsIndex, item.datatype, item.key, item.chunkIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
         }
     }
     return ESP_OK;
@@ -20,6 +20,8 @@
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_key_index.hpp"
+#include "nvs_item_batch.hpp"
 #include "partition.hpp"
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
@@ -27,6 +29,28 @@
 namespace nvs
 {
 
+/**
+ * State of a blob which is read or written piece by piece, see Storage::openBlobStream().
+ * Reads go directly between flash and the caller's buffer. A write stream collects the data in a buffer
+ * of one chunk, so that the blob consists of full-size chunks however small the pieces passed to it are.
+ */
+struct BlobStream {
+    uint8_t nsIndex;
+    char key[Item::MAX_KEY_LENGTH + 1];
+    bool write;
+    esp_err_t error;        // first error of a write stream, such a stream can only be closed
+    ItemType chunkType;     // BLOB_DATA, or BLOB for blobs stored in the old format without index
+    VerOffset chunkStart;
+    uint8_t chunkCount;
+    size_t dataSize;
+    VerOffset prevStart;    // version of the blob replaced by a write stream, VER_ANY if there is none
+    uint8_t cursorChunk;    // chunk which was accessed last ...
+    size_t cursorOffset;    // ... and the offset of its first byte within the blob
+    uint8_t verifiedChunk;  // chunk whose data CRC has been checked, CHUNK_ANY if none
+    std::unique_ptr<uint8_t[]> buffer;  // data of a write stream not yet written, Page::CHUNK_MAX_SIZE bytes
+    size_t bufferedSize;
+};
+
 class Storage : public intrusive_list_node<Storage>
 {
     enum class StorageState : uint32_t {
@@ -58,6 +82,22 @@ class Storage : public intrusive_list_node<Storage>
 
     typedef intrusive_list<BlobIndexNode> TBlobIndexList;
 
+    /**
+     * Summary record, stored as a data chunk in the namespace table (see Storage::writeSummary()).
+     * The header is followed by one SummaryNamespace for each namespace.
+     */
+    struct SummaryHeader {
+        uint32_t mDigest;           // PageManager::calcStateDigest(), the entries of the summary counting as empty
+        uint16_t mPageCount;
+        uint8_t mVersion;
+        uint8_t mNamespaceCount;
+    };
+
+    struct SummaryNamespace {
+        uint8_t mIndex;
+        char mName[Item::MAX_KEY_LENGTH];   // not null-terminated if the name takes all of it
+    };
+
 public:
     ~Storage();
 
@@ -75,6 +115,12 @@ public:
 
     esp_err_t writeItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
 
+    /**
+     * Write all items staged in the batch to a single page. The new values become visible at once.
+     * Staged values which are equal to the stored ones are dropped from the batch.
+     */
+    esp_err_t writeItems(ItemBatch& batch);
+
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize);
 
     esp_err_t getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize);
@@ -123,6 +169,38 @@ public:
 
     esp_err_t eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    /**
+     * Prepare reading or writing a blob in pieces. A read stream refers to the blob stored at the time of
+     * opening, a write stream creates a new version of the blob which replaces the stored one once
+     * the stream is closed. The blob must not be modified otherwise while a stream is open.
+     */
+    esp_err_t openBlobStream(uint8_t nsIndex, const char* key, bool write, BlobStream& stream);
+
+    esp_err_t readBlobStream(BlobStream& stream, size_t offset, void* data, size_t dataSize);
+
+    esp_err_t cmpBlobStream(BlobStream& stream, size_t offset, const void* data, size_t dataSize);
+
+    /**
+     * Append data to the blob of a write stream. The data is buffered and written as soon as it fills
+     * a chunk up to the end of the current page; the rest is written when the stream is committed.
+     */
+    esp_err_t writeBlobStream(BlobStream& stream, const void* data, size_t dataSize);
+
+    /**
+     * Finish a stream. Closing a write stream with commit set writes the blob index and erases the previous
+     * version of the blob, otherwise the chunks written so far are erased.
+     */
+    esp_err_t closeBlobStream(BlobStream& stream, bool commit);
+
+    /**
+     * Write a summary of the partition (a checksum of the page states and the namespace table), which allows
+     * the next init() to skip loading the items of all full pages as long as nothing has been modified since.
+     * The previous summary is replaced. Does nothing if fast mount is disabled or the summary is up to date.
+     * No summary is written while a write stream is open or after an item could not be removed, because
+     * the chunks or duplicates left behind have to be cleaned up by a full load at the next init().
+     */
+    esp_err_t writeSummary();
+
     void debugDump();
 
     void debugCheck();
@@ -152,13 +230,46 @@ protected:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    esp_err_t findItemIndexed(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart);
+
+    esp_err_t writeItemToPage(Page& page, uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = Page::CHUNK_ANY);
+
+    esp_err_t eraseItemFromPage(Page& page, uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+    esp_err_t requestNewPage();
+
+    void buildKeyIndex();
+
+    void eraseDuplicateItems();
+
+    esp_err_t loadSummary();
+
+    esp_err_t accessBlobStream(BlobStream& stream, size_t offset, uint8_t* readData, const uint8_t* cmpData, size_t dataSize);
+
+    esp_err_t flushBlobStream(BlobStream& stream, bool final);
+
+    void eraseBlobStreamChunks(BlobStream& stream);
+
 protected:
+    static const size_t KEY_INDEX_MAX_ENTRIES;
+
+    static const bool FAST_MOUNT;
+
     Partition *mPartition;
     size_t mPageCount;
     PageManager mPageManager;
     TNamespaces mNamespaces;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
+    KeyIndex mKeyIndex {KEY_INDEX_MAX_ENTRIES};
+    bool mKeyIndexDeferred = false;     // key index is built by the first lookup after a fast mount
+    bool mFastMount = FAST_MOUNT;
+    Page* mSummaryPage = nullptr;       // location of the summary which is known to be up to date ...
+    size_t mSummaryIndex = 0;
+    size_t mSummarySpan = 0;
+    uint32_t mSummaryDigest = 0;        // ... and the page state it describes
+    size_t mOpenWriteStreams = 0;       // write streams whose chunks would be orphans after a power-off
+    bool mCleanupPending = false;       // a failed remove left a duplicate behind
 };
 
 } // namespace nvs
@@ -39,11 +39,9 @@ uint32_t Item::calculateCrc32WithoutValue() const
     return result;
 }
 
-uint32_t Item::calculateCrc32(const uint8_t* data, size_t size)
+uint32_t Item::calculateCrc32(const uint8_t* data, size_t size, uint32_t crc)
 {
-    uint32_t result = 0xffffffff;
-    result = esp_rom_crc32_le(result, data, size);
-    return result;
+    return esp_rom_crc32_le(crc, data, size);
 }
 
 } // namespace nvs
@@ -13,6 +13,7 @@
 // limitations under the License.
 #include "nvs_partition.hpp"
 #include "nvs_encrypted_partition.hpp"
+#include "nvs_storage.hpp"
 #include "spi_flash_emulation.h"
 #include "nvs.h"
 
@@ -147,3 +148,33 @@ struct EncryptedPartitionFixture {
 
     nvs::NVSEncryptedPartition part;
 };
+
+/**
+ * Storage whose key index may hold at most the given number of entries. A limit of 0 disables the
+ * index, so that all lookups search the pages one by one.
+ */
+class KeyIndexLimitedStorage : public nvs::Storage {
+public:
+    KeyIndexLimitedStorage(nvs::Partition *partition, size_t maxKeyIndexEntries) : Storage(partition)
+    {
+        mKeyIndex.setMaxEntries(maxKeyIndexEntries);
+    }
+
+    bool isKeyIndexActive() const
+    {
+        return mKeyIndex.isActive();
+    }
+};
+
+class FastMountStorage : public nvs::Storage {
+public:
+    FastMountStorage(nvs::Partition *partition, bool fastMount = true) : Storage(partition)
+    {
+        mFastMount = fastMount;
+    }
+
+    bool isSummaryValid() const
+    {
+        return mSummaryPage != nullptr;
+    }
+};
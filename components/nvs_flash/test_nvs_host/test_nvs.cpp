@@ -27,6 +27,7 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <string>
+#include <chrono>
 
 #include "test_fixtures.hpp"
 
@@ -3523,6 +3524,715 @@ TEST_CASE("check and read data from partition generated via manufacturing utilit
 }
 #endif
 
+static double measure_lookups_per_second(Storage& storage, size_t keyCount, size_t lookupCount)
+{
+    char key[16];
+    uint32_t value;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookupCount; ++i) {
+        snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>((i * 7919) % keyCount));
+        CHECK(storage.readItem(1, key, value) == ESP_OK);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return lookupCount / elapsed.count();
+}
+
+TEST_CASE("benchmark key lookups with and without key index", "[nvs][benchmark]")
+{
+    const size_t LOOKUP_COUNT = 5000;
+    const uint32_t pageCounts[] = {4, 16, 64, 256};
+    char key[16];
+
+    for (uint32_t pageCount : pageCounts) {
+        PartitionEmulationFixture f(0, pageCount);
+        // fill all pages but the spare one, writing them directly is much faster than going through Storage
+        const size_t keyCount = (pageCount - 1) * Page::ENTRY_COUNT;
+        for (uint32_t pageIndex = 0; pageIndex < pageCount - 1; ++pageIndex) {
+            Page p;
+            p.load(&f.part, pageIndex);
+            p.setSeqNumber(pageIndex);
+            for (size_t i = pageIndex * Page::ENTRY_COUNT; i < (pageIndex + 1) * Page::ENTRY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                REQUIRE(p.writeItem(1, key, static_cast<uint32_t>(i)) == ESP_OK);
+            }
+        }
+
+        KeyIndexLimitedStorage indexedStorage(&f.part, keyCount);
+        REQUIRE(indexedStorage.init(0, pageCount) == ESP_OK);
+        REQUIRE(indexedStorage.isKeyIndexActive());
+        double indexed = measure_lookups_per_second(indexedStorage, keyCount, LOOKUP_COUNT);
+
+        KeyIndexLimitedStorage scanStorage(&f.part, 0);
+        REQUIRE(scanStorage.init(0, pageCount) == ESP_OK);
+        double scanned = measure_lookups_per_second(scanStorage, keyCount, LOOKUP_COUNT);
+
+        s_perf << "Key lookups with " << pageCount << " pages (" << keyCount << " keys): "
+               << static_cast<uint64_t>(indexed) << "/s with key index, "
+               << static_cast<uint64_t>(scanned) << "/s without" << std::endl;
+    }
+}
+
+TEST_CASE("nvs batch api writes staged values on commit", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 3);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "i32", -1));
+    uint8_t blob[64];
+    memset(blob, 0x11, sizeof(blob));
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+
+    TEST_ESP_ERR(nvs_batch_set_u8(handle, "u8", 1), ESP_ERR_INVALID_STATE);
+    TEST_ESP_ERR(nvs_batch_commit(handle), ESP_ERR_INVALID_STATE);
+
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_ERR(nvs_batch_begin(handle), ESP_ERR_INVALID_STATE);
+    TEST_ESP_OK(nvs_batch_set_u8(handle, "u8", 1));
+    TEST_ESP_OK(nvs_batch_set_u8(handle, "u8", 2));
+    TEST_ESP_OK(nvs_batch_set_i32(handle, "i32", 42));
+    TEST_ESP_OK(nvs_batch_set_u64(handle, "u64", 0x123456789abcdefULL));
+    TEST_ESP_OK(nvs_batch_set_str(handle, "str", "staged string"));
+    memset(blob, 0x22, sizeof(blob));
+    TEST_ESP_OK(nvs_batch_set_blob(handle, "blob", blob, sizeof(blob)));
+    TEST_ESP_ERR(nvs_batch_set_u8(handle, "key_is_too_long_", 1), ESP_ERR_NVS_KEY_TOO_LONG);
+
+    // nothing is visible before the commit
+    uint8_t u8;
+    int32_t i32;
+    TEST_ESP_ERR(nvs_get_u8(handle, "u8", &u8), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_get_i32(handle, "i32", &i32));
+    CHECK(i32 == -1);
+
+    TEST_ESP_OK(nvs_batch_commit(handle));
+    TEST_ESP_ERR(nvs_batch_commit(handle), ESP_ERR_INVALID_STATE);
+
+    uint64_t u64;
+    char str[32];
+    size_t strSize = sizeof(str);
+    uint8_t readBlob[sizeof(blob)];
+    size_t blobSize = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_u8(handle, "u8", &u8));
+    CHECK(u8 == 2);
+    TEST_ESP_OK(nvs_get_i32(handle, "i32", &i32));
+    CHECK(i32 == 42);
+    TEST_ESP_OK(nvs_get_u64(handle, "u64", &u64));
+    CHECK(u64 == 0x123456789abcdefULL);
+    TEST_ESP_OK(nvs_get_str(handle, "str", str, &strSize));
+    CHECK(strcmp(str, "staged string") == 0);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+    CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+    // the old values have been erased
+    nvs_stats_t stats;
+    TEST_ESP_OK(nvs_get_stats(NVS_DEFAULT_PART_NAME, &stats));
+    size_t usedEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedEntries));
+    CHECK(usedEntries == 1 + 1 + 1 + 2 + 4);
+
+    // aborted batches don't change anything
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_OK(nvs_batch_set_u8(handle, "u8", 3));
+    nvs_batch_abort(handle);
+    TEST_ESP_OK(nvs_get_u8(handle, "u8", &u8));
+    CHECK(u8 == 2);
+
+    // committing unchanged values doesn't write to flash
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_OK(nvs_batch_set_u8(handle, "u8", 2));
+    TEST_ESP_OK(nvs_batch_set_blob(handle, "blob", blob, sizeof(blob)));
+    f.emu.clearStats();
+    TEST_ESP_OK(nvs_batch_commit(handle));
+    CHECK(f.emu.getWriteOps() == 0);
+
+    // values survive re-initialization
+    nvs_close(handle);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+    TEST_ESP_OK(nvs_open("test", NVS_READONLY, &handle));
+    TEST_ESP_ERR(nvs_batch_begin(handle), ESP_ERR_NVS_READ_ONLY);
+    TEST_ESP_OK(nvs_get_u8(handle, "u8", &u8));
+    CHECK(u8 == 2);
+    blobSize = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+    CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+    nvs_close(handle);
+
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("nvs batch must fit into a single page", "[nvs]")
+{
+    ItemBatch batch;
+    char key[16];
+    for (uint32_t i = 0; i < Page::ENTRY_COUNT; ++i) {
+        snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(batch.add(1, ItemType::U32, key, &i, sizeof(i)));
+    }
+    uint32_t value = 0;
+    TEST_ESP_ERR(batch.add(1, ItemType::U32, "one_more", &value, sizeof(value)), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    // replacing a staged value doesn't need more room
+    TEST_ESP_OK(batch.add(1, ItemType::U32, "key_0", &value, sizeof(value)));
+    CHECK(batch.entryCount() == static_cast<size_t>(Page::ENTRY_COUNT));
+
+    uint8_t blob[Page::CHUNK_MAX_SIZE];
+    batch.clear();
+    TEST_ESP_ERR(batch.add(1, ItemType::BLOB, "blob", blob, sizeof(blob)), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    TEST_ESP_OK(batch.add(1, ItemType::BLOB, "blob", blob, sizeof(blob) - Page::ENTRY_SIZE));
+    CHECK(batch.entryCount() == static_cast<size_t>(Page::ENTRY_COUNT));
+
+    // a full batch ends up on a fresh page
+    PartitionEmulationFixture f(0, 3);
+    Storage storage(&f.part);
+    TEST_ESP_OK(storage.init(0, 3));
+    TEST_ESP_OK(storage.writeItem(1, "first", value));
+    TEST_ESP_OK(storage.writeItems(batch));
+    size_t readSize;
+    TEST_ESP_OK(storage.getItemDataSize(1, ItemType::BLOB, "blob", readSize));
+    CHECK(readSize == sizeof(blob) - Page::ENTRY_SIZE);
+    TEST_ESP_OK(storage.readItem(1, "first", value));
+}
+
+TEST_CASE("nvs batch is written atomically if power goes off", "[nvs]")
+{
+    const size_t KEY_COUNT = 8;
+    const char oldStr[] = "old string";
+    const char newStr[] = "new string which is longer than the old one";
+    uint8_t oldBlob[100];
+    uint8_t newBlob[200];
+    std::fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    std::fill_n(newBlob, sizeof(newBlob), 0x22);
+    // makes the batch go to the second page
+    std::string filler(Page::CHUNK_MAX_SIZE - 20 * Page::ENTRY_SIZE, 'x');
+    char key[16];
+
+    // duplicates are looked up with the key index, or page by page if it is disabled
+    for (size_t maxKeyIndexEntries : {1024, 0}) {
+        for (uint32_t failAfter = 0; ; ++failAfter) {
+            PartitionEmulationFixture f(0, 3);
+            esp_err_t err;
+            {
+                Storage storage(&f.part);
+                REQUIRE(storage.init(0, 3) == ESP_OK);
+                for (uint32_t i = 0; i < KEY_COUNT; ++i) {
+                    snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                    REQUIRE(storage.writeItem(1, key, i) == ESP_OK);
+                }
+                REQUIRE(storage.writeItem(1, ItemType::SZ, "str", oldStr, sizeof(oldStr)) == ESP_OK);
+                REQUIRE(storage.writeItem(1, ItemType::BLOB, "blob", oldBlob, sizeof(oldBlob)) == ESP_OK);
+                REQUIRE(storage.writeItem(1, ItemType::SZ, "filler", filler.c_str(), filler.size() + 1) == ESP_OK);
+
+                ItemBatch batch;
+                for (uint32_t i = 0; i < KEY_COUNT; ++i) {
+                    snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                    uint32_t value = i + 100;
+                    REQUIRE(batch.add(1, ItemType::U32, key, &value, sizeof(value)) == ESP_OK);
+                }
+                REQUIRE(batch.add(1, ItemType::SZ, "str", newStr, sizeof(newStr)) == ESP_OK);
+                REQUIRE(batch.add(1, ItemType::BLOB, "blob", newBlob, sizeof(newBlob)) == ESP_OK);
+
+                f.emu.failAfter(failAfter);
+                err = storage.writeItems(batch);
+                f.emu.failAfter(UINT32_MAX);
+            }
+
+            KeyIndexLimitedStorage storage(&f.part, maxKeyIndexEntries);
+            REQUIRE(storage.init(0, 3) == ESP_OK);
+            CHECK(storage.isKeyIndexActive() == (maxKeyIndexEntries != 0));
+            uint32_t value;
+            REQUIRE(storage.readItem(1, "key_0", value) == ESP_OK);
+            const bool isNew = (value == 100);
+            if (err == ESP_OK) {
+                CHECK(isNew);
+            }
+            for (uint32_t i = 0; i < KEY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                REQUIRE(storage.readItem(1, key, value) == ESP_OK);
+                CHECK(value == (isNew ? i + 100 : i));
+            }
+            char str[sizeof(newStr)];
+            REQUIRE(storage.readItem(1, ItemType::SZ, "str", str, sizeof(str)) == ESP_OK);
+            CHECK(strcmp(str, isNew ? newStr : oldStr) == 0);
+            uint8_t blob[sizeof(newBlob)];
+            size_t blobSize = isNew ? sizeof(newBlob) : sizeof(oldBlob);
+            REQUIRE(storage.readItem(1, ItemType::BLOB, "blob", blob, blobSize) == ESP_OK);
+            CHECK(memcmp(blob, isNew ? newBlob : oldBlob, blobSize) == 0);
+            size_t usedEntries;
+            REQUIRE(storage.calcEntriesInNamespace(1, usedEntries) == ESP_OK);
+            CHECK(usedEntries == KEY_COUNT + 1 + (isNew ? 2 + 1 + 7 + 1 : 1 + 1 + 4 + 1) + 1 + filler.size() / Page::ENTRY_SIZE + 1);
+
+            if (err == ESP_OK) {
+                break;
+            }
+        }
+    }
+}
+
+TEST_CASE("count flash operations of individual and batched writes", "[nvs][benchmark]")
+{
+    const size_t keyCounts[] = {1, 8, 32, 100};
+    char key[16];
+
+    for (size_t keyCount : keyCounts) {
+        size_t writeOps[2];
+        size_t eraseOps[2];
+        for (int batched = 0; batched < 2; ++batched) {
+            PartitionEmulationFixture f(0, 4);
+            Storage storage(&f.part);
+            REQUIRE(storage.init(0, 4) == ESP_OK);
+            // start from a partially used page, so that the writes have to move to a new one
+            for (uint32_t i = 0; i < Page::ENTRY_COUNT - 20; ++i) {
+                snprintf(key, sizeof(key), "old_%u", static_cast<unsigned>(i));
+                REQUIRE(storage.writeItem(1, key, i) == ESP_OK);
+            }
+
+            f.emu.clearStats();
+            ItemBatch batch;
+            for (uint32_t i = 0; i < keyCount; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                if (batched) {
+                    REQUIRE(batch.add(1, ItemType::U32, key, &i, sizeof(i)) == ESP_OK);
+                } else {
+                    REQUIRE(storage.writeItem(1, key, i) == ESP_OK);
+                }
+            }
+            if (batched) {
+                REQUIRE(storage.writeItems(batch) == ESP_OK);
+            }
+            writeOps[batched] = f.emu.getWriteOps();
+            eraseOps[batched] = f.emu.getEraseOps();
+
+            uint32_t value;
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(keyCount - 1));
+            REQUIRE(storage.readItem(1, key, value) == ESP_OK);
+            CHECK(value == keyCount - 1);
+        }
+        CHECK(writeOps[1] <= writeOps[0]);
+        CHECK(eraseOps[1] <= eraseOps[0]);
+        s_perf << "Writing " << keyCount << " keys: " << writeOps[0] << " writes, " << eraseOps[0] << " erases individually, "
+               << writeOps[1] << " writes, " << eraseOps[1] << " erases batched" << std::endl;
+    }
+}
+
+TEST_CASE("nvs blob stream api reads and writes blobs in pieces", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 10);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 10));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+
+    static uint8_t blob[3 * Page::CHUNK_MAX_SIZE + 123];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 7 + i / 256);
+    }
+
+    nvs_blob_stream_t stream;
+    size_t length;
+    TEST_ESP_ERR(nvs_blob_open_read(handle, "blob", &stream, &length), ESP_ERR_NVS_NOT_FOUND);
+
+    const size_t pieceSize = 1000;
+    TEST_ESP_OK(nvs_blob_open_write(handle, "blob", &stream));
+    for (size_t offset = 0; offset < sizeof(blob); offset += pieceSize) {
+        size_t size = (sizeof(blob) - offset < pieceSize) ? sizeof(blob) - offset : pieceSize;
+        TEST_ESP_OK(nvs_blob_write_next(stream, blob + offset, size));
+    }
+    // the blob isn't visible before the stream is closed
+    size_t blobSize = 0;
+    TEST_ESP_ERR(nvs_get_blob(handle, "blob", nullptr, &blobSize), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    static uint8_t readBlob[sizeof(blob)];
+    blobSize = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+    CHECK(blobSize == sizeof(blob));
+    CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+    TEST_ESP_OK(nvs_blob_open_read(handle, "blob", &stream, &length));
+    CHECK(length == sizeof(blob));
+    const size_t offsets[] = {0, 31, 999, 1000, Page::CHUNK_MAX_SIZE - 5, 17, sizeof(blob) - 300};
+    for (size_t offset : offsets) {
+        uint8_t piece[300];
+        memset(piece, 0, sizeof(piece));
+        TEST_ESP_OK(nvs_blob_read_at(stream, offset, piece, sizeof(piece)));
+        CHECK(memcmp(piece, blob + offset, sizeof(piece)) == 0);
+    }
+    uint8_t piece[16];
+    TEST_ESP_ERR(nvs_blob_read_at(stream, sizeof(blob) - 8, piece, sizeof(piece)), ESP_ERR_NVS_INVALID_LENGTH);
+
+    bool equal = false;
+    TEST_ESP_OK(nvs_blob_cmp_at(stream, 0, blob, sizeof(blob), &equal));
+    CHECK(equal);
+    TEST_ESP_OK(nvs_blob_cmp_at(stream, 2000, blob + 2000, 5000, &equal));
+    CHECK(equal);
+    uint8_t changed = blob[4000] ^ 0x01;
+    TEST_ESP_OK(nvs_blob_cmp_at(stream, 4000, &changed, 1, &equal));
+    CHECK_FALSE(equal);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    // overwriting the blob replaces the previous version
+    size_t usedBefore;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedBefore));
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] ^= 0x5a;
+    }
+    TEST_ESP_OK(nvs_blob_open_write(handle, "blob", &stream));
+    TEST_ESP_OK(nvs_blob_write_next(stream, blob, Page::CHUNK_MAX_SIZE));
+    TEST_ESP_OK(nvs_blob_write_next(stream, blob + Page::CHUNK_MAX_SIZE, sizeof(blob) - Page::CHUNK_MAX_SIZE));
+    TEST_ESP_OK(nvs_blob_close(stream));
+    size_t usedAfter;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedAfter));
+    CHECK(usedAfter <= usedBefore);
+    blobSize = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+    CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+    // an aborted stream keeps the previous value and leaves no chunks behind
+    TEST_ESP_OK(nvs_blob_open_write(handle, "blob", &stream));
+    TEST_ESP_OK(nvs_blob_write_next(stream, blob, 100));
+    nvs_blob_abort(stream);
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedBefore));
+    CHECK(usedBefore == usedAfter);
+    TEST_ESP_OK(nvs_blob_open_read(handle, "blob", &stream, &length));
+    CHECK(length == sizeof(blob));
+    TEST_ESP_OK(nvs_blob_cmp_at(stream, 0, blob, sizeof(blob), &equal));
+    CHECK(equal);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    // blobs written by nvs_set_blob can be read in pieces as well
+    TEST_ESP_OK(nvs_set_blob(handle, "small", blob, 100));
+    TEST_ESP_OK(nvs_blob_open_read(handle, "small", &stream, &length));
+    CHECK(length == 100);
+    TEST_ESP_OK(nvs_blob_read_at(stream, 50, piece, sizeof(piece)));
+    CHECK(memcmp(piece, blob + 50, sizeof(piece)) == 0);
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    nvs_handle_t readOnly;
+    TEST_ESP_OK(nvs_open("test", NVS_READONLY, &readOnly));
+    TEST_ESP_ERR(nvs_blob_open_write(readOnly, "blob", &stream), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(readOnly);
+
+    // a stream doesn't outlive its handle
+    TEST_ESP_OK(nvs_blob_open_read(handle, "blob", &stream, &length));
+    nvs_close(handle);
+    TEST_ESP_ERR(nvs_blob_read_at(stream, 0, piece, sizeof(piece)), ESP_ERR_NVS_INVALID_HANDLE);
+    TEST_ESP_ERR(nvs_blob_close(stream), ESP_ERR_NVS_INVALID_HANDLE);
+
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("nvs blob stream writes a large blob passed in small pieces", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 24);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 24));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+
+    static uint8_t blob[64 * 1024];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 13 + i / 512);
+    }
+
+    // far more pieces than a blob can have chunks
+    const size_t pieceSize = 512;
+    nvs_blob_stream_t stream;
+    TEST_ESP_OK(nvs_blob_open_write(handle, "blob", &stream));
+    for (size_t offset = 0; offset < sizeof(blob); offset += pieceSize) {
+        TEST_ESP_OK(nvs_blob_write_next(stream, blob + offset, pieceSize));
+    }
+    TEST_ESP_OK(nvs_blob_close(stream));
+
+    static uint8_t readBlob[sizeof(blob)];
+    size_t blobSize = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+    CHECK(blobSize == sizeof(blob));
+    CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+    // the pieces are stored in as many entries as the blob written at once
+    size_t streamedEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &streamedEntries));
+    TEST_ESP_OK(nvs_erase_key(handle, "blob"));
+    size_t emptyEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &emptyEntries));
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+    size_t setEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &setEntries));
+    CHECK(streamedEntries - emptyEntries == setEntries - emptyEntries);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("nvs blob stream keeps the previous value if power goes off", "[nvs]")
+{
+    static uint8_t oldBlob[2000];
+    static uint8_t newBlob[5000];
+    memset(oldBlob, 0x11, sizeof(oldBlob));
+    memset(newBlob, 0x22, sizeof(newBlob));
+
+    for (size_t failAfter = 0; ; failAfter += 7) {
+        PartitionEmulationFixture f(0, 5);
+        Storage storage(&f.part);
+        REQUIRE(storage.init(0, 5) == ESP_OK);
+        REQUIRE(storage.writeItem(1, ItemType::BLOB, "blob", oldBlob, sizeof(oldBlob)) == ESP_OK);
+
+        f.emu.failAfter(failAfter);
+        BlobStream stream;
+        esp_err_t err = storage.openBlobStream(1, "blob", true, stream);
+        if (err == ESP_OK) {
+            err = storage.writeBlobStream(stream, newBlob, 3000);
+            if (err == ESP_OK) {
+                err = storage.writeBlobStream(stream, newBlob + 3000, sizeof(newBlob) - 3000);
+            }
+            esp_err_t closeErr = storage.closeBlobStream(stream, err == ESP_OK);
+            if (err == ESP_OK) {
+                err = closeErr;
+            }
+        }
+
+        f.emu.failAfter(UINT32_MAX);
+        Storage recovered(&f.part);
+        REQUIRE(recovered.init(0, 5) == ESP_OK);
+        size_t dataSize;
+        REQUIRE(recovered.getItemDataSize(1, ItemType::BLOB, "blob", dataSize) == ESP_OK);
+        const bool isNew = (dataSize == sizeof(newBlob));
+        if (err == ESP_OK) {
+            CHECK(isNew);
+        }
+        static uint8_t readBlob[sizeof(newBlob)];
+        REQUIRE(recovered.readItem(1, ItemType::BLOB, "blob", readBlob, dataSize) == ESP_OK);
+        CHECK(memcmp(readBlob, isNew ? newBlob : oldBlob, dataSize) == 0);
+
+        if (err == ESP_OK) {
+            break;
+        }
+    }
+}
+
+TEST_CASE("nvs fast mount uses the summary until the partition is modified", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 8);
+    char key[16];
+    uint8_t blob[3000];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i);
+    }
+
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 8) == ESP_OK);
+        CHECK_FALSE(storage.isSummaryValid());
+        uint8_t nsIndex;
+        REQUIRE(storage.createOrOpenNamespace("first", true, nsIndex) == ESP_OK);
+        REQUIRE(storage.createOrOpenNamespace("second_namespac", true, nsIndex) == ESP_OK);
+        for (uint32_t i = 0; i < 300; ++i) {
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+            REQUIRE(storage.writeItem(1 + i % 2, key, i) == ESP_OK);
+        }
+        REQUIRE(storage.writeItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)) == ESP_OK);
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        CHECK(storage.isSummaryValid());
+        // nothing is written if the summary is up to date
+        f.emu.clearStats();
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        CHECK(f.emu.getWriteOps() == 0);
+    }
+
+    f.emu.clearStats();
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 8) == ESP_OK);
+        CHECK(storage.isSummaryValid());
+        // only page headers, entry state tables and the items of the active page are read
+        CHECK(f.emu.getReadOps() < 8 * 2 + Page::ENTRY_COUNT * 2);
+
+        uint8_t nsIndex;
+        REQUIRE(storage.createOrOpenNamespace("second_namespac", false, nsIndex) == ESP_OK);
+        CHECK(nsIndex == 2);
+        REQUIRE(storage.createOrOpenNamespace("first", false, nsIndex) == ESP_OK);
+        CHECK(nsIndex == 1);
+        CHECK(storage.createOrOpenNamespace("third", false, nsIndex) == ESP_ERR_NVS_NOT_FOUND);
+        for (uint32_t i = 0; i < 300; ++i) {
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+            uint32_t value;
+            REQUIRE(storage.readItem(1 + i % 2, key, value) == ESP_OK);
+            CHECK(value == i);
+        }
+        uint8_t readBlob[sizeof(blob)];
+        REQUIRE(storage.readItem(1, ItemType::BLOB, "blob", readBlob, sizeof(readBlob)) == ESP_OK);
+        CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+        // reading doesn't invalidate the summary
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        CHECK(storage.isSummaryValid());
+        // erasing a key does
+        REQUIRE(storage.eraseItem(1, "key_0") == ESP_OK);
+    }
+
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 8) == ESP_OK);
+        CHECK_FALSE(storage.isSummaryValid());
+        uint32_t value;
+        CHECK(storage.readItem(1, "key_0", value) == ESP_ERR_NVS_NOT_FOUND);
+        REQUIRE(storage.readItem(2, "key_1", value) == ESP_OK);
+        REQUIRE(storage.writeItem(1, "key_0", 1000u) == ESP_OK);
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        // only one summary is kept
+        size_t usedEntries;
+        REQUIRE(storage.calcEntriesInNamespace(Page::NS_INDEX, usedEntries) == ESP_OK);
+        CHECK(usedEntries == 2 + 3);
+    }
+
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 8) == ESP_OK);
+        CHECK(storage.isSummaryValid());
+        uint32_t value;
+        REQUIRE(storage.readItem(1, "key_0", value) == ESP_OK);
+        CHECK(value == 1000);
+        // writes work on lazily loaded pages, including the ones which have to be reclaimed
+        for (uint32_t i = 0; i < 1000; ++i) {
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i % 300));
+            REQUIRE(storage.writeItem(1 + i % 2, key, i + 1) == ESP_OK);
+        }
+        for (uint32_t i = 700; i < 1000; ++i) {
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i % 300));
+            REQUIRE(storage.readItem(1 + i % 2, key, value) == ESP_OK);
+            CHECK(value == i + 1);
+        }
+    }
+
+    // without fast mount, the summary is dropped
+    {
+        FastMountStorage storage(&f.part, false);
+        REQUIRE(storage.init(0, 8) == ESP_OK);
+        size_t usedEntries;
+        REQUIRE(storage.calcEntriesInNamespace(Page::NS_INDEX, usedEntries) == ESP_OK);
+        CHECK(usedEntries == 2);
+    }
+}
+
+TEST_CASE("nvs fast mount falls back to a full scan if power goes off", "[nvs]")
+{
+    char key[16];
+    for (size_t failAfter = 0; ; ++failAfter) {
+        PartitionEmulationFixture f(0, 4);
+        {
+            FastMountStorage storage(&f.part);
+            REQUIRE(storage.init(0, 4) == ESP_OK);
+            for (uint32_t i = 0; i < 100; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                REQUIRE(storage.writeItem(1, key, i) == ESP_OK);
+            }
+            REQUIRE(storage.writeSummary() == ESP_OK);
+            REQUIRE(storage.writeItem(1, "key_0", 100u) == ESP_OK);
+
+            f.emu.failAfter(failAfter);
+            esp_err_t err = storage.writeItem(1, "key_1", 101u);
+            if (err == ESP_OK) {
+                err = storage.writeSummary();
+            }
+            f.emu.failAfter(UINT32_MAX);
+            if (err == ESP_OK) {
+                break;
+            }
+        }
+
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 4) == ESP_OK);
+        uint32_t value;
+        REQUIRE(storage.readItem(1, "key_0", value) == ESP_OK);
+        CHECK(value == 100);
+        REQUIRE(storage.readItem(1, "key_1", value) == ESP_OK);
+        CHECK((value == 1 || value == 101));
+        REQUIRE(storage.readItem(1, "key_99", value) == ESP_OK);
+        CHECK(value == 99);
+    }
+}
+
+TEST_CASE("nvs fast mount doesn't write a summary while a write stream is open", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 4);
+    uint8_t chunk[64];
+    std::fill_n(chunk, sizeof(chunk), 0xa5);
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 4) == ESP_OK);
+        REQUIRE(storage.writeItem(1, "key", 1u) == ESP_OK);
+        BlobStream stream;
+        REQUIRE(storage.openBlobStream(1, "blob", true, stream) == ESP_OK);
+        REQUIRE(storage.writeBlobStream(stream, chunk, sizeof(chunk)) == ESP_OK);
+        // e.g. nvs_commit() on another handle
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        CHECK_FALSE(storage.isSummaryValid());
+        // power goes off before the stream is closed
+    }
+
+    {
+        FastMountStorage storage(&f.part);
+        REQUIRE(storage.init(0, 4) == ESP_OK);
+        CHECK_FALSE(storage.isSummaryValid());
+        // the orphaned chunk was erased by the full load
+        size_t usedEntries;
+        REQUIRE(storage.calcEntriesInNamespace(1, usedEntries) == ESP_OK);
+        CHECK(usedEntries == 1);
+
+        BlobStream stream;
+        REQUIRE(storage.openBlobStream(1, "blob", true, stream) == ESP_OK);
+        REQUIRE(storage.writeBlobStream(stream, chunk, sizeof(chunk)) == ESP_OK);
+        REQUIRE(storage.closeBlobStream(stream, true) == ESP_OK);
+        REQUIRE(storage.writeSummary() == ESP_OK);
+        CHECK(storage.isSummaryValid());
+    }
+}
+
+TEST_CASE("measure mount time with and without summary", "[nvs][benchmark]")
+{
+    const uint32_t pageCounts[] = {16, 128, 512};
+    char key[16];
+
+    for (uint32_t pageCount : pageCounts) {
+        PartitionEmulationFixture f(0, pageCount);
+        // fill 3/4 of the pages, writing them directly is much faster than going through Storage
+        const uint32_t usedPages = pageCount * 3 / 4;
+        for (uint32_t pageIndex = 0; pageIndex < usedPages; ++pageIndex) {
+            Page p;
+            p.load(&f.part, pageIndex);
+            p.setSeqNumber(pageIndex);
+            for (size_t i = pageIndex * Page::ENTRY_COUNT; i < (pageIndex + 1) * Page::ENTRY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                REQUIRE(p.writeItem(1, key, static_cast<uint32_t>(i)) == ESP_OK);
+            }
+            REQUIRE(p.markFull() == ESP_OK);
+        }
+
+        size_t readOps[2];
+        size_t flashTime[2];
+        for (int fastMount = 0; fastMount < 2; ++fastMount) {
+            if (fastMount) {
+                FastMountStorage storage(&f.part);
+                REQUIRE(storage.init(0, pageCount) == ESP_OK);
+                REQUIRE(storage.writeSummary() == ESP_OK);
+            }
+            f.emu.clearStats();
+            FastMountStorage storage(&f.part, fastMount);
+            REQUIRE(storage.init(0, pageCount) == ESP_OK);
+            CHECK(storage.isSummaryValid() == (fastMount != 0));
+            readOps[fastMount] = f.emu.getReadOps();
+            flashTime[fastMount] = f.emu.getTotalTime();
+
+            uint32_t value;
+            REQUIRE(storage.readItem(1, "key_0", value) == ESP_OK);
+            CHECK(value == 0);
+        }
+        CHECK(flashTime[1] < flashTime[0]);
+        s_perf << "Mounting " << pageCount << " pages: " << readOps[0] << " reads, " << flashTime[0] / 1000 << " ms full scan, "
+               << readOps[1] << " reads, " << flashTime[1] / 1000 << " ms with summary" << std::endl;
+    }
+}
+
 /* Add new tests above */
 /* This test has to be the final one */
 
@@ -58,3 +58,80 @@ TEST_CASE("Storage iterator recognizes blob with VerOffset::VER_1_OFFSET", "[nvs
 
     REQUIRE(NVSPartitionManager::get_instance()->deinit_partition("test") == ESP_OK);
 }
+
+TEST_CASE("Storage key index stays consistent when pages are reclaimed", "[nvs_storage]")
+{
+    const uint32_t PAGE_COUNT = 6;
+    const size_t KEY_COUNT = 200;
+    PartitionEmulationFixture f(0, PAGE_COUNT, "test");
+    char key[16];
+
+    {
+        KeyIndexLimitedStorage storage(&f.part, 1024);
+        REQUIRE(storage.init(0, PAGE_COUNT) == ESP_OK);
+        REQUIRE(storage.isKeyIndexActive());
+
+        // overwriting the keys several times forces the page manager to move items to new pages
+        for (uint32_t round = 0; round < 8; ++round) {
+            for (size_t i = 0; i < KEY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+                REQUIRE(storage.writeItem(1, key, static_cast<uint32_t>(i + round)) == ESP_OK);
+            }
+        }
+        for (size_t i = 0; i < KEY_COUNT; i += 3) {
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+            REQUIRE(storage.eraseItem(1, key) == ESP_OK);
+        }
+        CHECK(storage.isKeyIndexActive());
+
+        for (size_t i = 0; i < KEY_COUNT; ++i) {
+            uint32_t value = 0;
+            snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+            if (i % 3 == 0) {
+                CHECK(storage.readItem(1, key, value) == ESP_ERR_NVS_NOT_FOUND);
+            } else {
+                CHECK(storage.readItem(1, key, value) == ESP_OK);
+                CHECK(value == i + 7);
+            }
+        }
+    }
+
+    // a storage without index must see exactly the same contents
+    KeyIndexLimitedStorage scanStorage(&f.part, 0);
+    REQUIRE(scanStorage.init(0, PAGE_COUNT) == ESP_OK);
+    CHECK(!scanStorage.isKeyIndexActive());
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        uint32_t value = 0;
+        snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+        if (i % 3 == 0) {
+            CHECK(scanStorage.readItem(1, key, value) == ESP_ERR_NVS_NOT_FOUND);
+        } else {
+            CHECK(scanStorage.readItem(1, key, value) == ESP_OK);
+            CHECK(value == i + 7);
+        }
+    }
+}
+
+TEST_CASE("Storage falls back to page search if key index limit is exceeded", "[nvs_storage]")
+{
+    const uint32_t PAGE_COUNT = 4;
+    PartitionEmulationFixture f(0, PAGE_COUNT, "test");
+    KeyIndexLimitedStorage storage(&f.part, 64);
+    char key[16];
+
+    REQUIRE(storage.init(0, PAGE_COUNT) == ESP_OK);
+    CHECK(storage.isKeyIndexActive());
+
+    for (uint32_t i = 0; i < 100; ++i) {
+        snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+        REQUIRE(storage.writeItem(1, key, i) == ESP_OK);
+    }
+    CHECK(!storage.isKeyIndexActive());
+
+    for (uint32_t i = 0; i < 100; ++i) {
+        uint32_t value = 0;
+        snprintf(key, sizeof(key), "key_%u", static_cast<unsigned>(i));
+        CHECK(storage.readItem(1, key, value) == ESP_OK);
+        CHECK(value == i);
+    }
+}
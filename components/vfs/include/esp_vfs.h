@@ -68,6 +68,13 @@ typedef struct
     void *sem;              /*!< semaphore instance */
 } esp_vfs_select_sem_t;
 
+/**
+ * @brief Handle of a file descriptor in a poll set, passed to the poll_start function of a VFS driver
+ *
+ * See esp_vfs_poll.h for the poll set API.
+ */
+typedef struct esp_vfs_poll_item* esp_vfs_poll_watch_t;
+
 /**
  * @brief VFS definition structure
  *
@@ -243,6 +250,12 @@ typedef struct
     void* (*get_socket_select_semaphore)(void);
     /** get_socket_select_semaphore returns semaphore allocated in the socket driver; set only for the socket driver */
     esp_err_t (*end_select)(void *end_select_args);
+    /** poll_start is called when a file descriptor of this VFS is added to a poll set; from then on the driver calls esp_vfs_poll_notify() with the given watch when the state of the file descriptor may have changed */
+    esp_err_t (*poll_start)(int fd, esp_vfs_poll_watch_t watch);
+    /** poll_stop is called when the file descriptor is removed from the poll set; the driver must not use the watch after poll_stop returns */
+    void (*poll_stop)(int fd, esp_vfs_poll_watch_t watch);
+    /** poll_state returns the current state of the file descriptor as a combination of POLLIN, POLLOUT, POLLERR and POLLHUP; it is called from task context */
+    uint32_t (*poll_state)(int fd);
 #endif // CONFIG_VFS_SUPPORT_SELECT
 } esp_vfs_t;
 
@@ -431,6 +444,24 @@ void esp_vfs_select_triggered(esp_vfs_select_sem_t sem);
  */
 void esp_vfs_select_triggered_isr(esp_vfs_select_sem_t sem, BaseType_t *woken);
 
+/**
+ * @brief Notification from a VFS driver that the state of a file descriptor in a poll set may have changed
+ *
+ * The poll set then calls the poll_state function of the driver, the next time esp_vfs_poll_wait() runs.
+ * This function may be called from a critical section of the driver.
+ *
+ * @param watch watch which was passed to the driver by the poll_start call
+ */
+void esp_vfs_poll_notify(esp_vfs_poll_watch_t watch);
+
+/**
+ * @brief Notification from a VFS driver that the state of a file descriptor in a poll set may have changed (ISR version)
+ *
+ * @param watch watch which was passed to the driver by the poll_start call
+ * @param woken is set to pdTRUE if the function wakes up a task with higher priority
+ */
+void esp_vfs_poll_notify_isr(esp_vfs_poll_watch_t watch, BaseType_t *woken);
+
 /**
  *
  * @brief Implements the VFS layer of POSIX pread()
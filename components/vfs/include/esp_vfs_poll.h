@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/poll.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file esp_vfs_poll.h
+ *
+ * @brief Persistent poll sets, an alternative to select() for event loops
+ *
+ * select() passes all file descriptors to all VFS drivers on every call, and the drivers
+ * register and unregister their notifications each time. A poll set keeps the file
+ * descriptors registered with the drivers between the calls of esp_vfs_poll_wait().
+ * The drivers mark the file descriptors which may have become ready, so a wait only
+ * checks those. Sockets are checked with one call of the socket driver select function
+ * per wait, with file descriptor sets which are kept up to date by esp_vfs_poll_ctl().
+ *
+ * The events are level-triggered: a file descriptor is returned by every esp_vfs_poll_wait()
+ * call for as long as it is ready.
+ *
+ * Only one task may wait on a poll set at a time. A file descriptor other than a socket
+ * may be added to one poll set at a time. A file descriptor has to be removed from
+ * the poll set before it is closed.
+ *
+ * The VFS driver of a file descriptor needs to implement the poll_start, poll_stop and
+ * poll_state functions of esp_vfs_t, or be the socket driver. This is the case for UART,
+ * eventfd and lwIP sockets.
+ */
+
+/**
+ * @brief Handle of a poll set
+ */
+typedef struct esp_vfs_poll_set* esp_vfs_poll_handle_t;
+
+/**
+ * @brief Operations of esp_vfs_poll_ctl()
+ */
+typedef enum {
+    ESP_VFS_POLL_CTL_ADD,   /*!< Add a file descriptor to the poll set */
+    ESP_VFS_POLL_CTL_MOD,   /*!< Change the events and the user data of a file descriptor in the poll set */
+    ESP_VFS_POLL_CTL_DEL,   /*!< Remove a file descriptor from the poll set */
+} esp_vfs_poll_ctl_op_t;
+
+/**
+ * @brief Event returned by esp_vfs_poll_wait()
+ */
+typedef struct {
+    int fd;             /*!< File descriptor */
+    uint32_t events;    /*!< Combination of POLLIN, POLLOUT, POLLERR and POLLHUP */
+    void *user_data;    /*!< User data given to esp_vfs_poll_ctl() for the file descriptor */
+} esp_vfs_poll_event_t;
+
+/**
+ * @brief Create a poll set
+ *
+ * @param[out] out_set  handle of the new poll set
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if out_set is NULL
+ *      - ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t esp_vfs_poll_create(esp_vfs_poll_handle_t *out_set);
+
+/**
+ * @brief Destroy a poll set
+ *
+ * The file descriptors which are still in the poll set are removed from it.
+ * No task may wait on the poll set.
+ *
+ * @param set  poll set
+ */
+void esp_vfs_poll_destroy(esp_vfs_poll_handle_t set);
+
+/**
+ * @brief Add, change or remove a file descriptor of a poll set
+ *
+ * @param set        poll set
+ * @param op         operation
+ * @param fd         file descriptor
+ * @param events     events to wait for, a combination of POLLIN and POLLOUT.
+ *                   POLLERR and POLLHUP are always reported. Ignored for ESP_VFS_POLL_CTL_DEL.
+ * @param user_data  pointer returned in the events of the file descriptor. Ignored for ESP_VFS_POLL_CTL_DEL.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the file descriptor is not valid, or the arguments are not valid
+ *      - ESP_ERR_INVALID_STATE if the file descriptor is already in the poll set (ADD),
+ *        or it is not in the poll set (MOD, DEL), or the driver can't watch it (e.g. it is
+ *        in another poll set)
+ *      - ESP_ERR_NOT_SUPPORTED if the VFS driver of the file descriptor doesn't support poll sets
+ *      - ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t esp_vfs_poll_ctl(esp_vfs_poll_handle_t set, esp_vfs_poll_ctl_op_t op, int fd, uint32_t events, void *user_data);
+
+/**
+ * @brief Wait until file descriptors of the poll set are ready
+ *
+ * @param set         poll set
+ * @param events      array receiving the events of the ready file descriptors
+ * @param max_events  size of the events array
+ * @param timeout_ms  timeout in milliseconds, -1 to wait forever, 0 to return immediately.
+ *                    The timeout is rounded up to the system tick.
+ *
+ * @return  the number of events stored in the array, 0 on timeout, or -1
+ *          when an error (specified by errno) has occurred
+ */
+int esp_vfs_poll_wait(esp_vfs_poll_handle_t set, esp_vfs_poll_event_t *events, int max_events, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
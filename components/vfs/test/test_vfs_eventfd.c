@@ -19,6 +19,7 @@
 
 #include "driver/timer.h"
 #include "esp_vfs.h"
+#include "esp_vfs_poll.h"
 #include "freertos/FreeRTOS.h"
 #include "unity.h"
 
@@ -355,3 +356,53 @@ TEST_CASE("eventfd multiple selects", "[vfs][eventfd]")
     TEST_ASSERT_EQUAL(0, close(fd));
     TEST_ESP_OK(esp_vfs_eventfd_unregister());
 }
+
+TEST_CASE("eventfd poll set", "[vfs][eventfd]")
+{
+    esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&config));
+
+    int fd0 = eventfd(0, 0);
+    int fd1 = eventfd(0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd1);
+
+    esp_vfs_poll_handle_t set;
+    TEST_ESP_OK(esp_vfs_poll_create(&set));
+    TEST_ESP_OK(esp_vfs_poll_ctl(set, ESP_VFS_POLL_CTL_ADD, fd0, POLLIN, &fd0));
+    TEST_ESP_OK(esp_vfs_poll_ctl(set, ESP_VFS_POLL_CTL_ADD, fd1, POLLIN, &fd1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_poll_ctl(set, ESP_VFS_POLL_CTL_ADD, fd0, POLLIN, NULL));
+
+    esp_vfs_poll_event_t events[2];
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_wait(set, events, 2, 0));
+
+    xTaskCreate(signal_task, "signal_task", 2048, &fd0, 5, NULL);
+    int ret = esp_vfs_poll_wait(set, events, 2, 2000);
+    TEST_ASSERT_EQUAL(1, ret);
+    TEST_ASSERT_EQUAL(fd0, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLIN, events[0].events);
+    TEST_ASSERT_EQUAL_PTR(&fd0, events[0].user_data);
+
+    // level-triggered: reported again until the value is read
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_wait(set, events, 2, 0));
+    uint64_t val;
+    TEST_ASSERT_EQUAL(sizeof(val), read(fd0, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_wait(set, events, 2, 0));
+
+    // POLLOUT is reported after the events are changed
+    TEST_ESP_OK(esp_vfs_poll_ctl(set, ESP_VFS_POLL_CTL_MOD, fd1, POLLIN | POLLOUT, &fd1));
+    ret = esp_vfs_poll_wait(set, events, 2, 0);
+    TEST_ASSERT_EQUAL(1, ret);
+    TEST_ASSERT_EQUAL(fd1, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLOUT, events[0].events);
+
+    TEST_ESP_OK(esp_vfs_poll_ctl(set, ESP_VFS_POLL_CTL_DEL, fd1, 0, NULL));
+    val = 1;
+    TEST_ASSERT_EQUAL(sizeof(val), write(fd1, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_wait(set, events, 2, 0));
+
+    esp_vfs_poll_destroy(set);
+    TEST_ASSERT_EQUAL(0, close(fd0));
+    TEST_ASSERT_EQUAL(0, close(fd1));
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
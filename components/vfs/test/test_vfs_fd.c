@@ -266,3 +266,62 @@ TEST_CASE("Open & write & close through VFS passes performance test", "[vfs]")
 #endif
 
 }
+
+#ifdef CONFIG_VFS_SUPPORT_DIR
+static int time_test_vfs_stat(const char *path, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    return 0;
+}
+
+TEST_CASE("Open & close and stat with all VFS slots in use", "[vfs]")
+{
+    esp_vfs_t desc = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .open = time_test_vfs_open,
+        .close = time_test_vfs_close,
+        .stat = time_test_vfs_stat,
+    };
+
+    /* Fill all free VFS slots, so that path lookups have to choose out of
+     * the maximum number of registered filesystems (8).
+     */
+    char prefixes[8][8];
+    int registered = 0;
+    for (; registered < (int) (sizeof(prefixes) / sizeof(prefixes[0])); ++registered) {
+        snprintf(prefixes[registered], sizeof(prefixes[0]), "/fs%d", registered);
+        if (esp_vfs_register(prefixes[registered], &desc, NULL) != ESP_OK) {
+            break;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, registered);
+    printf("registered %d filesystems\n", registered);
+
+    char paths[8][16];
+    for (int i = 0; i < registered; ++i) {
+        snprintf(paths[i], sizeof(paths[0]), "%s" FILE1, prefixes[i]);
+    }
+
+    const int iter_count = 5000;
+    ccomp_timer_start();
+    for (int i = 0; i < iter_count; ++i) {
+        const int fd = open(paths[i % registered], 0, 0);
+        TEST_ASSERT_NOT_EQUAL(fd, -1);
+        TEST_ASSERT_NOT_EQUAL(close(fd), -1);
+    }
+    int64_t time_diff_us = ccomp_timer_stop();
+    printf("open & close: %d per second\n", (int) (iter_count * 1000000LL / time_diff_us));
+
+    struct stat st;
+    ccomp_timer_start();
+    for (int i = 0; i < iter_count; ++i) {
+        TEST_ASSERT_EQUAL(0, stat(paths[i % registered], &st));
+    }
+    time_diff_us = ccomp_timer_stop();
+    printf("stat: %d per second\n", (int) (iter_count * 1000000LL / time_diff_us));
+
+    for (int i = 0; i < registered; ++i) {
+        TEST_ESP_OK( esp_vfs_unregister(prefixes[i]) );
+    }
+}
+#endif // CONFIG_VFS_SUPPORT_DIR
@@ -14,11 +14,14 @@
 #include <sys/unistd.h>
 #include <sys/lock.h>
 #include <sys/param.h>
+#include <sys/poll.h>
+#include <sys/queue.h>
 #include <dirent.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_vfs.h"
 #include "esp_vfs_private.h"
+#include "esp_vfs_poll.h"
 #include "sdkconfig.h"
 
 #ifdef CONFIG_VFS_SUPPRESS_SELECT_DEBUG_OUTPUT
@@ -46,7 +49,8 @@ typedef struct {
     uint8_t _reserved :5;
     vfs_index_t vfs_index;
     local_fd_t local_fd;
-} fd_table_t;
+} __attribute__((aligned(4))) fd_table_t;
+_Static_assert(sizeof(fd_table_t) == sizeof(uint32_t), "fd_table_t entries must be read with a single load");
 
 typedef struct {
     bool isset; // none or at least one bit is set in the following 3 fd sets
@@ -58,9 +62,88 @@ typedef struct {
 static vfs_entry_t* s_vfs[VFS_MAX_COUNT] = { 0 };
 static size_t s_vfs_count = 0;
 
+// Indices of the VFS entries which have a path prefix, sorted by the prefix length, longest first
+typedef struct {
+    size_t count;
+    vfs_index_t index[VFS_MAX_COUNT];
+} vfs_prefix_table_t;
+
+/* The table is double-buffered, so that get_vfs_for_path() can read it without a lock. The low bit of
+ * s_vfs_by_prefix_gen selects the published copy. update_vfs_by_prefix() fills in the other copy and then
+ * increments s_vfs_by_prefix_gen. A reader which sees the generation change while it scans may have read
+ * a copy being rewritten, and scans again. Writers are serialized by s_vfs_by_prefix_lock.
+ */
+static vfs_prefix_table_t s_vfs_by_prefix[2];
+static uint32_t s_vfs_by_prefix_gen = 0;
+static _lock_t s_vfs_by_prefix_lock;
+
 static fd_table_t s_fd_table[MAX_FDS] = { [0 ... MAX_FDS-1] = FD_TABLE_ENTRY_UNUSED };
 static _lock_t s_fd_table_lock;
 
+// Bit N is set if s_fd_table[N] is in use, protected by s_fd_table_lock
+#define FD_USED_BITS    32
+_Static_assert(MAX_FDS % FD_USED_BITS == 0, "MAX_FDS must be a multiple of FD_USED_BITS");
+static uint32_t s_fd_used[MAX_FDS / FD_USED_BITS];
+
+/* Entries of s_fd_table are written as a whole, with the lock held, and read without the lock.
+ * A single load guarantees that vfs_index and local_fd of the same entry are seen together.
+ */
+static inline fd_table_t fd_table_get(int fd)
+{
+    fd_table_t entry;
+    __atomic_load(&s_fd_table[fd], &entry, __ATOMIC_ACQUIRE);
+    return entry;
+}
+
+// Must be called with s_fd_table_lock held
+static inline void fd_table_set(int fd, fd_table_t entry)
+{
+    __atomic_store(&s_fd_table[fd], &entry, __ATOMIC_RELEASE);
+    if (entry.vfs_index == -1) {
+        s_fd_used[fd / FD_USED_BITS] &= ~(1u << (fd % FD_USED_BITS));
+    } else {
+        s_fd_used[fd / FD_USED_BITS] |= 1u << (fd % FD_USED_BITS);
+    }
+}
+
+// Get the lowest unused file descriptor, or -1 if all are in use. Must be called with s_fd_table_lock held.
+static int fd_table_find_unused(void)
+{
+    for (int i = 0; i < MAX_FDS / FD_USED_BITS; ++i) {
+        if (s_fd_used[i] != UINT32_MAX) {
+            return i * FD_USED_BITS + __builtin_ctz(~s_fd_used[i]);
+        }
+    }
+    return -1;
+}
+
+// Rebuild s_vfs_by_prefix after a VFS has been registered or unregistered
+static void update_vfs_by_prefix(void)
+{
+    _lock_acquire(&s_vfs_by_prefix_lock);
+    const uint32_t gen = s_vfs_by_prefix_gen;
+    vfs_prefix_table_t *table = &s_vfs_by_prefix[(gen + 1) & 1];
+    size_t count = 0;
+    for (size_t i = 0; i < s_vfs_count; ++i) {
+        const vfs_entry_t *vfs = s_vfs[i];
+        if (vfs == NULL || vfs->path_prefix_len == LEN_PATH_PREFIX_IGNORED) {
+            continue;
+        }
+        // insertion sort; entries with equal prefix lengths keep the order of their indices
+        size_t pos = count;
+        while (pos > 0 && s_vfs[table->index[pos - 1]]->path_prefix_len < vfs->path_prefix_len) {
+            table->index[pos] = table->index[pos - 1];
+            --pos;
+        }
+        table->index[pos] = i;
+        ++count;
+    }
+    table->count = count;
+    // publish the copy filled in above
+    __atomic_store_n(&s_vfs_by_prefix_gen, gen + 1, __ATOMIC_RELEASE);
+    _lock_release(&s_vfs_by_prefix_lock);
+}
+
 esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_vfs_t* vfs, void* ctx, int *vfs_index)
 {
     if (len != LEN_PATH_PREFIX_IGNORED) {
@@ -100,6 +183,7 @@ esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_v
     entry->path_prefix_len = len;
     entry->ctx = ctx;
     entry->offset = index;
+    update_vfs_by_prefix();
 
     if (vfs_index) {
         *vfs_index = index;
@@ -131,16 +215,14 @@ esp_err_t esp_vfs_register_fd_range(const esp_vfs_t *vfs, void *ctx, int min_fd,
                 s_vfs[i] = NULL;
                 for (int j = min_fd; j < i; ++j) {
                     if (s_fd_table[j].vfs_index == index) {
-                        s_fd_table[j] = FD_TABLE_ENTRY_UNUSED;
+                        fd_table_set(j, FD_TABLE_ENTRY_UNUSED);
                     }
                 }
                 _lock_release(&s_fd_table_lock);
                 ESP_LOGD(TAG, "esp_vfs_register_fd_range cannot set fd %d (used by other VFS)", i);
                 return ESP_ERR_INVALID_ARG;
             }
-            s_fd_table[i].permanent = true;
-            s_fd_table[i].vfs_index = index;
-            s_fd_table[i].local_fd = i;
+            fd_table_set(i, (fd_table_t) { .permanent = true, .vfs_index = index, .local_fd = i });
         }
         _lock_release(&s_fd_table_lock);
     }
@@ -166,14 +248,15 @@ esp_err_t esp_vfs_unregister_with_id(esp_vfs_id_t vfs_id)
         return ESP_ERR_INVALID_ARG;
     }
     vfs_entry_t* vfs = s_vfs[vfs_id];
-    free(vfs);
     s_vfs[vfs_id] = NULL;
+    update_vfs_by_prefix();
+    free(vfs);
 
     _lock_acquire(&s_fd_table_lock);
     // Delete all references from the FD lookup-table
     for (int j = 0; j < VFS_MAX_COUNT; ++j) {
         if (s_fd_table[j].vfs_index == vfs_id) {
-            s_fd_table[j] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_set(j, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -212,19 +295,15 @@ esp_err_t esp_vfs_register_fd_with_local_fd(esp_vfs_id_t vfs_id, int local_fd, b
 
     esp_err_t ret = ESP_ERR_NO_MEM;
     _lock_acquire(&s_fd_table_lock);
-    for (int i = 0; i < MAX_FDS; ++i) {
-        if (s_fd_table[i].vfs_index == -1) {
-            s_fd_table[i].permanent = permanent;
-            s_fd_table[i].vfs_index = vfs_id;
-            if (local_fd >= 0) {
-                s_fd_table[i].local_fd = local_fd;
-            } else {
-                s_fd_table[i].local_fd = i;
-            }
-            *fd = i;
-            ret = ESP_OK;
-            break;
-        }
+    int i = fd_table_find_unused();
+    if (i >= 0) {
+        fd_table_set(i, (fd_table_t) {
+            .permanent = permanent,
+            .vfs_index = vfs_id,
+            .local_fd = (local_fd >= 0) ? local_fd : i
+        });
+        *fd = i;
+        ret = ESP_OK;
     }
     _lock_release(&s_fd_table_lock);
 
@@ -246,7 +325,7 @@ esp_err_t esp_vfs_unregister_fd(esp_vfs_id_t vfs_id, int fd)
     _lock_acquire(&s_fd_table_lock);
     fd_table_t *item = s_fd_table + fd;
     if (item->permanent == true && item->vfs_index == vfs_id && item->local_fd == fd) {
-        *item = FD_TABLE_ENTRY_UNUSED;
+        fd_table_set(fd, FD_TABLE_ENTRY_UNUSED);
         ret = ESP_OK;
     }
     _lock_release(&s_fd_table_lock);
@@ -270,27 +349,22 @@ static inline bool fd_valid(int fd)
     return (fd < MAX_FDS) && (fd >= 0);
 }
 
-static const vfs_entry_t *get_vfs_for_fd(int fd)
+// Get the VFS and the local file descriptor for a global file descriptor, without locking.
+// Returns NULL if the file descriptor is not in use.
+static const vfs_entry_t *get_vfs_for_fd(int fd, int *local_fd)
 {
     const vfs_entry_t *vfs = NULL;
+    *local_fd = -1;
     if (fd_valid(fd)) {
-        const int index = s_fd_table[fd].vfs_index; // single read -> no locking is required
-        vfs = get_vfs_for_index(index);
+        const fd_table_t entry = fd_table_get(fd); // single read -> no locking is required
+        vfs = get_vfs_for_index(entry.vfs_index);
+        if (vfs) {
+            *local_fd = entry.local_fd;
+        }
     }
     return vfs;
 }
 
-static inline int get_local_fd(const vfs_entry_t *vfs, int fd)
-{
-    int local_fd = -1;
-
-    if (vfs && fd_valid(fd)) {
-        local_fd = s_fd_table[fd].local_fd; // single read -> no locking is required
-    }
-
-    return local_fd;
-}
-
 static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 {
     assert(strncmp(src_path, vfs->path_prefix, vfs->path_prefix_len) == 0);
@@ -303,42 +377,41 @@ static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 
 const vfs_entry_t* get_vfs_for_path(const char* path)
 {
-    const vfs_entry_t* best_match = NULL;
-    ssize_t best_match_prefix_len = -1;
     size_t len = strlen(path);
-    for (size_t i = 0; i < s_vfs_count; ++i) {
-        const vfs_entry_t* vfs = s_vfs[i];
-        if (!vfs || vfs->path_prefix_len == LEN_PATH_PREFIX_IGNORED) {
-            continue;
-        }
-        // match path prefix
-        if (len < vfs->path_prefix_len ||
-            memcmp(path, vfs->path_prefix, vfs->path_prefix_len) != 0) {
-            continue;
-        }
-        // this is the default VFS and we don't have a better match yet.
-        if (vfs->path_prefix_len == 0 && !best_match) {
-            best_match = vfs;
-            continue;
-        }
-        // if path is not equal to the prefix, expect to see a path separator
-        // i.e. don't match "/data" prefix for "/data1/foo.txt" path
-        if (len > vfs->path_prefix_len &&
-                path[vfs->path_prefix_len] != '/') {
-            continue;
-        }
-        // Out of all matching path prefixes, select the longest one;
-        // i.e. if "/dev" and "/dev/uart" both match, for "/dev/uart/1" path,
-        // choose "/dev/uart",
-        // This causes all s_vfs_count VFS entries to be scanned when opening
-        // a file by name. This can be optimized by introducing a table for
-        // FS search order, sorted so that longer prefixes are checked first.
-        if (best_match_prefix_len < (ssize_t) vfs->path_prefix_len) {
-            best_match_prefix_len = (ssize_t) vfs->path_prefix_len;
-            best_match = vfs;
+    // Out of all matching path prefixes, select the longest one;
+    // i.e. if "/dev" and "/dev/uart" both match, for "/dev/uart/1" path,
+    // choose "/dev/uart". Prefixes are checked from the longest one, so the
+    // first match is the best one. The default VFS (empty prefix) is checked last.
+    const vfs_entry_t* found;
+    uint32_t gen;
+    do {
+        found = NULL;
+        gen = __atomic_load_n(&s_vfs_by_prefix_gen, __ATOMIC_ACQUIRE);
+        const vfs_prefix_table_t *table = &s_vfs_by_prefix[gen & 1];
+        const size_t count = MIN(table->count, VFS_MAX_COUNT);
+        for (size_t i = 0; i < count; ++i) {
+            const vfs_entry_t* vfs = s_vfs[table->index[i]];
+            if (!vfs) {
+                continue;
+            }
+            // match path prefix
+            if (len < vfs->path_prefix_len ||
+                memcmp(path, vfs->path_prefix, vfs->path_prefix_len) != 0) {
+                continue;
+            }
+            // if path is not equal to the prefix, expect to see a path separator
+            // i.e. don't match "/data" prefix for "/data1/foo.txt" path
+            if (vfs->path_prefix_len > 0 && len > vfs->path_prefix_len &&
+                    path[vfs->path_prefix_len] != '/') {
+                continue;
+            }
+            found = vfs;
+            break;
         }
-    }
-    return best_match;
+        // the table must be read before the generation is checked again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&s_vfs_by_prefix_gen, __ATOMIC_RELAXED) != gen);
+    return found;
 }
 
 /*
@@ -399,14 +472,11 @@ int esp_vfs_open(struct _reent *r, const char * path, int flags, int mode)
     CHECK_AND_CALL(fd_within_vfs, r, vfs, open, path_within_vfs, flags, mode);
     if (fd_within_vfs >= 0) {
         _lock_acquire(&s_fd_table_lock);
-        for (int i = 0; i < MAX_FDS; ++i) {
-            if (s_fd_table[i].vfs_index == -1) {
-                s_fd_table[i].permanent = false;
-                s_fd_table[i].vfs_index = vfs->offset;
-                s_fd_table[i].local_fd = fd_within_vfs;
-                _lock_release(&s_fd_table_lock);
-                return i;
-            }
+        int i = fd_table_find_unused();
+        if (i >= 0) {
+            fd_table_set(i, (fd_table_t) { .permanent = false, .vfs_index = vfs->offset, .local_fd = fd_within_vfs });
+            _lock_release(&s_fd_table_lock);
+            return i;
         }
         _lock_release(&s_fd_table_lock);
         int ret;
@@ -421,8 +491,8 @@ int esp_vfs_open(struct _reent *r, const char * path, int flags, int mode)
 
 ssize_t esp_vfs_write(struct _reent *r, int fd, const void * data, size_t size)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -434,8 +504,8 @@ ssize_t esp_vfs_write(struct _reent *r, int fd, const void * data, size_t size)
 
 off_t esp_vfs_lseek(struct _reent *r, int fd, off_t size, int mode)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -447,8 +517,8 @@ off_t esp_vfs_lseek(struct _reent *r, int fd, off_t size, int mode)
 
 ssize_t esp_vfs_read(struct _reent *r, int fd, void * dst, size_t size)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -461,8 +531,8 @@ ssize_t esp_vfs_read(struct _reent *r, int fd, void * dst, size_t size)
 ssize_t esp_vfs_pread(int fd, void *dst, size_t size, off_t offset)
 {
     struct _reent *r = __getreent();
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -475,8 +545,8 @@ ssize_t esp_vfs_pread(int fd, void *dst, size_t size, off_t offset)
 ssize_t esp_vfs_pwrite(int fd, const void *src, size_t size, off_t offset)
 {
     struct _reent *r = __getreent();
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -488,8 +558,8 @@ ssize_t esp_vfs_pwrite(int fd, const void *src, size_t size, off_t offset)
 
 int esp_vfs_close(struct _reent *r, int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -502,7 +572,7 @@ int esp_vfs_close(struct _reent *r, int fd)
         if (s_fd_table[fd].has_pending_select) {
             s_fd_table[fd].has_pending_close = true;
         } else {
-            s_fd_table[fd] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_set(fd, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -511,8 +581,8 @@ int esp_vfs_close(struct _reent *r, int fd)
 
 int esp_vfs_fstat(struct _reent *r, int fd, struct stat * st)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -524,8 +594,8 @@ int esp_vfs_fstat(struct _reent *r, int fd, struct stat * st)
 
 int esp_vfs_fcntl_r(struct _reent *r, int fd, int cmd, int arg)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -537,8 +607,8 @@ int esp_vfs_fcntl_r(struct _reent *r, int fd, int cmd, int arg)
 
 int esp_vfs_ioctl(int fd, int cmd, ...)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -554,8 +624,8 @@ int esp_vfs_ioctl(int fd, int cmd, ...)
 
 int esp_vfs_fsync(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1046,7 +1116,7 @@ int esp_vfs_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *errorfds
     _lock_acquire(&s_fd_table_lock);
     for (int fd = 0; fd < nfds; ++fd) {
         if (s_fd_table[fd].has_pending_close) {
-            s_fd_table[fd] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_set(fd, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -1100,14 +1170,445 @@ void esp_vfs_select_triggered_isr(esp_vfs_select_sem_t sem, BaseType_t *woken)
     }
 }
 
+/*
+ * Poll sets
+ *
+ * A poll set keeps its file descriptors registered with the VFS drivers between the calls of esp_vfs_poll_wait().
+ * The drivers put the items of the file descriptors which may have become ready in the ready list of the set (through
+ * esp_vfs_poll_notify), so that a wait only queries the state of those. Sockets don't have such a notification,
+ * they are checked by one socket_select() call with the cached socket FD sets of the set.
+ */
+
+typedef struct esp_vfs_poll_item {
+    int fd;                                         // global file descriptor
+    int local_fd;
+    uint32_t events;
+    void *user_data;
+    const vfs_entry_t *vfs;
+    struct esp_vfs_poll_set *set;
+    bool is_socket;
+    bool in_ready;                                  // the item is in the ready list, protected by set->spinlock
+    TAILQ_ENTRY(esp_vfs_poll_item) ready_entries;
+    TAILQ_ENTRY(esp_vfs_poll_item) socket_entries;
+} poll_item_t;
+
+TAILQ_HEAD(poll_item_list, esp_vfs_poll_item);
+
+struct esp_vfs_poll_set {
+    _lock_t lock;                                   // protects everything except for the members below the spinlock
+    poll_item_t *items[MAX_FDS];                    // items indexed by the global file descriptor
+    struct poll_item_list sockets;
+    const vfs_entry_t *socket_vfs;
+    int socket_nfds;
+    fd_set socket_readfds;
+    fd_set socket_writefds;
+    fd_set socket_errorfds;
+    SemaphoreHandle_t sem;                          // the waiter blocks on it when there are no sockets
+    portMUX_TYPE spinlock;
+    struct poll_item_list ready;
+    void *socket_sem;                               // set while the waiter blocks in socket_select()
+    const vfs_entry_t *socket_sem_vfs;              // socket driver of socket_sem
+};
+
+static void poll_set_wake(struct esp_vfs_poll_set *set, BaseType_t *woken)
+{
+    portENTER_CRITICAL_SAFE(&set->spinlock);
+    void *socket_sem = set->socket_sem;
+    const vfs_entry_t *socket_vfs = set->socket_sem_vfs;
+    portEXIT_CRITICAL_SAFE(&set->spinlock);
+
+    if (woken) {
+        if (socket_sem) {
+            socket_vfs->vfs.stop_socket_select_isr(socket_sem, woken);
+        } else {
+            xSemaphoreGiveFromISR(set->sem, woken);
+        }
+    } else {
+        if (socket_sem) {
+            socket_vfs->vfs.stop_socket_select(socket_sem);
+        } else {
+            xSemaphoreGive(set->sem);
+        }
+    }
+}
+
+static void poll_item_mark_ready(poll_item_t *item)
+{
+    struct esp_vfs_poll_set *set = item->set;
+    portENTER_CRITICAL_SAFE(&set->spinlock);
+    if (!item->in_ready) {
+        item->in_ready = true;
+        TAILQ_INSERT_TAIL(&set->ready, item, ready_entries);
+    }
+    portEXIT_CRITICAL_SAFE(&set->spinlock);
+}
+
+void esp_vfs_poll_notify(esp_vfs_poll_watch_t watch)
+{
+    poll_item_mark_ready(watch);
+    poll_set_wake(watch->set, NULL);
+}
+
+void esp_vfs_poll_notify_isr(esp_vfs_poll_watch_t watch, BaseType_t *woken)
+{
+    BaseType_t local_woken = pdFALSE;
+    poll_item_mark_ready(watch);
+    poll_set_wake(watch->set, &local_woken);
+    if (woken) {
+        *woken = (local_woken || *woken);
+    }
+}
+
+esp_err_t esp_vfs_poll_create(esp_vfs_poll_handle_t *out_set)
+{
+    if (out_set == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_vfs_poll_set *set = calloc(1, sizeof(struct esp_vfs_poll_set));
+    if (set == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    set->sem = xSemaphoreCreateBinary();
+    if (set->sem == NULL) {
+        free(set);
+        return ESP_ERR_NO_MEM;
+    }
+    _lock_init(&set->lock);
+    TAILQ_INIT(&set->sockets);
+    TAILQ_INIT(&set->ready);
+    portMUX_INITIALIZE(&set->spinlock);
+    *out_set = set;
+    return ESP_OK;
+}
+
+static void poll_socket_fd_sets_update(struct esp_vfs_poll_set *set, poll_item_t *item)
+{
+    FD_CLR(item->fd, &set->socket_readfds);
+    FD_CLR(item->fd, &set->socket_writefds);
+    FD_CLR(item->fd, &set->socket_errorfds);
+    if (item->events & POLLIN) {
+        FD_SET(item->fd, &set->socket_readfds);
+    }
+    if (item->events & POLLOUT) {
+        FD_SET(item->fd, &set->socket_writefds);
+    }
+    FD_SET(item->fd, &set->socket_errorfds);
+}
+
+static void poll_item_remove(struct esp_vfs_poll_set *set, poll_item_t *item)
+{
+    if (item->is_socket) {
+        FD_CLR(item->fd, &set->socket_readfds);
+        FD_CLR(item->fd, &set->socket_writefds);
+        FD_CLR(item->fd, &set->socket_errorfds);
+        TAILQ_REMOVE(&set->sockets, item, socket_entries);
+        if (item->fd + 1 == set->socket_nfds) {
+            set->socket_nfds = 0;
+            poll_item_t *it;
+            TAILQ_FOREACH(it, &set->sockets, socket_entries) {
+                set->socket_nfds = MAX(set->socket_nfds, it->fd + 1);
+            }
+        }
+        if (TAILQ_EMPTY(&set->sockets)) {
+            set->socket_vfs = NULL;
+        }
+    } else {
+        // after poll_stop returns, the driver doesn't notify about the item anymore
+        item->vfs->vfs.poll_stop(item->local_fd, item);
+        portENTER_CRITICAL(&set->spinlock);
+        if (item->in_ready) {
+            TAILQ_REMOVE(&set->ready, item, ready_entries);
+            item->in_ready = false;
+        }
+        portEXIT_CRITICAL(&set->spinlock);
+    }
+    set->items[item->fd] = NULL;
+    free(item);
+}
+
+void esp_vfs_poll_destroy(esp_vfs_poll_handle_t set)
+{
+    if (set == NULL) {
+        return;
+    }
+    _lock_acquire(&set->lock);
+    for (int fd = 0; fd < MAX_FDS; ++fd) {
+        if (set->items[fd]) {
+            poll_item_remove(set, set->items[fd]);
+        }
+    }
+    _lock_release(&set->lock);
+    _lock_close(&set->lock);
+    vSemaphoreDelete(set->sem);
+    free(set);
+}
+
+static esp_err_t poll_item_add(struct esp_vfs_poll_set *set, int fd, uint32_t events, void *user_data)
+{
+    int local_fd;
+    const vfs_entry_t *vfs = get_vfs_for_fd(fd, &local_fd);
+    if (vfs == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const bool is_socket = (vfs->vfs.socket_select != NULL);
+    if (is_socket) {
+        if (set->socket_vfs != NULL && set->socket_vfs != vfs) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    } else if (vfs->vfs.poll_start == NULL || vfs->vfs.poll_stop == NULL || vfs->vfs.poll_state == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    poll_item_t *item = calloc(1, sizeof(poll_item_t));
+    if (item == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    item->fd = fd;
+    item->local_fd = local_fd;
+    item->events = events;
+    item->user_data = user_data;
+    item->vfs = vfs;
+    item->set = set;
+    item->is_socket = is_socket;
+
+    if (is_socket) {
+        set->socket_vfs = vfs;
+        TAILQ_INSERT_TAIL(&set->sockets, item, socket_entries);
+        set->socket_nfds = MAX(set->socket_nfds, fd + 1);
+        poll_socket_fd_sets_update(set, item);
+        set->items[fd] = item;
+        // the waiter might be blocked in socket_select() with the previous FD sets
+        poll_set_wake(set, NULL);
+    } else {
+        esp_err_t err = vfs->vfs.poll_start(local_fd, item);
+        if (err != ESP_OK) {
+            free(item);
+            return err;
+        }
+        set->items[fd] = item;
+        // the file descriptor may be ready already
+        esp_vfs_poll_notify(item);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_poll_ctl(esp_vfs_poll_handle_t set, esp_vfs_poll_ctl_op_t op, int fd, uint32_t events, void *user_data)
+{
+    if (set == NULL || fd < 0 || fd >= MAX_FDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    _lock_acquire(&set->lock);
+    poll_item_t *item = set->items[fd];
+    switch (op) {
+        case ESP_VFS_POLL_CTL_ADD:
+            ret = item ? ESP_ERR_INVALID_STATE : poll_item_add(set, fd, events, user_data);
+            break;
+        case ESP_VFS_POLL_CTL_MOD:
+            if (item == NULL) {
+                ret = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            item->events = events;
+            item->user_data = user_data;
+            if (item->is_socket) {
+                poll_socket_fd_sets_update(set, item);
+                poll_set_wake(set, NULL);
+            } else {
+                esp_vfs_poll_notify(item);
+            }
+            break;
+        case ESP_VFS_POLL_CTL_DEL:
+            if (item == NULL) {
+                ret = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            poll_item_remove(set, item);
+            break;
+        default:
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+    }
+    _lock_release(&set->lock);
+    return ret;
+}
+
+// Queries the drivers about the items in the ready list. Items which are still ready are put back to the end of
+// the list, so that the next wait reports them again, after the items which didn't fit into the events array.
+// Called with set->lock held.
+static int poll_collect_ready(struct esp_vfs_poll_set *set, esp_vfs_poll_event_t *events, int max_events)
+{
+    struct poll_item_list candidates = TAILQ_HEAD_INITIALIZER(candidates);
+    struct poll_item_list still_ready = TAILQ_HEAD_INITIALIZER(still_ready);
+    portENTER_CRITICAL(&set->spinlock);
+    TAILQ_CONCAT(&candidates, &set->ready, ready_entries);
+    portEXIT_CRITICAL(&set->spinlock);
+
+    int count = 0;
+    poll_item_t *item;
+    while (count < max_events && (item = TAILQ_FIRST(&candidates)) != NULL) {
+        // once in_ready is cleared, a notification from the driver puts the item to the ready list again
+        portENTER_CRITICAL(&set->spinlock);
+        TAILQ_REMOVE(&candidates, item, ready_entries);
+        item->in_ready = false;
+        portEXIT_CRITICAL(&set->spinlock);
+
+        const uint32_t state = item->vfs->vfs.poll_state(item->local_fd) & (item->events | POLLERR | POLLHUP);
+        if (state) {
+            events[count].fd = item->fd;
+            events[count].events = state;
+            events[count].user_data = item->user_data;
+            ++count;
+            portENTER_CRITICAL(&set->spinlock);
+            if (!item->in_ready) {
+                item->in_ready = true;
+                TAILQ_INSERT_TAIL(&still_ready, item, ready_entries);
+            }
+            portEXIT_CRITICAL(&set->spinlock);
+        }
+    }
+
+    // the remaining candidates first, then the items notified in the meantime, then the reported ones
+    portENTER_CRITICAL(&set->spinlock);
+    TAILQ_CONCAT(&candidates, &set->ready, ready_entries);
+    TAILQ_CONCAT(&candidates, &still_ready, ready_entries);
+    TAILQ_CONCAT(&set->ready, &candidates, ready_entries);
+    portEXIT_CRITICAL(&set->spinlock);
+    return count;
+}
+
+// Reports the sockets set in the given FD sets. Called with set->lock held.
+static int poll_collect_sockets(struct esp_vfs_poll_set *set, const fd_set *readfds, const fd_set *writefds,
+                                const fd_set *errorfds, esp_vfs_poll_event_t *events, int max_events)
+{
+    int count = 0;
+    poll_item_t *item;
+    TAILQ_FOREACH(item, &set->sockets, socket_entries) {
+        if (count == max_events) {
+            break;
+        }
+        uint32_t state = 0;
+        if (FD_ISSET(item->fd, readfds)) {
+            state |= POLLIN;
+        }
+        if (FD_ISSET(item->fd, writefds)) {
+            state |= POLLOUT;
+        }
+        if (FD_ISSET(item->fd, errorfds)) {
+            state |= POLLERR;
+        }
+        if (state) {
+            events[count].fd = item->fd;
+            events[count].events = state;
+            events[count].user_data = item->user_data;
+            ++count;
+        }
+    }
+    return count;
+}
+
+int esp_vfs_poll_wait(esp_vfs_poll_handle_t set, esp_vfs_poll_event_t *events, int max_events, int timeout_ms)
+{
+    struct _reent* r = __getreent();
+    if (set == NULL || events == NULL || max_events <= 0) {
+        __errno_r(r) = EINVAL;
+        return -1;
+    }
+
+    // Round up the number of ticks and add 1, the same as esp_vfs_select() does
+    const bool wait_forever = (timeout_ms < 0);
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = wait_forever ? 0 : ((timeout_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) + 1;
+    bool timed_out = (timeout_ms == 0);
+
+    while (true) {
+        _lock_acquire(&set->lock);
+        int ret = poll_collect_ready(set, events, max_events);
+
+        fd_set readfds, writefds, errorfds;
+        const vfs_entry_t *socket_vfs = set->socket_vfs;
+        const int socket_nfds = set->socket_nfds;
+        if (socket_vfs != NULL && ret < max_events) {
+            readfds = set->socket_readfds;
+            writefds = set->socket_writefds;
+            errorfds = set->socket_errorfds;
+            struct timeval tv = { 0 };
+            int socket_ret = socket_vfs->vfs.socket_select(socket_nfds, &readfds, &writefds, &errorfds, &tv);
+            if (socket_ret < 0) {
+                _lock_release(&set->lock);
+                return -1;
+            }
+            if (socket_ret > 0) {
+                ret += poll_collect_sockets(set, &readfds, &writefds, &errorfds, events + ret, max_events - ret);
+            }
+        }
+        if (ret > 0 || timed_out) {
+            _lock_release(&set->lock);
+            return ret;
+        }
+
+        TickType_t ticks_to_wait = portMAX_DELAY;
+        if (!wait_forever) {
+            const TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= ticks) {
+                _lock_release(&set->lock);
+                return 0;
+            }
+            ticks_to_wait = ticks - elapsed;
+        }
+
+        if (socket_vfs == NULL) {
+            // a notification which arrives between here and the take leaves the semaphore given
+            _lock_release(&set->lock);
+            timed_out = (xSemaphoreTake(set->sem, ticks_to_wait) != pdTRUE);
+            continue;
+        }
+
+        // Publish the socket semaphore, so that the notifications interrupt socket_select(). The ready list is
+        // checked in the same critical section, a notification comes either before or after.
+        readfds = set->socket_readfds;
+        writefds = set->socket_writefds;
+        errorfds = set->socket_errorfds;
+        void *socket_sem = socket_vfs->vfs.get_socket_select_semaphore();
+        portENTER_CRITICAL(&set->spinlock);
+        const bool has_ready = !TAILQ_EMPTY(&set->ready);
+        if (!has_ready) {
+            set->socket_sem = socket_sem;
+            set->socket_sem_vfs = socket_vfs;
+        }
+        portEXIT_CRITICAL(&set->spinlock);
+        _lock_release(&set->lock);
+        if (has_ready) {
+            continue;
+        }
+
+        struct timeval tv = {
+            .tv_sec = (ticks_to_wait * portTICK_PERIOD_MS) / 1000,
+            .tv_usec = ((ticks_to_wait * portTICK_PERIOD_MS) % 1000) * 1000,
+        };
+        int socket_ret = socket_vfs->vfs.socket_select(socket_nfds, &readfds, &writefds, &errorfds,
+                                                       wait_forever ? NULL : &tv);
+        portENTER_CRITICAL(&set->spinlock);
+        set->socket_sem = NULL;
+        portEXIT_CRITICAL(&set->spinlock);
+        if (socket_ret < 0) {
+            return -1;
+        }
+        // the sockets and the ready list are checked again at the beginning of the loop
+        timed_out = (socket_ret == 0 && !wait_forever &&
+                     xTaskGetTickCount() - start >= ticks);
+    }
+}
+
 #endif // CONFIG_VFS_SUPPORT_SELECT
 
 #ifdef CONFIG_VFS_SUPPORT_TERMIOS
 
 int tcgetattr(int fd, struct termios *p)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1120,8 +1621,8 @@ int tcgetattr(int fd, struct termios *p)
 
 int tcsetattr(int fd, int optional_actions, const struct termios *p)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1134,8 +1635,8 @@ int tcsetattr(int fd, int optional_actions, const struct termios *p)
 
 int tcdrain(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1148,8 +1649,8 @@ int tcdrain(int fd)
 
 int tcflush(int fd, int select)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1162,8 +1663,8 @@ int tcflush(int fd, int select)
 
 int tcflow(int fd, int action)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1176,8 +1677,8 @@ int tcflow(int fd, int action)
 
 pid_t tcgetsid(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1190,8 +1691,8 @@ pid_t tcgetsid(int fd)
 
 int tcsendbreak(int fd, int duration)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
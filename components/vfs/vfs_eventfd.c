@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/lock.h>
+#include <sys/poll.h>
 #include <sys/select.h>
 #include <sys/types.h>
 
@@ -67,6 +68,8 @@ typedef struct {
     volatile uint64_t       value;
     // a double-linked list for all pending select args with this fd
     event_select_args_t     *select_args;
+    // poll set watching this fd, see esp_vfs_poll.h
+    esp_vfs_poll_watch_t    poll_watch;
     _lock_t                 lock;
     // only for event fds that support ISR.
     spinlock_t              data_spin_lock;
@@ -84,6 +87,11 @@ static void trigger_select_for_event(event_context_t *event)
         esp_vfs_select_triggered(select_args->signal_sem);
         select_args = select_args->next_in_fd;
     }
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    if (event->poll_watch != NULL) {
+        esp_vfs_poll_notify(event->poll_watch);
+    }
+#endif
 }
 
 static void trigger_select_for_event_isr(event_context_t *event, BaseType_t *task_woken)
@@ -95,6 +103,11 @@ static void trigger_select_for_event_isr(event_context_t *event, BaseType_t *tas
         *task_woken = (local_woken || *task_woken);
         select_args = select_args->next_in_fd;
     }
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    if (event->poll_watch != NULL) {
+        esp_vfs_poll_notify_isr(event->poll_watch, task_woken);
+    }
+#endif
 }
 
 #ifdef CONFIG_VFS_SUPPORT_SELECT
@@ -220,6 +233,85 @@ static esp_err_t event_end_select(void *end_select_args)
 
     return ESP_OK;
 }
+
+static esp_err_t event_poll_start(int fd, esp_vfs_poll_watch_t watch)
+{
+    esp_err_t error = ESP_OK;
+
+    if (fd >= s_event_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    _lock_acquire_recursive(&s_events[fd].lock);
+    if (s_events[fd].support_isr) {
+        portENTER_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+
+    if (s_events[fd].fd != fd) {
+        error = ESP_ERR_INVALID_ARG;
+    } else if (s_events[fd].poll_watch != NULL) { // watched by another poll set
+        error = ESP_ERR_INVALID_STATE;
+    } else {
+        s_events[fd].poll_watch = watch;
+    }
+
+    if (s_events[fd].support_isr) {
+        portEXIT_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+    _lock_release_recursive(&s_events[fd].lock);
+
+    return error;
+}
+
+static void event_poll_stop(int fd, esp_vfs_poll_watch_t watch)
+{
+    if (fd >= s_event_size) {
+        return;
+    }
+
+    _lock_acquire_recursive(&s_events[fd].lock);
+    if (s_events[fd].support_isr) {
+        portENTER_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+
+    // the watch is already cleared if the fd has been closed
+    if (s_events[fd].poll_watch == watch) {
+        s_events[fd].poll_watch = NULL;
+    }
+
+    if (s_events[fd].support_isr) {
+        portEXIT_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+    _lock_release_recursive(&s_events[fd].lock);
+}
+
+static uint32_t event_poll_state(int fd)
+{
+    // event fds are always writable
+    uint32_t state = POLLOUT;
+
+    if (fd >= s_event_size) {
+        return POLLNVAL;
+    }
+
+    _lock_acquire_recursive(&s_events[fd].lock);
+    if (s_events[fd].support_isr) {
+        portENTER_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+
+    if (s_events[fd].fd != fd) { // already closed
+        state |= POLLERR | POLLHUP;
+    } else if (s_events[fd].is_set) {
+        state |= POLLIN;
+    }
+
+    if (s_events[fd].support_isr) {
+        portEXIT_CRITICAL(&s_events[fd].data_spin_lock);
+    }
+    _lock_release_recursive(&s_events[fd].lock);
+
+    return state;
+}
 #endif // CONFIG_VFS_SUPPORT_SELECT
 
 static ssize_t signal_event_fd_from_isr(int fd, const void *data, size_t size)
@@ -342,6 +434,13 @@ static int event_close(int fd)
             s_events[fd].fd = FD_PENDING_SELECT;
             trigger_select_for_event(&s_events[fd]);
         }
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+        if (s_events[fd].poll_watch != NULL) {
+            // let the poll set report the error, the fd may be reused by the next eventfd() call
+            esp_vfs_poll_notify(s_events[fd].poll_watch);
+            s_events[fd].poll_watch = NULL;
+        }
+#endif
         s_events[fd].value = 0;
         if (s_events[fd].support_isr) {
             portEXIT_CRITICAL(&s_events[fd].data_spin_lock);
@@ -379,6 +478,9 @@ esp_err_t esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t *config)
 #ifdef CONFIG_VFS_SUPPORT_SELECT
         .start_select = &event_start_select,
         .end_select   = &event_end_select,
+        .poll_start   = &event_poll_start,
+        .poll_stop    = &event_poll_stop,
+        .poll_state   = &event_poll_state,
 #endif
     };
     return esp_vfs_register_with_id(&vfs, NULL, &s_eventfd_vfs_id);
@@ -437,6 +539,7 @@ int eventfd(unsigned int initval, int flags)
             s_events[i].is_set = false;
             s_events[i].value = initval;
             s_events[i].select_args = NULL;
+            s_events[i].poll_watch = NULL;
             if (support_isr) {
                 portEXIT_CRITICAL(&s_events[i].data_spin_lock);
             }
@@ -11,6 +11,7 @@
 #include <sys/lock.h>
 #include <sys/fcntl.h>
 #include <sys/param.h>
+#include <sys/poll.h>
 #include "esp_vfs.h"
 #include "esp_vfs_dev.h"
 #include "esp_attr.h"
@@ -121,6 +122,8 @@ typedef struct {
 static uart_select_args_t **s_registered_selects = NULL;
 static int s_registered_select_num = 0;
 static portMUX_TYPE s_registered_select_lock = portMUX_INITIALIZER_UNLOCKED;
+// poll sets watching the UARTs, protected by s_registered_select_lock
+static esp_vfs_poll_watch_t s_poll_watch[UART_NUM] = { 0 };
 
 static esp_err_t uart_end_select(void *end_select_args);
 
@@ -422,6 +425,9 @@ static void select_notif_callback_isr(uart_port_t uart_num, uart_select_notif_t
             }
         }
     }
+    if (uart_select_notif != UART_SELECT_WRITE_NOTIF && s_poll_watch[uart_num] != NULL) {
+        esp_vfs_poll_notify_isr(s_poll_watch[uart_num], task_woken);
+    }
     portEXIT_CRITICAL_ISR(&s_registered_select_lock);
 }
 
@@ -496,7 +502,8 @@ static esp_err_t uart_end_select(void *end_select_args)
     portENTER_CRITICAL(uart_get_selectlock());
     esp_err_t ret = unregister_select(args);
     for (int i = 0; i < UART_NUM; ++i) {
-        uart_set_select_notif_callback(i, NULL);
+        // keep the callback of the UARTs watched by a poll set
+        uart_set_select_notif_callback(i, s_poll_watch[i] ? select_notif_callback_isr : NULL);
     }
     portEXIT_CRITICAL(uart_get_selectlock());
 
@@ -507,6 +514,66 @@ static esp_err_t uart_end_select(void *end_select_args)
     return ret;
 }
 
+static esp_err_t uart_poll_start(int fd, esp_vfs_poll_watch_t watch)
+{
+    if (fd < 0 || fd >= UART_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!uart_is_driver_installed(fd)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(uart_get_selectlock());
+    portENTER_CRITICAL(&s_registered_select_lock);
+    if (s_poll_watch[fd] != NULL) { // watched by another poll set
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        s_poll_watch[fd] = watch;
+        uart_set_select_notif_callback(fd, select_notif_callback_isr);
+    }
+    portEXIT_CRITICAL(&s_registered_select_lock);
+    portEXIT_CRITICAL(uart_get_selectlock());
+    return ret;
+}
+
+static void uart_poll_stop(int fd, esp_vfs_poll_watch_t watch)
+{
+    if (fd < 0 || fd >= UART_NUM) {
+        return;
+    }
+
+    portENTER_CRITICAL(uart_get_selectlock());
+    portENTER_CRITICAL(&s_registered_select_lock);
+    if (s_poll_watch[fd] == watch) {
+        s_poll_watch[fd] = NULL;
+        if (s_registered_select_num == 0) {
+            uart_set_select_notif_callback(fd, NULL);
+        }
+    }
+    portEXIT_CRITICAL(&s_registered_select_lock);
+    portEXIT_CRITICAL(uart_get_selectlock());
+}
+
+static uint32_t uart_poll_state(int fd)
+{
+    if (fd < 0 || fd >= UART_NUM) {
+        return POLLNVAL;
+    }
+    if (!uart_is_driver_installed(fd)) {
+        return POLLERR | POLLHUP;
+    }
+
+    // the driver buffers the data to be sent, writes block only when its TX buffer is full
+    uint32_t state = POLLOUT;
+    size_t buffered_size;
+    if (s_ctx[fd]->peek_char != NONE ||
+            (uart_get_buffered_data_len(fd, &buffered_size) == ESP_OK && buffered_size > 0)) {
+        state |= POLLIN;
+    }
+    return state;
+}
+
 #endif // CONFIG_VFS_SUPPORT_SELECT
 
 #ifdef CONFIG_VFS_SUPPORT_TERMIOS
@@ -976,6 +1043,9 @@ static const esp_vfs_t vfs = {
 #ifdef CONFIG_VFS_SUPPORT_SELECT
     .start_select = &uart_start_select,
     .end_select = &uart_end_select,
+    .poll_start = &uart_poll_start,
+    .poll_stop = &uart_poll_stop,
+    .poll_state = &uart_poll_state,
 #endif // CONFIG_VFS_SUPPORT_SELECT
 #ifdef CONFIG_VFS_SUPPORT_TERMIOS
     .tcsetattr = &uart_tcsetattr,
@@ -25,6 +25,11 @@ static const char *TAG = "wl_flash";
 #define WL_CFG_CRC_CONST UINT32_MAX
 #endif // WL_CFG_CRC_CONST
 
+// Number of position records read from flash at once when the position is recovered
+#ifndef WL_POS_READ_RECORDS
+#define WL_POS_READ_RECORDS 32
+#endif // WL_POS_READ_RECORDS
+
 #define WL_RESULT_CHECK(result) \
     if (result != ESP_OK) { \
         ESP_LOGE(TAG,"%s(%d): result = 0x%08x", __FUNCTION__, __LINE__, result); \
@@ -249,17 +254,43 @@ esp_err_t WL_Flash::recoverPos()
     esp_err_t result = ESP_OK;
     size_t position = 0;
     ESP_LOGV(TAG, "%s start", __func__);
+    // The position is only read from the flash here, at mount. From then on state.pos is kept
+    // in memory and updateWL() advances it, so the flash is never read again to find it.
+    // Read the position records in blocks, checking a record doesn't need a flash access then.
+    // If the buffer can't be allocated, read them one by one into temp_buff.
+    size_t block_records = WL_POS_READ_RECORDS;
+    uint8_t *pos_buff = (uint8_t *)malloc(block_records * this->cfg.wr_size);
+    if (pos_buff == NULL) {
+        block_records = 1;
+    }
+    size_t block_start = 0;
+    size_t block_count = 0;
     for (size_t i = 0; i < this->state.max_pos; i++) {
         bool pos_bits;
         position = i;
-        result = this->flash_drv->read(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
+        if (i >= block_start + block_count) {
+            block_start = i;
+            block_count = this->state.max_pos - i;
+            if (block_count > block_records) {
+                block_count = block_records;
+            }
+            result = this->flash_drv->read(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size,
+                                           pos_buff ? pos_buff : this->temp_buff, block_count * this->cfg.wr_size);
+            if (result != ESP_OK) {
+                break;
+            }
+        }
+        if (pos_buff) {
+            memcpy(this->temp_buff, pos_buff + (i - block_start) * this->cfg.wr_size, this->cfg.wr_size);
+        }
         pos_bits = this->OkBuffSet(i);
-        WL_RESULT_CHECK(result);
         ESP_LOGV(TAG, "%s - check pos: result=0x%08x, position= %i, pos_bits= 0x%08x", __func__, (uint32_t)result, (uint32_t)position, (uint32_t)pos_bits);
         if (pos_bits == false) {
             break; // we have found position
         }
     }
+    free(pos_buff);
+    WL_RESULT_CHECK(result);
 
     this->state.pos = position;
     if (this->state.pos == this->state.max_pos) {
@@ -527,6 +558,18 @@ size_t WL_Flash::calcAddr(size_t addr)
 }
 
 
+size_t WL_Flash::calcRunSize(size_t addr, size_t size)
+{
+    // Logical pages are mapped to consecutive physical pages, except where the mapping
+    // wraps around the end of the memory and at the dummy block, so the runs are long.
+    size_t virt_addr = this->calcAddr(addr);
+    size_t run_size = (size < this->cfg.page_size) ? size : this->cfg.page_size;
+    while (run_size < size && this->calcAddr(addr + run_size) == virt_addr + run_size) {
+        run_size += (size - run_size < this->cfg.page_size) ? size - run_size : this->cfg.page_size;
+    }
+    return run_size;
+}
+
 size_t WL_Flash::chip_size()
 {
     if (!this->configured) {
@@ -581,15 +624,15 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.page_size);
-        result = this->flash_drv->write(this->cfg.start_addr + virt_addr, &((uint8_t *)src)[i * this->cfg.page_size], this->cfg.page_size);
+    // Write each run of physically consecutive pages with one call
+    size_t offset = 0;
+    while (offset < size) {
+        size_t virt_addr = this->calcAddr(dest_addr + offset);
+        size_t run_size = this->calcRunSize(dest_addr + offset, size - offset);
+        result = this->flash_drv->write(this->cfg.start_addr + virt_addr, &((uint8_t *)src)[offset], run_size);
         WL_RESULT_CHECK(result);
+        offset += run_size;
     }
-    size_t virt_addr_last = this->calcAddr(dest_addr + count * this->cfg.page_size);
-    result = this->flash_drv->write(this->cfg.start_addr + virt_addr_last, &((uint8_t *)src)[count * this->cfg.page_size], size - count * this->cfg.page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
@@ -600,16 +643,16 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(src_addr + i * this->cfg.page_size);
-        ESP_LOGV(TAG, "%s - real_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) (this->cfg.start_addr + virt_addr), (uint32_t) size);
-        result = this->flash_drv->read(this->cfg.start_addr + virt_addr, &((uint8_t *)dest)[i * this->cfg.page_size], this->cfg.page_size);
+    // Read each run of physically consecutive pages with one call
+    size_t offset = 0;
+    while (offset < size) {
+        size_t virt_addr = this->calcAddr(src_addr + offset);
+        size_t run_size = this->calcRunSize(src_addr + offset, size - offset);
+        ESP_LOGV(TAG, "%s - real_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) (this->cfg.start_addr + virt_addr), (uint32_t) run_size);
+        result = this->flash_drv->read(this->cfg.start_addr + virt_addr, &((uint8_t *)dest)[offset], run_size);
         WL_RESULT_CHECK(result);
+        offset += run_size;
     }
-    size_t virt_addr_last = this->calcAddr(src_addr + count * this->cfg.page_size);
-    result = this->flash_drv->read(this->cfg.start_addr + virt_addr_last, &((uint8_t *)dest)[count * this->cfg.page_size], size - count * this->cfg.page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
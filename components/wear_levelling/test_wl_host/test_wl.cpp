@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <chrono>
+#include <utility>
 
 #include "esp_spi_flash.h"
 #include "esp_partition.h"
 #include "wear_levelling.h"
 #include "WL_Flash.h"
+#include "Partition.h"
 #include "SpiFlash.h"
 
 #include "catch.hpp"
@@ -17,6 +20,65 @@ extern SpiFlash spiflash;
 
 #define TEST_COUNT_MAX 100
 
+/* Counts the calls of the flash driver used by WL_Flash */
+class CountingFlash : public Flash_Access
+{
+public:
+    CountingFlash(Flash_Access *flash) : flash(flash) {}
+
+    size_t chip_size() override
+    {
+        return flash->chip_size();
+    }
+    size_t sector_size() override
+    {
+        return flash->sector_size();
+    }
+    esp_err_t erase_sector(size_t sector) override
+    {
+        erases++;
+        return flash->erase_sector(sector);
+    }
+    esp_err_t erase_range(size_t start_address, size_t size) override
+    {
+        erases++;
+        return flash->erase_range(start_address, size);
+    }
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override
+    {
+        writes++;
+        return flash->write(dest_addr, src, size);
+    }
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override
+    {
+        reads++;
+        return flash->read(src_addr, dest, size);
+    }
+    void reset()
+    {
+        reads = writes = erases = 0;
+    }
+
+    Flash_Access *flash;
+    size_t reads = 0;
+    size_t writes = 0;
+    size_t erases = 0;
+};
+
+/* Same configuration as wl_mount() uses */
+static void init_wl_config(wl_config_t *cfg, const esp_partition_t *partition)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->full_mem_size = partition->size;
+    cfg->start_addr = 0;
+    cfg->version = 2;
+    cfg->sector_size = SPI_FLASH_SEC_SIZE;
+    cfg->page_size = SPI_FLASH_SEC_SIZE;
+    cfg->updaterate = 16;
+    cfg->temp_buff_size = 32;
+    cfg->wr_size = 16;
+}
+
 TEST_CASE("write and read back data", "[wear_levelling]")
 {
     _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
@@ -208,3 +270,131 @@ TEST_CASE("power down test", "[wear_levelling]")
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
 }
+
+TEST_CASE("sequential reads and writes use one flash call per contiguous run", "[wear_levelling]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    CountingFlash counting(&part);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+
+    WL_Flash *wl = new WL_Flash();
+    REQUIRE(wl->config(&cfg, &counting) == ESP_OK);
+    REQUIRE(wl->init() == ESP_OK);
+
+    const size_t wl_size = wl->chip_size();
+    const size_t sector_size = wl->sector_size();
+    uint8_t *data = (uint8_t *) malloc(wl_size);
+    uint8_t *read = (uint8_t *) malloc(wl_size);
+    uint8_t *sector = (uint8_t *) malloc(sector_size);
+    for (size_t i = 0; i < wl_size; i++) {
+        data[i] = i * 7 + i / sector_size;
+    }
+    REQUIRE(wl->erase_range(0, wl_size) == ESP_OK);
+    REQUIRE(wl->write(0, data, wl_size) == ESP_OK);
+
+    // Move the dummy block through the memory, and compare the data read at once with the data read by sectors
+    for (int round = 0; round < 40; round++) {
+        for (int i = 0; i < 16 * 5; i++) {
+            // erasing and writing back a sector moves the dummy block once per updaterate erases
+            size_t s = (round * 13 + i) % (wl_size / sector_size);
+            REQUIRE(wl->erase_sector(s) == ESP_OK);
+            REQUIRE(wl->write(s * sector_size, data + s * sector_size, sector_size) == ESP_OK);
+        }
+        counting.reset();
+        REQUIRE(wl->read(0, read, wl_size) == ESP_OK);
+        // the memory is split into at most 3 runs: by the wrap around and by the dummy block
+        CHECK(counting.reads <= 3);
+        REQUIRE(memcmp(data, read, wl_size) == 0);
+        for (size_t s = 0; s < wl_size / sector_size; s += 7) {
+            REQUIRE(wl->read(s * sector_size, sector, sector_size) == ESP_OK);
+            REQUIRE(memcmp(data + s * sector_size, sector, sector_size) == 0);
+        }
+    }
+
+    // Recovering the position after a restart reads the position records in blocks
+    for (int i = 0; i < 16 * 100; i++) {
+        REQUIRE(wl->erase_sector(0) == ESP_OK);
+    }
+    REQUIRE(wl->write(0, data, sector_size) == ESP_OK);
+    delete wl;
+    wl = new WL_Flash();
+    REQUIRE(wl->config(&cfg, &counting) == ESP_OK);
+    counting.reset();
+    REQUIRE(wl->init() == ESP_OK);
+    printf("init after moving the dummy block: %zu flash reads\n", counting.reads);
+    CHECK(counting.reads < 20);
+    REQUIRE(wl->read(0, read, wl_size) == ESP_OK);
+    REQUIRE(memcmp(data, read, wl_size) == 0);
+
+    delete wl;
+    free(data);
+    free(read);
+    free(sector);
+}
+
+TEST_CASE("32 KB sequential reads and writes", "[wear_levelling][bench]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    CountingFlash counting(&part);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+    WL_Flash wl;
+    REQUIRE(wl.config(&cfg, &counting) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+
+    const size_t block_size = 32 * 1024;
+    const size_t block_count = wl.chip_size() / block_size;
+    const size_t sector_size = wl.sector_size();
+    uint8_t *block = (uint8_t *) malloc(block_size);
+    memset(block, 0x5a, block_size);
+
+    const size_t total_size = block_count * block_size;
+    const int rounds = 20;
+
+    // Writes and reads the memory in 32 KB blocks, passing chunk_size bytes per call of WL_Flash.
+    // With chunk_size equal to the sector size, this is the way the blocks used to be split.
+    auto measure = [&](size_t chunk_size) {
+        REQUIRE(wl.erase_range(0, total_size) == ESP_OK);
+        counting.reset();
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < block_count; i++) {
+                for (size_t offset = 0; offset < block_size; offset += chunk_size) {
+                    REQUIRE(wl.write(i * block_size + offset, block + offset, chunk_size) == ESP_OK);
+                }
+            }
+        }
+        std::chrono::duration<double> write_time = std::chrono::steady_clock::now() - start;
+        const size_t writes = counting.writes;
+
+        counting.reset();
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < block_count; i++) {
+                for (size_t offset = 0; offset < block_size; offset += chunk_size) {
+                    REQUIRE(wl.read(i * block_size + offset, block + offset, chunk_size) == ESP_OK);
+                }
+            }
+        }
+        std::chrono::duration<double> read_time = std::chrono::steady_clock::now() - start;
+        const size_t reads = counting.reads;
+
+        printf("32 KB blocks in %zu byte calls: %zu flash writes, %.1f MB/s, %zu flash reads, %.1f MB/s\n",
+               chunk_size, writes / rounds, rounds * total_size / write_time.count() / 1e6,
+               reads / rounds, rounds * total_size / read_time.count() / 1e6);
+        return std::make_pair(writes / rounds, reads / rounds);
+    };
+
+    measure(sector_size);
+    auto calls = measure(block_size);
+    // one call per block, except for the block containing the dummy block;
+    // the position of the dummy block is kept in memory, so no state is read
+    CHECK(calls.first <= block_count + 1);
+    CHECK(calls.second <= block_count + 1);
+    free(block);
+}
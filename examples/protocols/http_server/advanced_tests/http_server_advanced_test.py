@@ -62,6 +62,9 @@ def test_examples_protocol_http_server_advanced(env, extra_data):
     max_hdr_len = int(result[2])
     max_uri_len = int(result[3])
     max_stack_size = int(result[4])
+    result = dut1.expect(re.compile(r"(?:[\s\S]*)Worker Tasks: '(\d+)'(?:[\s\S]*)Slow Handler Delay: '(\d+)'"), timeout=15)
+    workers = int(result[0])
+    slow_delay_ms = int(result[1])
 
     Utility.console_log('Got IP   : ' + got_ip)
     Utility.console_log('Got Port : ' + got_port)
@@ -75,6 +78,11 @@ def test_examples_protocol_http_server_advanced(env, extra_data):
         Utility.console_log('Ignoring failure')
     if not client.parallel_sessions_adder(got_ip, got_port, max_sessions):
         Utility.console_log('Ignoring failure')
+    slow_rate = client.slow_handler_load_test(got_ip, got_port, max_sessions, workers, slow_delay_ms)
+    if slow_rate:
+        ttfw_idf.log_performance('http_server_slow_handler_requests_per_sec', '{:.1f}'.format(slow_rate))
+    else:
+        Utility.console_log('Ignoring failure')
     if not client.leftover_data_test(got_ip, got_port):
         failed = True
     if not client.async_response_test(got_ip, got_port):
@@ -11,6 +11,12 @@ static const char *TAG = "TESTS";
 
 static int pre_start_mem, post_stop_mem;
 
+/* The URI handlers run on this many worker tasks */
+#define TEST_WORKER_COUNT       3
+
+/* Time taken by the /slow handler */
+#define SLOW_HANDLER_DELAY_MS   200
+
 struct async_resp_arg {
     httpd_handle_t hd;
     int fd;
@@ -278,6 +284,17 @@ static void generate_async_resp(void *arg)
     free(arg);
 }
 
+/* This handler stands for one waiting on a peripheral, e.g. a flash read or a
+ * sensor query. The load test measures how many of these run in parallel. */
+static esp_err_t slow_get_handler(httpd_req_t *req)
+{
+#define STR "Slow Hello World!"
+    vTaskDelay(pdMS_TO_TICKS(SLOW_HANDLER_DELAY_MS));
+    httpd_resp_send(req, STR, HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+#undef STR
+}
+
 static esp_err_t async_get_handler(httpd_req_t *req)
 {
 #define STR "Hello World!"
@@ -344,6 +361,11 @@ static const httpd_uri_t basic_handlers[] = {
       .method   = HTTP_GET,
       .handler  = async_get_handler,
       .user_ctx = NULL,
+    },
+    { .uri      = "/slow",
+      .method   = HTTP_GET,
+      .handler  = slow_get_handler,
+      .user_ctx = NULL,
     }
 };
 
@@ -369,8 +391,9 @@ static httpd_handle_t test_httpd_start(void)
     httpd_handle_t hd;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     /* Modify this setting to match the number of test URI handlers */
-    config.max_uri_handlers  = 9;
+    config.max_uri_handlers  = 10;
     config.server_port = 1234;
+    config.worker_count = TEST_WORKER_COUNT;
 
     /* This check should be a part of http_server */
     config.max_open_sockets = (CONFIG_LWIP_MAX_SOCKETS - 3);
@@ -382,6 +405,8 @@ static httpd_handle_t test_httpd_start(void)
         ESP_LOGI(TAG, "Max Header Length: '%d'", HTTPD_MAX_REQ_HDR_LEN);
         ESP_LOGI(TAG, "Max URI Length: '%d'", HTTPD_MAX_URI_LEN);
         ESP_LOGI(TAG, "Max Stack Size: '%d'", config.stack_size);
+        ESP_LOGI(TAG, "Worker Tasks: '%d'", config.worker_count);
+        ESP_LOGI(TAG, "Slow Handler Delay: '%d'", SLOW_HANDLER_DELAY_MS);
         return hd;
     }
     return NULL;
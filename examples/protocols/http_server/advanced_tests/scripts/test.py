@@ -341,6 +341,27 @@ class adder_thread (threading.Thread):
         self.session.close()
 
 
+class slow_thread (threading.Thread):
+    def __init__(self, dut, port, count):
+        threading.Thread.__init__(self)
+        self.count = count
+        self.session = Session(dut, port)
+        self.responses = 0
+
+    def run(self):
+        # Requests one after the other on the same session
+        for _ in range(self.count):
+            if not self.session.send_get('/slow'):
+                return
+            self.session.read_resp_hdrs()
+            if self.session.status != '200' or self.session.read_resp_data() != 'Slow Hello World!':
+                return
+            self.responses += 1
+
+    def close(self):
+        self.session.close()
+
+
 def get_hello(dut, port):
     # GET /hello should return 'Hello World!'
     Utility.console_log("[test] GET /hello returns 'Hello World!' =>", end=' ')
@@ -537,6 +558,41 @@ def parallel_sessions_adder(dut, port, max_sessions):
     return res
 
 
+def slow_handler_load_test(dut, port, sessions, workers, delay_ms, count=5):
+    # GETs on /slow, whose handler takes delay_ms, in parallel sessions.
+    # With worker tasks, up to `workers` handlers run at the same time.
+    Utility.console_log('[test] GET /slow ' + str(count) + ' times in ' + str(sessions) + ' sessions with '
+                        + str(workers) + ' worker tasks =>', end=' ')
+    t = []
+    for i in range(sessions):
+        t.append(slow_thread(dut, port, count))
+
+    start = time.time()
+    for i in range(len(t)):
+        t[i].start()
+    for i in range(len(t)):
+        t[i].join()
+    elapsed = time.time() - start
+
+    res = True
+    for i in range(len(t)):
+        if not test_val('Thread' + str(i) + ' responses', count, t[i].responses):
+            res = False
+        t[i].close()
+    if not res:
+        return None
+
+    # One handler at a time takes sessions * count * delay_ms
+    serial_time = sessions * count * delay_ms / 1000.0
+    Utility.console_log('{:.2f} s, {:.1f} requests/s, {:.1f}x the serial rate'.format(
+                        elapsed, sessions * count / elapsed, serial_time / elapsed))
+    if workers > 1 and sessions > 1 and elapsed > 0.75 * serial_time:
+        Utility.console_log('Fail! Handlers of the sessions did not run in parallel')
+        return None
+    Utility.console_log('Success')
+    return sessions * count / elapsed
+
+
 def async_response_test(dut, port):
     # Test that an asynchronous work is executed in the HTTPD's context
     # This is tested by reading two responses over the same session
@@ -980,6 +1036,8 @@ if __name__ == '__main__':
     max_sessions = 7
     max_uri_len = 512
     max_hdr_len = 512
+    workers = 3
+    slow_delay_ms = 200
 
     parser = argparse.ArgumentParser(description='Run HTTPD Test')
     parser.add_argument('-4','--ipv4', help='IPv4 address')
@@ -1023,6 +1081,7 @@ if __name__ == '__main__':
 
     Utility.console_log('### Sessions and Context Tests')
     parallel_sessions_adder(dut, port, max_sessions)
+    slow_handler_load_test(dut, port, max_sessions, workers, slow_delay_ms)
     leftover_data_test(dut, port)
     async_response_test(dut, port)
     spillover_session(dut, port, max_sessions)
@@ -87,6 +87,21 @@ def test_examples_protocol_http_server_file_serving(env, extra_data):  # type: (
     if download_file_digest != upload_file_digest:
         raise RuntimeError('The md5 hash of the downloaded file does not match with that of the uploaded file')
 
+    # Download a part of the file, then check that an unchanged file isn't sent again
+    Utility.console_log('\nTesting for Range and If-None-Match requests to the file server')
+    conn.request('GET', '/' + str(upload_file_name), headers={'Range': 'bytes=5-8'})
+    resp = conn.getresponse()
+    range_data = resp.read()
+    if resp.status != 206 or range_data != upload_data[5:9].encode('UTF-8'):
+        raise RuntimeError('Wrong response to Range request: {} {}'.format(resp.status, range_data))
+    etag = resp.getheader('ETag')
+    conn.request('GET', '/' + str(upload_file_name), headers={'If-None-Match': etag})
+    resp = conn.getresponse()
+    resp.read()
+    if resp.status != 304:
+        raise RuntimeError('Expected 304 Not Modified, got {}'.format(resp.status))
+    Utility.console_log('Passed the test for Range and If-None-Match requests to the file server')
+
     # Upload existing file on the file server
     Utility.console_log("\nTesting the upload of \"already existing\" file on the file server")
     client.postreq(conn, '/upload/' + str(upload_file_name), data=None)